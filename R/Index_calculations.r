@@ -119,13 +119,18 @@
 #'   this will determine the index used for the visualization.
 #'   
 #' @param minsamp an \code{integer} indicating the minimum number of individuals
-#'   to resample for rarefaction analysis. See \code{\link[vegan]{rarefy}} for 
+#'   to resample for rarefaction analysis. See \code{\link{rarefy_mlg}} for 
 #'   details.
 #'   
 #' @param legend \code{logical}. When this is set to \code{TRUE}, a legend 
 #'   describing the resulting table columns will be printed. Defaults to 
 #'   \code{FALSE}
 #'   
+#' @param threads The maximum number of parallel threads to be used to
+#'   calculate Hexp and the index of association for all populations. Defaults
+#'   to 1, which runs serially. A value of 0 will attempt to use as many
+#'   threads as there are available cores/CPUs.
+#'   
 #' @param ... arguments to be passed on to \code{\link{diversity_stats}}
 #'   
 #' @return A data frame with populations in rows and the following columns:
@@ -167,8 +172,15 @@
 #'   \code{\link{diversity_ci}}.}
 #'   \subsection{rarefaction}{Rarefaction analysis is performed on the number of
 #'   multilocus genotypes because it is relatively easy to estimate (Grünwald et
-#'   al., 2003). To obtain rarefied estimates of diversity, it is possible to
-#'   use \code{\link{diversity_ci}} with the argument \code{rarefy = TRUE}}
+#'   al., 2003). The expected number of MLGs and its standard error are
+#'   calculated exactly with \code{\link{rarefy_mlg}}. To obtain rarefied
+#'   estimates of diversity, it is possible to use \code{\link{diversity_ci}}
+#'   with the argument \code{rarefy = TRUE}}
+#'   \subsection{computation}{Hexp, Ia, and rbarD are calculated for all
+#'   populations at once in compiled code from the allele table of the whole
+#'   data set, without creating a separate object for each population. When
+#'   \code{sample > 0}, the permutation tests are still performed on each
+#'   population separately.}
 #'   \subsection{graphic}{This function outputs a \pkg{ggplot2} graphic of
 #'   histograms. These can be manipulated to be visualized in another manner by
 #'   retrieving the plot with the \code{\link{last_plot}} command from
@@ -307,7 +319,7 @@ poppr <- function(dat, total = TRUE, sublist = "ALL", exclude = NULL, blacklist
                   sample = 0, method = 1, missing = "ignore", cutoff = 0.05, 
                   quiet = FALSE, clonecorrect = FALSE, strata = 1, keep = 1, 
                   plot = TRUE, hist = TRUE, index = "rbarD", minsamp = 10, 
-                  legend = FALSE, ...){
+                  legend = FALSE, threads = 1L, ...){
 
   if (inherits(dat, c("genlight", "snpclone"))){
     msg <- "The poppr function will not work with genlight or snpclone objects"
@@ -345,28 +357,28 @@ poppr <- function(dat, total = TRUE, sublist = "ALL", exclude = NULL, blacklist
   } else {
     namelist$File <- basename(x$X)
   }
+  pdrop <- if (x$GENIND@type == "PA") FALSE else TRUE
   if (toupper(sublist[1]) == "TOTAL" & length(sublist) == 1){
-    dat           <- x$GENIND
-    pop(dat)      <- rep("Total", nInd(dat))
-    poplist       <- NULL
-    poplist$Total <- dat
+    dat      <- x$GENIND
+    pop(dat) <- rep("Total", nInd(dat))
+    popindex <- list(Total = seq_len(nInd(dat)))
   } else {
     dat <- popsub(x$GENIND, sublist = sublist, exclude = exclude)
     if (any(levels(pop(dat)) == "")) {
       levels(pop(dat))[levels(pop(dat)) == ""] <- "?"
       warning("missing population factor replaced with '?'")
     }
-    pdrop   <- if (dat$type == "PA") FALSE else TRUE
-    poplist <- if (is.null(pop(dat))) NULL else seppop(dat, drop = pdrop)
+    # Populations are represented by the indices of their samples.
+    popindex <- if (is.null(pop(dat))) NULL else split(seq_len(nInd(dat)), pop(dat))
   }
 
   # Creating the genotype matrix for vegan's diversity analysis.
   pop.mat <- mlg.matrix(dat)
-  if (total == TRUE & !is.null(poplist) & length(poplist) > 1){
-    poplist$Total <- dat
-    pop.mat       <- rbind(pop.mat, colSums(pop.mat))
+  if (total == TRUE & !is.null(popindex) & length(popindex) > 1){
+    popindex$Total <- seq_len(nInd(dat))
+    pop.mat        <- rbind(pop.mat, colSums(pop.mat))
   }
-  sublist <- names(poplist)
+  sublist <- names(popindex)
   Iout    <- NULL
   total   <- toupper(total)
   missing <- toupper(missing)
@@ -375,41 +387,38 @@ poppr <- function(dat, total = TRUE, sublist = "ALL", exclude = NULL, blacklist
   
   MLG.vec <- rowSums(ifelse(pop.mat > 0, 1, 0))
   N.vec   <- rowSums(pop.mat)
-  datploid <- unique(ploidy(dat))
-  Hexp_correction <- 1
-  if (length(datploid) > 1 || any(datploid > 2)){
-    datploid <- NULL
-    Hexp_correction <- N.vec/(N.vec - 1)
-  }
   divmat <- diversity_stats(pop.mat, ...)
   if (!is.matrix(divmat)){
     divmat <- matrix(divmat, nrow = 1, dimnames = list(NULL, names(divmat)))
   }
+  # Hexp, Ia, and rbarD for all populations in a single call.
+  sumindex <- if (is.null(popindex)) list(Total = seq_len(nInd(dat))) else popindex
+  summat   <- poppr_summary_native(dat, sumindex, missing = missing, 
+                                   threads = threads)
   
-  if (!is.null(poplist)){
+  if (!is.null(popindex)){
     # rarefaction giving the standard errors. This will use the minimum pop size
     # above a user-defined threshold.
     raremax <- ifelse(is.null(nrow(pop.mat)), sum(pop.mat), 
                       ifelse(min(rowSums(pop.mat)) > minsamp, 
                              min(rowSums(pop.mat)), minsamp))
 
-    Hexp <- vapply(lapply(poplist, pegas::as.loci), FUN = get_hexp_from_loci, 
-                   FUN.VALUE = numeric(1), ploidy = datploid, type = dat@type)
-
-    Hexp   <- data.frame(Hexp = Hexp)
-    N.rare <- suppressWarnings(vegan::rarefy(pop.mat, raremax, se = TRUE))
-    IaList <- lapply(sublist, function(x){
-      namelist <- list(file = namelist$File, population = x)
-      .ia(poplist[[x]], 
-          sample = sample, 
-          method = method,
-          quiet = quiet, 
-          missing = missing, 
-          hist = FALSE,
-          namelist = namelist)
-    })    
-    names(IaList) <- sublist
+    Hexp   <- data.frame(Hexp = summat[, "Hexp"])
+    N.rare <- rarefy_mlg(pop.mat, raremax)
     if (sample > 0){
+      # Permutation tests still need each population as a separate object.
+      IaList <- lapply(sublist, function(x){
+        namelist <- list(file = namelist$File, population = x)
+        .ia(dat[popindex[[x]], , drop = pdrop], 
+            sample = sample, 
+            method = method,
+            quiet = quiet, 
+            missing = missing, 
+            hist = FALSE,
+            namelist = namelist,
+            threads = threads)
+      })    
+      names(IaList) <- sublist
       classtest <- summary(IaList)
       classless <- !classtest[, "Class"] %in% "ialist"
       if (any(classless)){
@@ -424,7 +433,7 @@ poppr <- function(dat, total = TRUE, sublist = "ALL", exclude = NULL, blacklist
       }
       IaList <- data.frame(t(vapply(IaList, "[[", numeric(4), "index")))
     } else {
-      IaList <- t(as.data.frame(IaList))
+      IaList <- summat[, c("Ia", "rbarD"), drop = FALSE]
     }
     Iout <- as.data.frame(
       list(
@@ -444,19 +453,22 @@ poppr <- function(dat, total = TRUE, sublist = "ALL", exclude = NULL, blacklist
   } else { 
     # rarefaction giving the standard errors. No population structure means that
     # the sample is equal to the number of individuals.
-    N.rare <- rarefy(pop.mat, sum(pop.mat), se = TRUE)
-    Hexp   <- get_hexp_from_loci(pegas::as.loci(dat), 
-                                 ploidy = datploid, type = dat@type)
-    Hexp   <- data.frame(Hexp = Hexp)
-    IaList <-.ia(dat, 
-                 sample = sample, 
-                 method = method, 
-                 quiet = quiet,
-                 missing = missing, 
-                 namelist = list(File = namelist$File, population = "Total"),
-                 hist = plot
-                )
-    IaList <- if (sample > 0) IaList$index else IaList
+    N.rare <- rarefy_mlg(pop.mat, sum(pop.mat))
+    Hexp   <- data.frame(Hexp = summat[, "Hexp"])
+    if (sample > 0){
+      IaList <-.ia(dat, 
+                   sample = sample, 
+                   method = method, 
+                   quiet = quiet,
+                   missing = missing, 
+                   namelist = list(File = namelist$File, population = "Total"),
+                   hist = plot,
+                   threads = threads
+                  )
+      IaList <- IaList$index
+    } else {
+      IaList <- summat[1, c("Ia", "rbarD")]
+    }
     Iout <- as.data.frame(list(
       Pop = "Total",
       N = N.vec,
@@ -569,6 +581,11 @@ poppr.all <- function(filelist, ...){
 #'   reshuffled data is returned. If \code{FALSE} (default), the index is 
 #'   returned with associated p-values in a 4 element numeric vector.
 #'   
+#' @param threads (for ia) the maximum number of parallel threads to be used
+#'   for the permutations of codominant data. Defaults to 1, which runs
+#'   serially. A value of 0 will attempt to use as many threads as there are
+#'   available cores/CPUs. The results do not depend on the number of threads.
+#'   
 #' @return 
 #'   \subsection{for \code{pair.ia}}{
 #'   A matrix with two columns and choose(nLoc(gid), 2) rows representing the
@@ -761,7 +778,8 @@ poppr.all <- function(filelist, ...){
 #' }
 #==============================================================================#
 ia <- function(gid, sample = 0, method = 1, quiet = FALSE, missing = "ignore", 
-               plot = TRUE, hist = TRUE, index = "rbarD", valuereturn = FALSE){
+               plot = TRUE, hist = TRUE, index = "rbarD", valuereturn = FALSE,
+               threads = 1L){
   namelist <- list(population = ifelse(nPop(gid) > 1 | is.null(gid@pop), 
                                        "Total", popNames(gid)),
                    File = as.character(match.call()[2])
@@ -808,7 +826,8 @@ ia <- function(gid, sample = 0, method = 1, quiet = FALSE, missing = "ignore",
     }
     progressr::with_progress({
       samp <- .sampling(
-        popx, sample, missing, quiet = quiet, type = type, method = method
+        if (type == "PA") popx else gid, sample, missing, quiet = quiet, 
+        type = type, method = method, threads = threads
       )
     })
     p.val    <- sum(IarD[1] <= c(samp$Ia, IarD[1]))/(sample + 1)
@@ -942,6 +961,10 @@ pair_ia_internal <- function(gid, N, numLoci, lnames, np, nploci, p, sample = NU
 #' @param information When `TRUE` (Default), this will print out a header
 #'   of information to the R console.
 #'   
+#' @param threads The maximum number of parallel threads to be used. Defaults
+#'   to 1, which runs serially. A value of 0 will attempt to use as many
+#'   threads as there are available cores/CPUs.
+#'   
 #' @return a table with 4 columns indicating the Number of alleles/genotypes 
 #'   observed, Diversity index chosen, Nei's 1978 gene diversity (expected
 #'   heterozygosity), and Evenness.
@@ -962,6 +985,11 @@ pair_ia_internal <- function(gid, N, numLoci, lnames, np, nploci, p, sample = NU
 #'   within each locus. This includes the calculation for `Hexp`, which turns
 #'   into the unbiased Simpson's index.
 #'   
+#'   All statistics are calculated in compiled code from the counts of alleles
+#'   (or genotypes) in the allele table. Alleles consisting only of zeroes
+#'   (e.g. "000") represent missing data in codominant data and are not
+#'   counted.
+#'   
 #' @author Zhian N. Kamvar
 #' 
 #' @references
@@ -1002,20 +1030,20 @@ pair_ia_internal <- function(gid, N, numLoci, lnames, np, nploci, p, sample = NU
 #' }
 #==============================================================================#
 locus_table <- function(x, index = "simpson", lev = "allele", 
-                        population = "ALL", information = TRUE){
-  ploid   <- unique(ploidy(x))
-  type    <- x@type
+                        population = "ALL", information = TRUE, threads = 1L){
   INDICES <- c("shannon", "simpson", "invsimpson")
   index   <- match.arg(index, INDICES)
+  lev     <- match.arg(lev, c("allele", "genotype"))
   x       <- popsub(x, population, drop = FALSE)
-  x.loc   <- summary(as.loci(x))
-  outmat  <- vapply(x.loc, locus_table_pegas, numeric(4), index, lev, ploid, type)
-  loci    <- colnames(outmat)
-  divs    <- rownames(outmat)
-  res     <- matrix(0.0, nrow = ncol(outmat) + 1, ncol = nrow(outmat))
+  outmat  <- locus_table_native(x, lev = lev, threads = threads)[[1]]
+  idx     <- switch(index, simpson = "1-D", shannon = "H", invsimpson = "G")
+  outmat  <- outmat[, c(lev, idx, "Hexp", "Evenness"), drop = FALSE]
+  loci    <- rownames(outmat)
+  divs    <- colnames(outmat)
+  res     <- matrix(0.0, nrow = nrow(outmat) + 1, ncol = ncol(outmat))
   dimlist <- list(`locus` = c(loci, "mean"), `summary` = divs)
-  res[-nrow(res), ]     <- t(outmat)
-  res[nrow(res), ]      <- colMeans(res[-nrow(res), ], na.rm = TRUE)
+  res[-nrow(res), ]     <- outmat
+  res[nrow(res), ]      <- colMeans(outmat, na.rm = TRUE)
   attr(res, "dimnames") <- dimlist
   if (information){
     if (index == "simpson"){
@@ -1047,7 +1075,8 @@ locus_table <- function(x, index = "simpson", lev = "allele",
 #'   (Default) and data frame will report counts along with populations or 
 #'   individuals. Vectors will simply report which populations or individuals 
 #'   contain private alleles. Tables are matrices with populations or 
-#'   individuals in rows and alleles in columns. Data frames are long form.
+#'   individuals in rows and alleles in columns. Data frames are long form and
+#'   only contain the non-zero counts.
 #'   
 #' @param level one of `"population"` (Default) or `"individual"`.
 #'   
@@ -1059,6 +1088,10 @@ locus_table <- function(x, index = "simpson", lev = "allele",
 #' @param drop `logical`. if `TRUE`, populations/individuals without 
 #'   private alleles will be dropped from the result. Defaults to `FALSE`.
 #'   
+#' @param threads The maximum number of parallel threads to be used. Defaults
+#'   to 1, which runs serially. A value of 0 will attempt to use as many
+#'   threads as there are available cores/CPUs.
+#'   
 #' @return a matrix, data.frame, or vector defining the populations or
 #'   individuals containing private alleles. If vector is chosen, alleles are
 #'   not defined.
@@ -1099,7 +1132,7 @@ locus_table <- function(x, index = "simpson", lev = "allele",
 #==============================================================================#
 private_alleles <- function(gid, form = alleles ~ ., report = "table", 
                             level = "population", count.alleles = TRUE,
-                            drop = FALSE){
+                            drop = FALSE, threads = 1L){
   REPORTARGS <- c("table", "vector", "data.frame")
   LEVELARGS  <- c("individual", "population")
   LHS_ARGS <- c("alleles", "locus", "loci")
@@ -1127,45 +1160,35 @@ private_alleles <- function(gid, form = alleles ~ ., report = "table",
     stop(paste(gid, "is not a genind or genpop object."))
   }
   if (is.genind(gid) && !is.null(pop(gid)) | is.genpop(gid) && nPop(gid) > 1){
-    if (is.genind(gid)){
-      gid.pop <- tab(genind2genpop(gid, quiet = TRUE))
-    } else {
-      gid.pop <- tab(gid)
-    }
-    private_columns <- colSums(ifelse(gid.pop > 0, 1, 0), na.rm = TRUE) < 2
-    privates <- gid.pop[, private_columns, drop = FALSE]
-    if (level == "individual" & is.genind(gid)){
-      gid.tab  <- tab(gid)
-      privates <- gid.tab[, private_columns, drop = FALSE]
-    } else if (!count.alleles){
-      privates <- ifelse(privates > 0, 1, 0)
-    }
-    
+    individual <- level == "individual" & is.genind(gid)
+    res  <- private_alleles_native(gid, individual = individual, 
+                                   count.alleles = count.alleles,
+                                   by_locus = marker != "alleles",
+                                   threads = threads)
+    trip <- res$triples
+    keep <- seq_along(res$rows)
     if (drop){
-      privates <- privates[rowSums(privates, na.rm = TRUE) > 0, , drop = FALSE]
-    }
-    
-    if (marker != "alleles"){
-      private_fac <- locFac(gid)[private_columns]
-      privates <- vapply(unique(private_fac), function(l){
-        rowSums(privates[, private_fac == l, drop = FALSE], na.rm = TRUE)
-      }, FUN.VALUE = numeric(nrow(privates))
-      )
-      colnames(privates) <- locNames(gid)[unique(private_fac)]
+      totals <- vapply(split(trip$count, factor(trip$row, keep)), sum, 
+                       numeric(1), na.rm = TRUE)
+      keep   <- keep[totals > 0]
+      trip   <- trip[trip$row %in% keep, , drop = FALSE]
     }
-    if (length(privates) == 0){
-      privates <- NULL
+    if (length(keep) == 0 || length(res$cols) == 0){
       cat("No private alleles detected.")
       return(invisible(NULL))
     }
     if (report == "vector"){
-      privates <- rownames(privates)
+      privates <- res$rows[keep]
     } else if (report == "data.frame"){
       marker   <- if (marker == "alleles") "allele" else "locus"
-      names(dimnames(privates)) <- c(level, marker)
-      privates <- as.data.frame.table(privates, 
-                                      responseName = "count",
-                                      stringsAsFactors = FALSE)
+      privates <- data.frame(res$rows[trip$row], res$cols[trip$col], 
+                             trip$count, stringsAsFactors = FALSE)
+      names(privates) <- c(level, marker, "count")
+    } else {
+      privates <- matrix(0, nrow = length(res$rows), ncol = length(res$cols),
+                         dimnames = list(res$rows, res$cols))
+      privates[cbind(trip$row, trip$col)] <- trip$count
+      privates <- privates[keep, , drop = FALSE]
     }
     return(privates)
   } else {
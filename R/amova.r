@@ -92,7 +92,8 @@
 #'
 #' @param threads `integer` When using filtering or genlight objects, this 
 #'   parameter specifies the number of parallel processes passed to 
-#'   [mlg.filter()] and/or [bitwise.dist()]. 
+#'   [mlg.filter()] and/or [bitwise.dist()]. With `method = "poppr"`, it is
+#'   also the number of threads used for the sums of squares and permutations.
 #'
 #' @param missing specify method of correcting for missing data utilizing
 #'   options given in the function [missingno()]. Default is `"loci"`. This only
@@ -107,16 +108,22 @@
 #'   printed.
 #'
 #' @param method Which method for calculating AMOVA should be used? Choices
-#'   refer to package implementations: "ade4" (default) or "pegas". See details
-#'   for differences.
+#'   refer to package implementations: "ade4" (default), "pegas", or "poppr".
+#'   See details for differences.
 #'
 #' @param nperm the number of permutations passed to the pegas implementation of
-#'   amova.
+#'   amova. For `method = "poppr"`, this is the number of permutations used to
+#'   test each variance component (see [randtest()][ade4::randtest]).
 #'   
 #' @inheritParams mlg.filter
 #'   
 #' @return a list of class `amova` from the ade4 or pegas package. See 
-#'   [ade4::amova()] or [pegas::amova()] for details.
+#'   [ade4::amova()] or [pegas::amova()] for details. With `method = "poppr"`,
+#'   a list of class `poppr_amova` (inheriting from `amova`) with the same
+#'   `results`, `componentsofcovariance`, and `statphi` elements as the ade4
+#'   implementation. If `nperm > 0`, the element `test` will contain a
+#'   `krandtest` object with the permutation tests for each variance
+#'   component.
 #' 
 #' @details The poppr implementation of AMOVA is a very detailed wrapper for the
 #'   ade4 implementation. The output is an [ade4::amova()] class list that
@@ -151,7 +158,10 @@
 #'   or dominant markers as the haplotypes cannot be split further. Setting
 #'   `within = FALSE` uses the euclidean distance of the allele frequencies
 #'   within each individual. **Note:** `within = TRUE` is incompatible with
-#'   `filter = TRUE`. In this case, `within` will be set to `FALSE`}
+#'   `filter = TRUE`. In this case, `within` will be set to `FALSE`. With
+#'   `method = "poppr"` and no missing data, the haplotypes are read directly
+#'   from the allele counts (or the chromosomes of genlight objects) and no
+#'   new data set or distance matrix is created.}
 #'
 #'   \subsection{On Euclidean Distances:}{ With the \pkg{ade4} implementation of
 #'   AMOVA (utilized by \pkg{poppr}), distances must be Euclidean (due to the
@@ -159,7 +169,11 @@
 #'   are not always euclidean and must be corrected for before being analyzed.
 #'   Poppr automates this with three methods implemented in \pkg{ade4},
 #'   [quasieuclid()], [lingoes()], and [cailliez()]. The correction of these
-#'   distances should not adversely affect the outcome of the analysis.}
+#'   distances should not adversely affect the outcome of the analysis. Poppr
+#'   checks the distances and calculates the Lingoes and Cailliez constants
+#'   from the extreme eigenvalues only (found with the Lanczos algorithm over
+#'   `threads`), which is much faster than the full eigendecomposition used
+#'   by \pkg{ade4} for large data sets.}
 #'   
 #'   \subsection{On Filtering:}{ Filtering multilocus genotypes is performed by
 #'   [mlg.filter()]. This can necessarily only be done AMOVA tests that do not
@@ -180,7 +194,21 @@
 #'   implementation. If you want to perform permutation analyses on the pegas
 #'   implementation, you must set `within = FALSE`. In addition, while clone
 #'   correction is implemented for both methods, filtering is only implemented
-#'   for the ade4 version.}
+#'   for the ade4 version.
+#'   
+#'   The poppr version (`method = "poppr"`) gives the same results as the ade4
+#'   version, but calculates the sums of squares for every level of the
+#'   hierarchy in a single pass over the distance matrix in compiled code.
+#'   Permutation tests (`nperm`) shuffle the units of the level below the one
+#'   being tested within the level above it (Excoffier et al. 1992) and are
+#'   run in parallel over `threads`. Each permutation draws from its own
+#'   random number stream seeded from R's, so the results only depend on
+#'   [set.seed()], not the number of threads. When no distance matrix is
+#'   supplied and the data have no missing values, the poppr version does not
+#'   calculate any distances at all: the sums of squares of the Euclidean
+#'   distances are found from the allele counts (or frequencies) of each
+#'   population, which takes time and memory proportional to the size of the
+#'   data instead of the square of the number of samples.}
 #'   
 #'   \subsection{On Polyploids:}{ As of \pkg{poppr} version 2.7.0, this
 #'   function is able to calculate phi statistics for within-individual variance
@@ -235,6 +263,10 @@
 #' plot(amova.test)
 #' amova.test
 #' 
+#' # The poppr implementation can run the permutations in parallel
+#' amova.poppr <- poppr.amova(agc, ~Pop/Subpop, method = "poppr", nperm = 99)
+#' amova.poppr$test
+#' 
 #' \dontrun{
 #' 
 #' # You can get the same results with the pegas implementation
@@ -265,10 +297,12 @@ poppr.amova <- function(x, hier = NULL, clonecorrect = FALSE, within = TRUE,
                         correction = "quasieuclid", sep = "_", filter = FALSE, 
                         threshold = 0, algorithm = "farthest_neighbor", 
                         threads = 1L, missing = "loci", cutoff = 0.05, 
-                        quiet = FALSE,  method = c("ade4", "pegas"), nperm = 0){
+                        quiet = FALSE,  method = c("ade4", "pegas", "poppr"), 
+                        nperm = 0){
   if (!inherits(x, c("genind", "genlight"))) stop(paste(substitute(x), "must be a genind object."))
   if (is.null(hier)) stop("A population hierarchy must be specified")
-  methods   <- c("ade4", "pegas")
+  the_call  <- match.call()
+  methods   <- c("ade4", "pegas", "poppr")
   method    <- match.arg(method, methods)
   setPop(x) <- hier
   is_genind <- is.genind(x)
@@ -333,14 +367,29 @@ poppr.amova <- function(x, hier = NULL, clonecorrect = FALSE, within = TRUE,
   } else {
     if (!all(lengths(NA.posi(x)) == 0L)) warning("Missing data are not filtered from genlight data.")
   }
+  # Without missing data, the poppr method calculates the sums of squares
+  # straight from the data and no distance matrix is needed.
+  complete   <- if (is_genind) !anyNA(tab(x)) else all(lengths(NA.posi(x)) == 0L)
+  native_tab <- method == "poppr" && is.null(dist) && complete
+  hap_ploidy <- 1L
 
   # Splitting haplotypes ----------------------------------------------------
   #
   full_ploidy <- if (is_genind) codominant && sum(tabulate(get_local_ploidy(x)) > 0) == 1 else TRUE
   if (within && heterozygous && codominant && !haploid && full_ploidy) {
     hier <- update(hier, ~./Individual)
-    x    <- make_haplotypes(x)
-    x    <- if (is_genind) as.genclone(x) else as.snpclone(x)
+    if (native_tab && !(is_genind && test_zeroes(x))) {
+      # The haplotypes are handled in compiled code. Only the strata are
+      # expanded to one row per haplotype.
+      hap_ploidy <- max(ploidy(x))
+      if (is.null(indNames(x))) {
+        indNames(x) <- .genlab("ind", nInd(x))
+      }
+      addStrata(x) <- data.frame(Individual = indNames(x))
+    } else {
+      x <- make_haplotypes(x)
+      x <- if (is_genind) as.genclone(x) else as.snpclone(x)
+    }
   } else if (within && codominant && !full_ploidy && is.null(dist)) {
     warning(paste("Data with mixed ploidy or ambiguous allele dosage cannot have",
             "within-individual variance calculated until the dosage is correctly",
@@ -354,28 +403,39 @@ poppr.amova <- function(x, hier = NULL, clonecorrect = FALSE, within = TRUE,
   
   hierdf <- strata(x, formula = hier)
   if (method == "ade4") xstruct <- make_ade_df(hier, hierdf)
+  if (native_tab) {
+    hierdf  <- hierdf[rep(seq_len(nrow(hierdf)), each = hap_ploidy), , drop = FALSE]
+    loc_fac <- NULL
+    if (!is_genind) {
+      xdata <- x
+    } else if (hap_ploidy > 1L) {
+      xdata   <- tab(x, freq = FALSE)
+      loc_fac <- as.integer(locFac(x))
+    } else {
+      xdata <- tab(x, freq = freq)
+    }
+    return(native_amova_tab(xdata, hierdf[all.vars(hier)], ploidy = hap_ploidy,
+                            loc_fac = loc_fac, nperm = nperm, 
+                            threads = threads, call = the_call))
+  }
+  mlgs <- if (method != "pegas") mlg(x, quiet = TRUE) else nInd(x)
+  plan_memory("poppr.amova", n = nInd(x), mlgs = mlgs, method = method)
   if (is.null(dist)) {
     squared <- FALSE
-    if (method == "ade4") {
-      if (is_genind) {
-        xdist <- dist(tab(clonecorrect(x, strata = NA), freq = freq)) 
-      } else {
-        xdist <- bitwise.dist(clonecorrect(x, strata = NA), 
-                              euclidean = TRUE, scale_missing = TRUE, threads = threads)
-      }
+    xcc <- if (method != "pegas") clonecorrect(x, strata = NA) else x
+    if (is_genind) {
+      xdist <- cached_distance(tab(xcc, freq = freq), stats::dist, what = "dist")
     } else {
-      if (is_genind) {
-        xdist <- dist(tab(x, freq = freq)) 
-      } else {
-        xdist <- bitwise.dist(x, euclidean = TRUE, scale_missing = TRUE, threads = threads)
-      }
+      xdist <- cached_distance(xcc, bitwise.dist, euclidean = TRUE, 
+                               scale_missing = TRUE, threads = threads, 
+                               what = "bitwise.dist")
     }
   } else {
     datalength <- choose(nInd(x), 2)
     mlgs       <- mlg(x, quiet = TRUE)
     mlglength  <- choose(mlgs, 2)
     if (length(dist) > mlglength & length(dist) == datalength) {
-      corrected <- if (method == "ade4") .clonecorrector(x) else TRUE
+      corrected <- if (method != "pegas") .clonecorrector(x) else TRUE
       xdist     <- as.dist(as.matrix(dist)[corrected, corrected])
     } else if (length(dist) == mlglength) {
       xdist <- dist
@@ -392,31 +452,253 @@ poppr.amova <- function(x, hier = NULL, clonecorrect = FALSE, within = TRUE,
       xdist <- sqrt(xdist)
     }
   }
-  if (!is.euclid(xdist)) {
-    CORRECTIONS <- c("cailliez", "quasieuclid", "lingoes")
-    try(correct <- match.arg(correction, CORRECTIONS), silent = TRUE)
-    if (!exists("correct")){
-      stop(not_euclid_msg(correction))
-    } else {
-      correct_fun <- match.fun(correct)
-      if (correct == CORRECTIONS[2]){
-        message("Distance matrix is non-euclidean.")
-        message(c("Using quasieuclid correction method.",
-                  " See ?quasieuclid for details."))
-        xdist <- correct_fun(xdist)        
-      } else {
-        xdist <- correct_fun(xdist, print = TRUE, cor.zero = FALSE)        
-      }
-    }
-  }
+  xdist <- euclid_correction(xdist, correction, threads = threads)
   if (method == "ade4") {
     allmlgs <- unique(mlg.vector(x))
     xtab    <- t(mlg.table(x, plot = FALSE, quiet = TRUE, mlgsub = allmlgs))
     xtab    <- as.data.frame(xtab)
     return(ade4::amova(samples = xtab, distances = xdist, structures = xstruct))
+  } else if (method == "poppr") {
+    xmlg <- mlg.vector(x)
+    geno <- match(xmlg, unique(xmlg))
+    return(native_amova(xdist, hierdf[all.vars(hier)], geno, nperm = nperm,
+                        threads = threads, call = the_call))
   } else {
     form <- paste(all.vars(hier), collapse = "/")
     hier <- as.formula(paste("xdist ~", form))
     return(pegas::amova(hier, data = hierdf, nperm = nperm, is.squared = FALSE))
   }
 }
+
+#==============================================================================#
+# Make a distance matrix Euclidean with ade4's quasieuclid, lingoes, or cailliez
+# corrections.
+#
+# Checking the distances and finding the Lingoes and Cailliez constants only
+# needs the extreme eigenvalues of the double-centered matrix, which are found
+# in compiled code with the Lanczos algorithm in O(n^2) per step (see
+# src/euclid.c) instead of a full eigendecomposition. If the iteration does not
+# converge, ade4's dense versions are used instead.
+#
+# Public functions utilizing this function:
+# # poppr.amova
+#
+# Internal functions utilizing this function:
+# # none
+#==============================================================================#
+euclid_correction <- function(xdist, correction = "quasieuclid", threads = 1L,
+                              tol = 1e-07, max_steps = 300L){
+  CORRECTIONS <- c("cailliez", "quasieuclid", "lingoes")
+  correct <- tryCatch(match.arg(correction, CORRECTIONS), error = function(e) NULL)
+  how     <- if (is.null(correct)) 0L else match(correct, c("quasieuclid", "lingoes", "cailliez")) - 1L
+  euclid  <- .Call("euclid_constant", as.vector(xdist), how, tol, 
+                   as.integer(max_steps), as.integer(threads), PACKAGE = "poppr")
+  if (!euclid$converged) {
+    if (is.euclid(xdist)) return(xdist)
+    euclid$euclid <- FALSE
+    euclid$constant <- NULL
+  }
+  if (euclid$euclid) return(xdist)
+  if (is.null(correct)){
+    stop(not_euclid_msg(correction))
+  }
+  if (correct == CORRECTIONS[2]){
+    message("Distance matrix is non-euclidean.")
+    message(c("Using quasieuclid correction method.",
+              " See ?quasieuclid for details."))
+    return(quasieuclid(xdist))
+  } 
+  if (is.null(euclid$constant)) {
+    correct_fun <- match.fun(correct)
+    return(correct_fun(xdist, print = TRUE, cor.zero = FALSE))
+  }
+  if (correct == "lingoes") {
+    cat("Lingoes constant =", round(euclid$constant, digits = 6), "\n")
+    xdist <- sqrt(xdist^2 + 2*euclid$constant)
+  } else {
+    cat(paste("Cailliez constant =", round(euclid$constant, digits = 5), "\n"))
+    xdist <- xdist + euclid$constant
+  }
+  xdist
+}
+
+#==============================================================================#
+#' Run the native AMOVA engine
+#'
+#' @param xdist a Euclidean (not squared) dist object over the unique genotypes
+#' @param hierdf a data frame of the strata, highest level first
+#' @param geno an integer vector with one element per sample indicating the
+#'   observation in `xdist` that represents that sample
+#' @param nperm the number of permutations per variance component
+#' @param threads the number of threads
+#' @param call the call to store in the result
+#'
+#' @return an object of class `poppr_amova` 
+#' @noRd
+#==============================================================================#
+native_amova <- function(xdist, hierdf, geno, nperm = 0L, threads = 1L, 
+                         call = match.call()){
+  codes <- amova_strata_codes(hierdf)
+  res   <- .Call("amova_native", as.vector(xdist), as.integer(geno), codes,
+                 as.integer(nperm), as.integer(threads), PACKAGE = "poppr")
+  out   <- make_native_amova(res, names(hierdf), call)
+  if (nperm > 0) {
+    out$test <- make_native_amova_test(res, out, call)
+  }
+  out$distances  <- xdist
+  out$samples    <- as.integer(geno)
+  out$structures <- codes
+  out
+}
+
+#==============================================================================#
+#' Run the native AMOVA engine on a table or genlight object
+#'
+#' The squared Euclidean distances between the samples are never calculated.
+#' Instead, the sums of squares are calculated from the column sums of each
+#' unit in the hierarchy.
+#'
+#' @param xdata a numeric matrix with one row per sample or a genlight object,
+#'   neither with missing data
+#' @param hierdf a data frame of the strata, highest level first, with one row
+#'   per haplotype if `ploidy > 1`
+#' @param ploidy when greater than one, the AMOVA is calculated on `ploidy`
+#'   haplotypes per individual in `xdata` without creating them (see
+#'   amova_native_tab in src/amova.c).
+#' @param loc_fac when `ploidy > 1` and `xdata` is a table of allele counts,
+#'   an integer vector of the locus of each column
+#' @param nperm the number of permutations per variance component
+#' @param threads the number of threads
+#' @param call the call to store in the result
+#'
+#' @return an object of class `poppr_amova` where the element `distances` is
+#'   absent and `samples` contains `xdata`.
+#' @noRd
+#==============================================================================#
+native_amova_tab <- function(xdata, hierdf, ploidy = 1L, loc_fac = NULL, 
+                             nperm = 0L, threads = 1L, call = match.call()){
+  codes <- amova_strata_codes(hierdf)
+  res   <- .Call("amova_native_tab", xdata, as.integer(ploidy), loc_fac, 
+                 codes, as.integer(nperm), as.integer(threads), 
+                 PACKAGE = "poppr")
+  out   <- make_native_amova(res, names(hierdf), call)
+  if (nperm > 0) {
+    out$test <- make_native_amova_test(res, out, call)
+  }
+  out$samples    <- xdata
+  out$structures <- codes
+  out$ploidy     <- as.integer(ploidy)
+  out$loc.fac    <- loc_fac
+  out
+}
+
+#==============================================================================#
+# Convert a data frame of strata into a matrix of nested integer codes. Each
+# column is the interaction of itself with all of the columns before it so that
+# every unit has exactly one parent.
+#
+# Public functions utilizing this function:
+# # poppr.amova
+#
+# Internal functions utilizing this function:
+# # native_amova
+# # native_amova_tab
+#==============================================================================#
+amova_strata_codes <- function(hierdf){
+  codes <- vapply(seq_along(hierdf), function(i){
+    nested <- do.call("paste", c(unname(as.list(hierdf[seq_len(i)])), sep = "\r"))
+    as.integer(factor(nested, levels = unique(nested)))
+  }, integer(nrow(hierdf)))
+  dim(codes)      <- c(nrow(hierdf), length(hierdf))
+  colnames(codes) <- names(hierdf)
+  codes
+}
+
+#==============================================================================#
+# Arrange the output of the native AMOVA into the same shape as ade4's amova
+# object. The lowest level of the hierarchy is referred to as "samples".
+#
+# Internal functions utilizing this function:
+# # native_amova
+# # native_amova_tab
+#==============================================================================#
+make_native_amova <- function(res, levs, call){
+  K      <- length(levs)
+  lvname <- c(levs[-K], "samples")
+  srcs   <- c(
+    paste("Between", lvname[1]),
+    if (K > 1) paste("Between", lvname[-1], "Within", lvname[-K]),
+    "Within samples"
+  )
+  results <- data.frame(
+    Df        = c(res$df, sum(res$df)),
+    `Sum Sq`  = c(res$SS, res$W[1]),
+    `Mean Sq` = c(res$SS/res$df, res$W[1]/sum(res$df)),
+    check.names = FALSE
+  )
+  rownames(results) <- c(srcs, "Total")
+  sigma <- c(res$sigma, sum(res$sigma))
+  components <- data.frame(
+    Sigma = sigma,
+    `%`   = 100*sigma/sigma[length(sigma)],
+    check.names = FALSE
+  )
+  rownames(components) <- c(paste("Variations ", srcs), "Total variations")
+  # Phi for each level relative to the level above it
+  cumulative <- rev(cumsum(rev(res$sigma)))[seq_len(K)]
+  phi        <- c(1 - res$sigma[K + 1]/sigma[length(sigma)], 
+                  rev(res$sigma[seq_len(K)]/cumulative))
+  phinames   <- c("Phi-samples-total", 
+                  paste("Phi", rev(lvname), rev(c("total", lvname[-K])), sep = "-"))
+  statphi    <- data.frame(Phi = phi)
+  rownames(statphi) <- phinames
+  out <- list(call = call, results = results, 
+              componentsofcovariance = components, statphi = statphi)
+  class(out) <- c("poppr_amova", "amova")
+  out
+}
+
+#==============================================================================#
+# Create a krandtest object from the permutations of the native AMOVA. The
+# variations within samples are expected to be smaller than the permuted values
+# under population structure, all of the others are expected to be larger.
+#
+# Internal functions utilizing this function:
+# # native_amova
+# # native_amova_tab
+# # randtest.poppr_amova
+#==============================================================================#
+#' @importFrom ade4 as.krandtest
+make_native_amova_test <- function(res, amova, call){
+  nc    <- length(res$sigma)
+  tests <- rev(seq_len(nc))
+  sim   <- res$perm[, tests, drop = FALSE]
+  obs   <- res$sigma[tests]
+  nms   <- rownames(amova$componentsofcovariance)[tests]
+  alter <- c("less", rep("greater", nc - 1))
+  ade4::as.krandtest(sim = sim, obs = obs, alter = alter, call = call,
+                     names = nms)
+}
+
+#==============================================================================#
+#' @rdname poppr.amova
+#' @param xtest an object of class `poppr_amova` from `poppr.amova(method =
+#'   "poppr")`.
+#' @param nrepet the number of permutations for each variance component
+#' @param ... unused
+#' @method randtest poppr_amova
+#' @importFrom ade4 randtest
+#' @export
+#==============================================================================#
+randtest.poppr_amova <- function(xtest, nrepet = 99, threads = 1L, ...){
+  if (is.null(xtest$distances)) {
+    res <- .Call("amova_native_tab", xtest$samples, xtest$ploidy, 
+                 xtest$loc.fac, xtest$structures, as.integer(nrepet), 
+                 as.integer(threads), PACKAGE = "poppr")
+  } else {
+    res <- .Call("amova_native", as.vector(xtest$distances), xtest$samples, 
+                 xtest$structures, as.integer(nrepet), as.integer(threads), 
+                 PACKAGE = "poppr")
+  }
+  make_native_amova_test(res, xtest, match.call())
+}
@@ -95,6 +95,10 @@
 #'   distance and is considerably faster and more memory-efficient than the 
 #'   standard `dist()` function. 
 #'   
+#'   The calculation can be interrupted and reports its progress through the
+#'   \pkg{progressr} package when it is wrapped in
+#'   [progressr::with_progress()].
+#'   
 #' @note This function is optimized for [genlight][genlight-class] and
 #'   [snpclone][snpclone-class] objects. This does not mean that it is a
 #'   catch-all optimization for SNP data. Three assumptions must be met for this
@@ -193,22 +197,33 @@ bitwise.dist <- function(x, percent = TRUE, mat = FALSE, missing_match = TRUE,
   # Cast parameters to proper types before passing them to C
   threads <- as.integer(threads)
 
+  # If the full matrix does not fit in memory, the kernel writes the lower
+  # triangle straight into the dist object.
+  plan      <- plan_memory("bitwise.dist", n = inds, mat = mat, 
+                           scale_missing = scale_missing)
+  condensed <- plan$mode == "blocked"
   if (ploid == 1)
   {
-    pairwise_dist <- .Call("bitwise_distance_haploid", x, missing_match, threads)
+    pairwise_dist <- .Call("bitwise_distance_haploid", x, missing_match, threads, native_progress(), condensed)
   }
   else
   {
-    pairwise_dist <- .Call("bitwise_distance_diploid", x, missing_match, euclidean, differences_only, threads)
+    pairwise_dist <- .Call("bitwise_distance_diploid", x, missing_match, euclidean, differences_only, threads, native_progress(), condensed)
   }
+  profile <- attr(pairwise_dist, "poppr_profile")
+  start   <- if (!is.null(profile)) proc.time()[["elapsed"]]
   dist.mat <- pairwise_dist
-  dim(dist.mat) <- c(inds,inds)
-  colnames(dist.mat) <- ind.names
-  rownames(dist.mat) <- ind.names
-  nas <- NA.posi(x)
+  if (!condensed){
+    dim(dist.mat) <- c(inds,inds)
+    colnames(dist.mat) <- ind.names
+    rownames(dist.mat) <- ind.names
+  }
+  nas    <- NA.posi(x)
+  counts <- TRUE
   if (scale_missing && sum(lengths(nas)) > 0) {
-    adj      <- missing_correction(nas, nLoc(x))
+    adj      <- missing_correction(nas, nLoc(x), mat = !condensed)
     dist.mat <- dist.mat * adj
+    counts   <- FALSE
   }
   if (euclidean) {
     dist.mat <- sqrt(dist.mat)
@@ -222,9 +237,21 @@ bitwise.dist <- function(x, percent = TRUE, mat = FALSE, missing_match = TRUE,
       dist.mat <- dist.mat/(numPairs*ploid)
     }
   }
-  if (mat == FALSE) {
+  if (condensed) {
+    # The kernel returns doubles; raw differences are integers as before
+    if (counts && !euclidean && !percent){
+      storage.mode(dist.mat) <- "integer"
+    }
+    dist.mat <- structure(dist.mat, Size = inds, Labels = ind.names, 
+                          Diag = FALSE, Upper = FALSE, class = "dist")
+  } else if (mat == FALSE) {
     dist.mat <- as.dist(dist.mat)
   }
+  if (!is.null(profile)){
+    seconds  <- c(conversion = proc.time()[["elapsed"]] - start)
+    dist.mat <- with_profile(dist.mat, profile, kernel = "bitwise.dist", 
+                             seconds = seconds)
+  }
   return(dist.mat)
 }
 
@@ -250,6 +277,270 @@ poppr_has_parallel <- function(){
 
 }
 
+#==============================================================================#
+#' Number of threads used by poppr
+#'
+#' Reports how many threads the parallel functions of poppr will use.
+#'
+#' @return a named integer vector with the elements
+#'   - `pool`: the largest number of threads any function will use.
+#'   - `processors`: the number of processors available to R.
+#'   - `cgroup`: the CPU quota of the control group of the R process
+#'     (`NA` if there is none).
+#'   - `limit`: the value of `OMP_THREAD_LIMIT` (`NA` if it is not set).
+#'   - `default`: the number of threads used when `threads = 0`.
+#'
+#' @details The `threads` argument of every parallel function in poppr
+#'   is resolved in the same way:
+#'   - `threads = 0` uses `getOption("poppr.threads")` if it is a positive
+#'     number and `pool` threads otherwise.
+#'   - Any other value is capped at `pool`, which is the smallest of
+#'     `processors`, `cgroup`, and `limit`. It is found once per session.
+#'   - A function called from within a parallel region runs on one thread.
+#'
+#'   The number of threads is set for each call only, so the OpenMP settings
+#'   of the R session are never changed. Threads can be bound to cores by
+#'   setting the `OMP_PROC_BIND` and `OMP_PLACES` environment variables
+#'   before R is started.
+#'
+#' @author Zhian N. Kamvar
+#' @seealso [poppr_has_parallel()]
+#' @md
+#' @export
+#' @examples
+#' poppr_threads()
+#' op <- options(poppr.threads = 1L)
+#' poppr_threads()["default"]
+#' options(op)
+#==============================================================================#
+poppr_threads <- function(){
+  .Call("poppr_thread_info", PACKAGE = "poppr")
+}
+
+#==============================================================================#
+#' Profiles of the compiled code of poppr
+#'
+#' Summarizes where the time of a call to one of the compiled kernels of
+#' poppr went.
+#'
+#' @param x the result of [bitwise.dist()], [bitwise.ia()], [diss.dist()], or
+#'   [mlg.filter()] computed with `options(poppr.profile = TRUE)`, or its
+#'   `"poppr_profile"` attribute.
+#' @param by `"kernel"` (default) for one row per kernel or `"phase"` for one
+#'   row per phase of each kernel.
+#'
+#' @return `NULL` if `x` has no profile, otherwise a data frame with the
+#'   columns
+#'   - `kernel`: the name of the compiled kernel or R function.
+#'   - `threads`, `seconds`, `imbalance`, and one column for each count
+#'     (`by = "kernel"`).
+#'   - `phase`, `seconds`, and `percent` (`by = "phase"`).
+#'
+#' @details If the option `poppr.profile` is `TRUE`, the kernels record the
+#'   time of each of their phases, counts of their work (pairs of samples,
+#'   loci, missing genotypes, and bytes read from the data), and the time each
+#'   thread spent working. The record is attached to the result as the
+#'   `"poppr_profile"` attribute. The R code around a kernel adds its own
+#'   record when it converts the result. The imbalance is the longest time a
+#'   thread worked over the mean time of the threads, so a value of 1 means
+#'   that the work was spread evenly.
+#'
+#'   Without the option, the kernels do not read any clocks and the results
+#'   have no such attribute. The profile does not change the results.
+#'
+#' @author Zhian N. Kamvar
+#' @seealso [poppr_threads()]
+#' @md
+#' @export
+#' @examples
+#' x   <- glSim(n.ind = 50, n.snp.nonstruc = 1e3, ploidy = 2)
+#' op  <- options(poppr.profile = TRUE)
+#' res <- bitwise.dist(x)
+#' options(op)
+#' poppr_profile(res)
+#' poppr_profile(res, by = "phase")
+#==============================================================================#
+poppr_profile <- function(x, by = c("kernel", "phase")){
+  by      <- match.arg(by)
+  profile <- if (inherits(x, "poppr_profile")) x else attr(x, "poppr_profile")
+  if (is.null(profile)){
+    return(NULL)
+  }
+  if (by == "phase"){
+    res <- lapply(profile, function(k){
+      data.frame(kernel = rep(k$kernel, length(k$seconds)),
+                 phase = names(k$seconds), seconds = unname(k$seconds),
+                 stringsAsFactors = FALSE)
+    })
+    res <- do.call("rbind", res)
+    res$percent <- 100 * res$seconds / sum(res$seconds)
+    return(res)
+  }
+  counts <- unique(unlist(lapply(profile, function(k) names(k$counts))))
+  res <- lapply(profile, function(k){
+    row <- data.frame(kernel = k$kernel, threads = k$threads,
+                      seconds = sum(k$seconds), imbalance = k$imbalance,
+                      stringsAsFactors = FALSE)
+    for (i in counts){
+      row[[i]] <- if (i %in% names(k$counts)) k$counts[[i]] else NA_real_
+    }
+    row
+  })
+  do.call("rbind", res)
+}
+
+#==============================================================================#
+#' Memory available to poppr
+#'
+#' Reports the memory of the system and the budget that poppr plans its
+#' largest calculations with.
+#'
+#' @return a named numeric vector of bytes with the elements
+#'   - `physical`: the physical memory of the system.
+#'   - `available`: the memory the system can give to new allocations
+#'     (`NA` where it is not known).
+#'   - `cgroup`: the memory limit of the control group of the R process
+#'     (`NA` if there is none).
+#'   - `cgroup_usage`: the memory the control group is using.
+#'   - `budget`: the memory poppr plans with.
+#'
+#' @details The budget is `getOption("poppr.memory_limit")` if it is set.
+#'   It can be a number of bytes or a string like `"8G"` or `"500 MB"`. If it
+#'   is not set, the budget is what is left of the limit of the control group,
+#'   or the available memory of the system if there is no limit.
+#'
+#'   Before [bitwise.dist()], [diss.dist()], [bruvo.dist()], [mlg.filter()],
+#'   and [poppr.amova()] allocate their results, they compare an estimate of
+#'   the memory they need with the budget (see [memory_plan()]).
+#'
+#' @author Zhian N. Kamvar
+#' @seealso [memory_plan()], [poppr_threads()]
+#' @md
+#' @export
+#' @examples
+#' poppr_memory()
+#' op <- options(poppr.memory_limit = "1G")
+#' poppr_memory()["budget"]
+#' options(op)
+#==============================================================================#
+poppr_memory <- function(){
+  info <- .Call("poppr_memory_info", PACKAGE = "poppr")
+  c(info, budget = memory_budget(info)$bytes)
+}
+
+#==============================================================================#
+#' Plan the memory of a calculation
+#'
+#' Estimates the memory a function of poppr needs for a data set and how
+#' the function will run within the budget of [poppr_memory()].
+#'
+#' @param x a [genind][adegenet::genind], [genclone][genclone-class],
+#'   [genlight][adegenet::genlight], or [snpclone][snpclone-class] object.
+#' @param fun the name of the function.
+#' @param ... arguments of `fun` that change its memory: `mat` for
+#'   [bitwise.dist()] and [diss.dist()], `scale_missing` for [bitwise.dist()],
+#'   `by_locus` for [bruvo.dist()], and `method` for [poppr.amova()].
+#'
+#' @return a data frame with one row and the columns
+#'   - `fun`: the name of the function.
+#'   - `mode`: `"memory"` if the function runs as usual, `"blocked"` if it
+#'     computes the distances in blocks to fit the budget, and `"none"` if it
+#'     does not fit and will stop with an error.
+#'   - `bytes`: the memory needed in that mode.
+#'   - `block`: the number of loci in a block ([bruvo.dist()] only).
+#'   - `memory`, `blocked`: the memory needed as usual and in blocks (`NA`
+#'     if the function has no blocked mode).
+#'   - `budget`, `source`: the budget and where it came from.
+#'
+#' @details The estimates count the large vectors a function allocates at
+#'   the same time and ignore the data. In the blocked modes,
+#'   - [bitwise.dist()] writes the lower triangle of the distances directly
+#'     into the `dist` object instead of a full matrix (not with `mat = TRUE`).
+#'   - [bruvo.dist()] averages the distances over blocks of loci instead of
+#'     keeping the distances of all loci.
+#'
+#'   The results are the same in every mode. For [mlg.filter()] and
+#'   [poppr.amova()], the number of multilocus genotypes is taken from the
+#'   data if it is a clone object and is the number of samples otherwise.
+#'
+#' @author Zhian N. Kamvar
+#' @seealso [poppr_memory()]
+#' @md
+#' @export
+#' @examples
+#' data(Pinf)
+#' memory_plan(Pinf, "bruvo.dist")
+#' op <- options(poppr.memory_limit = 1e4)
+#' memory_plan(Pinf, "bruvo.dist")
+#' options(op)
+#==============================================================================#
+memory_plan <- function(x, fun = c("bitwise.dist", "diss.dist", "bruvo.dist",
+                                   "mlg.filter", "poppr.amova"), ...){
+  fun   <- match.arg(fun)
+  sizes <- list(n = nInd(x), nloc = nLoc(x), 
+                alleles = if (is(x, "genind")) sum(nAll(x)) else nLoc(x),
+                mlgs = if (is.clone(x)) nmll(x) else nInd(x))
+  sizes <- utils::modifyList(sizes, list(...))
+  plan  <- do.call("plan_memory", c(list(fun), sizes, list(report = FALSE)))
+  as.data.frame(plan, stringsAsFactors = FALSE)
+}
+
+#==============================================================================#
+#' Cache of distances and networks
+#'
+#' Lists or clears the results poppr keeps between calls.
+#'
+#' @param clear if `TRUE`, the cache is emptied. Defaults to `FALSE`.
+#'
+#' @return a data frame with one row per entry, from the most recently used,
+#'   and the columns
+#'   - `key`: the hash of the data and arguments of the entry.
+#'   - `what`: the function that calculated the entry.
+#'   - `bytes`: the size of the entry.
+#'
+#'   With `clear = TRUE`, the entries that were removed are returned
+#'   invisibly.
+#'
+#' @details The distance matrices calculated by [filter_stats()],
+#'   [poppr.amova()], [aboot()], [bruvo.msn()], and [mlg.filter()] (with
+#'   `memory = TRUE`) and the distance matrices and minimum spanning networks
+#'   calculated in [imsn()] are cached, so that they are only calculated once
+#'   per R session. The entries are found by a hash of the content of the data
+#'   and of the arguments, so the cache is shared by all of these functions
+#'   and an entry is found again for the same data no matter where they come
+#'   from. Distance functions written by the user are only cached by
+#'   [mlg.filter()] and [imsn()], because the text of a function does not show
+#'   the objects it uses.
+#'
+#'   The cache holds at most `getOption("poppr.cache_limit")` bytes, which
+#'   defaults to `"1G"`, and at most a quarter of the memory that is left for
+#'   calculations and the cache (see [poppr_memory()]). If it is full, the
+#'   entries used least recently are removed. A limit of 0 turns the cache
+#'   off.
+#'
+#' @author Zhian N. Kamvar
+#' @seealso [imsn()], [poppr_memory()]
+#' @md
+#' @export
+#' @examples
+#' poppr_cache()
+#' poppr_cache(clear = TRUE)
+#==============================================================================#
+poppr_cache <- function(clear = FALSE){
+  entries <- .poppr_cache$entries
+  used    <- vapply(entries, "[[", numeric(1), "used")
+  entries <- entries[order(used, decreasing = TRUE)]
+  res <- data.frame(key = as.character(names(entries)), 
+                    what = vapply(entries, "[[", character(1), "what"),
+                    bytes = vapply(entries, "[[", numeric(1), "bytes"),
+                    stringsAsFactors = FALSE, row.names = NULL)
+  if (clear){
+    .poppr_cache$entries <- list()
+    return(invisible(res))
+  }
+  res
+}
+
 #' Calculate correction for genetic distances
 #'
 #' @param nas a list of missing positions per sample
@@ -261,12 +552,7 @@ poppr_has_parallel <- function(){
 #'   from 1 to the number of loci.
 #' @noRd
 missing_correction <- function(nas, nloc, mat = TRUE){
-  res <- .Call("adjust_missing", nas, nloc, PACKAGE = "poppr")
-  if (mat) {
-    return(res)
-  } else {
-    return(res[lower.tri(res)])
-  }
+  .Call("adjust_missing", nas, nloc, !mat, PACKAGE = "poppr")
 }
 
 #==============================================================================#
@@ -314,8 +600,6 @@ bitwise.ia <- function(x, missing_match=TRUE, differences_only=FALSE, threads=0)
   # Stop if the ploidy of the genlight object is not haploid or diploid
   stopifnot(min(ploidy(x)) == 2 || min(ploidy(x)) == 1)
 
-  ploid     <- min(ploidy(x))
-
   # Threads must be something that can cast to integer
   if(!is.numeric(threads) && !is.integer(threads) && threads >= 0)
   {
@@ -323,26 +607,7 @@ bitwise.ia <- function(x, missing_match=TRUE, differences_only=FALSE, threads=0)
   }
   # Cast parameters to proper types before passing them to C
   threads <- as.integer(threads)
-  # Ensure that every SNPbin object has data for all chromosomes
-  if (ploid == 2){
-    x  <- fix_uneven_diploid(x)
-    IA <- .Call("association_index_diploid", 
-                genlight = x, 
-                missing_match = missing_match, 
-                differences_only = differences_only, 
-                requested_threads = threads, 
-                PACKAGE = "poppr")
-  }
-  else if(ploid == 1)
-  {
-    IA <- .Call("association_index_haploid", x, missing_match, threads, 
-                PACKAGE = "poppr")
-  }
-  else
-  {
-    stop("bitwise.ia only supports haploids and diploids")
-  }
-  return(IA)
+  genlight_ia(x, missing_match, differences_only, threads, native_progress())
 
 }
 
@@ -506,7 +771,7 @@ win.ia <- function(x, window = 100L, min.snps = 3L, threads = 1L, quiet = FALSE,
         if (sum(j) < min.snps) {
           res_mat[res_counter] <- NA_real_
         } else {
-          res_mat[res_counter] <- bitwise.ia(x[, j], threads = threads)
+          res_mat[res_counter] <- genlight_ia(x[, j], threads = as.integer(threads))
         }
         if (name_window || chromos) {
           the_name <- if (chromos) paste(the_chrom, winmat[i, 2], sep = ".") else as.character(winmat[i, 2])
@@ -611,7 +876,7 @@ samp.ia <- function(x, n.snp = 100L, reps = 100L, threads = 1L, quiet = FALSE){
     for (i in seq(reps)){
       if (i %% p$step == 0) p$rog()
       posns <- sample(nloc, n.snp)
-      res_mat[i] <- bitwise.ia(x[, posns], threads = threads)
+      res_mat[i] <- genlight_ia(x[, posns], threads = as.integer(threads))
     }
   })
   return(res_mat)
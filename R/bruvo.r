@@ -420,21 +420,24 @@ bruvo.boot <- function(pop, replen = 1, add = TRUE, loss = TRUE, sample = 100,
                             loss = loss))
   }
 
-  tre <- bootfun(bootgen)
-  if (is.null(root)){
-    root <- ape::is.ultrametric(tre)
-  }
-  if (any (tre$edge.length < 0)){
-    warning(negative_branch_warning(), immediate.=TRUE)
-	  tre <- fix_negative_branch(tre)
-  }
-  if (quiet == FALSE){
-    cat("\nBootstrapping...\n") 
-    cat("(note: calculation of node labels can take a while even after") 
-    cat(" the progress bar is full)\n\n")
-  }
-  bp <- boot.phylo(tre, bootgen, FUN = bootfun, B = sample, quiet = quiet, 
-                   rooted = root, ...)
+  # The replicates share the memory plan of the first tree
+  with_memory_plan({
+    tre <- bootfun(bootgen)
+    if (is.null(root)){
+      root <- ape::is.ultrametric(tre)
+    }
+    if (any (tre$edge.length < 0)){
+      warning(negative_branch_warning(), immediate.=TRUE)
+      tre <- fix_negative_branch(tre)
+    }
+    if (quiet == FALSE){
+      cat("\nBootstrapping...\n") 
+      cat("(note: calculation of node labels can take a while even after") 
+      cat(" the progress bar is full)\n\n")
+    }
+    bp <- boot.phylo(tre, bootgen, FUN = bootfun, B = sample, quiet = quiet, 
+                     rooted = root, ...)
+  })
   tre$node.labels <- round(((bp / sample)*100))
   if (!is.null(cutoff)){
     if (cutoff < 1 | cutoff > 100){
@@ -640,7 +643,9 @@ bruvo.msn <- function (gid, replen = 1, add = TRUE, loss = TRUE,
     gid     <- filtered$gid
   } else {
     cgid    <- gid[.clonecorrector(gid), ]
-    distmat <- as.matrix(bruvo.dist(cgid, replen=replen, add = add, loss = loss))
+    distmat <- cached_distance(cgid, bruvo.dist, replen = replen, add = add, 
+                               loss = loss, what = "bruvo.dist")
+    distmat <- as.matrix(distmat)
   }
   poppr_msn_list <- msn_constructor(
     gid = gid,
@@ -185,6 +185,13 @@ setClass(
 #' 
 #' An internal object used for bootstrapping. Not intended for user interaction.
 #' 
+#' The allele table (with missing data replaced once on creation) and the
+#' slots describing its loci are shared by all subsets of a bootgen object.
+#' Subsetting loci with \code{[} only changes the \code{loci} slot, which is
+#' read directly by \code{\link{diss.dist}} and the distances based on allele
+#' frequencies. \code{\link[adegenet]{tab}} returns the allele table of the
+#' selected loci.
+#' 
 #' @section Extends: 
 #' Virtual Class \code{"\linkS4class{gen}"}.
 #' 
@@ -197,6 +204,8 @@ setClass(
 #'   locus where each element in the vector represents the index for a specific
 #'   allele.
 #' @slot names a vector containing names of the observed samples.
+#' @slot loci an integer vector of the selected loci of the allele table. Loci
+#'   may be repeated.
 #' @keywords internal
 #' @author Zhian N. Kamvar
 #' @import methods
@@ -207,11 +216,13 @@ setClass("bootgen",
                           type = "character",
                           ploidy = "integer",
                           names = "vector", 
-                          alllist = "list"),
+                          alllist = "list",
+                          loci = "integer"),
          prototype = prototype(
           type = character(0),
           ploidy = integer(0),
           names = character(0),
-          alllist = list()
+          alllist = list(),
+          loci = integer(0)
           )
 )
@@ -442,7 +442,8 @@ missingno <- function(pop, type = "loci", cutoff = 0.05, quiet=FALSE, freq = FAL
     warning("missingno cannot be applied to genlight objects at this time.")
     return(pop)
   }
-  if(sum(is.na(pop@tab)) > 0){
+  qc <- locus_qc_native(pop)
+  if (qc$nmissing > 0){
     # removes any loci (columns) with missing values.
     MISSINGOPTS <- c("loci", "genotypes", "mean", "zero", "0", "ignore", "asis")
     freq_warning <- paste("Objects of class 'genind' must have integers in the",
@@ -452,7 +453,7 @@ missingno <- function(pop, type = "loci", cutoff = 0.05, quiet=FALSE, freq = FAL
     if (type %in% c("ignore", "asis")){
       return(pop)
     }
-    navals <- percent_missing(pop, type = type, cutoff = cutoff)
+    navals <- percent_missing(pop, type = type, cutoff = cutoff, qc = qc)
     if (type == "loci"){
       if(quiet != TRUE){
         if (length(navals) == ncol(tab(pop))){
@@ -460,7 +461,7 @@ missingno <- function(pop, type = "loci", cutoff = 0.05, quiet=FALSE, freq = FAL
               paste0(cutoff*100,"%")," found.\n")
         } else {
           remloc <- locNames(pop)[!cumsum(nAll(pop)) %in% navals]
-          rem    <- sum(is.na(tab(pop)))
+          rem    <- qc$nmissing
           missing_messenger(remloc, type = c("locus", "loci"), nremoved = rem, 
                             cutoff = cutoff)
         }
@@ -473,7 +474,7 @@ missingno <- function(pop, type = "loci", cutoff = 0.05, quiet=FALSE, freq = FAL
               paste0(cutoff*100, "%")," found.\n")
         } else {
           remgeno <- indNames(pop)[-navals]
-          rem     <- sum(is.na(tab(pop)))
+          rem     <- qc$nmissing
           missing_messenger(remgeno, type = c("genotype", "genotypes"),
                             nremoved = rem, cutoff = cutoff)
         }
@@ -481,7 +482,7 @@ missingno <- function(pop, type = "loci", cutoff = 0.05, quiet=FALSE, freq = FAL
       pop <- pop[navals, ]
     } else if (type == "mean"){
       if (!quiet){
-        message("\n Replaced ", sum(is.na(tab(pop)))," missing values.")
+        message("\n Replaced ", qc$nmissing," missing values.")
       }
       pop@tab <- tab(pop, freq = freq, NA.method = "mean", quiet=quiet)
       if (freq){
@@ -491,7 +492,7 @@ missingno <- function(pop, type = "loci", cutoff = 0.05, quiet=FALSE, freq = FAL
     # changes all NA's to 0. NOT RECOMMENDED. INTRODUCES MORE DIVERSITY.
     else if (type %in% c("zero","0")){
       if (!quiet){
-        message("\n Replaced ", sum(is.na(tab(pop)))," missing values.")
+        message("\n Replaced ", qc$nmissing," missing values.")
       }
       pop@tab <- tab(pop, freq = freq, NA.method = "zero", quiet=quiet)
 
@@ -577,7 +578,6 @@ missingno <- function(pop, type = "loci", cutoff = 0.05, quiet=FALSE, freq = FAL
 #' }
 #' @export
 #==============================================================================#
-#' @importFrom pegas as.loci
 informloci <- function(pop, cutoff = 2/nInd(pop), MAF = 0.01, quiet = FALSE){
   if (!is.genind(pop)){
     stop("This function only works on genind objects.")
@@ -597,16 +597,16 @@ informloci <- function(pop, cutoff = 2/nInd(pop), MAF = 0.01, quiet = FALSE){
     message("cutoff value: ", cutoff*100, " % ( ",min_ind, " ", ind," ).")
     message("MAF         : ", MAF)
   }
+  qc <- locus_qc_native(pop, MAF = MAF)
+  # A locus is uninformative if too many samples share its most common
+  # genotype. For AFLP data, this means too many or too few typed samples.
+  glocivals <- qc$genotype_max <= nInd(pop) - min_ind
   if (pop@type == "PA"){
-    # cutoff applies to too many or too few typed individuals in AFLP cases.
-    glocivals <- apply(tab(pop), 2, sum) %in% min_ind:(nInd(pop) - min_ind)
+    glocivals <- glocivals & qc$locus_missing == 0
+    alocivals <- isPoly(pop, "locus", thres = MAF)
   } else {
-    genloc    <- as.loci(pop)
-    the_loci  <- attr(genloc, "locicol")
-    glocivals <- apply(genloc[the_loci], 2, test_table, min_ind, nInd(pop))
+    alocivals <- qc$polymorphic
   }
-
-  alocivals <- isPoly(pop, "locus", thres = MAF)
   
   locivals  <- alocivals & glocivals
   
@@ -63,6 +63,10 @@
 #' @param mat \code{logical}. Return a matrix object. Default set to 
 #'   \code{FALSE}, returning a dist object. \code{TRUE} returns a matrix object.
 #'   
+#' @param threads The maximum number of parallel threads to be used within this
+#'   function. Defaults to 1, which runs serially. A value of 0 will attempt to
+#'   use as many threads as there are available cores/CPUs.
+#'   
 #' @return Pairwise distances between individuals present in the genind object.
 #' @author Zhian N. Kamvar
 #'   
@@ -71,8 +75,9 @@
 #'   distance, or the number of differences between two strings.
 #'   
 #' @note When \code{percent = TRUE}, this is exactly the same as
-#'   \code{\link{provesti.dist}}, except that it performs better for large
-#'   numbers of individuals (n > 125) at the cost of available memory.
+#'   \code{\link{provesti.dist}}. The distances are calculated in compiled
+#'   code in a single pass over the data and only the distance matrix itself is
+#'   stored.
 #'
 #' @seealso \code{\link{prevosti.dist}},
 #'    \code{\link{bitwise.dist}} (for SNP data)
@@ -90,7 +95,7 @@
 #' @export
 #==============================================================================#
 
-diss.dist <- function(x, percent=FALSE, mat=FALSE){
+diss.dist <- function(x, percent=FALSE, mat=FALSE, threads = 1L){
   stopifnot(is(x, "gen"))
   ploid     <- x@ploidy
   if (is(x, "bootgen")){
@@ -99,35 +104,31 @@ diss.dist <- function(x, percent=FALSE, mat=FALSE){
     ind.names <- indNames(x)
   }
   inds      <- nrow(x@tab)
-  np        <- choose(inds, 2)
-  dist.mat  <- matrix(data = 0, nrow = inds, ncol = inds)
   numLoci   <- nLoc(x)
   type      <- x@type
+  loci      <- integer(0)
   if (type == "PA"){
-    dist_by_locus <- matrix(.Call("pairdiffs", x@tab))
-    ploid <- 1
+    # Presence/absence data are treated as a single locus
+    xtab    <- tab(x)
+    loc_fac <- rep(1L, ncol(xtab))
+    ploid   <- 1
   } else if (is(x, "bootgen")){
-    dist_by_locus <- vapply(seq(numLoci), function(i){
-      .Call("pairdiffs", tab(x[, i]))/2
-    }, numeric(np))
-  } else {  
-    x <- seploc(x)
-    dist_by_locus <- vapply(x, function(x) .Call("pairdiffs", x@tab)/2,
-                            numeric(np))
-  }
-  if (is.matrix(dist_by_locus)){
-    dist.mat[lower.tri(dist.mat)] <- rowSums(ceiling(dist_by_locus))    
+    # The loci of the view are read directly from the shared table.
+    xtab    <- x@tab
+    loc_fac <- as.integer(x@loc.fac)
+    loci    <- x@loci
   } else {
-    dist.mat[lower.tri(dist.mat)] <- ceiling(dist_by_locus)
-  }
-  colnames(dist.mat) <- ind.names
-  rownames(dist.mat) <- ind.names
-  if (percent){
-    dist.mat <- sweep(dist.mat, 1, ploid * numLoci, "/")
+    xtab    <- tab(x)
+    loc_fac <- as.integer(x@loc.fac)
   }
-  dist.mat <- as.dist(dist.mat)
+  divisor <- if (percent) rep_len(as.numeric(ploid * numLoci), inds) else numeric(0)
+  plan_memory("diss.dist", n = inds, alleles = ncol(xtab), mat = mat)
+  dist.mat <- .Call("diss_distance", xtab, loc_fac, type != "PA", divisor, 
+                    as.integer(threads), loci, PACKAGE = "poppr")
+  dist.mat <- make_attributes(dist.mat, inds, ind.names, "diss.dist", 
+                              match.call())
   if (mat == TRUE){
-    dist.mat <- as.matrix(dist.mat)
+    dist.mat <- with_profile(as.matrix(dist.mat), attr(dist.mat, "poppr_profile"))
   }
   return(dist.mat)
 }
@@ -145,6 +146,10 @@ diss.dist <- function(x, percent=FALSE, mat=FALSE){
 #'   values are detected and replaced. If \code{FALSE}, these values will be 
 #'   replaced without warning. See Details below.
 #'   
+#' @param threads The maximum number of parallel threads to be used within this
+#'   function. Defaults to 1, which runs serially. A value of 0 will attempt to
+#'   use as many threads as there are available cores/CPUs.
+#'   
 #' @return an object of class dist with the same number of observations as the 
 #'   number of individuals in your data.
 #'   
@@ -229,25 +234,13 @@ diss.dist <- function(x, percent=FALSE, mat=FALSE){
 #' (pronan <- prevosti.dist(nan9))
 #' 
 #==============================================================================#
-nei.dist <- function(x, warning = TRUE){
-  if (is(x, "gen")){
-    MAT    <- get_gen_mat(x)
-  } else if (length(dim(x)) == 2){
-    MAT <- x
-  } else {
-    stop("Object must be a matrix or genind object")
-  }
-  IDMAT <- MAT %*% t(MAT)
-  vec   <- sqrt(diag(IDMAT))
-  IDMAT <- IDMAT/vec[col(IDMAT)]
-  IDMAT <- IDMAT/vec[row(IDMAT)]
-  D     <- -log(IDMAT)
+nei.dist <- function(x, warning = TRUE, threads = 1L){
+  D <- pop_dist_engine(x, "Nei", threads = threads)[[1]]
   if (any(D %in% Inf)){
     D <- infinite_vals_replacement(D, warning)
   }
-  D     <- as.dist(D)
-  labs  <- get_gen_dist_labs(x)
-  D     <- make_attributes(D, length(labs), labs, "Nei", match.call())
+  labs <- get_gen_dist_labs(x)
+  D    <- make_attributes(D, length(labs), labs, "Nei", match.call())
   return(D)
 }
 
@@ -255,123 +248,39 @@ nei.dist <- function(x, warning = TRUE){
 
 #' @rdname genetic_distance
 #' @export
-edwards.dist <- function(x){
-  if (is(x, "gen")){ 
-    MAT  <- get_gen_mat(x)
-    nloc <- nLoc(x)
-  } else if (length(dim(x)) == 2){
-    MAT  <- x
-    nloc <- ncol(x)
-  } else {
-    stop("Object must be a matrix or genind object")
-  }
-  MAT     <- sqrt(MAT)
-  D       <- MAT%*%t(MAT)
-  D       <- 1 - D/nloc # Negative number are generated here.
-  diag(D) <- 0
-  D       <- sqrt(D)
-  D       <- as.dist(D)
-  labs    <- get_gen_dist_labs(x)
-  D       <- make_attributes(D, length(labs), labs, "Edwards", match.call())
+edwards.dist <- function(x, threads = 1L){
+  D    <- pop_dist_engine(x, "Edwards", threads = threads)[[1]]
+  labs <- get_gen_dist_labs(x)
+  D    <- make_attributes(D, length(labs), labs, "Edwards", match.call())
   return(D)
 }
 
 
 #' @rdname genetic_distance
 #' @export
-rogers.dist <- function(x){
-  if (is(x, "gen")){ 
-    if (is.genind(x) && x@type == "PA"){
-      MAT     <- x@tab
-      nloc    <- nLoc(x)
-      loc.fac <- factor(locNames(x), levels = locNames(x))
-      nlig    <- nrow(x@tab)
-    } else {
-      MAT     <- get_gen_mat(x)
-      nloc    <- nLoc(x)
-      loc.fac <- x@loc.fac
-      nlig    <- nrow(x@tab)      
-    }
-  } else if (length(dim(x)) == 2){
-    MAT     <- x
-    nloc    <- ncol(x)
-    loc.fac <- factor(colnames(x), levels = colnames(x))
-    nlig    <- nrow(x)
-  } else {
-    stop("Object must be a matrix or genind object")
-  }
-  # kX is a list of K=nloc matrices
-  kX <- lapply(split(MAT, loc.fac[col(MAT)]), matrix, nrow = nlig)
-  D  <- matrix(0, nlig, nlig)
-  for(i in 1:length(kX)){
-    D <- D + dcano(kX[[i]])
-  }
-  D    <- D/length(kX)
-  D    <- as.dist(D)
+rogers.dist <- function(x, threads = 1L){
+  D    <- pop_dist_engine(x, "Rogers", threads = threads)[[1]]
   labs <- get_gen_dist_labs(x)
-  D    <- make_attributes(D, nlig, labs, "Rogers", match.call())
+  D    <- make_attributes(D, length(labs), labs, "Rogers", match.call())
   return(D)
 }
 
 #' @rdname genetic_distance
 #' @export
-reynolds.dist <- function(x){
-  if (is(x, "gen")){ 
-    MAT    <- get_gen_mat(x)
-    nloc   <- nLoc(x)
-  } else if (length(dim(x)) == 2){
-    MAT  <- x
-    nloc <- ncol(x)
-  } else {
-    stop("Object must be a matrix or genind object")
-  }
-  denomi       <- MAT %*% t(MAT)
-  vec          <- apply(MAT, 1, function(x) sum(x*x))
-  D            <- -2*denomi + vec[col(denomi)] + vec[row(denomi)]
-  diag(D)      <- 0
-  denomi       <- 2*nloc - 2*denomi
-  diag(denomi) <- 1
-  D            <- D/denomi
-  D            <- sqrt(D)
-  D            <- as.dist(D)
-  labs         <- get_gen_dist_labs(x)
-  D            <- make_attributes(D, length(labs), labs, "Reynolds", 
-                                  match.call())
+reynolds.dist <- function(x, threads = 1L){
+  D    <- pop_dist_engine(x, "Reynolds", threads = threads)[[1]]
+  labs <- get_gen_dist_labs(x)
+  D    <- make_attributes(D, length(labs), labs, "Reynolds", match.call())
   return(D)
 }
 
 #' @rdname genetic_distance
 #' @export
-provesti.dist <- function(x){
-  if (is(x, "gen")){
-    MAT   <- get_gen_mat(x)
-    nlig  <- nrow(tab(x))
-    nloc  <- nLoc(x)
-    ploid <- x@ploidy
-  } else if (length(dim(x)) == 2){
-    MAT  <- x
-    nlig <- nrow(x)
-    nloc <- ncol(x)
-  } else {
-    stop("Object must be a matrix or genind object")
-  }
-  w0   <- 1:(nlig-1)
-  loca <- function(k, nlig, MAT, nLoc){
-    w1     <- (k+1):nlig
-    resloc <- vapply(w1, function(y) sum(abs(MAT[k, ] - MAT[y, ]), na.rm = TRUE), numeric(1))
-    if (is(x, "gen") && x@type == "codom"){
-      # This only applies to codominant data because dominant data can only take
-      # on a single state. Dividing by two indicates that the observations can
-      # occupy co-occurring states.
-      resloc <- resloc/2
-    }
-    return(resloc/nloc)
-  }
-
-  d    <- unlist(lapply(w0, loca, nlig, MAT, nloc))
+provesti.dist <- function(x, threads = 1L){
+  D    <- pop_dist_engine(x, "Provesti", threads = threads)[[1]]
   labs <- get_gen_dist_labs(x)
-  d    <- make_attributes(d, nlig, labs, "Provesti", match.call())
-  return(d)
+  D    <- make_attributes(D, length(labs), labs, "Provesti", match.call())
+  return(D)
 }
 
 # Making an alias to correct the spelling to fix issue #65
@@ -209,23 +209,20 @@ read.genalex <- function(genalex, ploidy = 2, geo = FALSE, region = FALSE,
   # The first two lines from a genalex file contain all of the information about
   # the structure of the file (except for ploidy and geographic info)
   gencall  <- match.call()
-
-  all.info <- strsplit(readLines(genalex, n = 2), sep)
-  cskip    <- ifelse(inherits(genalex, "connection"), 0, 2)
-  gena     <- utils::read.table(
-    genalex, 
-    sep = sep,
-    header = TRUE,
-    skip = cskip,
-    colClasses = "character",
-    stringsAsFactors = FALSE,
-    check.names = FALSE,
-    quote = "\""
-  )
-  for (i in seq_along(gena)) {
-    the_col <- trimws(gena[[i]])
-    the_col[the_col == ""] <- NA_character_
-    gena[[i]] <- the_col
+  
+  # Local files are read directly in compiled code. Connections, URLs, and
+  # compressed files are read into memory first.
+  in_memory <- inherits(genalex, "connection") || 
+               grepl("(://|[.](gz|bz2|xz)$)", genalex)
+  if (in_memory) {
+    all.lines <- readLines(genalex)
+    all.info  <- strsplit(all.lines[1:2], sep)
+    gena      <- read_genalex_table(paste(all.lines[-(1:2)], collapse = "\n"),
+                                    is_file = FALSE, sep = sep)
+    rm(all.lines)
+  } else {
+    all.info <- strsplit(readLines(genalex, n = 2), sep)
+    gena     <- read_genalex_table(genalex, is_file = TRUE, sep = sep, skip = 2L)
   }
   num.info <- as.numeric(all.info[[1]])
   pop.info <- all.info[[2]][-c(1:3)]
@@ -236,8 +233,8 @@ read.genalex <- function(genalex, ploidy = 2, geo = FALSE, region = FALSE,
   npops    <- num.info[3]
   
   # Ensuring that all rows and columns have data
-  data_rows <- apply(gena, 1, function(i) !all(is.na(i)))
-  data_cols <- apply(gena, 2, function(i) !all(is.na(i)))
+  data_rows <- Reduce(function(a, b) a | !is.na(b), gena, logical(nrow(gena)))
+  data_cols <- vapply(gena, function(i) !all(is.na(i)), logical(1))
   gcols     <- colnames(gena)
   dups      <- duplicated(gcols)
   if (any(dups) && any(gcols[dups] != "")){
@@ -291,8 +288,8 @@ read.genalex <- function(genalex, ploidy = 2, geo = FALSE, region = FALSE,
   if (region == TRUE && !is.na(region_columns) && pop_and_region) {
     if (geo_columns || no_geo_columns) {
       # The regions were not specified in the columns
-      pop.vec     <- gena[[2]]
-      ind.vec     <- gena[[1]]
+      pop.vec     <- as.character(gena[[2]])
+      ind.vec     <- as.character(gena[[1]])
       xy          <- gena[, geoinds]
       region.inds <- ((npops + 5):length(num.info)) # Indices for the regions
       reg.inds    <- num.info[region.inds] # Number of individuals per region
@@ -312,8 +309,8 @@ read.genalex <- function(genalex, ploidy = 2, geo = FALSE, region = FALSE,
       pop.vec      <- if (any(gena[[1]] == pop.info[1])) 1 else 2
       reg.vec      <- if (pop.vec == 2) 1 else 2
       orig.ind.vec <- NULL
-      reg.vec      <- gena[[reg.vec]] # Regional Vector 
-      pop.vec      <- gena[[pop.vec]] # Population Vector
+      reg.vec      <- as.character(gena[[reg.vec]]) # Regional Vector 
+      pop.vec      <- as.character(gena[[pop.vec]]) # Population Vector
       if (geo == TRUE) {
         xy   <- gena[, geoinds]
         gena <- gena[, -geoinds, drop = FALSE]
@@ -321,21 +318,21 @@ read.genalex <- function(genalex, ploidy = 2, geo = FALSE, region = FALSE,
       } else {
         xy   <- NULL
       }
-      ind.vec <- gena[[clm]] # Individual Vector
+      ind.vec <- as.character(gena[[clm]]) # Individual Vector
       gena    <- gena[, -c(1, 2, clm), drop = FALSE] # removing the non-genotypic columns
     }
   } else if (geo == TRUE && just_pop) {
     # There are no Regions specified, but there are geographic coordinates
     reg.vec <- NULL
-    pop.vec <- gena[[2]]
-    ind.vec <- gena[[1]]
+    pop.vec <- as.character(gena[[2]])
+    ind.vec <- as.character(gena[[1]])
     xy      <- gena[, geoinds]
     gena    <- gena[, -c(1, 2, geoinds), drop = FALSE]
   } else {
     # There are no Regions or geographic coordinates
     reg.vec <- NULL
-    pop.vec <- gena[[2]]
-    ind.vec <- gena[[1]]
+    pop.vec <- as.character(gena[[2]])
+    ind.vec <- as.character(gena[[1]])
     xy      <- NULL
     gena    <- gena[, -c(1, 2), drop = FALSE]
   }
@@ -343,8 +340,7 @@ read.genalex <- function(genalex, ploidy = 2, geo = FALSE, region = FALSE,
   `%null%` <- function(a, b) if (is.null(a)) NULL else b
   
   if (!is.null(xy)) {
-    mode(xy[[1]]) <- "numeric"
-    mode(xy[[2]]) <- "numeric"
+    xy[] <- lapply(xy, function(i) as.numeric(as.character(i)))
   }
 
   xy_trail_na <- xy %null% (rev(cumsum(rev(rowSums(!is.na(xy))))) > 0)
@@ -361,64 +357,26 @@ read.genalex <- function(genalex, ploidy = 2, geo = FALSE, region = FALSE,
   rownames(xy)   <- if (xy_nomatch) rownames(xy) else ind.vec
   
   #----------------------------------------------------------------------------#
-  # The genotype matrix has been isolated at this point. Now this will
-  # reconstruct the matrix in a way that adegenet likes it.
+  # The genotype matrix has been isolated at this point. Now the alleles are
+  # counted from the factor codes of each column in compiled code.
   #----------------------------------------------------------------------------#
-  clm      <- ncol(gena)
-  gena.mat <- as.matrix(gena)
-  # Checking for greater than haploid data.
+  clm <- ncol(gena)
   if (nloci == clm/ploidy & ploidy > 1){
     # Missing data in genalex is coded as "0" for non-presence/absence data.
-    # We will convert these data later, but this will take care of the 
-    # data that's considered missing here
-    gena[is.na(gena.mat)] <- "0"
-    
-    type  <- 'codom'
-    # The remainder of the position when divided by ploidy is 1, which means
-    # that this is the first column starting the locus
-    loci  <- which(seq(clm) %% ploidy == 1)
-    gena2 <- gena[, loci, drop = FALSE]
-
-    # Collapsing all alleles over all loci into their respective loci.
-    for (pos in loci){
-      # Get the locus position in gena2. Example, in a triploid, the second
-      # locus would be at gena[, 4:6], so the second element in pos would be 4
-      # because position %% ploidy is 4 %% 3 == 1
-      # We get our position out by:
-      #  1. subtracting 1 to account for the modulo
-      #  2. divide by ploidy
-      #  3. add 1 to bring it up to R's 1-index
-      pos_out <- ((pos - 1)/ploidy) + 1
-      pos_in  <- pos:(pos + ploidy - 1) # allele positions in gena
-      # paste columns of locus together
-      donor   <- do.call("paste", c(gena[pos_in], list(sep = "/")))
-      gena2[, pos_out] <- donor
-    }
-
-    # Treating missing data.
-    gena2[gena2 == paste(rep("0", ploidy), collapse = "/")] <- NA_character_
-    
-    # Importing
-    res.gid <- df2genind(gena2, sep="/", ind.names = ind.vec, pop = pop.vec,
-                         ploidy = ploidy, type = type)
-  } else if (nloci == clm & all(gena.mat %in% as.integer(-1:1))) {
+    # Genotypes with only missing alleles are missing; otherwise, the missing
+    # alleles are kept as "0" for polyploids.
+    type    <- "codom"
+    gploidy <- ploidy
+  } else if (nloci == clm && is_genalex_pa(gena)) {
     # Checking for AFLP data.
     # Missing data in genalex is coded as "-1" for presence/absence data.
-    # this converts it to "NA" for adegenet.
-    if(any(gena.mat == -1L)){
-      gena[gena.mat == -1L] <- NA
-    }
-    type <- 'PA'
-    res.gid <- df2genind(gena, ind.names = ind.vec, pop = pop.vec,
-                         ploidy = ploidy, type = type, ncode = 1)
-  } else if (nloci == clm & !all(gena.mat %in% as.integer(-1:1))) {
+    type    <- "PA"
+    gploidy <- 1L
+  } else if (nloci == clm) {
     # Checking for haploid microsatellite data or SNP data
-    if (any(gena.mat == "0", na.rm = TRUE)){
-      gena[gena.mat == "0"] <- NA
-    }
-    type    <- 'codom'
-    res.gid <- df2genind(gena, ind.names = ind.vec, pop = pop.vec,
-                         ploidy = 1, type = type)
+    type    <- "codom"
+    gploidy <- 1L
+    ploidy  <- 1L
   } else {
     weirdomsg <- paste(
       "Something went wrong. Please ensure that your data is", 
@@ -438,6 +396,8 @@ read.genalex <- function(genalex, ploidy = 2, geo = FALSE, region = FALSE,
       "   3. Create a new issue on https://github.com/grunwaldlab/poppr/issues")
     stop(weirdomsg)
   }
+  loci    <- colnames(gena)[seq(1, clm, by = gploidy)]
+  res.gid <- genalex_genind(gena, loci, ind.vec, pop.vec, ploidy, gploidy, type)
   res.gid@call <- gencall
   # Checking for individual name duplications or removals -------------------
   
@@ -480,6 +440,93 @@ read.genalex <- function(genalex, ploidy = 2, geo = FALSE, region = FALSE,
   return(res.gid)
 }
 
+#==============================================================================#
+#' Importing genotypes from VCF files
+#' 
+#' Read the genotypes of a (plain or gzipped) VCF file into a [genlight-class]
+#' or [snpclone-class] object for [bitwise.dist()], [win.ia()], and
+#' [samp.ia()].
+#' 
+#' @param file the name of a VCF file. Files compressed with gzip or bgzip are
+#'   decompressed while reading.
+#'   
+#' @param biallelic `logical` if `TRUE` (default), only sites with exactly one
+#'   alternate allele are kept. If `FALSE`, all alternate alleles of a site are
+#'   counted as one allele.
+#'   
+#' @param maf the minimum minor allele frequency of the sites to keep.
+#'   Defaults to 0, which keeps all sites.
+#'   
+#' @param max_missing the maximum proportion of samples with missing
+#'   genotypes at the sites to keep. Defaults to 1, which keeps all sites.
+#'   
+#' @param chunk_size the number of lines of the file that are decoded at once.
+#'   Memory for one byte per sample is needed for every line of a chunk.
+#'   
+#' @param snpclone `logical` if `TRUE`, a snpclone object is returned.
+#'   Defaults to `FALSE`, which returns a genlight object.
+#'   
+#' @param threads the number of threads to use. A value of 0 will use as many
+#'   threads as are available.
+#'   
+#' @details The file is read in chunks of lines and only the GT field of each
+#'   sample is decoded. The lines of a chunk are decoded and filtered in
+#'   parallel and the sites that pass the filters are added directly to the
+#'   packed genotypes of the samples, so a genotype matrix is never created.
+#'   
+#'   A genotype with any missing allele is missing. The ploidy of each sample
+#'   is the largest number of alleles in its genotypes. Loci without an ID are
+#'   named after their chromosome and position, which are stored in the
+#'   object for [win.ia()].
+#'   
+#' @return a [genlight-class] or [snpclone-class] object.
+#' 
+#' @seealso [read.genalex()], [bitwise.dist()], [win.ia()]
+#' @export
+#' @author Zhian N. Kamvar
+#' @md
+#' @examples
+#' vcf <- tempfile(fileext = ".vcf")
+#' writeLines(c("##fileformat=VCFv4.2",
+#'              paste("#CHROM", "POS", "ID", "REF", "ALT", "QUAL", "FILTER", 
+#'                    "INFO", "FORMAT", "A", "B", "C", sep = "\t"),
+#'              paste("1", "10", "rs1", "A", "G", ".", "PASS", ".", "GT", 
+#'                    "0/0", "0/1", "1/1", sep = "\t"),
+#'              paste("1", "20", ".", "C", "T", ".", "PASS", ".", "GT", 
+#'                    "0/1", "./.", "0/0", sep = "\t")), vcf)
+#' x <- read_vcf(vcf)
+#' as.matrix(x)
+#' bitwise.dist(x)
+#' unlink(vcf)
+#==============================================================================#
+read_vcf <- function(file, biallelic = TRUE, maf = 0, max_missing = 1, 
+                     chunk_size = 1000L, snpclone = FALSE, threads = 1L){
+  if (!file.exists(file)){
+    stop("The file ", file, " does not exist.")
+  }
+  res <- .Call("read_vcf_native", path.expand(file), as.logical(biallelic), 
+               as.numeric(maf), as.numeric(max_missing), as.integer(chunk_size),
+               as.integer(threads), PACKAGE = "poppr")
+  loci      <- res$loc.names
+  unnamed   <- is.na(loci)
+  loci[unnamed] <- paste(res$chromosome[unnamed], res$position[unnamed], 
+                         sep = "_")
+  # The slots are filled directly; the SNPbin objects are already complete.
+  gl            <- new("genlight")
+  gl@gen        <- res$gen
+  gl@n.loc      <- length(loci)
+  gl@ind.names  <- res$ind.names
+  gl@loc.names  <- loci
+  gl@loc.all    <- res$alleles
+  gl@chromosome <- factor(res$chromosome, unique(res$chromosome))
+  gl@position   <- res$position
+  gl@ploidy     <- res$ploidy
+  if (snpclone){
+    gl <- as.snpclone(gl, parallel = FALSE)
+  }
+  gl
+}
+
 #==============================================================================#
 #' Export data from genind objects to genalex formatted \*.csv files.
 #' 
@@ -593,14 +640,16 @@ genind2genalex <- function(gid, filename = "", overwrite = FALSE, quiet = FALSE,
   # names. 
   topline <- c(topline, popsizes)
   secondline <- c("", "", "", popNames(gid))
-  ploid <- ploidy(gid)
+  ploid    <- ploidy(gid)
+  PA       <- gid@type == "PA"
+  maxploid <- if (PA) 1L else max(ploid)
   # Constructing the locus names. GenAlEx separates the alleles of the loci, so
   # There is one locus name for every p ploidy columns you have.
-  if(all(ploid > 1) & gid@type == "codom"){
+  if(maxploid > 1){
     # To intersperse spaces between the locus names, make a ploidy x loci
     # matrix, fill the first row with the loci names, fill the rest with
     # emptiness, and then convert it into a vector.
-    locnames       <- matrix(character(nLoc(gid)*max(ploid)), nrow = max(ploid))
+    locnames       <- matrix(character(nLoc(gid)*maxploid), nrow = maxploid)
     locnames[1, ]  <- locNames(gid)
     locnames[-1, ] <- " "
     dim(locnames)  <- NULL
@@ -632,31 +681,39 @@ genind2genalex <- function(gid, filename = "", overwrite = FALSE, quiet = FALSE,
   }
   if(!quiet) cat("Extracting the table ... ")
   the_gid <- as.character(pop(gid))
-  df      <- genind2df(gid, sep = "/", usepop = FALSE)
-  if (any(ploid > 1)){
-    df <- generate_bruvo_mat(df, maxploid = max(ploid), sep = "/", mat_type = "character")
+  if (PA) {
+    loc_fac <- seq_len(ncol(tab(gid)))
+    alls    <- character(ncol(tab(gid)))
+  } else {
+    loc_fac <- as.integer(locFac(gid))
+    alls    <- unlist(alleles(gid), use.names = FALSE)
   }
-  df[is.na(df)] <- 0
+  # The genotypes are formatted from the allele counts in compiled code with
+  # "0" for missing alleles ("-1" for presence/absence data).
+  genos <- .Call("genalex_rows", tab(gid), loc_fac, alls, as.integer(maxploid),
+                 PA, sep, PACKAGE = "poppr")
   
   # making sure that the individual names are included.
   if(all(indNames(gid) == "") | is.null(indNames(gid))){
     indNames(gid) <- paste("ind", seq(nInd(gid)), sep="")
   }
-  df <- cbind(indNames(gid), the_gid, df)
-  # setting the NA replacement. This doesn't work too well. 
-  replacement <- if(gid@type == "PA") "-1" else "0"
+  quote_field <- function(x) paste0("\"", gsub("\"", "\"\"", x), "\"")
+  df     <- paste(quote_field(indNames(gid)), quote_field(the_gid), genos, 
+                  sep = sep)
+  ncells <- 2L + length(locnames)
   if(!quiet) cat("Writing the table to", filename, "... ")
   
   if(geo == TRUE & !is.null(gid$other[[geodf]])){
     replacemat <- matrix("", 3, 3)
     replacemat[3, 2:3] <- c("X", "Y")
     infolines <- cbind(infolines, replacemat)
-    df2 <- data.frame(list("Space" = rep("", nInd(gid))))
     gdf <- as.matrix(gid@other[[geodf]])
+    gdf <- matrix(as.character(gdf), ncol = 2)
     if (nrow(gdf) < nInd(gid)){
       gdf <- rbind(gdf, matrix("", nInd(gid) - nrow(gdf), 2))
     }
-    df <- cbind(df, df2, gdf)
+    df     <- paste(df, "", gdf[, 1], gdf[, 2], sep = sep)
+    ncells <- ncells + 3L
   } else if (geo == TRUE) {
     popcall <- popcall[2]
     warning(paste0("There is no data frame or matrix in ",
@@ -665,17 +722,138 @@ genind2genalex <- function(gid, filename = "", overwrite = FALSE, quiet = FALSE,
                   " resulting file."))
   }
   
-  df[df == "NA" | is.na(df)] <- replacement
-  
-  if (ncol(infolines) > ncol(df)){
-    lendiff <- ncol(infolines) - ncol(df)
-    padding <- matrix("", nrow = nInd(gid), ncol = lendiff)
-    df      <- cbind(df, padding)
-  }
-  write.table(infolines, file = filename, quote = FALSE, row.names = FALSE, 
-              col.names = FALSE, sep = sep)
-  write.table(df, file = filename, quote = TRUE, na = replacement, append = TRUE, 
-              row.names = FALSE, col.names = FALSE, sep = sep)
+  if (ncol(infolines) > ncells){
+    df <- paste0(df, strrep(sep, ncol(infolines) - ncells))
+  }
+  infolines <- apply(infolines, 1, paste, collapse = sep)
+  writeLines(c(infolines, df), filename)
   if(!quiet) cat("Done.\n")
   invisible(return(filename))
 }
+
+#==============================================================================#
+#' Save and read binary poppr files
+#' 
+#' A poppr file is a binary file that stores a [genclone-class],
+#' [snpclone-class], [genind-class], or [genlight-class] object and
+#' (optionally) a distance matrix between its samples. The allele table (or
+#' the packed SNP and missing data planes of a genlight object), the strata,
+#' the multilocus genotypes, and the distance matrix are each stored in their
+#' own section of the file, so that a subset of the samples can be read
+#' without reading the rest of the file.
+#' 
+#' @param x for `save_poppr()`, a genclone, snpclone, genind, or genlight
+#'   object. For `read_poppr()`, the name of a poppr file or a `poppr_file`
+#'   object from `open_poppr()`.
+#'   
+#' @param file the name of the poppr file.
+#'   
+#' @param distance a [dist()] object or a square matrix of distances between
+#'   the samples of `x` to store with the data. Defaults to `NULL`.
+#'   
+#' @param overwrite `logical` if `FALSE` (default) and `file` exists, then the
+#'   file will not be overwritten.
+#'   
+#' @param population a vector of population names or indices of the
+#'   populations to read (as in [popsub()]). Defaults to `NULL`, which reads all
+#'   samples.
+#'   
+#' @param what either `"data"` (default) to read the samples or `"distance"`
+#'   to read the distance matrix between the samples.
+#'   
+#' @details `open_poppr()` maps the file into memory where the operating
+#'   system allows it (otherwise, it is read) and only reads the number of
+#'   samples and loci, the sample names, and the population factor. [nInd()],
+#'   [nLoc()], and [mlg()] work on the opened file without creating the
+#'   object. `read_poppr()` copies only the rows of the allele table (or the
+#'   SNP planes) and the distances between the samples in the selected
+#'   populations out of the file.
+#'   
+#'   The file is written in the byte order of the machine and cannot be read
+#'   on a machine with a different byte order.
+#'   
+#' @return 
+#'   - `save_poppr()`: the file name, invisibly.
+#'   - `open_poppr()`: an object of class `poppr_file`.
+#'   - `read_poppr()`: an object of the same class that was saved or a
+#'   [dist()] object.
+#'   
+#' @seealso [read.genalex()], [popsub()]
+#' @export
+#' @rdname poppr_file
+#' @aliases poppr_file
+#' @author Zhian N. Kamvar
+#' @md
+#' @examples
+#' data(monpop)
+#' f <- tempfile(fileext = ".poppr")
+#' save_poppr(monpop, f, distance = diss.dist(monpop))
+#' pf <- open_poppr(f)
+#' pf
+#' nInd(pf)
+#' mlg(pf)
+#' read_poppr(pf, population = 1)
+#' read_poppr(pf, population = 1, what = "distance")
+#' close(pf)
+#' unlink(f)
+#==============================================================================#
+save_poppr <- function(x, file, distance = NULL, overwrite = FALSE){
+  if (!is.genind(x) && !inherits(x, "genlight")){
+    stop("x must be a genind, genclone, genlight, or snpclone object.")
+  }
+  if (file.exists(file) && !overwrite){
+    msg <- paste("The file", file, "exists and will not be overwritten.",
+                 "\nUse `overwrite = TRUE` if you want to replace this file.")
+    stop(msg)
+  }
+  if (!is.null(distance)){
+    distance <- stats::as.dist(distance)
+    if (attr(distance, "Size") != nInd(x)){
+      stop("the distance matrix must have one observation per sample.")
+    }
+  }
+  sections <- poppr_file_sections(x, distance)
+  .Call("poppr_file_write", path.expand(file), sections, PACKAGE = "poppr")
+  invisible(file)
+}
+
+#==============================================================================#
+#' @rdname poppr_file
+#' @export
+#==============================================================================#
+open_poppr <- function(file){
+  ptr   <- .Call("poppr_file_open", path.expand(file), PACKAGE = "poppr")
+  index <- .Call("poppr_file_index", ptr, PACKAGE = "poppr")
+  index <- as.data.frame(index, stringsAsFactors = FALSE)
+  res   <- list(file = file, ptr = ptr, index = index)
+  info  <- unserialize(poppr_file_get(res, "info"))
+  structure(c(res, info), class = "poppr_file")
+}
+
+#==============================================================================#
+#' @rdname poppr_file
+#' @export
+#==============================================================================#
+read_poppr <- function(x, population = NULL, what = c("data", "distance")){
+  what <- match.arg(what)
+  if (!inherits(x, "poppr_file")){
+    x <- open_poppr(x)
+  }
+  rows <- poppr_file_rows(x, population)
+  if (what == "distance"){
+    return(poppr_file_dist(x, rows))
+  }
+  poppr_file_object(x, rows)
+}
+
+#==============================================================================#
+#' @rdname poppr_file
+#' @param con a `poppr_file` object to close. The file is also closed when the
+#'   object is garbage collected.
+#' @method close poppr_file
+#' @export
+#==============================================================================#
+close.poppr_file <- function(con, ...){
+  .Call("poppr_file_close", con$ptr, PACKAGE = "poppr")
+  invisible(NULL)
+}
@@ -43,29 +43,172 @@
 #!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!#
 
 #==============================================================================#
-# Distance Matrix Storage Function
+# Result Cache
 #
-# Helper function used to store data between function calls.
+# Results that take long to compute (distance matrices and minimum spanning
+# networks) are kept in .poppr_cache between calls. They are keyed by a hash
+# of the content of the data and the arguments (see cache_key and
+# distance_key), so the cache is shared by every call in the R session,
+# including every imsn() session.
+# When the entries are larger than the limit of cache_limit(), the entries
+# that were used least recently are dropped.
 #
-# @param v used in \code{.last.value$set(v)} to store object v
-# 
-# @return a list like \code{.last.value.dist} and
-#  \code{.last.value.param} with attributes $set(v) and $get()
-#  which store data globally, allowing access between function calls.
+# The entries are lists with
+#  - value the cached result
+#  - what a label for poppr_cache()
+#  - bytes the size of the value
+#  - used the tick of the last time the entry was used
+#
+# Public functions utilizing this:
+# # imsn poppr_cache mlg.filter filter_stats poppr.amova aboot bruvo.msn
+#
+# Internal functions utilizing this:
+# # cache_get cache_set cache_value
+#==============================================================================#
+.poppr_cache <- new.env(parent = emptyenv())
+.poppr_cache$entries <- list()
+.poppr_cache$tick    <- 0
+
+#==============================================================================#
+# Hash the content of data and arguments for the keys of .poppr_cache. The call
+# slot of genind and genlight objects is ignored, so that the same data give
+# the same key no matter how they were created.
+#
+# Input:
+#  - ... any R objects. Functions should be given by their text.
+#
+# Output: a string of 32 hexadecimal digits (see src/poppr_hash.c)
+#
+# Public functions utilizing this function:
+# # imsn
+#
+# Internal functions utilizing this function:
+# # distance_key
+#==============================================================================#
+cache_key <- function(...){
+  args <- lapply(list(...), function(i){
+    if (isS4(i) && methods::.hasSlot(i, "call")){
+      methods::slot(i, "call", check = FALSE) <- NULL
+    }
+    i
+  })
+  .Call("poppr_hash", args, PACKAGE = "poppr")
+}
+
+#==============================================================================#
+# Get a value from .poppr_cache and mark it as used.
+#
+# Input:
+#  - key the result of cache_key()
+#
+# Output: the value or NULL if it is not in the cache
+#
+# Public functions utilizing this function:
+# # none
+#
+# Internal functions utilizing this function:
+# # cache_value
+#==============================================================================#
+cache_get <- function(key){
+  entry <- .poppr_cache$entries[[key]]
+  if (is.null(entry)){
+    return(NULL)
+  }
+  .poppr_cache$tick <- .poppr_cache$tick + 1
+  .poppr_cache$entries[[key]]$used <- .poppr_cache$tick
+  entry$value
+}
+
+#==============================================================================#
+# The number of bytes the cache may hold. This is getOption("poppr.cache_limit"),
+# but at most a quarter of the memory the cache could have: the memory budget
+# of the calculations (see memory_budget) and the memory the cache already
+# holds. The cache thus shrinks before it takes the memory plan_memory needs
+# for the calculations.
+#
+# Output: the number of bytes (0 turns the cache off)
 #
 # Public functions utilizing this function:
-# # mlg.filter
+# # none
 #
 # Internal functions utilizing this function:
+# # cache_set
+#==============================================================================#
+cache_limit <- function(){
+  limit <- getOption("poppr.cache_limit")
+  limit <- if (is.null(limit) || is.na(limit)) 0 else as_bytes(limit)
+  if (limit <= 0){
+    return(0)
+  }
+  budget <- memory_budget()$bytes
+  if (is.na(budget)){
+    return(limit)
+  }
+  cached <- sum(vapply(.poppr_cache$entries, "[[", numeric(1), "bytes"))
+  min(limit, max(budget + cached, 0) / 4)
+}
+
+#==============================================================================#
+# Put a value into .poppr_cache and drop the entries used least recently until
+# the cache fits cache_limit(). Values larger than the limit are not cached.
+#
+# Input:
+#  - key the result of cache_key()
+#  - value any R object except NULL
+#  - what a label for the entry
+#
+# Output: the value, invisibly
+#
+# Public functions utilizing this function:
 # # none
-# 
+#
+# Internal functions utilizing this function:
+# # cache_value
+#==============================================================================#
+cache_set <- function(key, value, what = ""){
+  limit <- cache_limit()
+  bytes <- as.numeric(utils::object.size(value))
+  if (is.null(value) || bytes > limit){
+    return(invisible(value))
+  }
+  .poppr_cache$tick <- .poppr_cache$tick + 1
+  entries <- .poppr_cache$entries
+  entries[[key]] <- list(value = value, what = what, bytes = bytes, 
+                         used = .poppr_cache$tick)
+  sizes <- vapply(entries, "[[", numeric(1), "bytes")
+  used  <- vapply(entries, "[[", numeric(1), "used")
+  drop  <- order(used)
+  while (sum(sizes) > limit){
+    sizes[drop[1]] <- 0
+    entries[[names(used)[drop[1]]]] <- NULL
+    drop <- drop[-1]
+  }
+  .poppr_cache$entries <- entries
+  invisible(value)
+}
+
+#==============================================================================#
+# Get a value from .poppr_cache or compute and cache it.
+#
+# Input:
+#  - key the result of cache_key()
+#  - expr the expression computing the value. It is only evaluated if the
+#    value is not in the cache.
+#  - what a label for the entry
+#
+# Output: the value
+#
+# Public functions utilizing this function:
+# # imsn mlg.filter
+#
+# Internal functions utilizing this function:
+# # cached_distance
 #==============================================================================#
-.last.value <- function(){
-  last_value <- NULL
-  list(
-    get = function() {last_value},
-    set = function(v) {last_value <<- v }
-  )
+cache_value <- function(key, expr, what = ""){
+  value <- cache_get(key)
+  if (is.null(value)){
+    value <- expr
+    cache_set(key, value, what)
+  }
+  value
 }
-.last.value.dist <- .last.value()
-.last.value.param <- .last.value()
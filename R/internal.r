@@ -134,20 +134,16 @@ process_file <- function(input, quiet=TRUE, missing="ignore", cutoff=0.05,
 # # none.
 #==============================================================================#
 
-percent_missing <- function(pop, type="loci", cutoff=0.05){
+percent_missing <- function(pop, type="loci", cutoff=0.05, 
+                            qc = locus_qc_native(pop)){
   if (toupper(type) == "LOCI"){
-    missing_loci        <- 1 - propTyped(pop, "loc")
-    locfac              <- locFac(pop)
-    names(missing_loci) <- levels(locfac)
-    missing_loci        <- missing_loci[missing_loci <= cutoff]
-    misslist            <- 1:length(locfac)
-    filter              <- locfac %in% names(missing_loci)
+    missing_loci <- qc$locus_missing / nInd(pop)
+    filter       <- (missing_loci <= cutoff)[qc$loc_fac]
   } else {
-    missing_geno <- 1 - propTyped(pop, "ind")
-    misslist     <- 1:nInd(pop)
+    missing_geno <- qc$sample_missing / length(qc$locus_missing)
     filter       <- missing_geno <= cutoff
   }
-  return(misslist[filter])
+  return(which(filter))
 }
 
 #==============================================================================#
@@ -403,7 +399,7 @@ final <- function(Iout, result){
 #==============================================================================#
 
 .ia <- function(pop, sample=0, method=1, quiet=FALSE, namelist=NULL, 
-                missing="ignore", hist=TRUE, index = "rbarD"){
+                missing="ignore", hist=TRUE, index = "rbarD", threads = 1L){
   METHODS = c("permute alleles", "parametric bootstrap",
               "non-parametric bootstrap", "multilocus")
   if(pop@type!="PA"){
@@ -452,7 +448,8 @@ final <- function(Iout, result){
       progressr::handlers("void")
     }
     progressr::with_progress({
-      samp <- .sampling(popx, sample, missing, quiet=quiet, type=type, method=method)
+      samp <- .sampling(pop, sample, missing, quiet=quiet, type=type, method=method,
+                        threads=threads)
     })
     p.val    <- sum(IarD[1] <= c(samp$Ia, IarD[1]))/(sample + 1)#ia.pval(index="Ia", samp2, IarD[1])
     p.val[2] <- sum(IarD[2] <= c(samp$rbarD, IarD[2]))/(sample + 1)#ia.pval(index="rbarD", samp2, IarD[2])
@@ -715,20 +712,6 @@ guesslengths <- function(vec){
     return(1)
   }
 }
-#==============================================================================#
-# Specifically used to find loci with an excessive number of the same genotype.
-#
-# Public functions utilizing this function:
-# # informloci
-#
-# Internal functions utilizing this function:
-# # none
-#==============================================================================#
-test_table <- function(loc, min_ind, n){
-  tab <- table(loc)
-  return(ifelse(any(tab > n - min_ind), FALSE, TRUE))
-}
-
 #==============================================================================#
 # Normalize negative branch lenght by converting the negative branch to zero
 # and adding the negative value to the sibling branch.
@@ -826,6 +809,34 @@ bruvos_distance <- function(bruvomat, funk_call = match.call(), add = TRUE,
   # Getting the permutation vector.
   perms <- .Call("permuto", ploid, PACKAGE = "poppr")
 
+  # If the distances for all loci do not fit in memory, the average is
+  # accumulated over blocks of loci.
+  if (!by_locus){
+    plan <- plan_memory("bruvo.dist", n = nrow(x), nloc = ncol(x)/ploid)
+    if (plan$mode == "blocked"){
+      nloc   <- ncol(x)/ploid
+      blocks <- split(seq_len(nloc), ceiling(seq_len(nloc)/plan$block))
+      total  <- 0
+      counts <- 0
+      for (b in blocks){
+        cols    <- as.vector(outer(seq_len(ploid), (b - 1L) * ploid, "+"))
+        distmat <- .Call("bruvo_distance", x[, cols, drop = FALSE], perms, 
+                         ploid, add, loss, getOption("old.bruvo.model"),
+                         PACKAGE = "poppr")
+        distmat[distmat == 100] <- NA
+        total   <- total + rowSums(distmat, na.rm = TRUE)
+        counts  <- counts + rowSums(!is.na(distmat))
+      }
+      rm(distmat)
+      dist.mat <- structure(total/counts, Size = nrow(x), Diag = FALSE, 
+                            Upper = FALSE, class = "dist")
+      attr(dist.mat, "Labels") <- bruvomat@ind.names
+      attr(dist.mat, "method") <- "Bruvo"
+      attr(dist.mat, "call")   <- funk_call
+      return(dist.mat)
+    }
+  }
+
   # Calculating bruvo's distance over each locus. 
   distmat <- .Call("bruvo_distance", 
                    x,     # data matrix
@@ -1049,21 +1060,25 @@ separate_haplotypes <- function(x){
   dplyr::bind_rows(df)
 }
 #==============================================================================#
-# The function locus_table_pegas is the internal workhorse. It will process a
-# summary.loci object into a nice table utilizing the various diversity indices
-# provided by vegan. Note that it has a catch which will remove all allele names
-# that are any amount of zeroes and nothing else. The reason for this being that
-# these alleles actually represent missing data. The wrapper for this is
-# locus_table, which will take in a genind object and send it into
-# locus_table_pegas. 
-# Note: lev argument has only the options of "allele" or "genotype"
-# 
-# UPDATE 2015-07-16: I had noticed in issue #47 that the definition of Hexp was
-# completely wrong. It was correcting by the number of classes as opposed to the
-# number of samples, artificially increasing the diversity. It has been
-# corrected with one exception: polyploids will not be able to utilize this
-# correction because the allelic dosage is ambiguous. This is corrected by
-# utilizing Müller's index, which is equivalent to the unbiased Simpson's index.
+# Calculate diversity statistics for every locus of one or more populations in
+# compiled code. Allele (or genotype) counts are taken directly from the allele
+# table, so no genotype strings are created. Alleles that are any amount of
+# zeroes and nothing else represent missing data in codominant data and are not
+# counted.
+#
+# Like poppr, Hexp is Nei's unbiased gene diversity. Polyploids will not be
+# able to utilize this correction because the allelic dosage is ambiguous. For
+# lev = "genotype", this is Müller's index, which is equivalent to the unbiased
+# Simpson's index.
+#
+# Input:
+#  - x a genind or genclone object
+#  - pops a list of integer vectors of samples in each population
+#  - lev either "allele" or "genotype"
+#  - threads the number of threads
+#
+# Output: a list of matrices (one per population) with loci in rows and the
+# number of observed types, 1-D, H, G, Hexp, and Evenness in columns.
 # 
 # Public functions utilizing this function:
 # # locus_table
@@ -1071,77 +1086,1072 @@ separate_haplotypes <- function(x){
 # Internal functions utilizing this function:
 # # none
 #==============================================================================#
-locus_table_pegas <- function(x, index = "simpson", lev = "allele", ploidy = NULL, 
-                              type = "codom", hexp_only = FALSE){
-  unique_types <- x[[lev]]
-  # Removing any zero-typed alleles that would be present with polyploids.
-  unique_types <- remove_zeroes(unique_types, type)
+locus_table_native <- function(x, pops = list(seq_len(nInd(x))), 
+                               lev = "allele", threads = 1L){
+  PA <- x@type == "PA"
+  if (PA){
+    loc_fac <- seq_len(ncol(tab(x)))
+    zeroes  <- logical(ncol(tab(x)))
+    loci    <- colnames(tab(x))
+  } else {
+    loc_fac <- as.integer(locFac(x))
+    zeroes  <- grepl("^0+?$", unlist(alleles(x), use.names = FALSE))
+    loci    <- locNames(x)
+  }
+  pops <- lapply(pops, as.integer)
+  res  <- .Call("locus_summary", tab(x), loc_fac, pops, zeroes, 
+                lev == "genotype", PA, as.integer(threads), PACKAGE = "poppr")
+  stats <- c(lev, "1-D", "H", "G", "Hexp", "Evenness")
+  res   <- lapply(res, "dimnames<-", list(loci, stats))
+  names(res) <- names(pops)
+  return(res)
+}
 
-  n    <- sum(unique_types)
-  Simp <- vegan::diversity(unique_types, "simp")
-  nei  <- (n/(n-1)) * Simp
-  
-  if (hexp_only){
-    return(nei)
-  }
-  
-  N <- length(unique_types) # Resetting N to be the number of unique types.
-  H <- vegan::diversity(unique_types)
-  G <- vegan::diversity(unique_types, "inv")
-  
-  if (index == "simpson"){
-    idx        <- Simp
-    names(idx) <- "1-D"
-  } else if (index == "shannon"){
-    idx        <- H
-    names(idx) <- "H"
+#==============================================================================#
+# Calculate Hexp, Ia, and rbarD for several populations of a genind object in
+# compiled code. The populations are defined by vectors of sample indices, so
+# no subsets of the data are created.
+#
+# Input:
+#  - gid a genind or genclone object
+#  - pops a named list of integer vectors of samples in each population
+#  - missing the (upper case) missing data treatment from poppr
+#  - threads the number of threads
+#
+# Output: a matrix with populations in rows and Hexp, Ia, and rbarD in columns
+# 
+# Public functions utilizing this function:
+# # poppr
+#
+# Internal functions utilizing this function:
+# # none
+#==============================================================================#
+poppr_summary_native <- function(gid, pops, missing = "IGNORE", threads = 1L){
+  PA <- gid@type == "PA"
+  if (PA){
+    loc_fac <- seq_len(ncol(tab(gid)))
+    zeroes  <- logical(ncol(tab(gid)))
   } else {
-    idx        <- G
-    names(idx) <- "G"
+    loc_fac <- as.integer(locFac(gid))
+    zeroes  <- grepl("^0+?$", unlist(alleles(gid), use.names = FALSE))
+  }
+  pops <- lapply(pops, as.integer)
+  res  <- .Call("population_summary", tab(gid), loc_fac, pops, zeroes, 
+                as.integer(ploidy(gid)), PA, missing == "MEAN", 
+                as.integer(threads), PACKAGE = "poppr")
+  dimnames(res) <- list(names(pops), c("Hexp", "Ia", "rbarD"))
+  return(res)
+}
+
+#==============================================================================#
+# Shuffle every locus of a codominant genind object independently in compiled
+# code (see src/shuffle.c). The methods are those of shufflepop().
+#
+# Input:
+#  - pop a genind or genclone object with codominant data
+#  - method an integer from 1 to 4
+#  - nrep the number of shuffled data sets
+#  - threads the number of threads
+#
+# Output: 
+#  - shuffle_tab_native: a list of nrep shuffled allele count matrices without
+#    dimnames
+#  - shuffle_ia_native: a matrix with nrep rows and the index of association
+#    and rbarD of each shuffled data set in columns
+# 
+# Public functions utilizing this function:
+# # shufflepop
+#
+# Internal functions utilizing this function:
+# # .sampling
+#==============================================================================#
+shuffle_tab_native <- function(pop, method = 1L, nrep = 1L, threads = 1L){
+  .Call("shuffle_tab", tab(pop), as.integer(locFac(pop)), 
+        as.integer(ploidy(pop)), as.integer(method), as.integer(nrep), 
+        as.integer(threads), PACKAGE = "poppr")
+}
+
+shuffle_ia_native <- function(pop, method = 1L, nrep = 1L, threads = 1L){
+  .Call("shuffle_ia", tab(pop), as.integer(locFac(pop)), 
+        as.integer(ploidy(pop)), as.integer(method), as.integer(nrep), 
+        as.integer(threads), PACKAGE = "poppr")
+}
+
+#==============================================================================#
+# Does a distance function take a threads argument that was not already given?
+#
+# Input:
+#  - DISTFUN a distance function
+#  - ... the other arguments that will be passed to DISTFUN
+#
+# Output: TRUE if threads should be passed to DISTFUN
+# 
+# Public functions utilizing this function:
+# # mlg.filter filter_stats
+#
+# Internal functions utilizing this function:
+# # mlg.filter.internal
+#==============================================================================#
+distance_takes_threads <- function(DISTFUN, ...){
+  "threads" %in% names(formals(DISTFUN)) && !"threads" %in% names(list(...))
+}
+
+#==============================================================================#
+# The options that change the distances calculated by poppr, such as
+# old.bruvo.model for bruvo.dist. They are part of the keys of cached
+# distances, so that changing an option does not give the distances that were
+# calculated with the old setting.
+#
+# Output: a named list of the values of the options
+# 
+# Public functions utilizing this function:
+# # imsn
+#
+# Internal functions utilizing this function:
+# # distance_key
+#==============================================================================#
+distance_options <- function(){
+  list(old.bruvo.model = getOption("old.bruvo.model"))
+}
+
+#==============================================================================#
+# The key of a distance matrix in the cache of poppr (see R/global_memory.r).
+# It is made of the content of the data, the text of the distance function,
+# the other arguments, and the options that change the distances (see
+# distance_options). The number of threads is not part of it, because it does
+# not change the distances. 
+#
+# The text of a function written by the user does not show the objects it
+# refers to, so by default only functions from packages are cached. Results
+# are not cached while options(poppr.profile) is set, so that the profiles
+# show the work that was done.
+#
+# Input:
+#  - x the data (or anything the distance is derived from)
+#  - DISTFUN a distance function
+#  - ... the other arguments that change the distance
+#  - memory TRUE to cache any function, NA to only cache functions from
+#    packages, or FALSE to cache nothing
+#
+# Output: a key or NULL if the distance should not be cached
+# 
+# Public functions utilizing this function:
+# # mlg.filter
+#
+# Internal functions utilizing this function:
+# # cached_distance mlg.filter.internal
+#==============================================================================#
+distance_key <- function(x, DISTFUN, ..., memory = NA){
+  if (isFALSE(memory) || isTRUE(getOption("poppr.profile"))){
+    return(NULL)
+  }
+  if (is.na(memory) && !isNamespace(environment(DISTFUN))){
+    return(NULL)
   }
-  E.5      <- (G - 1)/(exp(H) - 1)
-  names(N) <- lev
-  return(c(N, idx, Hexp = nei, Evenness = E.5)) 
+  cache_key("distance", x, paste(deparse(DISTFUN), collapse = "\n"), list(...),
+            distance_options())
+}
 
+#==============================================================================#
+# Calculate a distance matrix or get it from the cache of poppr.
+#
+# Input:
+#  - x the data
+#  - DISTFUN a distance function
+#  - ... the other arguments of DISTFUN
+#  - threads passed to DISTFUN if it takes them (NULL to never pass them)
+#  - memory see distance_key
+#  - what the label of the cache entry
+#
+# Output: the result of DISTFUN
+# 
+# Public functions utilizing this function:
+# # filter_stats poppr.amova aboot bruvo.msn
+#
+# Internal functions utilizing this function:
+# # none
+#==============================================================================#
+cached_distance <- function(x, DISTFUN, ..., threads = NULL, memory = NA, 
+                            what = "distance"){
+  compute <- function(){
+    if (!is.null(threads) && distance_takes_threads(DISTFUN, ...)){
+      DISTFUN(x, ..., threads = threads)
+    } else {
+      DISTFUN(x, ...)
+    }
+  }
+  key <- distance_key(x, DISTFUN, ..., memory = memory)
+  if (is.null(key)){
+    return(compute())
+  }
+  cache_value(key, compute(), what)
 }
+
 #==============================================================================#
-# This function takes a vector of allele counts and searches for the names
-# that appear to be zero-length alleles. These alleles are then removed from
-# analysis.
+# Create the progress callback of a compiled kernel. The kernel calls it from
+# the main thread with the proportion of its work done since the last call, at
+# most every tenth of a second. The proportions are counted in steps of a
+# progressr progressor, so progress is reported when the call is wrapped in
+# progressr::with_progress().
+#
+# Input:
+#  - steps the number of steps of the progressor
+#
+# Output: a function of one argument
 # 
 # Public functions utilizing this function:
+# # bitwise.dist bitwise.ia
+#
+# Internal functions utilizing this function:
 # # none
+#==============================================================================#
+native_progress <- function(steps = 50L){
+  p    <- progressr::progressor(steps)
+  done <- 0
+  function(fraction){
+    # a small tolerance keeps the last step from being lost to rounding
+    new  <- floor((done + fraction) * steps + 1e-8) - floor(done * steps + 1e-8)
+    done <<- done + fraction
+    if (new > 0) p(amount = new)
+    invisible(NULL)
+  }
+}
+
+#==============================================================================#
+# Carry the profiles of compiled kernels over to a result. With
+# options(poppr.profile = TRUE), kernels attach a "poppr_profile" attribute to
+# what they return (see src/poppr_profile.h), which is lost when the R code
+# converts it. The profiles are combined in order and attached to x, followed
+# by one record of the R code around the kernels if seconds are given.
+#
+# Input:
+#  - x the result to return
+#  - ... "poppr_profile" attributes or NULL
+#  - kernel the name of the R function
+#  - seconds a named vector of the seconds spent in each phase of the R code
+#
+# Output: x, with the "poppr_profile" attribute if there is a profile
+# 
+# Public functions utilizing this function:
+# # bitwise.dist diss.dist mlg.filter
 #
 # Internal functions utilizing this function:
-# # locus_table_pegas
-# # get_hexp_from_loci
+# # mlg.filter.internal
 #==============================================================================#
-remove_zeroes <- function(unique_types, type){
-  zero_names   <- grep("^0+?$", names(unique_types))
-  if (length(zero_names) > 0 & type == "codom"){
-    unique_types <- unique_types[-zero_names]
+with_profile <- function(x, ..., kernel = NULL, seconds = NULL){
+  profile <- unlist(list(...), recursive = FALSE)
+  if (length(profile) == 0L){
+    return(x)
   }
-  return(unique_types)
+  if (!is.null(seconds)){
+    profile[[length(profile) + 1L]] <- list(kernel = kernel, threads = 1L,
+                                            seconds = seconds,
+                                            counts = numeric(0),
+                                            thread_seconds = sum(seconds),
+                                            imbalance = 1)
+  }
+  attr(x, "poppr_profile") <- structure(profile, class = "poppr_profile")
+  x
 }
 
 #==============================================================================#
-# This function replaces the old definition of Hexp in poppr and will actually
-# return a measure of expected heterozygosity. The only catch is that if an 
-# incoming population has varying ploidy or ploidy greater than two, the
-# returned value is the same as the result of Hs (except missing values do not
-# corrupt the whole calculation). This is then treated in the poppr function by
-# multiplying by the sample size correction to give a corrected simpson's index.
+# Convert a memory size to bytes. Sizes are numbers of bytes or strings with a
+# unit in powers of 1024, such as "512M", "8G", or "1.5 GB".
+#
+# Input:
+#  - x a number or a string
+#
+# Output: the number of bytes
 # 
 # Public functions utilizing this function:
-# # poppr
+# # poppr_memory memory_plan
+#
+# Internal functions utilizing this function:
+# # memory_budget
+#==============================================================================#
+as_bytes <- function(x){
+  if (is.numeric(x)){
+    return(as.numeric(x))
+  }
+  size  <- toupper(gsub("[[:space:]]", "", as.character(x)))
+  size  <- sub("([KMGT])?I?B$", "\\1", size)
+  unit  <- sub("^[0-9.]+", "", size)
+  power <- match(unit, c("", "K", "M", "G", "T")) - 1
+  bytes <- suppressWarnings(as.numeric(sub("[KMGT]$", "", size)))
+  if (length(x) != 1 || is.na(power) || is.na(bytes)){
+    stop("memory sizes must be numbers of bytes or strings like \"8G\", not ", 
+         deparse(x), call. = FALSE)
+  }
+  bytes * 1024^power
+}
+
+#==============================================================================#
+# The memory a calculation may use in bytes. This is
+# options(poppr.memory_limit) if it is set, else the limit of the cgroup of the
+# process less its usage, else the memory available on the machine (see
+# src/poppr_memory.c).
+#
+# Input:
+#  - info the result of .Call("poppr_memory_info")
+#
+# Output: a list with the bytes (NA if unknown) and their source
+# 
+# Public functions utilizing this function:
+# # poppr_memory memory_plan
+#
+# Internal functions utilizing this function:
+# # plan_memory
+#==============================================================================#
+memory_budget <- function(info = .Call("poppr_memory_info", PACKAGE = "poppr")){
+  limit <- getOption("poppr.memory_limit")
+  if (!is.null(limit) && !is.na(limit)){
+    return(list(bytes = as_bytes(limit), source = "options(poppr.memory_limit)"))
+  }
+  if (!is.na(info[["cgroup"]])){
+    usage <- if (is.na(info[["cgroup_usage"]])) 0 else info[["cgroup_usage"]]
+    return(list(bytes = info[["cgroup"]] - usage, 
+                source = "the cgroup memory limit"))
+  }
+  list(bytes = info[["available"]], source = "the available memory")
+}
+
+#==============================================================================#
+# Estimate the peak memory of a calculation in bytes. The estimates count the
+# buffers of the compiled code and the copies the R code makes of its result,
+# but not the data, which are already in memory.
+#
+#  - memory: the calculation as it is done without a memory limit
+#  - blocked: the calculation in blocks (NA if it cannot be blocked). For
+#    bitwise.dist(), the kernel writes the lower triangle of the distance
+#    matrix straight into the dist object. For bruvo.dist(), the distances
+#    are averaged over blocks of loci, and this is the estimate for blocks of
+#    one locus.
+#  - per_locus: the memory of every further locus in a block
+#
+# Input:
+#  - fun the name of the function
+#  - n the number of samples
+#  - nloc the number of loci
+#  - alleles the number of alleles
+#  - mlgs the number of multilocus genotypes
+#  - mat, scale_missing, by_locus the arguments of the function
+#  - method the method of poppr.amova
+#
+# Output: a named vector of bytes
+# 
+# Public functions utilizing this function:
+# # memory_plan
+#
+# Internal functions utilizing this function:
+# # plan_memory
+#==============================================================================#
+memory_estimate <- function(fun, n, nloc = 1, alleles = 0, mlgs = n, 
+                            mat = FALSE, scale_missing = FALSE, 
+                            by_locus = FALSE, method = "poppr"){
+  n2 <- as.numeric(n)^2
+  m2 <- as.numeric(mlgs)^2
+  est <- switch(fun,
+    bitwise.dist = c(20 * n2 + 16 * n2 * scale_missing,
+                     if (mat) NA else 8 * n2 + 8 * n2 * scale_missing, 0),
+    diss.dist    = c(4 * n2 + 4 * as.numeric(n) * alleles + 24 * n2 * mat, NA, 0),
+    bruvo.dist   = c(12 * n2 * nloc + 16 * n2, if (by_locus) NA else 24 * n2, 
+                     12 * n2),
+    mlg.filter   = c(16 * n2 + 24 * m2 + 4 * as.numeric(mlgs) * n, NA, 0),
+    poppr.amova  = c(if (method == "poppr") 16 * m2 else 32 * m2, NA, 0),
+    stop("no memory estimate for ", fun, call. = FALSE)
+  )
+  stats::setNames(est, c("memory", "blocked", "per_locus"))
+}
+
+#==============================================================================#
+# Plan the memory of a calculation. The calculation is done as usual if its
+# estimate fits the budget (or the budget is unknown), in blocks if only the
+# blocked estimate fits, and not at all otherwise. With report = TRUE, a
+# blocked plan is reported with a message and a plan that does not fit is an
+# error, so the calculation stops before it allocates anything. Within
+# with_memory_plan(), the memory information is read once and a blocked plan
+# of each function is only reported once.
+#
+# Input:
+#  - fun the name of the function
+#  - ... the sizes passed to memory_estimate
+#  - report whether to report the plan
+#
+# Output: a list with
+#  - fun the name of the function
+#  - mode "memory", "blocked", or "none"
+#  - bytes the estimate of the mode
+#  - block the number of loci in a block (NA if there are no blocks of loci)
+#  - memory, blocked the estimates of memory_estimate
+#  - budget, source the result of memory_budget
+# 
+# Public functions utilizing this function:
+# # bitwise.dist diss.dist bruvo.dist mlg.filter poppr.amova memory_plan
+#
+# Internal functions utilizing this function:
+# # bruvos_distance mlg.filter.internal
+#==============================================================================#
+plan_memory <- function(fun, ..., report = TRUE){
+  est    <- memory_estimate(fun, ...)
+  info   <- .memory_plan$info
+  if (is.null(info)){
+    info <- .Call("poppr_memory_info", PACKAGE = "poppr")
+  }
+  budget <- memory_budget(info)
+  plan   <- list(fun = fun, mode = "memory", bytes = est[["memory"]], 
+                 block = NA_integer_, memory = est[["memory"]], 
+                 blocked = est[["blocked"]], budget = budget$bytes, 
+                 source = budget$source)
+  if (is.na(budget$bytes) || est[["memory"]] <= budget$bytes){
+    return(plan)
+  }
+  size <- function(x) format(structure(x, class = "object_size"), units = "auto")
+  need <- paste0(fun, "() needs about ", size(est[["memory"]]), 
+                 " of memory, more than the ", size(max(budget$bytes, 0)), 
+                 " of ", budget$source, ".")
+  if (!is.na(est[["blocked"]]) && est[["blocked"]] <= budget$bytes){
+    plan$mode  <- "blocked"
+    plan$bytes <- est[["blocked"]]
+    what       <- "the distances in blocks"
+    if (est[["per_locus"]] > 0){
+      fixed      <- est[["blocked"]] - est[["per_locus"]]
+      plan$block <- as.integer(min(list(...)$nloc, 
+                                   floor((budget$bytes - fixed) / est[["per_locus"]])))
+      plan$bytes <- fixed + est[["per_locus"]] * plan$block
+      what       <- paste("the distances in blocks of", plan$block, "loci")
+    }
+    if (report && !fun %in% .memory_plan$reported){
+      message(need, "\nIt will calculate ", what, " with about ", 
+              size(plan$bytes), ".")
+      if (!is.null(.memory_plan$info)){
+        .memory_plan$reported <- c(.memory_plan$reported, fun)
+      }
+    }
+    return(plan)
+  }
+  plan$mode <- "none"
+  if (report){
+    stop(need, "\nUse fewer samples or set options(poppr.memory_limit = Inf) ",
+         "to run it anyway.", call. = FALSE)
+  }
+  plan
+}
+
+#==============================================================================#
+# Plan the memory of a call that repeats a calculation, such as the replicates
+# of a bootstrap, only once. While expr is evaluated, plan_memory() uses the
+# memory information that was read when it started and reports a blocked plan
+# of each function only for the first replicate. Nested calls share the plan of
+# the outermost call.
+#
+# Input:
+#  - expr the expression to evaluate
+#
+# Output: the value of expr
+# 
+# Public functions utilizing this function:
+# # aboot bruvo.boot
+#
+# Internal functions utilizing this function:
+# # none
+#==============================================================================#
+.memory_plan <- new.env(parent = emptyenv())
+
+with_memory_plan <- function(expr){
+  if (!is.null(.memory_plan$info)){
+    return(expr)
+  }
+  .memory_plan$info     <- .Call("poppr_memory_info", PACKAGE = "poppr")
+  .memory_plan$reported <- character(0)
+  on.exit(rm(list = c("info", "reported"), envir = .memory_plan))
+  expr
+}
+
+#==============================================================================#
+# Calculate the index of association of a genlight object in compiled code.
+#
+# Input:
+#  - x a genlight object of haploids or diploids
+#  - missing_match, differences_only, threads see bitwise.ia
+#  - progress a function from native_progress() or NULL
+#
+# Output: the index of association
+# 
+# Public functions utilizing this function:
+# # bitwise.ia win.ia samp.ia
+#
+# Internal functions utilizing this function:
+# # none
+#==============================================================================#
+genlight_ia <- function(x, missing_match = TRUE, differences_only = FALSE, 
+                        threads = 0L, progress = NULL){
+  ploid <- min(ploidy(x))
+  # Ensure that every SNPbin object has data for all chromosomes
+  if (ploid == 2){
+    x  <- fix_uneven_diploid(x)
+    IA <- .Call("association_index_diploid", 
+                genlight = x, 
+                missing_match = missing_match, 
+                differences_only = differences_only, 
+                requested_threads = threads, 
+                progress = progress,
+                PACKAGE = "poppr")
+  }
+  else if(ploid == 1)
+  {
+    IA <- .Call("association_index_haploid", x, missing_match, threads, 
+                progress, PACKAGE = "poppr")
+  }
+  else
+  {
+    stop("bitwise.ia only supports haploids and diploids")
+  }
+  return(IA)
+}
+
+#==============================================================================#
+# Simulate a population in compiled code for benchmarks and tests. Sexual
+# samples draw their alleles from random allele frequencies of each locus.
+# Clonal samples copy one of a number of founders with stepwise mutations of
+# their alleles. The alleles of a genind object are named after their size in
+# base pairs (repeat length times the number of repeats), so they can be used
+# with bruvo.dist.
+#
+# Input:
+#  - n the number of samples
+#  - nloc the number of loci
+#  - ploidy the ploidy of the samples
+#  - alleles the number of alleles of each locus (recycled to nloc). This is
+#    always 2 for genlight objects.
+#  - clones the number of clonal founders. 0 (default) simulates a sexual
+#    population.
+#  - missing the probability that the genotype of a sample at a locus is
+#    missing
+#  - mutation the probability that an allele of a clone mutates by one repeat
+#  - replen the repeat length of the loci (recycled to nloc)
+#  - npop the number of populations (the "Pop" stratum)
+#  - type "genind" for a genclone object or "genlight" for a snpclone object
+#  - threads the number of threads
+#
+# Output: a genclone or snpclone object
+# 
+# Public functions utilizing this function:
+# # none
+#
+# Internal functions utilizing this function:
+# # none (see inst/benchmarks)
+#==============================================================================#
+simulate_poppr <- function(n = 100L, nloc = 10L, ploidy = 2L, alleles = 5L, 
+                           clones = 0L, missing = 0, mutation = 0.01, 
+                           replen = 2L, npop = 1L, 
+                           type = c("genind", "genlight"), threads = 1L){
+  type    <- match.arg(type)
+  n       <- as.integer(n)
+  nloc    <- as.integer(nloc)
+  ploidy  <- as.integer(ploidy)
+  alleles <- if (type == "genlight") rep(2L, nloc) else rep_len(as.integer(alleles), nloc)
+  replen  <- rep_len(as.integer(replen), nloc)
+  geno    <- .Call("simulate_genotypes", n, nloc, ploidy, alleles, 
+                   as.integer(clones), as.numeric(missing), 
+                   as.numeric(mutation), as.integer(threads), PACKAGE = "poppr")
+  samples <- sprintf(paste0("sample_%0", nchar(n), "d"), seq_len(n))
+  loci    <- sprintf(paste0("locus_%0", nchar(nloc), "d"), seq_len(nloc))
+  strata  <- data.frame(Pop = factor(rep_len(seq_len(npop), n)))
+  if (type == "genlight"){
+    dosage <- matrix(0L, nrow = n, ncol = nloc)
+    for (i in seq_len(ploidy)){
+      dosage <- dosage + geno[, (seq_len(nloc) - 1L) * ploidy + i, drop = FALSE]
+    }
+    dimnames(dosage) <- list(samples, loci)
+    res <- new("genlight", dosage, ploidy = ploidy, parallel = FALSE)
+    strata(res) <- strata
+    setPop(res) <- ~Pop
+    return(as.snpclone(res, parallel = FALSE))
+  }
+  tab <- lapply(seq_len(nloc), function(l){
+    cols   <- (l - 1L) * ploidy + seq_len(ploidy)
+    counts <- vapply(seq_len(alleles[l]) - 1L, function(a){
+      rowSums(geno[, cols, drop = FALSE] == a)
+    }, integer(n))
+    counts <- matrix(counts, nrow = n)
+    colnames(counts) <- paste(loci[l], replen[l] * (seq_len(alleles[l]) + 9L), 
+                              sep = ".")
+    counts
+  })
+  tab <- do.call("cbind", tab)
+  rownames(tab) <- samples
+  res <- genind(tab, pop = strata$Pop, ploidy = ploidy, type = "codom", 
+                strata = strata)
+  as.genclone(res)
+}
+
+#==============================================================================#
+# Read the table of a GenAlEx file (everything after the two information
+# lines) in compiled code. Every column becomes a factor of its trimmed values
+# with levels in order of appearance. Empty cells and "NA" are missing.
+#
+# Input:
+#  - source a file name or a single string with the text of the table
+#  - is_file TRUE if source is a file name
+#  - sep the column separator
+#  - skip the number of lines to skip before the header
+#
+# Output: a data frame of factors with the header as column names
+# 
+# Public functions utilizing this function:
+# # read.genalex
 #
 # Internal functions utilizing this function:
 # # none
 #==============================================================================#
-get_hexp_from_loci <- function(loci, type = "codom", ploidy = NULL){
-  loci <- vapply(summary(loci), FUN = locus_table_pegas, FUN.VALUE = numeric(1),
-                 ploidy = ploidy, type = type, hexp_only = TRUE)    
-  return(mean(loci, na.rm = TRUE))
+read_genalex_table <- function(source, is_file = TRUE, sep = ",", skip = 0L){
+  if (nchar(sep) != 1){
+    stop("sep must be one byte/character (eg. \",\")")
+  }
+  res  <- .Call("genalex_tokenize", source, is_file, sep, as.integer(skip), 
+                PACKAGE = "poppr")
+  gena <- res$columns
+  nrow <- if (length(gena) > 0) length(gena[[1]]) else 0L
+  names(gena) <- res$names
+  structure(gena, class = "data.frame", row.names = .set_row_names(nrow))
+}
+
+#==============================================================================#
+# Test if the genotype columns of a GenAlEx table are presence/absence data,
+# i.e. all values are 1, 0, or -1 and none are missing.
+#
+# Public functions utilizing this function:
+# # read.genalex
+#
+# Internal functions utilizing this function:
+# # none
+#==============================================================================#
+is_genalex_pa <- function(gena){
+  all(vapply(gena, function(i){
+    observed <- levels(i)[tabulate(i, nlevels(i)) > 0]
+    !anyNA(i) && all(observed %in% c("-1", "0", "1"))
+  }, logical(1)))
+}
+
+#==============================================================================#
+# Create a genind object from the genotype columns of a GenAlEx table. The
+# allele counts are tabulated from the factor codes in compiled code, so the
+# genotypes are never pasted into strings.
+#
+# Like df2genind, samples with duplicated names are renamed with their row
+# numbers and samples without any genotypes are removed.
+#
+# Input:
+#  - gena a data frame of factors with the genotype columns
+#  - loci the names of the loci
+#  - ind.vec the sample names
+#  - pop.vec the population of each sample
+#  - ploidy the ploidy of the samples
+#  - gploidy the number of columns per locus
+#  - type "codom" or "PA"
+#
+# Output: a genind object
+# 
+# Public functions utilizing this function:
+# # read.genalex
+#
+# Internal functions utilizing this function:
+# # none
+#==============================================================================#
+genalex_genind <- function(gena, loci, ind.vec, pop.vec, ploidy, gploidy, type){
+  res <- .Call("genalex_tab", gena, as.integer(gploidy), type == "PA", 
+               PACKAGE = "poppr")
+  tab <- res$tab
+  if (type == "PA"){
+    colnames(tab) <- loci
+  } else {
+    colnames(tab) <- paste(loci[res$locus], res$allele, sep = ".")
+  }
+  if (anyDuplicated(ind.vec)){
+    warning("duplicate labels detected for some individuals; using generic labels")
+    ind.vec <- as.character(seq_along(ind.vec))
+  }
+  rownames(tab) <- ind.vec
+  if (!all(res$scored)){
+    warning("Individuals with no scored loci have been removed: ", 
+            paste(ind.vec[!res$scored], collapse = ", "))
+    tab     <- tab[res$scored, , drop = FALSE]
+    pop.vec <- pop.vec[res$scored]
+  }
+  genind(tab, pop = pop.vec, ploidy = ploidy, type = type)
+}
+
+#==============================================================================#
+# Read a section of an open poppr file. Only the requested rows and columns
+# are copied out of the file.
+#
+# Input:
+#  - x a poppr_file object
+#  - name the name of the section
+#  - rows NULL or the elements, rows, or samples to read
+#  - cols NULL or the columns of a matrix to read
+#
+# Output: a vector or matrix
+# 
+# Public functions utilizing this function:
+# # open_poppr, read_poppr
+#
+# Internal functions utilizing this function:
+# # poppr_file_object, poppr_file_dist, poppr_file_mlg
+#==============================================================================#
+poppr_file_get <- function(x, name, rows = NULL, cols = NULL){
+  .Call("poppr_file_section", x$ptr, name, rows, cols, PACKAGE = "poppr")
+}
+
+#==============================================================================#
+# Create the sections of a poppr file from a genind or genlight object.
+#
+# The large parts of the object are stored in their own sections:
+#
+#  - tab: the allele table of a genind object
+#  - snp: the raw SNP planes of a genlight object with one column per sample.
+#         Samples with fewer chromosomes than the maximum are padded with
+#         zeroes.
+#  - snp_na: the missing data of a genlight object as bits in the same layout
+#            as a single plane
+#  - snp_planes, snp_ploidy: the number of planes and the ploidy of each
+#                            sample of a genlight object.
+#  - strata, mlg: the serialized strata and multilocus genotypes
+#  - dist: the distance matrix
+#
+# The rest of the object, without its samples, is serialized in "object" and
+# the summary read by open_poppr is serialized in "info".
+#
+# Public functions utilizing this function:
+# # save_poppr
+#
+# Internal functions utilizing this function:
+# # none
+#==============================================================================#
+poppr_file_sections <- function(x, distance = NULL){
+  n        <- nInd(x)
+  skeleton <- x
+  mlgs     <- if (is.clone(x)) x@mlg else NULL
+  info <- list(class     = class(x)[1],
+               nInd      = n, 
+               nLoc      = nLoc(x), 
+               ind.names = indNames(x), 
+               pop       = pop(x),
+               dist      = if (is.null(distance)) NULL else attr(distance, "method"))
+  skeleton@strata <- NULL
+  if (is.clone(x)){
+    skeleton@mlg <- integer(0)
+  }
+  if (inherits(x, "genlight")){
+    if (n == 0){
+      stop("a genlight object without samples cannot be saved.")
+    }
+    nbytes     <- ceiling(nLoc(x) / 8)
+    snp_planes <- vapply(x@gen, function(i) length(i@snp), integer(1))
+    snp_ploidy <- vapply(x@gen, function(i) as.integer(i@ploidy), integer(1))
+    maxplanes  <- max(snp_planes)
+    snp <- vapply(x@gen, function(i){
+      unlist(c(i@snp, rep(list(raw(nbytes)), maxplanes - length(i@snp))))
+    }, raw(nbytes * maxplanes))
+    snp_na <- vapply(x@gen, function(i){
+      bits <- logical(nbytes * 8)
+      bits[i@NA.posi] <- TRUE
+      packBits(bits)
+    }, raw(nbytes))
+    skeleton@gen <- x@gen[1]
+    res <- list(snp        = matrix(snp, ncol = n),
+                snp_na     = matrix(snp_na, ncol = n),
+                snp_planes = snp_planes,
+                snp_ploidy = snp_ploidy)
+  } else {
+    skeleton@tab <- x@tab[0, , drop = FALSE]
+    res <- list(tab = unname(x@tab))
+  }
+  res <- c(list(info   = serialize(info, NULL),
+                object = serialize(skeleton, NULL),
+                strata = serialize(x@strata, NULL),
+                mlg    = serialize(mlgs, NULL)),
+           res)
+  if (!is.null(distance)){
+    res$dist <- structure(as.vector(distance), Size = attr(distance, "Size"))
+  }
+  res
+}
+
+#==============================================================================#
+# Find the samples of the selected populations of a poppr file.
+#
+# Input:
+#  - x a poppr_file object
+#  - population NULL or a vector of population names or indices
+#
+# Output: NULL for all samples or the indices of the samples
+#
+# Public functions utilizing this function:
+# # read_poppr
+#
+# Internal functions utilizing this function:
+# # none
+#==============================================================================#
+poppr_file_rows <- function(x, population = NULL){
+  if (is.null(population)){
+    return(NULL)
+  }
+  if (is.null(x$pop)){
+    stop("The file ", x$file, " has no population factor.")
+  }
+  pops <- levels(x$pop)
+  if (is.numeric(population)){
+    if (any(population < 1 | population > length(pops))){
+      stop("population indices must be between 1 and ", length(pops))
+    }
+    population <- pops[population]
+  }
+  if (!all(population %in% pops)){
+    unknown <- population[!population %in% pops]
+    stop("The populations ", paste(unknown, collapse = ", "), 
+         " are not in ", x$file)
+  }
+  which(x$pop %in% population)
+}
+
+#==============================================================================#
+# Subset the elements of the other slot that have one entry per sample, the
+# same way adegenet does when subsetting a genind or genlight object.
+#
+# Public functions utilizing this function:
+# # read_poppr
+#
+# Internal functions utilizing this function:
+# # poppr_file_object
+#==============================================================================#
+subset_other <- function(other, keep, n){
+  lapply(other, function(i){
+    if (is.character(i)){
+      i
+    } else if (!is.null(nrow(i))){
+      if (nrow(i) == n) i[keep, , drop = FALSE] else i
+    } else if (length(i) == n){
+      i[keep]
+    } else {
+      i
+    }
+  })
+}
+
+#==============================================================================#
+# Create the genind, genclone, genlight, or snpclone object of the selected
+# samples of a poppr file.
+#
+# Input:
+#  - x a poppr_file object
+#  - rows NULL for all samples or the indices of the samples
+#
+# Output: an object of the class that was saved.
+#
+# Public functions utilizing this function:
+# # read_poppr
+#
+# Internal functions utilizing this function:
+# # none
+#==============================================================================#
+poppr_file_object <- function(x, rows = NULL){
+  keep   <- if (is.null(rows)) seq_len(x$nInd) else rows
+  obj    <- unserialize(poppr_file_get(x, "object"))
+  strata <- unserialize(poppr_file_get(x, "strata"))
+  mlgs   <- unserialize(poppr_file_get(x, "mlg"))
+  inds   <- x$ind.names[keep]
+  if (inherits(obj, "genlight")){
+    snp        <- poppr_file_get(x, "snp", cols = rows)
+    snp_na     <- poppr_file_get(x, "snp_na", cols = rows)
+    snp_planes <- poppr_file_get(x, "snp_planes", rows)
+    snp_ploidy <- poppr_file_get(x, "snp_ploidy", rows)
+    template   <- obj@gen[[1]]
+    nbytes     <- nrow(snp_na)
+    obj@gen    <- lapply(seq_along(keep), function(i){
+      res         <- template
+      planes      <- matrix(snp[, i], nrow = nbytes)
+      res@snp     <- lapply(seq_len(snp_planes[i]), function(j) planes[, j])
+      res@NA.posi <- which(as.logical(rawToBits(snp_na[, i])[seq_len(res@n.loc)]))
+      res@ploidy  <- snp_ploidy[i]
+      if (!is.null(template@label)) res@label <- inds[i]
+      res
+    })
+    obj@ind.names <- inds
+    if (!is.null(obj@ploidy)) obj@ploidy <- obj@ploidy[keep]
+  } else {
+    tab <- poppr_file_get(x, "tab", rows)
+    dimnames(tab) <- list(inds, colnames(obj@tab))
+    obj@tab    <- tab
+    obj@ploidy <- obj@ploidy[keep]
+  }
+  obj@pop    <- x$pop
+  obj@strata <- strata
+  if (is.clone(obj)){
+    obj@mlg <- mlgs
+  }
+  if (is.null(rows)){
+    return(obj)
+  }
+  if (!is.null(x$pop)){
+    obj@pop <- droplevels(x$pop[keep])
+  }
+  if (!is.null(strata)){
+    obj@strata <- droplevels(strata[keep, , drop = FALSE])
+  }
+  obj@other <- subset_other(obj@other, keep, x$nInd)
+  if (is.clone(obj)){
+    obj@mlg <- if (is(mlgs, "MLG")) mlgs[keep, all = TRUE] else mlgs[keep]
+  }
+  obj
+}
+
+#==============================================================================#
+# Read the distances between the selected samples of a poppr file.
+#
+# Public functions utilizing this function:
+# # read_poppr
+#
+# Internal functions utilizing this function:
+# # none
+#==============================================================================#
+poppr_file_dist <- function(x, rows = NULL){
+  if (!"dist" %in% x$index$name){
+    stop("No distance matrix was saved in ", x$file)
+  }
+  keep <- if (is.null(rows)) seq_len(x$nInd) else rows
+  res  <- poppr_file_get(x, "dist", rows)
+  structure(res, Size = length(keep), Labels = x$ind.names[keep], 
+            Diag = FALSE, Upper = FALSE, method = x$dist, class = "dist")
+}
+
+#==============================================================================#
+# The multilocus genotypes of the samples of a poppr file. For objects that
+# were not saved as genclone or snpclone objects, the genotypes are found from
+# the allele table or from the SNP planes, missing data, and ploidy of each
+# sample of a genlight object.
+#
+# Public functions utilizing this function:
+# # mlg
+#
+# Internal functions utilizing this function:
+# # none
+#==============================================================================#
+poppr_file_mlg <- function(x){
+  mlgs <- unserialize(poppr_file_get(x, "mlg"))
+  if (length(mlgs) == x$nInd){
+    return(mlgs[])
+  }
+  if ("tab" %in% x$index$name){
+    geno <- do.call("paste", as.data.frame(poppr_file_get(x, "tab")))
+  } else {
+    snp  <- rbind(poppr_file_get(x, "snp"), poppr_file_get(x, "snp_na"))
+    geno <- paste(apply(snp, 2, paste, collapse = ""), 
+                  poppr_file_get(x, "snp_ploidy"))
+  }
+  match(geno, unique(geno))
+}
+
+#==============================================================================#
+# Quality control statistics of the loci and samples of a genind object in a
+# single pass over the allele table in compiled code. These give the filters
+# of missingno and informloci without converting or copying the data.
+#
+# Input:
+#  - gid a genind or genclone object
+#  - MAF the minimum allele frequency for a locus to be polymorphic (this is
+#    the thresh argument of adegenet::isPoly)
+#  - threads the number of threads
+#
+# Output: a list with
+#  - locus_missing the number of samples missing at each locus
+#  - sample_missing the number of loci missing in each sample
+#  - genotypes the number of genotypes observed at each locus
+#  - genotype_max the number of samples with the most common genotype
+#  - maf the frequency of the second most common allele at each locus
+#  - polymorphic TRUE for loci with at least two alleles of frequency >= MAF
+#  - loc_fac the locus of each column of the allele table
+#  - nmissing the number of missing cells of the allele table
+#
+# Presence/absence data are treated as one locus per column.
+# 
+# Public functions utilizing this function:
+# # missingno, informloci
+#
+# Internal functions utilizing this function:
+# # percent_missing
+#==============================================================================#
+locus_qc_native <- function(gid, MAF = 0.01, threads = 1L){
+  if (gid@type == "PA"){
+    loc_fac <- seq_len(ncol(tab(gid)))
+  } else {
+    loc_fac <- as.integer(locFac(gid))
+  }
+  res <- .Call("locus_qc", tab(gid), loc_fac, as.numeric(MAF), 
+               as.integer(threads), PACKAGE = "poppr")
+  res$loc_fac  <- loc_fac
+  res$nmissing <- sum(res$locus_missing * tabulate(loc_fac))
+  return(res)
+}
+
+#==============================================================================#
+# Find the private alleles of a genind or genpop object in compiled code. The
+# population counts are tallied from the allele table, so no genpop object is
+# created, and only the non-zero counts of the private alleles are returned.
+#
+# Input:
+#  - gid a genind or genpop object with populations
+#  - individual if TRUE, report samples instead of populations (genind only)
+#  - count.alleles if FALSE, report presence of alleles in populations
+#  - by_locus if TRUE, sum the private alleles of each locus
+#  - threads the number of threads
+#
+# Output: a list with
+#  - private a logical vector marking the private alleles
+#  - rows the names of the samples or populations
+#  - cols the names of the alleles or loci with private alleles
+#  - triples a data frame with the row, col, and count of each non-zero count
+#    (indices into rows and cols) in column-major order
+# 
+# Public functions utilizing this function:
+# # private_alleles
+#
+# Internal functions utilizing this function:
+# # none
+#==============================================================================#
+private_alleles_native <- function(gid, individual = FALSE, 
+                                   count.alleles = TRUE, by_locus = FALSE,
+                                   threads = 1L){
+  x <- tab(gid)
+  if (is.genpop(gid)){
+    individual <- FALSE
+    pop        <- seq_len(nrow(x))
+    npop       <- nrow(x)
+    rows       <- rownames(x)
+  } else {
+    pop  <- as.integer(pop(gid))
+    npop <- nlevels(pop(gid))
+    rows <- if (individual) rownames(x) else levels(pop(gid))
+  }
+  if (gid@type == "PA"){
+    loc_fac <- seq_len(ncol(x))
+    loci    <- colnames(x)
+  } else {
+    loc_fac <- as.integer(locFac(gid))
+    loci    <- locNames(gid)
+  }
+  res <- .Call("private_allele_table", x, pop, npop, loc_fac, individual, 
+               count.alleles, by_locus, as.integer(threads), PACKAGE = "poppr")
+  if (by_locus){
+    private_loci <- unique(loc_fac[res$private])
+    cols    <- loci[private_loci]
+    res$col <- match(res$col, private_loci)
+  } else {
+    cols    <- colnames(x)[res$private]
+    res$col <- match(res$col, which(res$private))
+  }
+  triples <- data.frame(row = res$row, col = res$col, count = res$count)
+  list(private = res$private, rows = rows, cols = cols, triples = triples)
 }
 
 #==============================================================================#
@@ -1172,28 +2182,6 @@ poppr.plot.phylo <- function(tree, type = "nj", root = FALSE){
 }
 
 
-#==============================================================================#
-# Function to do something with Rodger's distance
-#
-# Public functions utilizing this function:
-# rodger.dist
-#
-# Private functions utilizing this function:
-# # none
-#==============================================================================#
-# From adegenet dist.genpop
-dcano <- function(mat) {
-  daux       <- mat%*%t(mat)
-  vec        <- diag(daux)
-  daux       <- -2*daux + vec[col(daux)] + vec[row(daux)]
-  diag(daux) <- 0
-  # if (any(daux == Inf)){
-  #   daux <- infinite_vals_replacement(daux, warning)
-  # }
-  daux       <- sqrt(daux*0.5)
-  return(daux)
-}
-
 #==============================================================================#
 # tabulate the amount of missing data per locus. 
 #
@@ -1231,7 +2219,8 @@ infinite_vals_replacement <- function(D, warning){
 #==============================================================================#
 # Given a tree function and a distance function, this will generate an
 # automatic tree generating function. This is useful for functions such as
-# boot.phylo.
+# boot.phylo. With memory = TRUE, the function caches the distance matrix (see
+# cached_distance).
 #
 # Public functions utilizing this function:
 # anyboot
@@ -1247,7 +2236,15 @@ tree_generator <- function(tree, distance, quiet = TRUE, ...){
   matchargs <- names(distargs)[names(distargs) %in% names(otherargs)]
   distargs[matchargs] <- otherargs[matchargs]
   if (!quiet) cat("\nTREE....... ", tree,"\nDISTANCE... ", distance)
-  treedist <- function(x){
+  label    <- if (is.character(distance)) distance else "distance"
+  treedist <- function(x, memory = FALSE){
+    if (memory){
+      # Only the distance of the data is cached, not those of the replicates.
+      # The defaults of the distance are part of the text of the function.
+      dis <- do.call(cached_distance, c(list(x, DISTFUNK), otherargs[matchargs],
+                                        list(what = label)))
+      return(TREEFUNK(dis))
+    }
     distargs[[1]] <- x
     TREEFUNK(do.call(DISTFUNK, distargs))
   }
@@ -1272,6 +2269,59 @@ get_gen_mat <- function(x){
   return(MAT)
 }
 
+#==============================================================================#
+# Calculate one or more of the allele frequency based genetic distances in a
+# single pass over the data in compiled code (see src/pop_distance.c).
+#
+# Input:
+#  - x a genind, genpop, bootgen, or matrix object
+#  - methods a character vector of "Nei", "Edwards", "Rogers", "Reynolds",
+#    and/or "Provesti"
+#  - threads the number of threads to use (0 = all available)
+#
+# Output: a named list of condensed distance vectors without attributes.
+#
+# Public functions utilizing this function:
+# *.dist
+#
+# Private functions utilizing this function:
+# # none
+#==============================================================================#
+pop_dist_engine <- function(x, methods, threads = 1L){
+  DISTS <- c("Nei", "Edwards", "Rogers", "Reynolds", "Provesti")
+  which <- match(methods, DISTS)
+  if (anyNA(which)) {
+    stop(paste("Unknown distance:", paste(methods[is.na(which)], collapse = ", ")))
+  }
+  loci <- integer(0)
+  if (is(x, "bootgen")){
+    # The loci of the view are read directly from the shared table.
+    MAT     <- x@tab
+    loci    <- x@loci
+    nloc    <- length(loci)
+    loc.fac <- if (x@type == "PA") seq_len(ncol(MAT)) else as.integer(x@loc.fac)
+    codom   <- x@type == "codom"
+  } else if (is(x, "gen")){
+    MAT     <- get_gen_mat(x)
+    nloc    <- nLoc(x)
+    # Presence/absence data have one column per locus.
+    loc.fac <- if (x@type == "PA") seq_len(ncol(MAT)) else as.integer(x@loc.fac)
+    codom   <- x@type == "codom"
+  } else if (length(dim(x)) == 2){
+    MAT     <- x
+    nloc    <- ncol(x)
+    loc.fac <- seq_len(ncol(x))
+    codom   <- FALSE
+  } else {
+    stop("Object must be a matrix or genind object")
+  }
+  storage.mode(MAT) <- "double"
+  res <- .Call("pop_distance", MAT, as.integer(loc.fac), as.integer(nloc),
+               codom, as.integer(which), as.integer(threads), loci, 
+               PACKAGE = "poppr")
+  stats::setNames(res, methods)
+}
+
 #==============================================================================#
 # This will retrieve the labels for the distance matrix from "gen" objects
 #
@@ -1843,6 +2893,51 @@ boot_per_pop <- function(x, rg = multinom_boot, n, mle = NULL, H = TRUE,
   return(res)
 }
 
+#==============================================================================#
+# Bootstrap H, G, lambda, and E.5 for all populations of an mlg.table in
+# compiled code. The results are returned as a list of "boot" objects so that
+# they are identical in form to those from boot_per_pop.
+#
+# Input:
+#  - tab an mlg.table
+#  - n the number of replicates
+#  - mle the number of samples to draw (see multinom_boot and rare_sim_boot)
+#  - rarefy if TRUE, samples are drawn without replacement
+#  - stats a logical vector of length 4 indicating which of H, G, lambda, and
+#    E.5 should be returned
+#  - threads the number of threads
+#
+# Public functions utilizing this function:
+# ## diversity_boot
+# 
+# Internal functions utilizing this function:
+# ## none
+#==============================================================================#
+native_diversity_boot <- function(tab, n, mle = NULL, rarefy = FALSE, 
+                                  stats = rep(TRUE, 4), threads = 1L){
+  statnames <- c("H", "G", "lambda", "E.5")[stats]
+  size <- if (is.null(mle)) 1L else as.integer(mle)
+  # The seed is recorded before the replicates draw from it, as in boot::boot
+  if (!exists(".Random.seed", envir = .GlobalEnv, inherits = FALSE)){
+    stats::runif(1)
+  }
+  seed  <- get(".Random.seed", envir = .GlobalEnv, inherits = FALSE)
+  boots <- .Call("diversity_bootstrap", tab, as.integer(n), size, rarefy, 
+                 as.integer(threads), PACKAGE = "poppr")
+  rg  <- if (rarefy) rare_sim_boot else multinom_boot
+  res <- lapply(seq_len(nrow(tab)), function(i){
+    t0 <- boots[[1]][i, stats]
+    names(t0) <- statnames
+    out <- list(t0 = t0, t = boots[[2]][[i]][, stats, drop = FALSE], R = n, 
+                data = extract_samples(tab[i, ]), seed = seed, 
+                statistic = boot_stats, sim = "parametric", call = match.call(),
+                ran.gen = rg, mle = mle)
+    structure(out, class = "boot", boot_type = "boot")
+  })
+  names(res) <- rownames(tab)
+  return(res)
+}
+
 #==============================================================================#
 # multinomial sampler for bootstrapping
 # 
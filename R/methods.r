@@ -63,33 +63,17 @@ setMethod(
   f = "[",
   signature(x = "bootgen"),
   definition = function(x, i, j, ..., drop = FALSE){
-    if (missing(i)) i <- TRUE
     if (missing(j)) j <- TRUE
     loc <- dim(x)[2]
     if (length(j) > loc | any(j > loc)){
       stop('subscript out of bounds')
     }
-    
-    # Taking Names
-    locnall         <- x@loc.n.all[j]
-    allnames        <- x@all.names[j]
-    names(allnames) <- names(x@all.names)[seq_along(allnames)]
-    names(locnall)  <- names(allnames)
-    alllist         <- slot(x, "alllist")[j]
-    indices         <- unlist(alllist)
-    locnames        <- rep(names(allnames), locnall)
-    tabnames        <- paste(locnames, unlist(allnames), sep = ".")
-    res             <- slot(x, "tab")[i, indices, drop = drop]
-    colnames(res)   <- tabnames
-    
-    ## Resetting all factors that need to be set. 
-    slot(x, "tab")       <- res
-    slot(x, "loc.fac")   <- factor(locnames, names(allnames))
-    slot(x, "loc.n.all") <- locnall
-    slot(x, "all.names") <- allnames
-    slot(x, "alllist")   <- .Call("expand_indices", cumsum(locnall), 
-                                  length(alllist), PACKAGE = "poppr")
-    slot(x, "names")     <- slot(x, "names")[i]
+    # Only the loci of the view change; the allele table is shared.
+    slot(x, "loci") <- slot(x, "loci")[j]
+    if (!missing(i)){
+      slot(x, "tab")   <- slot(x, "tab")[i, , drop = FALSE]
+      slot(x, "names") <- slot(x, "names")[i]
+    }
     return(x)
   }
 )
@@ -101,7 +85,18 @@ setMethod(
   f = "dim",
   signature(x = "bootgen"),
   definition = function(x){
-    return(c(length(slot(x, "names")), nlevels(slot(x, "loc.fac"))))
+    return(c(length(slot(x, "names")), length(slot(x, "loci"))))
+  }
+)
+
+#==============================================================================#
+# @rdname bootgen-methods
+#==============================================================================#
+setMethod(
+  f = "nLoc",
+  signature(x = "bootgen"),
+  definition = function(x, ...){
+    return(length(slot(x, "loci")))
   }
 )
 setGeneric("dist")
@@ -157,8 +152,15 @@ setMethod(
     slot(.Object, "loc.fac")   <- slot(gen, "loc.fac")
     slot(.Object, "loc.n.all") <- num_alleles  
     slot(.Object, "all.names") <- slot(gen, "all.names") 
-    slot(.Object, "alllist")   <- .Call("expand_indices", cumsum(num_alleles), 
-                                        num_loci, PACKAGE = "poppr")
+    if (slot(gen, "type") == "PA"){
+      # Presence/absence data have one column per locus.
+      num_loci                 <- ncol(slot(.Object, "tab"))
+      slot(.Object, "alllist") <- as.list(seq_len(num_loci))
+    } else {
+      slot(.Object, "alllist") <- .Call("expand_indices", cumsum(num_alleles), 
+                                          num_loci, PACKAGE = "poppr")
+    }
+    slot(.Object, "loci")      <- seq_len(num_loci)
     slot(.Object, "names")     <- objnames
     slot(.Object, "type")      <- slot(gen, "type")
     slot(.Object, "ploidy")    <- as.integer(slot(gen, "ploidy"))
@@ -169,7 +171,18 @@ setMethod(
   f = "tab",
   signature = "bootgen",
   definition = function(x, freq = TRUE){ # freq is a dummy argument
-    return(x@tab)
+    loci <- x@loci
+    if (identical(loci, seq_along(x@alllist))){
+      return(x@tab)
+    }
+    res <- x@tab[, unlist(x@alllist[loci]), drop = FALSE]
+    if (x@type != "PA"){
+      # The loci are renamed in order so that repeated loci have unique names.
+      locnames      <- names(x@all.names)[seq_along(loci)]
+      locnames      <- rep(locnames, x@loc.n.all[loci])
+      colnames(res) <- paste(locnames, unlist(x@all.names[loci]), sep = ".")
+    }
+    return(res)
   })
 
 #==============================================================================#
@@ -1371,9 +1384,10 @@ setMethod(
 #'   the original (naive) MLG definition.
 #' @param missing any method to be used by \code{\link{missingno}}: "mean", 
 #'   "zero", "loci", "genotype", or "asis" (default).
-#' @param memory whether this function should remember the last distance matrix 
-#'   it generated. TRUE will attempt to reuse the last distance matrix if the 
-#'   other parameters are the same. (default) FALSE will ignore any stored 
+#' @param memory whether this function should remember the distance matrices
+#'   it generates. TRUE will reuse a distance matrix calculated before from the
+#'   same data, missing data treatment, distance, and arguments (see
+#'   \code{\link{poppr_cache}}). (default) FALSE will ignore any stored 
 #'   matrices and not store any it generates.
 #' @param algorithm determines the type of clustering to be done. 
 #' \describe{
@@ -1390,9 +1404,12 @@ setMethod(
 #'   \code{\link{bitwise.dist}} for snpclone objects. A matrix or table
 #'   containing distances between individuals (such as the output of 
 #'   \code{\link{rogers.dist}}) is also accepted for this parameter.
-#' @param threads (unused) Previously, this was the maximum number of parallel 
-#'  threads to be used within this function. Default is 1 indicating that this
-#'  function will run serially. Any other number will result in a warning.
+#' @param threads the number of threads used to calculate the distance matrix
+#'  if \code{distance} is a function with a \code{threads} argument, such as
+#'  \code{\link{bitwise.dist}} (0 = all available, see
+#'  \code{\link{poppr_threads}}). The filtering itself runs serially, so any
+#'  other number than 1 results in a warning when the distance is not
+#'  calculated here.
 #' @param stats a character vector specifying which statistics should be
 #'   returned (details below). Choices are "MLG", "THRESHOLDS", "DISTANCES",
 #'   "SIZES", or "ALL". If choosing "ALL" or more than one, a named list will be
@@ -1905,3 +1922,32 @@ old2new_genclone <- function(object, donor = new(class(object))){
   }
   return(n)
 }
+
+# poppr_file methods ------------------------------------------------------
+
+setOldClass("poppr_file")
+
+#==============================================================================#
+#' @rdname poppr_file
+#' @param ... unused.
+#' @export
+#==============================================================================#
+setMethod(
+  f = "nInd",
+  signature(x = "poppr_file"),
+  definition = function(x, ...){
+    x$nInd
+  }
+)
+
+#==============================================================================#
+#' @rdname poppr_file
+#' @export
+#==============================================================================#
+setMethod(
+  f = "nLoc",
+  signature(x = "poppr_file"),
+  definition = function(x, ...){
+    x$nLoc
+  }
+)
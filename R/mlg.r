@@ -47,6 +47,7 @@
 #'   
 #' @param gid a \code{\linkS4class{genind}}, \code{\linkS4class{genclone}},
 #'   \code{\linkS4class{genlight}}, or \code{\linkS4class{snpclone}} object.
+#'   \code{mlg()} also accepts a \code{poppr_file} from \code{\link{open_poppr}}.
 #'  
 #' @param strata a formula specifying the strata at which computation is to be
 #'   performed.
@@ -209,10 +210,12 @@ NULL
 #==============================================================================#
 
 mlg <- function(gid, quiet=FALSE){
-  if (!inherits(gid, c("genlight", "genind"))) {
+  if (!inherits(gid, c("genlight", "genind", "poppr_file"))) {
     stop(paste(substitute(gid), "is not a genind, or genlight object"))
   }
-  if (is.clone(gid) && length(gid@mlg) == nInd(gid)) {
+  if (inherits(gid, "poppr_file")) {
+    out <- length(unique(poppr_file_mlg(gid)))
+  } else if (is.clone(gid) && length(gid@mlg) == nInd(gid)) {
     out <- length(unique(gid@mlg[]))
   } else {
     if (inherits(gid, "genlight"))
@@ -102,6 +102,26 @@ print.locustable <- function(x, ...){
   }
 }
 
+#' @method print poppr_file
+#' @export
+print.poppr_file <- function(x, ...){
+  npop <- if (is.null(x$pop)) 0L else nlevels(x$pop)
+  cat("\nThis is a poppr file of a", x$class, "object:", x$file, "\n")
+  cat(x$nInd, ifelse(x$nInd == 1, "sample;", "samples;"), 
+      x$nLoc, ifelse(x$nLoc == 1, "locus;", "loci;"),
+      npop, ifelse(npop == 1, "population", "populations"), "\n")
+  cat("sections:", paste(x$index$name, collapse = ", "), "\n")
+  invisible(x)
+}
+
+#' @method print poppr_profile
+#' @export
+print.poppr_profile <- function(x, ...){
+  cat("\nProfile of", length(x), ifelse(length(x) == 1, "kernel", "kernels"), "\n")
+  print(poppr_profile(x), row.names = FALSE, digits = 3, ...)
+  invisible(x)
+}
+
 #' @method print pairia
 #' @export
 print.pairia <- function(x, ...){
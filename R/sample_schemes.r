@@ -126,29 +126,22 @@ shufflepop <- function(pop, method=1){
                         function(x) sample(tab(pop)[, x], replace=TRUE), pop@tab[, 1])
     }
   } else {
-    LF <- locFac(pop)
-    for (locus in locNames(pop)) {
-      pop@tab[, LF %in% locus] <- .locus.shuffler(pop[, loc = locus], method = method)@tab 
-    }
+    pop@tab[] <- shuffle_tab_native(pop, method = method)[[1]]
   }
   return(pop)
 }
 
 #==============================================================================#
-# .sampling will reshuffle the alleles per individual, per locus via the 
-# .single.sampler function, which is described below. It will then calculate the
-# Index of Association for the resampled population for the number of times
-# indicated in "iterations".
+# .sampling will reshuffle the alleles per individual, per locus with one of the
+# methods of shufflepop(). It will then calculate the Index of Association for
+# the resampled population for the number of times indicated in "iterations".
+# For codominant data, the permutations and the index of association are
+# calculated in compiled code, in chunks of replicates between progress updates.
 #==============================================================================#
 .sampling <- function(pop, iterations, quiet=FALSE, missing="ignore", type=type, 
-                      method=1){ 
+                      method=1, threads=1L){ 
   METHODS = c("permute alleles", "parametric bootstrap",
               "non-parametric bootstrap", "multilocus")
-  if(!is.list(pop)){
-    if(type=="PA"){
-      .Ia.Rd <- .PA.Ia.Rd
-    }
-  }
 	sample.data <- data.frame(list(Ia = vector(mode = "numeric", 
                                              length = iterations),
                                  rbarD = vector(mode = "numeric", 
@@ -156,9 +149,21 @@ shufflepop <- function(pop, method=1){
                                  )
                             )
   p <- make_progress(iterations, 50)
+  if (type != "PA"){
+    chunk <- max(1L, as.integer(p$step))
+    for (start in seq(1L, iterations, by = chunk)) {
+      reps <- seq.int(start, min(start + chunk - 1L, iterations))
+      IarD <- shuffle_ia_native(pop, method = method, nrep = length(reps), 
+                                threads = threads)
+      sample.data$Ia[reps]    <- IarD[, 1]
+      sample.data$rbarD[reps] <- IarD[, 2]
+      p$rog()
+    }
+    return(sample.data)
+  }
   for (c in seq(iterations)) {
     if (c %% p$step == 0) p$rog()
-    IarD <- .Ia.Rd(.all.shuffler(pop, type, method=method), missing=missing)   
+    IarD <- .PA.Ia.Rd(.all.shuffler(pop, type, method=method), missing=missing)   
     sample.data$Ia[c]    <- IarD[1]
     sample.data$rbarD[c] <- IarD[2]
   }
@@ -167,98 +172,27 @@ shufflepop <- function(pop, method=1){
 }
 
 #==============================================================================#
-# pop = a list of genind objects with one locus each.
+# pop = a genind object with presence/absence data.
 # 
-# This function shuffles alleles at each locus over all loci. 
+# This function shuffles each locus independently. 
 #==============================================================================#
 
 .all.shuffler <- function(pop, type=type, method=1){
   METHODS = c("permute alleles", "parametric bootstrap",
               "non-parametric bootstrap", "multilocus")
-  if(type=="PA"){
-    if(method == 1 | method == 4){
-      pop@tab <- vapply(1:ncol(tab(pop)),
-                        function(x) sample(tab(pop)[, x]), pop@tab[, 1])
-    } else if(method == 2) {
-      paramboot <- function(x){
-        one <- mean(tab(pop)[, x], na.rm=TRUE)
-        zero <- 1-one
-        return(sample(c(1L ,0L), length(tab(pop)[, x]), prob=c(one, zero), replace=TRUE))
-      }
-      pop@tab <- vapply(1:ncol(tab(pop)), paramboot, pop@tab[, 1])
-    } else if(method == 3) {
-      pop@tab <- vapply(1:ncol(tab(pop)),
-                        function(x) sample(tab(pop)[, x], replace=TRUE), pop@tab[, 1])
-    }
-  } else {
-    pop <- lapply(pop, .locus.shuffler, method = method)
-  }
-  return(pop)
-}
-
-#==============================================================================#
-# This function shuffles the alleles at each locus per individual.
-#==============================================================================# 
-
-.locus.shuffler <- function(pop, method=1){
-  METHODS = c("permute alleles", "parametric bootstrap",
-              "non-parametric bootstrap", "multilocus")
-  # if the locus is homozygous for all individuals, shuffling will not occur.
-  if( ncol(tab(pop)) > 1 ){
-
-    if (method == 4){
-
-      # Maintenence of the heterozygotic and allelic structure.
-      pop@tab <- .both.shuff(tab(pop))
-
-    } else if(method == 1){
-
-      # Maintenece of only the allelic structure. Heterozygosity can fluctuate.
-      pop@tab <- .permut.shuff(tab(pop))
-
-    } else if(method == 2){
-
-      # Parametric Bootstraping where both heterozygosity and allelic structure
-      # can change based on allelic frequency.
-      weights <- colMeans(tab(pop), na.rm = TRUE)
-      theSize <- sample(ploidy(pop), 1)
-      pop@tab <- t(stats::rmultinom(nrow(tab(pop)), size = theSize, prob = weights))
-
-    } else if(method == 3){
-
-      # Non-Parametric Bootstrap.
-      weights <- rep(1, ncol(tab(pop)))
-      theSize <- sample(ploidy(pop), 1)
-      pop@tab <- t(stats::rmultinom(nrow(tab(pop)), size = theSize, prob = weights))
-
+  if(method == 1 | method == 4){
+    pop@tab <- vapply(1:ncol(tab(pop)),
+                      function(x) sample(tab(pop)[, x]), pop@tab[, 1])
+  } else if(method == 2) {
+    paramboot <- function(x){
+      one <- mean(tab(pop)[, x], na.rm=TRUE)
+      zero <- 1-one
+      return(sample(c(1L ,0L), length(tab(pop)[, x]), prob=c(one, zero), replace=TRUE))
     }
+    pop@tab <- vapply(1:ncol(tab(pop)), paramboot, pop@tab[, 1])
+  } else if(method == 3) {
+    pop@tab <- vapply(1:ncol(tab(pop)),
+                      function(x) sample(tab(pop)[, x], replace=TRUE), pop@tab[, 1])
   }
   return(pop)
 }
-
-#==============================================================================#
-#
-# A function for true permutation shuffling. This will retain the same number of
-# observed allelic states as the original sample, but differ in the number of
-# heterozygous genotypes. 
-#
-#==============================================================================#
-  
-.permut.shuff <- function(mat){
-  bucket     <- colSums(mat, na.rm = TRUE)
-  ploidy     <- rowSums(mat, na.rm = TRUE)
-  bucketlist <- as.integer(sample(rep(1:length(bucket), bucket))) - 1L
-  mat        <- .Call("permute_shuff", mat, bucketlist, ploidy, PACKAGE = "poppr")
-  return(mat)
-}
-
-#==============================================================================#
-# shuffling both alleles at a locus, thus preserving the number of allelic
-# states as well as the heterozygosity. 
-#==============================================================================#
-.both.shuff <- function(mat){
-  typed <- which(!is.na(rowSums(mat)))
-  mat[typed, ] <- mat[sample(typed), ]
-  return(mat)
-}
-
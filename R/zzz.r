@@ -52,6 +52,10 @@
   startupmsg <- paste("This is poppr version", poppr_vers)
   startupmsg <- paste0(startupmsg, ". To get started, type package?poppr")
   paralltype <- ifelse(poppr::poppr_has_parallel(), "available", "unavailable")
+  if (poppr::poppr_has_parallel()){
+    paralltype <- paste0(paralltype, " (", poppr::poppr_threads()[["pool"]], 
+                         " threads)")
+  }
   startupmsg <- paste0(startupmsg, "\nOMP parallel support: ", paralltype, appendix)
   packageStartupMessage(startupmsg)
   if (!interactive() || stats::runif(1) > 0.1) return()
@@ -70,7 +74,11 @@
   op.poppr <- list(
     poppr.debug = FALSE,     # flag for verbosity
     old.bruvo.model = FALSE, # flag for using the old model of Bruvo's distance.
-    poppr.old.dplyr = FALSE  # flag to for testing old version of dplyr
+    poppr.old.dplyr = FALSE, # flag to for testing old version of dplyr
+    poppr.threads = 0L,      # threads used for threads = 0 (0 = all available)
+    poppr.profile = FALSE,   # attach profiles to the results of compiled code
+    poppr.memory_limit = NA, # memory budget in bytes (NA = what the system has)
+    poppr.cache_limit = "1G" # size of the cache of distances and networks
   )
   toset <- !(names(op.poppr) %in% names(op))
   if(any(toset)) options(op.poppr[toset])
@@ -33,7 +33,7 @@
 */
 
 int count_unique(SEXP arr1, SEXP arr2);
-SEXP adjust_missing(SEXP nas, SEXP nloc);
+SEXP adjust_missing(SEXP nas, SEXP nloc, SEXP condensed);
 /*
  * Count all unique elements for the union of two arrays
  * 
@@ -81,20 +81,39 @@ int count_unique(SEXP arr1, SEXP arr2)
  *  nas a list where each element represents a sample containing an integer 
  *      vector representing positions of missing data for that individual
  *  nloc an integer specifying the number of loci observed in the entire set
+ *  condensed TRUE if only the lower triangle should be returned in the order
+ *      of a dist object
  * 
  * Return:
- *  a square matrix
+ *  a square matrix or a vector of length n*(n - 1)/2
  */
-SEXP adjust_missing(SEXP nas, SEXP nloc)
+SEXP adjust_missing(SEXP nas, SEXP nloc, SEXP condensed)
 {
   int i;
   int j;
   int NLOC = asInteger(nloc);
   SEXP nai;
   SEXP naj;
+  SEXP out;
   double u;
+  R_xlen_t k = 0;
   int n    = length(nas);
-  SEXP out = PROTECT(allocMatrix(REALSXP, n, n));
+  if (asLogical(condensed) == TRUE)
+  {
+    out = PROTECT(allocVector(REALSXP, ((R_xlen_t)n*(n - 1))/2));
+    for (i = 0; i < n - 1; i++)
+    {
+      nai = VECTOR_ELT(nas, i);
+      for (j = i + 1; j < n; j++)
+      {
+        naj = VECTOR_ELT(nas, j);
+        REAL(out)[k++] = (double)NLOC/(double)(NLOC - count_unique(nai, naj));
+      }
+    }
+    UNPROTECT(1);
+    return(out);
+  }
+  out = PROTECT(allocMatrix(REALSXP, n, n));
   for (i = 0; i < n - 1; i++)
   {
     // set diag to one
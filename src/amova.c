@@ -0,0 +1,1261 @@
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+#
+# This software was authored by Zhian N. Kamvar and Javier F. Tabima, graduate
+# students at Oregon State University; Jonah C. Brooks, undergraduate student at
+# Oregon State University; and Dr. Nik Grünwald, an employee of USDA-ARS.
+#
+# Permission to use, copy, modify, and distribute this software and its
+# documentation for educational, research and non-profit purposes, without fee,
+# and without a written agreement is hereby granted, provided that the statement
+# above is incorporated into the material, giving appropriate attribution to the
+# authors.
+#
+# Permission to incorporate this software into commercial products may be
+# obtained by contacting USDA ARS and OREGON STATE UNIVERSITY Office for
+# Commercialization and Corporate Development.
+#
+# The software program and documentation are supplied "as is", without any
+# accompanying services from the USDA or the University. USDA ARS or the
+# University do not warrant that the operation of the program will be
+# uninterrupted or error-free. The end-user understands that the program was
+# developed for research purposes and is advised not to rely exclusively on the
+# program for any reason.
+#
+# IN NO EVENT SHALL USDA ARS OR OREGON STATE UNIVERSITY BE LIABLE TO ANY PARTY
+# FOR DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES, INCLUDING
+# LOST PROFITS, ARISING OUT OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION,
+# EVEN IF THE OREGON STATE UNIVERSITY HAS BEEN ADVISED OF THE POSSIBILITY OF
+# SUCH DAMAGE. USDA ARS OR OREGON STATE UNIVERSITY SPECIFICALLY DISCLAIMS ANY
+# WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+# MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE AND ANY STATUTORY
+# WARRANTY OF NON-INFRINGEMENT. THE SOFTWARE PROVIDED HEREUNDER IS ON AN "AS IS"
+# BASIS, AND USDA ARS AND OREGON STATE UNIVERSITY HAVE NO OBLIGATIONS TO PROVIDE
+# MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS.
+#
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+// Include openMP if the compiler supports it
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include <Rinternals.h>
+#include <R_ext/Utils.h>
+#include <R.h>
+#include "poppr_progress.h"
+#include "poppr_rng.h"
+#include "poppr_threads.h"
+
+#define AMOVA_DIST 0 // condensed distance matrix
+#define AMOVA_TAB  1 // numeric matrix of allele counts or frequencies
+#define AMOVA_SNP  2 // genlight object
+
+/*
+The hierarchy struct
+====================
+
+AMOVA levels are numbered from 0 (the total) to K (the lowest stratum in the
+hierarchy formula). The samples themselves are treated as level K + 1 so that
+permutations of samples and permutations of whole strata can share the same
+code. Every unit at level l (l > 0) has exactly one parent at level l - 1.
+
+  nlev   - K, the number of strata in the hierarchy
+  nsamp  - the number of samples (rows of the strata matrix)
+  ngrp   - the number of units at each level (K + 2 elements)
+  parent - for each level l in 1..K+1, the parent of each unit at level l - 1
+  size   - for each level l in 0..K+1, the number of samples in each unit
+  grp    - for each level l in 0..K, the unit of each sample at level l
+  offset - the position of level l (0..K) in arrays over all units
+*/
+struct amova_hier
+{
+  int nlev;
+  int nsamp;
+  int* ngrp;
+  int** parent;
+  double** size;
+  int** grp;
+  int* offset;
+  int total_units;
+};
+
+/*
+The data struct
+===============
+
+The genetic data in one of three forms. For AMOVA_DIST, the squared distance
+between samples i and j is dist[geno[i], geno[j]]. For AMOVA_TAB and AMOVA_SNP,
+it is the squared Euclidean distance between the rows of the data, which never
+needs to be calculated because every sum of squares can be found from the
+column sums of the units (see amova_pair_sums_tab).
+
+  dist   - a dist vector between ngeno genotypes (AMOVA_DIST)
+  geno   - the zero-based genotype for each sample (AMOVA_DIST)
+  tab    - an nind x ncol column-major matrix (AMOVA_TAB)
+  snp    - for each individual, maxchr pointers to the bit-packed
+           chromosomes of a SNPbin object (AMOVA_SNP)
+  nchr   - the number of chromosomes in each individual (AMOVA_SNP)
+
+When ploidy > 1, each individual is split into ploidy haplotypes that are the
+samples of the AMOVA, so nsamp = nind * ploidy and haplotype h of individual i
+is sample i * ploidy + h. The haplotypes are never created. For genlight
+objects, haplotype h is chromosome h. For tables of allele counts, haplotype h
+carries the h-th allele of each locus in column order (as genind2df() writes
+them), which is found from the count of the alleles before it in the same
+locus (cum).
+*/
+struct amova_data
+{
+  int mode;
+  int nsamp;
+  int nind;
+  int ploidy;
+  int* cum;
+  double* dist;
+  int ngeno;
+  int* geno;
+  int ncol;
+  double* tab;
+  Rbyte** snp;
+  int* nchr;
+  int maxchr;
+};
+
+SEXP amova_native(SEXP dist, SEXP geno, SEXP strata, SEXP nperm, SEXP requested_threads);
+SEXP amova_native_tab(SEXP x, SEXP ploidy, SEXP loc_fac, SEXP strata, SEXP nperm, SEXP requested_threads);
+static SEXP amova_run(struct amova_data *d, SEXP strata, SEXP nperm, SEXP requested_threads);
+static void amova_hier_fill(struct amova_hier *h, int *codes, int nsamp, int nlev);
+static void amova_hier_free(struct amova_hier *h);
+static void amova_pair_sums_dist(struct amova_hier *h, struct amova_data *d, double *pair_sums, int num_threads);
+static void amova_pair_sums_tab(struct amova_hier *h, struct amova_data *d, double *pair_sums, double *rownorm, int num_threads);
+static void amova_level_W(struct amova_hier *h, double *pair_sums, double *W);
+static void amova_sigma(int nlev, double nsamp, int *ngrp, int **parent, double **size, double *W, double *ss, double *df, double *sigma);
+static void amova_permute(struct amova_hier *h, struct amova_data *d, double *pair_sums, double *rownorm, double *W, double df_within, int npermutations, uint64_t seed, double *out, int num_threads, struct poppr_progress *prog);
+static inline double amova_d2(struct amova_data *d, int a, int b);
+static inline double amova_value(struct amova_data *d, int i, int k);
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+Squared distance between two samples from a condensed (dist) vector.
+
+Input: The data and the zero-based indices of two samples.
+Output: The squared distance. Identical genotypes have a distance of zero.
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+static inline double amova_d2(struct amova_data *d, int a, int b)
+{
+  R_xlen_t idx;
+  double x;
+  int tmp;
+  a = d->geno[a];
+  b = d->geno[b];
+  if (a == b)
+  {
+    return 0.0;
+  }
+  if (a > b)
+  {
+    tmp = a;
+    a = b;
+    b = tmp;
+  }
+  idx = (R_xlen_t)d->ngeno*a - ((R_xlen_t)a*(a + 1))/2 + b - a - 1;
+  x = d->dist[idx];
+  return x*x;
+}
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+The value of column k for sample s in a table or genlight object. For genlight
+objects, this is the number of chromosomes carrying the second allele. For
+haplotypes (ploidy > 1), this is 1 if the haplotype carries allele k and 0
+otherwise.
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+static inline double amova_value(struct amova_data *d, int s, int k)
+{
+  int c;
+  int i = s;
+  int h = 0;
+  int res = 0;
+  size_t idx;
+  Rbyte** chr;
+  if (d->ploidy > 1)
+  {
+    i = s / d->ploidy;
+    h = s % d->ploidy;
+  }
+  if (d->mode == AMOVA_TAB)
+  {
+    idx = i + (size_t)k*d->nind;
+    if (d->ploidy > 1)
+    {
+      return (h >= d->cum[idx] && h < d->cum[idx] + (int)d->tab[idx]) ? 1.0 : 0.0;
+    }
+    return d->tab[idx];
+  }
+  chr = d->snp + (size_t)i*d->maxchr;
+  if (d->ploidy > 1)
+  {
+    return (h < d->nchr[i]) ? (double)((chr[h][k >> 3] >> (k & 7)) & 1) : 0.0;
+  }
+  for (c = 0; c < d->nchr[i]; c++)
+  {
+    res += (chr[c][k >> 3] >> (k & 7)) & 1;
+  }
+  return (double)res;
+}
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+Fill the hierarchy struct from a matrix of nested strata codes.
+
+Input: codes - an nsamp x nlev integer matrix where column l contains 1-based
+               codes for the level l + 1 units. Codes must be nested so that
+               every unit has a single parent.
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+static void amova_hier_fill(struct amova_hier *h, int *codes, int nsamp, int nlev)
+{
+  int i;
+  int l;
+  int g;
+  // Validate before allocating anything so that error() does not leak.
+  for (i = 0; i < nsamp*nlev; i++)
+  {
+    if (codes[i] == NA_INTEGER || codes[i] < 1)
+    {
+      error("strata codes must be positive integers");
+    }
+  }
+  h->nlev   = nlev;
+  h->nsamp  = nsamp;
+  h->ngrp   = R_Calloc(nlev + 2, int);
+  h->parent = R_Calloc(nlev + 2, int*);
+  h->size   = R_Calloc(nlev + 2, double*);
+  h->grp    = R_Calloc(nlev + 1, int*);
+  h->offset = R_Calloc(nlev + 1, int);
+  h->ngrp[0] = 1;
+  h->ngrp[nlev + 1] = nsamp;
+  for (l = 1; l <= nlev; l++)
+  {
+    h->ngrp[l] = 0;
+    for (i = 0; i < nsamp; i++)
+    {
+      g = codes[i + (l - 1)*nsamp];
+      h->ngrp[l] = (g > h->ngrp[l]) ? g : h->ngrp[l];
+    }
+  }
+  h->total_units = 0;
+  for (l = 0; l <= nlev; l++)
+  {
+    h->offset[l] = h->total_units;
+    h->total_units += h->ngrp[l];
+  }
+  for (l = 0; l <= nlev + 1; l++)
+  {
+    h->size[l] = R_Calloc(h->ngrp[l], double);
+    h->parent[l] = (l > 0) ? R_Calloc(h->ngrp[l], int) : NULL;
+  }
+  for (l = 0; l <= nlev; l++)
+  {
+    h->grp[l] = R_Calloc(nsamp, int);
+  }
+  for (i = 0; i < nsamp; i++)
+  {
+    h->grp[0][i] = 0;
+    h->size[0][0] += 1.0;
+    for (l = 1; l <= nlev; l++)
+    {
+      g = codes[i + (l - 1)*nsamp] - 1;
+      h->grp[l][i] = g;
+      h->size[l][g] += 1.0;
+      h->parent[l][g] = h->grp[l - 1][i];
+    }
+    h->size[nlev + 1][i] = 1.0;
+    h->parent[nlev + 1][i] = h->grp[nlev][i];
+  }
+}
+
+static void amova_hier_free(struct amova_hier *h)
+{
+  int l;
+  for (l = 0; l <= h->nlev + 1; l++)
+  {
+    R_Free(h->size[l]);
+    if (l > 0)
+    {
+      R_Free(h->parent[l]);
+    }
+  }
+  for (l = 0; l <= h->nlev; l++)
+  {
+    R_Free(h->grp[l]);
+  }
+  R_Free(h->ngrp);
+  R_Free(h->parent);
+  R_Free(h->size);
+  R_Free(h->grp);
+  R_Free(h->offset);
+}
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+Calculate the sum of squared distances within every unit of every level in a
+single pass over all pairs of samples.
+
+Each pair of samples contributes its squared distance to the deepest unit that
+contains both samples. The pair sums are then pushed up the hierarchy so that
+pair_sums[offset[l] + g] contains the sum of all squared distances within unit
+g at level l.
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+static void amova_pair_sums_dist(struct amova_hier *h, struct amova_data *d, double *pair_sums, int num_threads)
+{
+  int i;
+  int j;
+  int l;
+  int g;
+  int depth;
+  int t;
+  int nlev = h->nlev;
+  int nsamp = h->nsamp;
+  int total_units = h->total_units;
+  int* offset = h->offset;
+  // One accumulator per thread to avoid collisions.
+  double* acc = R_Calloc((size_t)total_units*num_threads, double);
+
+  #ifdef _OPENMP
+  #pragma omp parallel for schedule(guided) num_threads(num_threads) private(i, j, l, depth, t)
+  #endif
+  for (i = 0; i < nsamp; i++)
+  {
+    #ifdef _OPENMP
+    t = omp_get_thread_num();
+    #else
+    t = 0;
+    #endif
+    double* my_acc = acc + (size_t)t*total_units;
+    for (j = 0; j < i; j++)
+    {
+      depth = 0;
+      for (l = 1; l <= nlev; l++)
+      {
+        if (h->grp[l][i] != h->grp[l][j])
+        {
+          break;
+        }
+        depth = l;
+      }
+      my_acc[offset[depth] + h->grp[depth][i]] += amova_d2(d, i, j);
+    }
+  }
+
+  memset(pair_sums, 0, sizeof(double)*total_units);
+  for (t = 0; t < num_threads; t++)
+  {
+    for (g = 0; g < total_units; g++)
+    {
+      pair_sums[g] += acc[(size_t)t*total_units + g];
+    }
+  }
+  // Push the within-unit sums up to the parents.
+  for (l = nlev; l > 0; l--)
+  {
+    for (g = 0; g < h->ngrp[l]; g++)
+    {
+      pair_sums[offset[l - 1] + h->parent[l][g]] += pair_sums[offset[l] + g];
+    }
+  }
+  R_Free(acc);
+}
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+Calculate the same pair sums as amova_pair_sums_dist directly from the data
+without calculating any distances.
+
+For squared Euclidean distances, the sum over all pairs in a unit g of size N is
+
+  sum(i < j in g) |x_i - x_j|^2 = N * sum(i in g) |x_i|^2 - |sum(i in g) x_i|^2
+
+which only needs the column sums and sums of squares of each unit. Each column
+is centered on its mean before it is used to avoid cancellation. The columns
+are split among threads and only need O(units) memory each, so the whole
+calculation is O(n * m) in time and never holds more than one column per
+thread.
+
+Input: rownorm - if not NULL, an array of length nsamp that will be filled
+                 with the squared norm of each (centered) sample.
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+static void amova_pair_sums_tab(struct amova_hier *h, struct amova_data *d, double *pair_sums, double *rownorm, int num_threads)
+{
+  int i;
+  int k;
+  int l;
+  int g;
+  int t;
+  int nlev = h->nlev;
+  int nsamp = h->nsamp;
+  int ncol = d->ncol;
+  int total_units = h->total_units;
+  int* offset = h->offset;
+  double* acc = R_Calloc((size_t)total_units*num_threads, double);
+  double* colsum = R_Calloc((size_t)total_units*num_threads, double);
+  double* colsq = R_Calloc((size_t)total_units*num_threads, double);
+  double* norms = R_Calloc((size_t)nsamp*num_threads, double);
+
+  #ifdef _OPENMP
+  #pragma omp parallel for schedule(static) num_threads(num_threads) private(i, k, l, g, t)
+  #endif
+  for (k = 0; k < ncol; k++)
+  {
+    #ifdef _OPENMP
+    t = omp_get_thread_num();
+    #else
+    t = 0;
+    #endif
+    double* my_acc = acc + (size_t)t*total_units;
+    double* my_sum = colsum + (size_t)t*total_units;
+    double* my_sq = colsq + (size_t)t*total_units;
+    double* my_norms = norms + (size_t)t*nsamp;
+    double mu = 0.0;
+    double x;
+    for (i = 0; i < nsamp; i++)
+    {
+      mu += amova_value(d, i, k);
+    }
+    mu /= nsamp;
+    memset(my_sum, 0, sizeof(double)*total_units);
+    memset(my_sq, 0, sizeof(double)*total_units);
+    for (i = 0; i < nsamp; i++)
+    {
+      x = amova_value(d, i, k) - mu;
+      g = offset[nlev] + h->grp[nlev][i];
+      my_sum[g] += x;
+      my_sq[g] += x*x;
+      my_norms[i] += x*x;
+    }
+    for (l = nlev; l > 0; l--)
+    {
+      for (g = 0; g < h->ngrp[l]; g++)
+      {
+        my_sum[offset[l - 1] + h->parent[l][g]] += my_sum[offset[l] + g];
+        my_sq[offset[l - 1] + h->parent[l][g]] += my_sq[offset[l] + g];
+      }
+    }
+    for (l = 0; l <= nlev; l++)
+    {
+      for (g = 0; g < h->ngrp[l]; g++)
+      {
+        x = my_sum[offset[l] + g];
+        my_acc[offset[l] + g] += h->size[l][g]*my_sq[offset[l] + g] - x*x;
+      }
+    }
+  }
+  memset(pair_sums, 0, sizeof(double)*total_units);
+  if (rownorm != NULL)
+  {
+    memset(rownorm, 0, sizeof(double)*nsamp);
+  }
+  for (t = 0; t < num_threads; t++)
+  {
+    for (g = 0; g < total_units; g++)
+    {
+      pair_sums[g] += acc[(size_t)t*total_units + g];
+    }
+    if (rownorm != NULL)
+    {
+      for (i = 0; i < nsamp; i++)
+      {
+        rownorm[i] += norms[(size_t)t*nsamp + i];
+      }
+    }
+  }
+  R_Free(acc);
+  R_Free(colsum);
+  R_Free(colsq);
+  R_Free(norms);
+}
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+The SSD of a unit is its pair sum divided by its size and W[l] is the sum of
+the SSDs of all units at level l.
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+static void amova_level_W(struct amova_hier *h, double *pair_sums, double *W)
+{
+  int l;
+  int g;
+  for (l = 0; l <= h->nlev; l++)
+  {
+    W[l] = 0.0;
+    for (g = 0; g < h->ngrp[l]; g++)
+    {
+      W[l] += pair_sums[h->offset[l] + g]/h->size[l][g];
+    }
+  }
+}
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+Calculate sums of squares, degrees of freedom, and variance components from the
+per-level SSDs for an unbalanced nested design.
+
+The source c (1..K) is the variation among level c units within level c - 1
+units. The coefficient of sigma_l in the expected mean square of source c is
+
+  k(c, l) = [Q(c, l) - Q(c - 1, l)]/df(c)
+
+where Q(h, l) is the sum over level l units v of N(v)^2/N(ancestor of v at h).
+The variance components are found by back substitution from the lowest level.
+
+Output: ss, df, and sigma all have K + 1 elements with the within-sample
+        component last.
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+static void amova_sigma(int nlev, double nsamp, int *ngrp, int **parent, double **size, double *W, double *ss, double *df, double *sigma)
+{
+  int c;
+  int l;
+  int h;
+  int v;
+  int a;
+  double nv2;
+  double ms;
+  double ms_within;
+  double q[nlev + 1];
+  double k[nlev + 1][nlev + 1];
+
+  for (c = 1; c <= nlev; c++)
+  {
+    df[c - 1] = (double)(ngrp[c] - ngrp[c - 1]);
+    ss[c - 1] = W[c - 1] - W[c];
+  }
+  df[nlev] = nsamp - ngrp[nlev];
+  ss[nlev] = W[nlev];
+
+  for (l = 1; l <= nlev; l++)
+  {
+    for (h = 0; h <= l; h++)
+    {
+      q[h] = 0.0;
+    }
+    for (v = 0; v < ngrp[l]; v++)
+    {
+      nv2 = size[l][v]*size[l][v];
+      a = v;
+      for (h = l; h >= 0; h--)
+      {
+        q[h] += nv2/size[h][a];
+        if (h > 0)
+        {
+          a = parent[h][a];
+        }
+      }
+    }
+    for (c = 1; c <= l; c++)
+    {
+      k[c][l] = (q[c] - q[c - 1])/df[c - 1];
+    }
+  }
+
+  ms_within = ss[nlev]/df[nlev];
+  sigma[nlev] = ms_within;
+  for (c = nlev; c > 0; c--)
+  {
+    ms = ss[c - 1]/df[c - 1] - ms_within;
+    for (l = c + 1; l <= nlev; l++)
+    {
+      ms -= k[c][l]*sigma[l - 1];
+    }
+    sigma[c - 1] = ms/k[c][c];
+  }
+}
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+Shuffle the group labels of the units within each parent (Fisher-Yates).
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+static void amova_shuffle(struct poppr_rng *rng, int *lab, int *unit_group, int nunits, int *par_start, int *par_units, int nparents)
+{
+  int u;
+  int p;
+  int i;
+  int j;
+  int tmp;
+  for (u = 0; u < nunits; u++)
+  {
+    lab[u] = unit_group[u];
+  }
+  for (p = 0; p < nparents; p++)
+  {
+    int start = par_start[p];
+    int n = par_start[p + 1] - start;
+    for (i = n - 1; i > 0; i--)
+    {
+      j = poppr_rng_int(rng, i + 1);
+      tmp = lab[par_units[start + i]];
+      lab[par_units[start + i]] = lab[par_units[start + j]];
+      lab[par_units[start + j]] = tmp;
+    }
+  }
+}
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+Run the permutation tests for every variance component.
+
+  - sigma for level c (1..K) is tested by shuffling the level c + 1 units (or
+    the samples when c = K) among the level c units while keeping them within
+    their level c - 1 unit.
+  - sigma within samples is tested by shuffling the samples among all of the
+    lowest level units.
+
+Only the pair sums of the receiving level change, so each permutation only
+recomputes those:
+
+  - When whole strata are shuffled, the pair sums between every two units that
+    share a parent are calculated once (from the distances, or from the unit
+    column sums for tables) and each permutation adds them up in O(units^2).
+  - When samples are shuffled and there is a distance matrix, the pair sums
+    are looked up for the pairs in each new group.
+  - When samples are shuffled from a table, the new group centroids are found
+    in one pass over the columns, split among the threads.
+
+The master thread polls prog for a user interrupt between permutations. Once
+the user interrupts, the remaining permutations and levels are skipped and the
+buffers are freed, so that the caller can raise the interrupt with
+poppr_progress_finish().
+
+Input: seed - the seed of the permutations. Permutation r of level c uses the
+              pair (r, c - 1) of poppr_rng_init().
+       prog - the progress of the permutations (one unit per permutation)
+Output: out - an npermutations x (K + 1) column-major array
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+static void amova_permute(struct amova_hier *h, struct amova_data *d, double *pair_sums, double *rownorm, double *W, double df_within, int npermutations, uint64_t seed, double *out, int num_threads, struct poppr_progress *prog)
+{
+  int nlev = h->nlev;
+  int nsamp = h->nsamp;
+  int c;
+  int r;
+  int i;
+  int j;
+  int k;
+  int l;
+  int u;
+  int p;
+  int a;
+
+  for (c = 1; c <= nlev + 1 && !poppr_progress_poll(prog); c++)
+  {
+    // Levels involved in this test. The residual test shuffles samples
+    // among the lowest units across the whole data set.
+    int ul = (c < nlev + 1) ? c + 1 : nlev + 1; // level of shuffled units
+    int gl = (c < nlev + 1) ? c : nlev;         // level of receiving units
+    int pl = (c < nlev + 1) ? c - 1 : 0;        // level that constrains
+    int nunits = h->ngrp[ul];
+    int nparents = h->ngrp[pl];
+    int ngroups = h->ngrp[gl];
+    int* unit_parent = R_Calloc(nunits, int);
+    int* unit_group = R_Calloc(nunits, int);
+    int* par_start = R_Calloc(nparents + 1, int);
+    int* par_units = R_Calloc(nunits, int);
+    int* unit_loc = R_Calloc(nunits, int);
+    int* fill = R_Calloc(nparents, int);
+    size_t* block_off = R_Calloc(nparents + 1, size_t);
+    double* self = R_Calloc(nunits, double);
+    double* block = NULL;
+    int centroids = (ul > nlev && d->mode != AMOVA_DIST);
+    int nws = centroids ? 1 : num_threads;
+    // Scratch space for each thread. R_Calloc cannot be called from the
+    // threads themselves.
+    int* ws_int = R_Calloc((size_t)nws*(2*nunits + 2*ngroups + 1), int);
+    double* ws_dbl = R_Calloc((size_t)nws*ngroups, double);
+    double* grp_norm = centroids ? R_Calloc(ngroups, double) : NULL;
+    double* grp_sq = centroids ? R_Calloc((size_t)ngroups*num_threads, double) : NULL;
+    double* grp_col = centroids ? R_Calloc((size_t)ngroups*num_threads, double) : NULL;
+
+    // Find the constraining parent and the current group of each unit.
+    for (u = 0; u < nunits; u++)
+    {
+      a = u;
+      for (l = ul; l > pl; l--)
+      {
+        if (l == gl + 1)
+        {
+          unit_group[u] = h->parent[l][a];
+        }
+        a = h->parent[l][a];
+      }
+      unit_parent[u] = (pl == 0) ? 0 : a;
+      self[u] = (ul <= nlev) ? pair_sums[h->offset[ul] + u] : 0.0;
+    }
+    // Counting sort of units by parent.
+    for (u = 0; u < nunits; u++)
+    {
+      par_start[unit_parent[u] + 1]++;
+    }
+    for (p = 0; p < nparents; p++)
+    {
+      par_start[p + 1] += par_start[p];
+    }
+    for (u = 0; u < nunits; u++)
+    {
+      p = unit_parent[u];
+      unit_loc[u] = fill[p];
+      par_units[par_start[p] + fill[p]++] = u;
+    }
+    // When the shuffled units are strata (not samples), precompute the
+    // between-unit pair sums for units that share a parent.
+    if (ul <= nlev)
+    {
+      for (p = 0; p < nparents; p++)
+      {
+        size_t np = par_start[p + 1] - par_start[p];
+        block_off[p + 1] = block_off[p] + np*np;
+      }
+      block = R_Calloc(block_off[nparents], double);
+      if (d->mode == AMOVA_DIST)
+      {
+        #ifdef _OPENMP
+        #pragma omp parallel for schedule(guided) num_threads(num_threads) private(i, j)
+        #endif
+        for (i = 0; i < nsamp; i++)
+        {
+          int ui = h->grp[ul][i];
+          for (j = 0; j < i; j++)
+          {
+            int uj = h->grp[ul][j];
+            int pi_ = unit_parent[ui];
+            if (ui == uj || pi_ != unit_parent[uj])
+            {
+              continue;
+            }
+            size_t np = par_start[pi_ + 1] - par_start[pi_];
+            double d2 = amova_d2(d, i, j);
+            #ifdef _OPENMP
+            #pragma omp atomic
+            #endif
+            block[block_off[pi_] + unit_loc[ui]*np + unit_loc[uj]] += d2;
+            #ifdef _OPENMP
+            #pragma omp atomic
+            #endif
+            block[block_off[pi_] + unit_loc[uj]*np + unit_loc[ui]] += d2;
+          }
+        }
+      }
+      else
+      {
+        // Between units u and v, the sum of squared distances is
+        // N(v)*S2(u) + N(u)*S2(v) - 2*<S(u), S(v)> where S is the vector of
+        // column sums and S2 is the sum of squares. The S2 terms are
+        // accumulated from the within-unit pair sums and the sample norms.
+        double* unit_sq = R_Calloc(nunits, double);
+        double* colsum = R_Calloc((size_t)nunits*num_threads, double);
+        double* tblock = R_Calloc(block_off[nparents]*num_threads, double);
+        int t;
+        for (i = 0; i < nsamp; i++)
+        {
+          unit_sq[h->grp[ul][i]] += rownorm[i];
+        }
+        #ifdef _OPENMP
+        #pragma omp parallel for schedule(static) num_threads(num_threads) private(i, j, u, p, t)
+        #endif
+        for (k = 0; k < d->ncol; k++)
+        {
+          #ifdef _OPENMP
+          t = omp_get_thread_num();
+          #else
+          t = 0;
+          #endif
+          double* my_sum = colsum + (size_t)t*nunits;
+          double* my_block = tblock + (size_t)t*block_off[nparents];
+          double mu = 0.0;
+          for (i = 0; i < nsamp; i++)
+          {
+            mu += amova_value(d, i, k);
+          }
+          mu /= nsamp;
+          memset(my_sum, 0, sizeof(double)*nunits);
+          for (i = 0; i < nsamp; i++)
+          {
+            my_sum[h->grp[ul][i]] += amova_value(d, i, k) - mu;
+          }
+          for (p = 0; p < nparents; p++)
+          {
+            size_t np = par_start[p + 1] - par_start[p];
+            for (i = 0; i < (int)np; i++)
+            {
+              double si = my_sum[par_units[par_start[p] + i]];
+              for (j = 0; j < i; j++)
+              {
+                my_block[block_off[p] + i*np + j] += si*my_sum[par_units[par_start[p] + j]];
+              }
+            }
+          }
+        }
+        for (p = 0; p < nparents; p++)
+        {
+          size_t np = par_start[p + 1] - par_start[p];
+          for (i = 0; i < (int)np; i++)
+          {
+            int ui = par_units[par_start[p] + i];
+            for (j = 0; j < i; j++)
+            {
+              int uj = par_units[par_start[p] + j];
+              double cross = 0.0;
+              for (t = 0; t < num_threads; t++)
+              {
+                cross += tblock[(size_t)t*block_off[nparents] + block_off[p] + i*np + j];
+              }
+              double val = h->size[ul][uj]*unit_sq[ui] + h->size[ul][ui]*unit_sq[uj] - 2.0*cross;
+              block[block_off[p] + unit_loc[ui]*np + unit_loc[uj]] = val;
+              block[block_off[p] + unit_loc[uj]*np + unit_loc[ui]] = val;
+            }
+          }
+        }
+        R_Free(unit_sq);
+        R_Free(colsum);
+        R_Free(tblock);
+      }
+    }
+
+    #ifdef _OPENMP
+    #pragma omp parallel for schedule(dynamic) num_threads(num_threads) private(r, u, p, i, j, l, k) if (!centroids)
+    #endif
+    for (r = 0; r < npermutations; r++)
+    {
+      struct poppr_rng rng;
+      int t;
+      #ifdef _OPENMP
+      t = centroids ? 0 : omp_get_thread_num();
+      #else
+      t = 0;
+      #endif
+      int* lab = ws_int + (size_t)t*(2*nunits + 2*ngroups + 1);
+      int* grp_units = lab + nunits;
+      int* grp_fill = grp_units + nunits;
+      int* grp_start = grp_fill + ngroups;
+      double* new_size = ws_dbl + (size_t)t*ngroups;
+      int* perm_par[nlev + 2];
+      double* perm_size[nlev + 2];
+      double perm_W[nlev + 1];
+      double ss[nlev + 1];
+      double df[nlev + 1];
+      double sigma[nlev + 1];
+      double Wg = 0.0;
+      int g;
+
+      // Only the master thread checks for interrupts; the other threads skip
+      // their permutations once it has seen one.
+      if (poppr_progress_poll(prog))
+      {
+        continue;
+      }
+      memset(grp_fill, 0, sizeof(int)*(2*ngroups + 1));
+      memset(new_size, 0, sizeof(double)*ngroups);
+      poppr_rng_init(&rng, seed, r, c - 1);
+      amova_shuffle(&rng, lab, unit_group, nunits, par_start, par_units, nparents);
+      for (u = 0; u < nunits; u++)
+      {
+        new_size[lab[u]] += h->size[ul][u];
+      }
+      if (centroids)
+      {
+        // N(g) * sum(|x_i|^2) - |sum(x_i)|^2 for each new group g
+        int tt;
+        memset(grp_norm, 0, sizeof(double)*ngroups);
+        memset(grp_sq, 0, sizeof(double)*ngroups*num_threads);
+        for (i = 0; i < nsamp; i++)
+        {
+          grp_norm[lab[i]] += rownorm[i];
+        }
+        #ifdef _OPENMP
+        #pragma omp parallel for schedule(static) num_threads(num_threads) private(i, g, tt)
+        #endif
+        for (k = 0; k < d->ncol; k++)
+        {
+          #ifdef _OPENMP
+          tt = omp_get_thread_num();
+          #else
+          tt = 0;
+          #endif
+          double* my_col = grp_col + (size_t)tt*ngroups;
+          double* my_sq = grp_sq + (size_t)tt*ngroups;
+          double mu = 0.0;
+          for (i = 0; i < nsamp; i++)
+          {
+            mu += amova_value(d, i, k);
+          }
+          mu /= nsamp;
+          memset(my_col, 0, sizeof(double)*ngroups);
+          for (i = 0; i < nsamp; i++)
+          {
+            my_col[lab[i]] += amova_value(d, i, k) - mu;
+          }
+          for (g = 0; g < ngroups; g++)
+          {
+            my_sq[g] += my_col[g]*my_col[g];
+          }
+        }
+        for (g = 0; g < ngroups; g++)
+        {
+          double sq = 0.0;
+          for (tt = 0; tt < num_threads; tt++)
+          {
+            sq += grp_sq[(size_t)tt*ngroups + g];
+          }
+          if (new_size[g] > 0)
+          {
+            Wg += (new_size[g]*grp_norm[g] - sq)/new_size[g];
+          }
+        }
+      }
+      else
+      {
+        // Gather the units of each group and add up their pair sums
+        for (u = 0; u < nunits; u++)
+        {
+          grp_start[lab[u] + 1]++;
+        }
+        for (g = 0; g < ngroups; g++)
+        {
+          grp_start[g + 1] += grp_start[g];
+        }
+        for (u = 0; u < nunits; u++)
+        {
+          grp_units[grp_start[lab[u]] + grp_fill[lab[u]]++] = u;
+        }
+        for (g = 0; g < ngroups; g++)
+        {
+          double ps = 0.0;
+          for (i = grp_start[g]; i < grp_start[g + 1]; i++)
+          {
+            int ui = grp_units[i];
+            ps += self[ui];
+            for (j = grp_start[g]; j < i; j++)
+            {
+              int uj = grp_units[j];
+              if (block != NULL)
+              {
+                p = unit_parent[ui];
+                size_t np = par_start[p + 1] - par_start[p];
+                ps += block[block_off[p] + unit_loc[ui]*np + unit_loc[uj]];
+              }
+              else
+              {
+                ps += amova_d2(d, ui, uj);
+              }
+            }
+          }
+          if (new_size[g] > 0)
+          {
+            Wg += ps/new_size[g];
+          }
+        }
+      }
+      if (c == nlev + 1)
+      {
+        // Only the residual changes for the within-sample test.
+        out[r + (size_t)(c - 1)*npermutations] = Wg/df_within;
+      }
+      else
+      {
+        for (l = 0; l <= nlev + 1; l++)
+        {
+          perm_par[l] = (l == ul) ? lab : h->parent[l];
+          perm_size[l] = (l == gl) ? new_size : h->size[l];
+        }
+        for (l = 0; l <= nlev; l++)
+        {
+          perm_W[l] = (l == gl) ? Wg : W[l];
+        }
+        amova_sigma(nlev, (double)nsamp, h->ngrp, perm_par, perm_size, perm_W, ss, df, sigma);
+        out[r + (size_t)(c - 1)*npermutations] = sigma[c - 1];
+      }
+      poppr_progress_add(prog, 1);
+    }
+    R_Free(unit_parent);
+    R_Free(unit_group);
+    R_Free(par_start);
+    R_Free(par_units);
+    R_Free(unit_loc);
+    R_Free(fill);
+    R_Free(block_off);
+    R_Free(self);
+    R_Free(ws_int);
+    R_Free(ws_dbl);
+    if (block != NULL)
+    {
+      R_Free(block);
+    }
+    if (centroids)
+    {
+      R_Free(grp_norm);
+      R_Free(grp_sq);
+      R_Free(grp_col);
+    }
+  }
+}
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+Common driver for the AMOVA entry points. See amova_native for the output.
+
+The callers allocate the members of d with R_alloc, and the buffers of this
+function are R_alloc'd as well, so that errors do not leak them. Only the
+hierarchy is allocated with R_Calloc, so it is freed before the interrupt of
+the permutations is raised.
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+static SEXP amova_run(struct amova_data *d, SEXP strata, SEXP nperm, SEXP requested_threads)
+{
+  SEXP Rout;
+  SEXP Rnames;
+  SEXP R_W;
+  SEXP R_SS;
+  SEXP R_df;
+  SEXP R_sigma;
+  SEXP R_perm;
+  SEXP Rdim;
+  struct amova_hier h;
+  struct poppr_progress prog;
+  int nsamp;
+  int nlev;
+  int npermutations;
+  int num_threads;
+  double* pair_sums;
+  double* rownorm = NULL;
+  double* W;
+
+  Rdim  = getAttrib(strata, R_DimSymbol);
+  nsamp = INTEGER(Rdim)[0];
+  nlev  = INTEGER(Rdim)[1];
+  npermutations = asInteger(nperm);
+  if (nsamp != d->nsamp)
+  {
+    error("the strata must have one row per sample");
+  }
+
+  num_threads = poppr_threads(requested_threads);
+
+  // Check for an interrupt before the hierarchy is allocated with R_Calloc
+  R_CheckUserInterrupt();
+  amova_hier_fill(&h, INTEGER(strata), nsamp, nlev);
+  pair_sums = (double*)R_alloc(h.total_units, sizeof(double));
+  W = (double*)R_alloc(nlev + 1, sizeof(double));
+  memset(pair_sums, 0, sizeof(double)*h.total_units);
+  memset(W, 0, sizeof(double)*(nlev + 1));
+
+  if (d->mode == AMOVA_DIST)
+  {
+    amova_pair_sums_dist(&h, d, pair_sums, num_threads);
+  }
+  else
+  {
+    rownorm = (double*)R_alloc(nsamp, sizeof(double));
+    memset(rownorm, 0, sizeof(double)*nsamp);
+    amova_pair_sums_tab(&h, d, pair_sums, rownorm, num_threads);
+  }
+  amova_level_W(&h, pair_sums, W);
+
+  PROTECT(R_W     = allocVector(REALSXP, nlev + 1));
+  PROTECT(R_SS    = allocVector(REALSXP, nlev + 1));
+  PROTECT(R_df    = allocVector(REALSXP, nlev + 1));
+  PROTECT(R_sigma = allocVector(REALSXP, nlev + 1));
+  memcpy(REAL(R_W), W, sizeof(double)*(nlev + 1));
+  amova_sigma(nlev, (double)nsamp, h.ngrp, h.parent, h.size, W, REAL(R_SS),
+              REAL(R_df), REAL(R_sigma));
+
+  if (npermutations > 0)
+  {
+    PROTECT(R_perm = allocMatrix(REALSXP, npermutations, nlev + 1));
+    // Permutation r of level c is the pair (r, c - 1) of one seed, so the
+    // permutations do not depend on how they are scheduled.
+    poppr_progress_init(&prog, (double)npermutations*(nlev + 1), R_NilValue);
+    amova_permute(&h, d, pair_sums, rownorm, W, REAL(R_df)[nlev],
+                  npermutations, poppr_rng_seed(), REAL(R_perm), num_threads,
+                  &prog);
+  }
+  else
+  {
+    PROTECT(R_perm = R_NilValue);
+  }
+
+  amova_hier_free(&h);
+  if (npermutations > 0)
+  {
+    poppr_progress_finish(&prog);
+  }
+
+  PROTECT(Rout = allocVector(VECSXP, 5));
+  PROTECT(Rnames = allocVector(STRSXP, 5));
+  SET_VECTOR_ELT(Rout, 0, R_W);
+  SET_VECTOR_ELT(Rout, 1, R_SS);
+  SET_VECTOR_ELT(Rout, 2, R_df);
+  SET_VECTOR_ELT(Rout, 3, R_sigma);
+  SET_VECTOR_ELT(Rout, 4, R_perm);
+  SET_STRING_ELT(Rnames, 0, mkChar("W"));
+  SET_STRING_ELT(Rnames, 1, mkChar("SS"));
+  SET_STRING_ELT(Rnames, 2, mkChar("df"));
+  SET_STRING_ELT(Rnames, 3, mkChar("sigma"));
+  SET_STRING_ELT(Rnames, 4, mkChar("perm"));
+  setAttrib(Rout, R_NamesSymbol, Rnames);
+  UNPROTECT(7);
+  return Rout;
+}
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+Calculates a hierarchical AMOVA and optional permutation tests of each variance
+component from a condensed distance matrix.
+
+Sums of squares are obtained in one pass over all pairs of samples using
+per-unit accumulators (see amova_pair_sums_dist). See amova_permute for the
+permutation scheme (Excoffier et al. 1992).
+
+Input: dist   - a dist vector of Euclidean (not squared) distances between
+                the unique genotypes.
+       geno   - a 1-based index of the genotype (row of dist) for each sample.
+       strata - an n x K integer matrix of nested, 1-based strata codes with
+                the highest level in the first column.
+       nperm  - the number of permutations per variance component.
+       requested_threads - number of threads (0 = all available).
+Output: A list with elements
+       W     - the SSD of each level (K + 1)
+       SS    - sums of squares of each source of variation (K + 1)
+       df    - degrees of freedom (K + 1)
+       sigma - variance components (K + 1)
+       perm  - an nperm x (K + 1) matrix of permuted variance components, or
+               NULL if nperm = 0.
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+SEXP amova_native(SEXP dist, SEXP geno, SEXP strata, SEXP nperm, SEXP requested_threads)
+{
+  SEXP Rout;
+  struct amova_data d;
+  int i;
+
+  memset(&d, 0, sizeof(struct amova_data));
+  d.mode  = AMOVA_DIST;
+  d.nsamp = XLENGTH(geno);
+  d.nind  = d.nsamp;
+  d.ploidy = 1;
+  d.dist  = REAL(dist);
+  d.ngeno = (int)((1 + sqrt(1 + 8*(double)XLENGTH(dist)))/2);
+  for (i = 0; i < d.nsamp; i++)
+  {
+    if (INTEGER(geno)[i] < 1 || INTEGER(geno)[i] > d.ngeno)
+    {
+      error("genotype index %d out of range", INTEGER(geno)[i]);
+    }
+  }
+  d.geno = (int*)R_alloc(d.nsamp, sizeof(int));
+  for (i = 0; i < d.nsamp; i++)
+  {
+    d.geno[i] = INTEGER(geno)[i] - 1;
+  }
+  PROTECT(Rout = amova_run(&d, strata, nperm, requested_threads));
+  UNPROTECT(1);
+  return Rout;
+}
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+Calculates a hierarchical AMOVA on the squared Euclidean distances between the
+rows of a numeric matrix or the samples of a genlight object without creating
+a distance matrix (see amova_pair_sums_tab). Permutations that shuffle samples
+only recompute the group centroids.
+
+With ploidy > 1, the AMOVA is calculated on the haplotypes of each individual
+(within-individual variance) without creating them (see amova_data).
+
+Input: x       - a numeric matrix with one row per sample and no missing data,
+                 or a genlight object with no missing data.
+       ploidy  - the number of haplotypes per individual. 1 analyzes the
+                 individuals themselves.
+       loc_fac - for tables with ploidy > 1, an integer vector giving the
+                 locus of each column of x. The columns of each locus must be
+                 contiguous and x must contain allele counts.
+       strata  - as in amova_native, but with one row per sample (haplotype)
+       nperm, requested_threads - see amova_native
+Output: see amova_native
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+SEXP amova_native_tab(SEXP x, SEXP ploidy, SEXP loc_fac, SEXP strata, SEXP nperm, SEXP requested_threads)
+{
+  SEXP Rout;
+  SEXP R_gen;
+  SEXP R_chr;
+  SEXP R_nloc;
+  struct amova_data d;
+  int i;
+  int c;
+  int k;
+  int count;
+  int* locus;
+
+  memset(&d, 0, sizeof(struct amova_data));
+  d.ploidy = asInteger(ploidy);
+  if (d.ploidy < 1 || d.ploidy == NA_INTEGER)
+  {
+    error("ploidy must be a positive integer");
+  }
+  if (isMatrix(x))
+  {
+    d.mode  = AMOVA_TAB;
+    d.nind  = INTEGER(getAttrib(x, R_DimSymbol))[0];
+    d.ncol  = INTEGER(getAttrib(x, R_DimSymbol))[1];
+    d.nsamp = d.nind*d.ploidy;
+    PROTECT(x = coerceVector(x, REALSXP));
+    d.tab   = REAL(x);
+    if (d.ploidy > 1)
+    {
+      if (XLENGTH(loc_fac) != d.ncol)
+      {
+        error("loc_fac must have one element per column");
+      }
+      locus = INTEGER(loc_fac);
+      for (i = 0; i < d.nind; i++)
+      {
+        for (k = 0; k < d.ncol; k++)
+        {
+          count = (int)d.tab[i + (size_t)k*d.nind];
+          if (count < 0 || count > d.ploidy)
+          {
+            error("allele counts must be between 0 and the ploidy");
+          }
+        }
+      }
+      // The number of alleles that come before each column in its locus
+      d.cum = (int*)R_alloc((size_t)d.nind*d.ncol, sizeof(int));
+      for (i = 0; i < d.nind; i++)
+      {
+        count = 0;
+        for (k = 0; k < d.ncol; k++)
+        {
+          if (k > 0 && locus[k] != locus[k - 1])
+          {
+            count = 0;
+          }
+          d.cum[i + (size_t)k*d.nind] = count;
+          count += (int)d.tab[i + (size_t)k*d.nind];
+        }
+      }
+    }
+    PROTECT(Rout = amova_run(&d, strata, nperm, requested_threads));
+    UNPROTECT(2);
+    return Rout;
+  }
+  // Set R_gen to genlight@gen, a list of SNPbin objects
+  R_gen   = getAttrib(x, install("gen"));
+  R_nloc  = getAttrib(x, install("n.loc"));
+  d.mode  = AMOVA_SNP;
+  d.nind  = XLENGTH(R_gen);
+  d.nsamp = d.nind*d.ploidy;
+  d.ncol  = asInteger(R_nloc);
+  d.nchr  = (int*)R_alloc(d.nind, sizeof(int));
+  d.maxchr = 1;
+  for (i = 0; i < d.nind; i++)
+  {
+    R_chr = getAttrib(VECTOR_ELT(R_gen, i), install("snp"));
+    d.nchr[i] = XLENGTH(R_chr);
+    d.maxchr = (d.nchr[i] > d.maxchr) ? d.nchr[i] : d.maxchr;
+  }
+  d.snp = (Rbyte**)R_alloc((size_t)d.nind*d.maxchr, sizeof(Rbyte*));
+  memset(d.snp, 0, sizeof(Rbyte*)*d.nind*d.maxchr);
+  for (i = 0; i < d.nind; i++)
+  {
+    R_chr = getAttrib(VECTOR_ELT(R_gen, i), install("snp"));
+    for (c = 0; c < d.nchr[i]; c++)
+    {
+      d.snp[(size_t)i*d.maxchr + c] = RAW(VECTOR_ELT(R_chr, c));
+    }
+  }
+  PROTECT(Rout = amova_run(&d, strata, nperm, requested_threads));
+  UNPROTECT(1);
+  return Rout;
+}
@@ -48,6 +48,9 @@
 #include <R_ext/Utils.h>
 #include <Rdefines.h>
 #include <R.h>
+#include "poppr_threads.h"
+#include "poppr_progress.h"
+#include "poppr_profile.h"
 
 
 // Assumptions:
@@ -96,10 +99,13 @@ struct locus
 };
 
 
-SEXP bitwise_distance_haploid(SEXP genlight, SEXP missing, SEXP requested_threads);
-SEXP bitwise_distance_diploid(SEXP genlight, SEXP missing, SEXP euclid, SEXP differences_only, SEXP requested_threads);
-SEXP association_index_haploid(SEXP genlight, SEXP missing, SEXP requested_threads);
-SEXP association_index_diploid(SEXP genlight, SEXP missing, SEXP differences_only, SEXP requested_threads);
+SEXP bitwise_distance_haploid(SEXP genlight, SEXP missing, SEXP requested_threads, SEXP progress, SEXP condensed);
+SEXP bitwise_distance_diploid(SEXP genlight, SEXP missing, SEXP euclid, SEXP differences_only, SEXP requested_threads, SEXP progress, SEXP condensed);
+SEXP association_index_haploid(SEXP genlight, SEXP missing, SEXP requested_threads, SEXP progress);
+SEXP association_index_diploid(SEXP genlight, SEXP missing, SEXP differences_only, SEXP requested_threads, SEXP progress);
+static SEXP bitwise_haploid(SEXP genlight, SEXP missing, SEXP requested_threads, int condensed, struct poppr_progress* prog, struct poppr_profile* prof);
+static SEXP bitwise_diploid(SEXP genlight, SEXP missing, SEXP euclid, SEXP differences_only, SEXP requested_threads, int condensed, struct poppr_progress* prog, struct poppr_profile* prof);
+static double genlight_pair_chunks(SEXP genlight);
 SEXP get_pgen_matrix_genind(SEXP genind, SEXP freqs, SEXP pops, SEXP npop);
 // SEXP get_pgen_matrix_genlight(SEXP genlight, SEXP window);
 // void fill_Pgen(double *pgen, struct locus *loci, int interval, SEXP genlight);
@@ -118,9 +124,34 @@ distances represent the number of sites between individuals which differ.
 Input: A genlight object containing samples of haploids.
        A boolean representing whether missing data should match (TRUE) or not.
        An integer representing the number of threads that should be used.
+       An R function to report progress to or NULL (see poppr_progress.h).
+       A boolean representing whether the distances should be returned as the
+          lower triangle of the matrix in the order of a dist object (TRUE)
+          or as the full matrix. The full matrix needs twice the memory.
 Output: A distance matrix representing the number of differences between each sample.
 ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
-SEXP bitwise_distance_haploid(SEXP genlight, SEXP missing, SEXP requested_threads)
+SEXP bitwise_distance_haploid(SEXP genlight, SEXP missing, SEXP requested_threads, SEXP progress, SEXP condensed)
+{
+  SEXP R_out;
+  struct poppr_progress prog;
+  struct poppr_profile prof;
+  poppr_progress_init(&prog, genlight_pair_chunks(genlight), progress);
+  poppr_profile_init(&prof, "bitwise_distance_haploid", poppr_threads(requested_threads));
+  if (prof.enabled)
+  {
+    poppr_profile_count(&prof, "loci", asInteger(getAttrib(genlight, install("n.loc"))));
+  }
+  R_out = PROTECT(bitwise_haploid(genlight, missing, requested_threads, asLogical(condensed) == TRUE, &prog, &prof));
+  poppr_progress_finish(&prog);
+  R_out = poppr_profile_attach(&prof, R_out);
+  UNPROTECT(1);
+  return R_out;
+}
+
+// The haploid distance kernel. The progress is the number of pairs of samples
+// times the number of chunks of 8 loci. This stops early if prog is
+// interrupted.
+static SEXP bitwise_haploid(SEXP genlight, SEXP missing, SEXP requested_threads, int condensed, struct poppr_progress* prog, struct poppr_profile* prof)
 {
   // This function calculates the raw genetic distance between samples in
   // a genlight object. The general flow of this function is as follows:
@@ -166,9 +197,12 @@ SEXP bitwise_distance_haploid(SEXP genlight, SEXP missing, SEXP requested_thread
   int k;
 
   int** distance_matrix;
+  double* condensed_out;
   int cur_distance;
   char tmp_sim_set;
+  double tic;
 
+  poppr_profile_phase(prof, "setup");
   // These variables and function calls are used to access elements of the
   // genlight object. ie, R_gen_symbol is being set up as an equivalent to the
   // @gen accessor for genlights.
@@ -189,31 +223,25 @@ SEXP bitwise_distance_haploid(SEXP genlight, SEXP missing, SEXP requested_thread
 
   // Set up and initialize the matrix for storing total distance between each
   // pair of genotypes
-  R_out = PROTECT(allocVector(INTSXP, num_gens*num_gens));
-  distance_matrix = R_Calloc(num_gens,int*);
-  for(i = 0; i < num_gens; i++)
+  // The condensed distances are written straight into the output.
+  distance_matrix = NULL;
+  condensed_out = NULL;
+  if (condensed)
   {
-    distance_matrix[i] = R_Calloc(num_gens,int);
+    R_out = PROTECT(allocVector(REALSXP, ((R_xlen_t)num_gens*(num_gens - 1))/2));
+    condensed_out = REAL(R_out);
   }
-
-  #ifdef _OPENMP
+  else
   {
-    // Set the number of threads to be used in each omp parallel region
-    if(INTEGER(requested_threads)[0] == 0)
-    {
-      num_threads = omp_get_max_threads();
-    }
-    else
+    R_out = PROTECT(allocVector(INTSXP, num_gens*num_gens));
+    distance_matrix = R_Calloc(num_gens,int*);
+    for(i = 0; i < num_gens; i++)
     {
-      num_threads = INTEGER(requested_threads)[0];
+      distance_matrix[i] = R_Calloc(num_gens,int);
     }
-    omp_set_num_threads(num_threads);
   }
-  #else
-  {
-    num_threads = 1;
-  }
-  #endif
+
+  num_threads = poppr_threads(requested_threads);
 
   next_missing_index_i = -1;
   next_missing_index_j = -1;
@@ -226,10 +254,15 @@ SEXP bitwise_distance_haploid(SEXP genlight, SEXP missing, SEXP requested_thread
   chr_length = 0;
   missing_match = asLogical(missing);
 
+  poppr_profile_phase(prof, "pairs");
   // Loop through every genotype
   for(i = 0; i < num_gens; i++)
   {
-    R_CheckUserInterrupt();
+    // Only the main thread can check for interrupts
+    if (poppr_progress_poll(prog))
+    {
+      break;
+    }
     // Set R_chr1_1 to be genlight@gen[[i]]@snp[[1]], aka a raw list
     // representing the entire first set of chromosomes in this genotype
     R_chr1_1 = VECTOR_ELT(getAttrib(VECTOR_ELT(R_gen,i),R_chr_symbol),0);
@@ -255,14 +288,15 @@ SEXP bitwise_distance_haploid(SEXP genlight, SEXP missing, SEXP requested_thread
     // to create for each thread.
 
     #ifdef _OPENMP
-    #pragma omp parallel for schedule(guided) \
+    #pragma omp parallel for schedule(guided) num_threads(num_threads) \
       private(j,cur_distance,R_chr2_1,R_nap2,next_missing_index_j,next_missing_j,next_missing_index_i,next_missing_i,\
-              tmp_sim_set, k, mask, nap2_length) \
+              tmp_sim_set, k, mask, nap2_length, tic) \
       shared(R_nap1, nap1_length, i, distance_matrix)
     #endif
 
     for(j = 0; j < i; j++)
     {
+      tic = poppr_profile_tic(prof);
       cur_distance = 0;
       // These will be arrays of type RAW
       // Set R_chr2_1 to be genlight@gen[[j]]@snp[[1]], aka a raw list
@@ -411,11 +445,30 @@ SEXP bitwise_distance_haploid(SEXP genlight, SEXP missing, SEXP requested_thread
       // threads will ever have the same (i,j) combination, nor will any threads
       // (i,j) be another threads (j,i), since j < i for all threads.
 
-      distance_matrix[i][j] = cur_distance;
-      distance_matrix[j][i] = cur_distance;
+      if (condensed)
+      {
+        // Row i > column j of a dist object
+        condensed_out[(R_xlen_t)num_gens*j - ((R_xlen_t)j*(j + 1))/2 + i - j - 1] = cur_distance;
+      }
+      else
+      {
+        distance_matrix[i][j] = cur_distance;
+        distance_matrix[j][i] = cur_distance;
+      }
+      poppr_profile_toc(prof, tic);
     } // End parallel
+    poppr_progress_add(prog, (int64_t)i*chr_length);
+    poppr_profile_count(prof, "pairs", i);
+    poppr_profile_count(prof, "missing", nap1_length);
+    poppr_profile_count(prof, "bytes", 2.0*i*chr_length);
   }
+  poppr_profile_phase(prof, "output");
 
+  if (condensed)
+  {
+    UNPROTECT(4);
+    return R_out;
+  }
   // Fill the output matrix
   for(i = 0; i < num_gens; i++)
   {
@@ -447,10 +500,35 @@ Input: A genlight object containing samples of diploids.
        A boolean representing whether distance (FALSE) or differences (TRUE)
           should be returned.
        An integer representing the number of threads that should be used.
+       An R function to report progress to or NULL (see poppr_progress.h).
+       A boolean representing whether the distances should be returned as the
+          lower triangle of the matrix in the order of a dist object (TRUE)
+          or as the full matrix. The full matrix needs twice the memory.
 Output: A distance matrix representing the distance between each sample in the
           genlight object.
 ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
-SEXP bitwise_distance_diploid(SEXP genlight, SEXP missing, SEXP euclid, SEXP differences_only, SEXP requested_threads)
+SEXP bitwise_distance_diploid(SEXP genlight, SEXP missing, SEXP euclid, SEXP differences_only, SEXP requested_threads, SEXP progress, SEXP condensed)
+{
+  SEXP R_out;
+  struct poppr_progress prog;
+  struct poppr_profile prof;
+  poppr_progress_init(&prog, genlight_pair_chunks(genlight), progress);
+  poppr_profile_init(&prof, "bitwise_distance_diploid", poppr_threads(requested_threads));
+  if (prof.enabled)
+  {
+    poppr_profile_count(&prof, "loci", asInteger(getAttrib(genlight, install("n.loc"))));
+  }
+  R_out = PROTECT(bitwise_diploid(genlight, missing, euclid, differences_only, requested_threads, asLogical(condensed) == TRUE, &prog, &prof));
+  poppr_progress_finish(&prog);
+  R_out = poppr_profile_attach(&prof, R_out);
+  UNPROTECT(1);
+  return R_out;
+}
+
+// The diploid distance kernel. The progress is the number of pairs of samples
+// times the number of chunks of 8 loci. This stops early if prog is
+// interrupted.
+static SEXP bitwise_diploid(SEXP genlight, SEXP missing, SEXP euclid, SEXP differences_only, SEXP requested_threads, int condensed, struct poppr_progress* prog, struct poppr_profile* prof)
 {
   // This function calculates the raw genetic distance between samples in
   // a genlight object. The general flow of this function is as follows:
@@ -501,9 +579,12 @@ SEXP bitwise_distance_diploid(SEXP genlight, SEXP missing, SEXP euclid, SEXP dif
   int k;
 
   int** distance_matrix;
+  double* condensed_out;
   int cur_distance;
   char tmp_sim_set;
+  double tic;
 
+  poppr_profile_phase(prof, "setup");
   // These variables and function calls are used to access elements of the genlight object.
   // ie, R_gen_symbol is being set up as an equivalent to the @gen accessor for genlights.
   R_gen_symbol = PROTECT(install("gen")); // Used for accessing the named elements of the genlight object
@@ -517,31 +598,25 @@ SEXP bitwise_distance_diploid(SEXP genlight, SEXP missing, SEXP euclid, SEXP dif
   num_gens = XLENGTH(R_gen);
 
   // Set up and initialize the matrix for storing total distance between each pair of genotypes
-  R_out = PROTECT(allocVector(INTSXP, num_gens*num_gens));
-  distance_matrix = R_Calloc(num_gens,int*);
-  for(i = 0; i < num_gens; i++)
+  // The condensed distances are written straight into the output.
+  distance_matrix = NULL;
+  condensed_out = NULL;
+  if (condensed)
   {
-    distance_matrix[i] = R_Calloc(num_gens,int);
+    R_out = PROTECT(allocVector(REALSXP, ((R_xlen_t)num_gens*(num_gens - 1))/2));
+    condensed_out = REAL(R_out);
   }
-
-  #ifdef _OPENMP
+  else
   {
-    // Set the number of threads to be used in each omp parallel region
-    if(INTEGER(requested_threads)[0] == 0)
+    R_out = PROTECT(allocVector(INTSXP, num_gens*num_gens));
+    distance_matrix = R_Calloc(num_gens,int*);
+    for(i = 0; i < num_gens; i++)
     {
-      num_threads = omp_get_max_threads();
+      distance_matrix[i] = R_Calloc(num_gens,int);
     }
-    else
-    {
-      num_threads = INTEGER(requested_threads)[0];
-    }
-    omp_set_num_threads(num_threads);
   }
-  #else
-  {
-    num_threads = 1;
-  }
-  #endif
+
+  num_threads = poppr_threads(requested_threads);
 
   next_missing_index_i = 0;
   next_missing_index_j = 0;
@@ -555,11 +630,16 @@ SEXP bitwise_distance_diploid(SEXP genlight, SEXP missing, SEXP euclid, SEXP dif
   missing_match = asLogical(missing);
   only_differences = asLogical(differences_only);
 
+  poppr_profile_phase(prof, "pairs");
   // Loop through every genotype
   for(i = 0; i < num_gens - 1; i++)
   {
     // Rprintf("-> Sample i:%d\n", i);
-    R_CheckUserInterrupt();
+    // Only the main thread can check for interrupts
+    if (poppr_progress_poll(prog))
+    {
+      break;
+    }
     // Set R_chr1_1 to be genlight@gen[[i]]@snp[[1]],
     // aka a raw list representing the entire first set of chromosomes in this genotype
     R_chr1_1 = VECTOR_ELT(getAttrib(VECTOR_ELT(R_gen,i),R_chr_symbol),0);
@@ -580,14 +660,15 @@ SEXP bitwise_distance_diploid(SEXP genlight, SEXP missing, SEXP euclid, SEXP dif
     // by more than one thread at a time. Private variables can be accessed without worry, but have
     // overhead to create for each thread.
     #ifdef _OPENMP
-    #pragma omp parallel for schedule(guided) \
+    #pragma omp parallel for schedule(guided) num_threads(num_threads) \
       private(j,cur_distance,R_chr2_1,R_chr2_2,R_nap2,next_missing_index_j,next_missing_j,next_missing_index_i,next_missing_i,\
-              set_1,set_2,tmp_sim_set, k, mask, nap2_length) \
+              set_1,set_2,tmp_sim_set, k, mask, nap2_length, tic) \
       shared(R_nap1, nap1_length, i, distance_matrix)
     #endif
     for(j = i + 1; j < num_gens; j++)
     {
       // Rprintf("-> Sample j:%d\n", j);
+      tic = poppr_profile_tic(prof);
       cur_distance = 0;
       // These will be arrays of type RAW
       // Set R_chr2_1 to be genlight@gen[[j]]@snp[[1]],
@@ -730,11 +811,36 @@ SEXP bitwise_distance_diploid(SEXP genlight, SEXP missing, SEXP euclid, SEXP dif
       // However, since each iteration of this loop will have a different value for j and the
       // same value for i, no two threads will ever have the same (i,j) combination, nor will
       // any threads (i,j) be another threads (j,i), since j < i for all threads.
-      distance_matrix[i][j] = cur_distance;
-      distance_matrix[j][i] = cur_distance;
+      if (condensed)
+      {
+        // Row j > column i of a dist object
+        condensed_out[(R_xlen_t)num_gens*i - ((R_xlen_t)i*(i + 1))/2 + j - i - 1] = cur_distance;
+      }
+      else
+      {
+        distance_matrix[i][j] = cur_distance;
+        distance_matrix[j][i] = cur_distance;
+      }
+      poppr_profile_toc(prof, tic);
     } // End parallel
+    poppr_progress_add(prog, (int64_t)(num_gens - 1 - i)*chr_length);
+    poppr_profile_count(prof, "pairs", num_gens - 1 - i);
+    poppr_profile_count(prof, "missing", nap1_length);
+    poppr_profile_count(prof, "bytes", 4.0*(num_gens - 1 - i)*chr_length);
   }
+  if (prof->enabled && num_gens > 0)
+  {
+    // The last sample is never sample i
+    R_nap1 = getAttrib(VECTOR_ELT(R_gen, num_gens - 1), R_nap_symbol);
+    poppr_profile_count(prof, "missing", XLENGTH(R_nap1));
+  }
+  poppr_profile_phase(prof, "output");
 
+  if (condensed)
+  {
+    UNPROTECT(4);
+    return R_out;
+  }
   // Fill the output matrix
   for(i = 0; i < num_gens; i++)
   {
@@ -758,9 +864,10 @@ Calculates the index of association of a genlight object of haploids.
 Input: A genlight object containing samples of diploids.
        A boolean representing whether or not missing values should match.
        An integer representing the number of threads to be used.
+       An R function to report progress to or NULL (see poppr_progress.h).
 Output: The index of association for this genlight object
 ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
-SEXP association_index_haploid(SEXP genlight, SEXP missing, SEXP requested_threads)
+SEXP association_index_haploid(SEXP genlight, SEXP missing, SEXP requested_threads, SEXP progress)
 {
   // This function calculates the index of association for samples in
   // a genlight object. The general flow of this function is as follows:
@@ -845,6 +952,9 @@ SEXP association_index_haploid(SEXP genlight, SEXP missing, SEXP requested_threa
   unsigned char Sn;             // Used for temporary bitwise calculations
   unsigned char offset;
   unsigned char val;
+  struct poppr_progress prog;
+  struct poppr_profile prof;
+  double tic;
 
 
   // These variables and function calls are used to access elements of the genlight object.
@@ -871,6 +981,10 @@ SEXP association_index_haploid(SEXP genlight, SEXP missing, SEXP requested_threa
   R_nloc = getAttrib(genlight,R_nloc_symbol);
   num_loci = INTEGER(R_nloc)[0];
 
+  // Progress counts the pairs of samples compared for each chunk, once here
+  // and once for the distance matrix.
+  poppr_progress_init(&prog, 2*genlight_pair_chunks(genlight), progress);
+
   // Prepare and allocate the output matrix
   R_out = PROTECT(allocVector(REALSXP, 1));
   // Prepare and allocate a matrix to store the SNPbin data from all samples
@@ -896,24 +1010,8 @@ SEXP association_index_haploid(SEXP genlight, SEXP missing, SEXP requested_threa
   M = R_Calloc(num_chunks*chunk_length, double);
   M2 = R_Calloc(num_chunks*chunk_length, double);
 
-  #ifdef _OPENMP
-  {
-    // Set the number of threads to be used in each omp parallel region
-    if(INTEGER(requested_threads)[0] == 0)
-    {
-      num_threads = omp_get_max_threads();
-    }
-    else
-    {
-      num_threads = INTEGER(requested_threads)[0];
-    }
-    omp_set_num_threads(num_threads);
-  }
-  #else
-  {
-    num_threads = 1;
-  }
-  #endif
+  num_threads = poppr_threads(requested_threads);
+  poppr_profile_init(&prof, "association_index_haploid", num_threads);
 
   next_missing_index_i = 0;
   next_missing_index_j = 0;
@@ -927,18 +1025,24 @@ SEXP association_index_haploid(SEXP genlight, SEXP missing, SEXP requested_threa
   chr_length = 0;
   missing_match = asLogical(missing);
 
+  poppr_profile_phase(&prof, "loci");
   // Loop through all SNP chunks
   #ifdef _OPENMP
-  #pragma omp parallel for schedule(guided) \
+  #pragma omp parallel for schedule(guided) num_threads(num_threads) \
     private(i,j,k,x,R_chr1_1,R_chr2_1,R_nap1,R_nap2,Sn,offset,val,\
             next_missing_index_j,next_missing_j,next_missing_index_i,next_missing_i,missing_mask_i,missing_mask_j,\
-            set_1,set_2, mask, nap1_length, nap2_length) \
+            set_1,set_2, mask, nap1_length, nap2_length, tic) \
     shared(M, M2, missing_match, only_differences, R_gen, R_nap_symbol,\
            num_gens, num_loci, num_chunks, chunk_length, chunk_matrix)
   #endif
   for(i = 0; i < num_chunks; i++)
   {
-    R_CheckUserInterrupt();
+    // Skip the remaining chunks after an interrupt
+    if (poppr_progress_poll(&prog))
+    {
+      continue;
+    }
+    tic = poppr_profile_tic(&prof);
     // Loop through all samples
     for(j = 0; j < num_gens; j++)
     {
@@ -1044,16 +1148,20 @@ SEXP association_index_haploid(SEXP genlight, SEXP missing, SEXP requested_threa
         }
       }
     }
+    poppr_progress_add(&prog, ((int64_t)num_gens*(num_gens - 1))/2);
+    poppr_profile_toc(&prof, tic);
   }
+  poppr_profile_count(&prof, "loci", num_loci);
 
   // Get the distance matrix from bitwise_distance
-  R_dists = PROTECT(bitwise_distance_haploid(genlight, missing, requested_threads));
+  R_dists = PROTECT(bitwise_haploid(genlight, missing, requested_threads, 0, &prog, &prof));
+  poppr_profile_phase(&prof, "variance");
 
   // Calculate the sum and squared sum of distances between samples
   D = 0;
   D2 = 0;
   #ifdef _OPENMP
-  #pragma omp parallel for schedule(guided) reduction(+ : D,D2) private(i,j)
+  #pragma omp parallel for schedule(guided) num_threads(num_threads) reduction(+ : D,D2) private(i,j)
   #endif
   for(i = 0; i < num_gens; i++)
   {
@@ -1091,11 +1199,10 @@ SEXP association_index_haploid(SEXP genlight, SEXP missing, SEXP requested_threa
   // Calculate the denominator for the index of association
   denom = 0;
   #ifdef _OPENMP
-  #pragma omp parallel for schedule(guided) reduction(+ : denom) private(i, j)
+  #pragma omp parallel for schedule(guided) num_threads(num_threads) reduction(+ : denom) private(i, j)
   #endif
   for(i = 0; i < num_loci; i++)
   {
-    R_CheckUserInterrupt();
     for(j = i+1; j < num_loci; j++)
     {
       if(i != j)
@@ -1117,6 +1224,8 @@ SEXP association_index_haploid(SEXP genlight, SEXP missing, SEXP requested_threa
   R_Free(vars);
   R_Free(M);
   R_Free(M2);
+  poppr_progress_finish(&prog);
+  R_out = poppr_profile_attach(&prof, R_out);
   UNPROTECT(6);
   return R_out;
 
@@ -1130,9 +1239,10 @@ Input: A genlight object containing samples of diploids.
        A boolean representing whether distances or differences should be counted.
        An integer representing the number of threads to be used.
        A kludge to allow bitwise_distance_diploid to work
+       An R function to report progress to or NULL (see poppr_progress.h).
 Output: The index of association for this genlight object over the specified loci
 ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
-SEXP association_index_diploid(SEXP genlight, SEXP missing, SEXP differences_only, SEXP requested_threads)
+SEXP association_index_diploid(SEXP genlight, SEXP missing, SEXP differences_only, SEXP requested_threads, SEXP progress)
 {
   // This function calculates the index of association for samples in
   // a genlight object. The general flow of this function is as follows:
@@ -1221,6 +1331,9 @@ SEXP association_index_diploid(SEXP genlight, SEXP missing, SEXP differences_onl
   unsigned char Hs;
   unsigned char offset;
   unsigned char val;
+  struct poppr_progress prog;
+  struct poppr_profile prof;
+  double tic;
 
 
   // These variables and function calls are used to access elements of the genlight object.
@@ -1247,6 +1360,10 @@ SEXP association_index_diploid(SEXP genlight, SEXP missing, SEXP differences_onl
   R_nloc = getAttrib(genlight,R_nloc_symbol);
   num_loci = INTEGER(R_nloc)[0];
 
+  // Progress counts the pairs of samples compared for each chunk, once for
+  // the distance matrix and once here.
+  poppr_progress_init(&prog, 2*genlight_pair_chunks(genlight), progress);
+
   // Prepare and allocate the output matrix
   R_out = PROTECT(allocVector(REALSXP, 1));
   // Prepare and allocate a matrix to store the SNPbin data from all samples
@@ -1277,24 +1394,8 @@ SEXP association_index_diploid(SEXP genlight, SEXP missing, SEXP differences_onl
   M = R_Calloc(num_chunks*chunk_length, double);
   M2 = R_Calloc(num_chunks*chunk_length, double);
 
-  #ifdef _OPENMP
-  {
-    // Set the number of threads to be used in each omp parallel region
-    if(INTEGER(requested_threads)[0] == 0)
-    {
-      num_threads = omp_get_max_threads();
-    }
-    else
-    {
-      num_threads = INTEGER(requested_threads)[0];
-    }
-    omp_set_num_threads(num_threads);
-  }
-  #else
-  {
-    num_threads = 1;
-  }
-  #endif
+  num_threads = poppr_threads(requested_threads);
+  poppr_profile_init(&prof, "association_index_diploid", num_threads);
 
   next_missing_index_i = 0;
   next_missing_index_j = 0;
@@ -1312,21 +1413,27 @@ SEXP association_index_diploid(SEXP genlight, SEXP missing, SEXP differences_onl
   // Get the distance matrix from bitwise_distance
   euclid = PROTECT(ScalarLogical(0));
   SEXP one_thread = PROTECT(ScalarInteger(1));
-  R_dists = PROTECT(bitwise_distance_diploid(genlight, missing, euclid, differences_only, one_thread));
+  R_dists = PROTECT(bitwise_diploid(genlight, missing, euclid, differences_only, one_thread, 0, &prog, &prof));
   
 
+  poppr_profile_phase(&prof, "loci");
   // Loop through all SNP chunks
   #ifdef _OPENMP
-  #pragma omp parallel for schedule(guided) \
+  #pragma omp parallel for schedule(guided) num_threads(num_threads) \
     private(i,j,k,x,R_chr1_1,R_chr1_2,R_chr2_1,R_chr2_2,R_nap1,R_nap2,Sn,Hnor,Hs,offset,val,\
             next_missing_index_j,next_missing_j,next_missing_index_i,next_missing_i,missing_mask_i,missing_mask_j,\
-            set_1,set_2, mask, nap1_length, nap2_length) \
+            set_1,set_2, mask, nap1_length, nap2_length, tic) \
     shared(M, M2, missing_match, only_differences, R_gen, R_nap_symbol,\
            num_gens, num_loci, num_chunks, chunk_length, chunk_matrix)
   #endif
   for(i = 0; i < num_chunks; i++)
   {
-    R_CheckUserInterrupt();
+    // Skip the remaining chunks after an interrupt
+    if (poppr_progress_poll(&prog))
+    {
+      continue;
+    }
+    tic = poppr_profile_tic(&prof);
     // Loop through all samples
     for(j = 0; j < num_gens; j++)
     {
@@ -1454,15 +1561,19 @@ SEXP association_index_diploid(SEXP genlight, SEXP missing, SEXP differences_onl
         }
       }
     }
+    poppr_progress_add(&prog, ((int64_t)num_gens*(num_gens - 1))/2);
+    poppr_profile_toc(&prof, tic);
   }
+  poppr_profile_count(&prof, "loci", num_loci);
 
 
+  poppr_profile_phase(&prof, "variance");
   // Calculate the sum and squared sum of distances between samples
   D = 0;
   D2 = 0;
   x = 0;
   #ifdef _OPENMP
-  #pragma omp parallel for schedule(guided) reduction(+ : D,D2) private(i,j)
+  #pragma omp parallel for schedule(guided) num_threads(num_threads) reduction(+ : D,D2) private(i,j)
   #endif
   for(i = 0; i < num_gens; i++)
   {
@@ -1497,11 +1608,10 @@ SEXP association_index_diploid(SEXP genlight, SEXP missing, SEXP differences_onl
   // Calculate the denominator for the index of association
   denom = 0;
   #ifdef _OPENMP
-  #pragma omp parallel for schedule(guided) reduction(+ : denom) private(i, j)
+  #pragma omp parallel for schedule(guided) num_threads(num_threads) reduction(+ : denom) private(i, j)
   #endif
   for(i = 0; i < num_loci; i++)
   {
-    R_CheckUserInterrupt();
     for(j = i+1; j < num_loci; j++)
     {
       if(i != j)
@@ -1523,11 +1633,34 @@ SEXP association_index_diploid(SEXP genlight, SEXP missing, SEXP differences_onl
   R_Free(vars);
   R_Free(M);
   R_Free(M2);
+  poppr_progress_finish(&prog);
+  R_out = poppr_profile_attach(&prof, R_out);
   UNPROTECT(8);
   return R_out;
 
 }
 
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+Counts the work of a distance matrix for the progress of the kernels above.
+
+Input: A genlight object.
+Output: The number of pairs of samples times the number of chunks of 8 loci.
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+static double genlight_pair_chunks(SEXP genlight)
+{
+  SEXP R_gen;
+  double num_gens;
+  double num_chunks;
+  R_gen = getAttrib(genlight, install("gen"));
+  num_gens = (double)XLENGTH(R_gen);
+  if (num_gens < 2)
+  {
+    return 0;
+  }
+  num_chunks = (double)XLENGTH(VECTOR_ELT(getAttrib(VECTOR_ELT(R_gen, 0), install("snp")), 0));
+  return num_gens*(num_gens - 1)/2*num_chunks;
+}
+
 
 
 /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
@@ -0,0 +1,687 @@
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+#
+# This software was authored by Zhian N. Kamvar and Javier F. Tabima, graduate
+# students at Oregon State University; Jonah C. Brooks, undergraduate student at
+# Oregon State University; and Dr. Nik Grünwald, an employee of USDA-ARS.
+#
+# Permission to use, copy, modify, and distribute this software and its
+# documentation for educational, research and non-profit purposes, without fee,
+# and without a written agreement is hereby granted, provided that the statement
+# above is incorporated into the material, giving appropriate attribution to the
+# authors.
+#
+# Permission to incorporate this software into commercial products may be
+# obtained by contacting USDA ARS and OREGON STATE UNIVERSITY Office for
+# Commercialization and Corporate Development.
+#
+# The software program and documentation are supplied "as is", without any
+# accompanying services from the USDA or the University. USDA ARS or the
+# University do not warrant that the operation of the program will be
+# uninterrupted or error-free. The end-user understands that the program was
+# developed for research purposes and is advised not to rely exclusively on the
+# program for any reason.
+#
+# IN NO EVENT SHALL USDA ARS OR OREGON STATE UNIVERSITY BE LIABLE TO ANY PARTY
+# FOR DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES, INCLUDING
+# LOST PROFITS, ARISING OUT OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION,
+# EVEN IF THE OREGON STATE UNIVERSITY HAS BEEN ADVISED OF THE POSSIBILITY OF
+# SUCH DAMAGE. USDA ARS OR OREGON STATE UNIVERSITY SPECIFICALLY DISCLAIMS ANY
+# WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+# MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE AND ANY STATUTORY
+# WARRANTY OF NON-INFRINGEMENT. THE SOFTWARE PROVIDED HEREUNDER IS ON AN "AS IS"
+# BASIS, AND USDA ARS AND OREGON STATE UNIVERSITY HAVE NO OBLIGATIONS TO PROVIDE
+# MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS.
+#
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+// Include openMP if the compiler supports it
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include <Rinternals.h>
+#include <R_ext/Utils.h>
+#include <R.h>
+#include "poppr_rng.h"
+#include "poppr_threads.h"
+
+/*
+Diversity statistics of multilocus genotype counts
+==================================================
+
+The statistics of diversity_stats() for a vector of MLG counts n_1..n_k with
+N = sum(n) can all be calculated from two sums over the counts:
+
+  H      - log(N) - sum(n log n)/N (Shannon-Wiener)
+  G      - N^2/sum(n^2) (Stoddart and Taylor)
+  lambda - 1 - sum(n^2)/N^2 (Simpson)
+  E.5    - (G - 1)/(exp(H) - 1) (evenness)
+
+The expected number of MLGs in a subsample of n without replacement
+(rarefaction, Hurlbert 1971; Heck et al. 1975) and its variance are
+
+  E(S_n) = sum_i (1 - q_i)
+  Var(S_n) = sum_i q_i(1 - q_i) + 2 sum_{i < j} (q_ij - q_i q_j)
+
+where q_i = C(N - n_i, n)/C(N, n) and q_ij = C(N - n_i - n_j, n)/C(N, n) are
+found from a table of log factorials. Both only depend on the counts, so MLGs
+with the same count are handled together and the cost of each point depends on
+the number of distinct counts, not the number of MLGs.
+
+For the bootstrap, every replicate of every population is an independent task
+with its own random number stream. The counts of a replicate are drawn either
+from a multinomial distribution with the observed proportions (with an alias
+table, so each draw is O(1)) or without replacement from the observed samples
+(a partial Fisher-Yates shuffle), and are never expanded into R vectors.
+*/
+
+#define DIV_NSTAT 4
+
+SEXP diversity_bootstrap(SEXP tab, SEXP nrep, SEXP size, SEXP rarefy, SEXP requested_threads);
+SEXP rarefaction_point(SEXP tab, SEXP sample, SEXP se, SEXP requested_threads);
+SEXP rarefaction_curve(SEXP tab, SEXP step, SEXP se, SEXP requested_threads);
+static void diversity_stats_counts(const int *counts, int k, double *out);
+static int rarefy_classes(const int *tab, int npop, int nmlg, int pop, int *hist, int *cnt, int *mult);
+static void rarefy_at(const int *cnt, const int *mult, int D, int N, int n, const double *lf, int se, double *S, double *sd);
+static int rarefy_setup(const int *tab, int npop, int nmlg, int *N);
+static double* rarefy_lfact(int n);
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+Calculates H, G, lambda, and E.5 from a vector of counts.
+
+Input: counts - a vector of k counts
+       k      - the number of counts
+       out    - a vector of length DIV_NSTAT for the results
+Output: none; out is filled. Empty vectors have H = 0 and NaN for the others,
+        as in vegan::diversity().
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+static void diversity_stats_counts(const int *counts, int k, double *out)
+{
+  int i;
+  double N = 0.0;
+  double nlogn = 0.0;
+  double sumsq = 0.0;
+  double simp;
+  for (i = 0; i < k; i++)
+  {
+    if (counts[i] > 0)
+    {
+      double n = (double)counts[i];
+      N     += n;
+      nlogn += n*log(n);
+      sumsq += n*n;
+    }
+  }
+  simp   = sumsq/(N*N);
+  out[0] = (N > 0.0) ? log(N) - nlogn/N : 0.0;
+  out[1] = 1.0/simp;
+  out[2] = 1.0 - simp;
+  out[3] = (out[1] - 1.0)/(exp(out[0]) - 1.0);
+}
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+Bootstraps H, G, lambda, and E.5 for every population of an MLG table.
+
+Input: tab    - an npop x nmlg matrix of MLG counts (mlg.table())
+       nrep   - the number of bootstrap replicates (R)
+       size   - the number of samples to draw in each replicate. For the
+                multinomial bootstrap, a value < 2 means the number of samples
+                in the population. For the rarefaction bootstrap, populations
+                with fewer samples than size are resampled at their own size.
+       rarefy - if TRUE, samples are drawn without replacement (rare_sim_boot),
+                otherwise from a multinomial distribution (multinom_boot).
+       requested_threads - number of threads (0 = all available)
+Output: A list with
+          t0 - an npop x 4 matrix of the observed H, G, lambda, and E.5
+          t  - a list of npop R x 4 matrices of the bootstrapped statistics
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+SEXP diversity_bootstrap(SEXP tab, SEXP nrep, SEXP size, SEXP rarefy, SEXP requested_threads)
+{
+  SEXP Rout;
+  SEXP Rt0;
+  SEXP Rt;
+  SEXP Rdim;
+  int npop;
+  int nmlg;
+  int R;
+  int draw;
+  int do_rare;
+  int num_threads;
+  int p;
+  int i;
+  int maxk = 1;
+  int maxn = 1;
+  int* counts;
+  int* k;
+  int* N;
+  int* alias;
+  int* expand;
+  int* work_counts;
+  int* work_expand;
+  size_t* off;
+  size_t* eoff;
+  size_t ntask;
+  size_t task;
+  double* prob;
+  double** tout;
+  double stats[DIV_NSTAT];
+  uint64_t seed;
+
+  Rdim    = getAttrib(tab, R_DimSymbol);
+  npop    = INTEGER(Rdim)[0];
+  nmlg    = INTEGER(Rdim)[1];
+  R       = asInteger(nrep);
+  draw    = asInteger(size);
+  do_rare = asLogical(rarefy);
+
+  num_threads = poppr_threads(requested_threads);
+
+  PROTECT(tab = coerceVector(tab, INTSXP));
+  PROTECT(Rout = allocVector(VECSXP, 2));
+  Rt0 = allocMatrix(REALSXP, npop, DIV_NSTAT);
+  SET_VECTOR_ELT(Rout, 0, Rt0);
+  Rt = allocVector(VECSXP, npop);
+  SET_VECTOR_ELT(Rout, 1, Rt);
+  tout = (double**)R_alloc(npop, sizeof(double*));
+  for (p = 0; p < npop; p++)
+  {
+    SET_VECTOR_ELT(Rt, p, allocMatrix(REALSXP, R, DIV_NSTAT));
+    tout[p] = REAL(VECTOR_ELT(Rt, p));
+  }
+
+  R_CheckUserInterrupt();
+
+  // The observed MLGs of each population, their alias tables, and their
+  // samples (rarefaction only).
+  k     = R_Calloc(npop, int);
+  N     = R_Calloc(npop, int);
+  off   = R_Calloc(npop + 1, size_t);
+  eoff  = R_Calloc(npop + 1, size_t);
+  for (p = 0; p < npop; p++)
+  {
+    for (i = 0; i < nmlg; i++)
+    {
+      int c = INTEGER(tab)[p + (size_t)i*npop];
+      if (c == NA_INTEGER || c < 0)
+      {
+        R_Free(k);
+        R_Free(N);
+        R_Free(off);
+        R_Free(eoff);
+        error("MLG counts must be non-negative integers");
+      }
+      if (c > 0)
+      {
+        k[p]++;
+        N[p] += c;
+      }
+    }
+    off[p + 1]  = off[p] + k[p];
+    eoff[p + 1] = eoff[p] + (do_rare ? N[p] : 0);
+    maxk = (k[p] > maxk) ? k[p] : maxk;
+    maxn = (N[p] > maxn) ? N[p] : maxn;
+  }
+  counts = R_Calloc(off[npop] + 1, int);
+  alias  = R_Calloc(off[npop] + 1, int);
+  prob   = R_Calloc(off[npop] + 1, double);
+  expand = R_Calloc(eoff[npop] + 1, int);
+  for (p = 0; p < npop; p++)
+  {
+    int j = 0;
+    int* small;
+    int* large;
+    int ns = 0;
+    int nl = 0;
+    int* pc = counts + off[p];
+    int* pa = alias + off[p];
+    double* pp = prob + off[p];
+    for (i = 0; i < nmlg; i++)
+    {
+      int c = INTEGER(tab)[p + (size_t)i*npop];
+      if (c > 0)
+      {
+        pc[j++] = c;
+      }
+    }
+    diversity_stats_counts(pc, k[p], stats);
+    for (i = 0; i < DIV_NSTAT; i++)
+    {
+      REAL(Rt0)[p + (size_t)i*npop] = stats[i];
+    }
+    if (do_rare)
+    {
+      int* pe = expand + eoff[p];
+      int e = 0;
+      for (j = 0; j < k[p]; j++)
+      {
+        for (i = 0; i < pc[j]; i++)
+        {
+          pe[e++] = j;
+        }
+      }
+      continue;
+    }
+    // Vose's alias method
+    small = R_Calloc(k[p] + 1, int);
+    large = R_Calloc(k[p] + 1, int);
+    for (j = 0; j < k[p]; j++)
+    {
+      pp[j] = (double)pc[j]*k[p]/N[p];
+      if (pp[j] < 1.0)
+      {
+        small[ns++] = j;
+      }
+      else
+      {
+        large[nl++] = j;
+      }
+    }
+    while (ns > 0 && nl > 0)
+    {
+      int s = small[--ns];
+      int l = large[--nl];
+      pa[s] = l;
+      pp[l] = (pp[l] + pp[s]) - 1.0;
+      if (pp[l] < 1.0)
+      {
+        small[ns++] = l;
+      }
+      else
+      {
+        large[nl++] = l;
+      }
+    }
+    while (nl > 0)
+    {
+      pp[large[--nl]] = 1.0;
+    }
+    while (ns > 0)
+    {
+      pp[small[--ns]] = 1.0;
+    }
+    R_Free(small);
+    R_Free(large);
+  }
+
+  // Replicate rep of population pop is the pair (rep, pop) of one seed, so
+  // the replicates do not depend on how they are scheduled.
+  ntask = (size_t)npop*R;
+  seed  = poppr_rng_seed();
+
+  // Per-thread tallies and sample buffers
+  work_counts = R_Calloc((size_t)num_threads*maxk, int);
+  work_expand = R_Calloc(do_rare ? (size_t)num_threads*maxn : 1, int);
+  #ifdef _OPENMP
+  #pragma omp parallel for schedule(dynamic, 16) num_threads(num_threads) private(task)
+  #endif
+  for (task = 0; task < ntask; task++)
+  {
+    int tid = 0;
+    int pop = (int)(task / R);
+    int rep = (int)(task % R);
+    int kp = k[pop];
+    int np = N[pop];
+    int s;
+    int j;
+    int* tally;
+    double tstats[DIV_NSTAT];
+    struct poppr_rng rng;
+    #ifdef _OPENMP
+    tid = omp_get_thread_num();
+    #endif
+    tally = work_counts + (size_t)tid*maxk;
+    poppr_rng_init(&rng, seed, rep, pop);
+    memset(tally, 0, sizeof(int)*(kp > 0 ? kp : 1));
+    if (do_rare)
+    {
+      // Sampling all of the samples without replacement returns the
+      // observed counts.
+      if (np <= draw)
+      {
+        memcpy(tally, counts + off[pop], sizeof(int)*kp);
+      }
+      else
+      {
+        int* buf = work_expand + (size_t)tid*maxn;
+        memcpy(buf, expand + eoff[pop], sizeof(int)*np);
+        for (s = 0; s < draw; s++)
+        {
+          int swap = s + poppr_rng_int(&rng, np - s);
+          int tmp = buf[swap];
+          buf[swap] = buf[s];
+          buf[s] = tmp;
+          tally[tmp]++;
+        }
+      }
+    }
+    else if (kp > 0)
+    {
+      const int* pa = alias + off[pop];
+      const double* pp = prob + off[pop];
+      int nd = (draw < 2) ? np : draw;
+      for (s = 0; s < nd; s++)
+      {
+        j = poppr_rng_int(&rng, kp);
+        tally[(poppr_rng_unif(&rng) < pp[j]) ? j : pa[j]]++;
+      }
+    }
+    diversity_stats_counts(tally, kp, tstats);
+    for (j = 0; j < DIV_NSTAT; j++)
+    {
+      tout[pop][rep + (size_t)j*R] = tstats[j];
+    }
+  }
+  R_Free(work_counts);
+  R_Free(work_expand);
+  R_Free(k);
+  R_Free(N);
+  R_Free(off);
+  R_Free(eoff);
+  R_Free(counts);
+  R_Free(alias);
+  R_Free(prob);
+  R_Free(expand);
+  UNPROTECT(2);
+  return Rout;
+}
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+Collapses the MLG counts of one population into distinct counts.
+
+Input: tab  - an npop x nmlg matrix of MLG counts
+       pop  - the population (row)
+       hist - a zeroed work vector at least as long as the population size + 1.
+              It is zeroed again on return.
+       cnt  - output: the distinct counts
+       mult - output: the number of MLGs with each count
+Output: the number of distinct counts (D)
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+static int rarefy_classes(const int *tab, int npop, int nmlg, int pop, int *hist, int *cnt, int *mult)
+{
+  int i;
+  int c;
+  int D = 0;
+  int maxc = 0;
+  for (i = 0; i < nmlg; i++)
+  {
+    c = tab[pop + (size_t)i*npop];
+    if (c > 0)
+    {
+      hist[c]++;
+      maxc = (c > maxc) ? c : maxc;
+    }
+  }
+  for (c = 1; c <= maxc; c++)
+  {
+    if (hist[c] > 0)
+    {
+      cnt[D]  = c;
+      mult[D] = hist[c];
+      hist[c] = 0;
+      D++;
+    }
+  }
+  return D;
+}
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+Calculates the expected number of MLGs and its standard error for one
+population at a sample size of n. Sample sizes larger than the population give
+the observed number of MLGs with no error (as vegan::rarefy() does).
+
+Input: cnt, mult, D - the distinct counts (see rarefy_classes)
+       N            - the number of samples in the population
+       n            - the sample size
+       lf           - log factorials from 0 to at least N
+       se           - if nonzero, the standard error is calculated
+Output: none; S and sd are filled.
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+#define RARE_Q(a) ((N - (a) < n) ? 0.0 : exp(lf[N - (a)] - lf[N - (a) - n] - ldiv))
+static void rarefy_at(const int *cnt, const int *mult, int D, int N, int n, const double *lf, int se, double *S, double *sd)
+{
+  int a;
+  int b;
+  double ldiv;
+  double qa;
+  double qb;
+  double res = 0.0;
+  double var = 0.0;
+  ldiv = (n <= N) ? lf[N] - lf[N - n] : 0.0;
+  for (a = 0; a < D; a++)
+  {
+    qa   = RARE_Q(cnt[a]);
+    res += mult[a]*(1.0 - qa);
+    if (se)
+    {
+      var += mult[a]*qa*(1.0 - qa);
+      // pairs of MLGs with the same count
+      var += (double)mult[a]*(mult[a] - 1)*(RARE_Q(2*cnt[a]) - qa*qa);
+      for (b = 0; b < a; b++)
+      {
+        qb   = RARE_Q(cnt[b]);
+        var += 2.0*mult[a]*mult[b]*(RARE_Q(cnt[a] + cnt[b]) - qa*qb);
+      }
+    }
+  }
+  *S  = res;
+  *sd = (var > 0.0) ? sqrt(var) : 0.0;
+}
+#undef RARE_Q
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+Log factorials from 0 to n and the largest row sum of an MLG table.
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+static int rarefy_setup(const int *tab, int npop, int nmlg, int *N)
+{
+  int p;
+  int i;
+  int c;
+  int maxn = 0;
+  for (p = 0; p < npop; p++)
+  {
+    N[p] = 0;
+    for (i = 0; i < nmlg; i++)
+    {
+      c = tab[p + (size_t)i*npop];
+      if (c == NA_INTEGER || c < 0)
+      {
+        return -1;
+      }
+      N[p] += c;
+    }
+    maxn = (N[p] > maxn) ? N[p] : maxn;
+  }
+  return maxn;
+}
+
+static double* rarefy_lfact(int n)
+{
+  int i;
+  double* lf = R_Calloc(n + 1, double);
+  for (i = 1; i <= n; i++)
+  {
+    lf[i] = lf[i - 1] + log((double)i);
+  }
+  return lf;
+}
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+Exact rarefaction of an MLG table at one sample size per population.
+
+Input: tab    - an npop x nmlg matrix of MLG counts (mlg.table())
+       sample - a vector of sample sizes, recycled over the populations
+       se     - if TRUE, standard errors are calculated
+       requested_threads - number of threads (0 = all available)
+Output: A 2 x npop matrix with the expected number of MLGs in the first row and
+        their standard errors in the second (as vegan::rarefy(se = TRUE)).
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+SEXP rarefaction_point(SEXP tab, SEXP sample, SEXP se, SEXP requested_threads)
+{
+  SEXP Rout;
+  SEXP Rdim;
+  int npop;
+  int nmlg;
+  int nsample;
+  int do_se;
+  int num_threads;
+  int maxn;
+  int p;
+  int* N;
+  int* work;
+  double* lf;
+  double* out;
+
+  Rdim    = getAttrib(tab, R_DimSymbol);
+  npop    = INTEGER(Rdim)[0];
+  nmlg    = INTEGER(Rdim)[1];
+  nsample = length(sample);
+  do_se   = asLogical(se);
+  if (nsample == 0)
+  {
+    error("sample must have at least one element");
+  }
+  num_threads = poppr_threads(requested_threads);
+
+  PROTECT(tab = coerceVector(tab, INTSXP));
+  PROTECT(sample = coerceVector(sample, INTSXP));
+  PROTECT(Rout = allocMatrix(REALSXP, 2, npop));
+  out  = REAL(Rout);
+  N    = R_Calloc(npop + 1, int);
+  maxn = rarefy_setup(INTEGER(tab), npop, nmlg, N);
+  if (maxn < 0)
+  {
+    R_Free(N);
+    error("MLG counts must be non-negative integers");
+  }
+  lf   = rarefy_lfact(maxn);
+  // hist, cnt, and mult for each thread
+  work = R_Calloc((size_t)num_threads*3*(maxn + 1), int);
+  #ifdef _OPENMP
+  #pragma omp parallel for schedule(dynamic) num_threads(num_threads) private(p)
+  #endif
+  for (p = 0; p < npop; p++)
+  {
+    int tid = 0;
+    int D;
+    int n = INTEGER(sample)[p % nsample];
+    int* hist;
+    #ifdef _OPENMP
+    tid = omp_get_thread_num();
+    #endif
+    hist = work + (size_t)tid*3*(maxn + 1);
+    D = rarefy_classes(INTEGER(tab), npop, nmlg, p, hist, hist + maxn + 1, 
+                       hist + 2*(maxn + 1));
+    if (n == NA_INTEGER)
+    {
+      out[2*p]     = NA_REAL;
+      out[2*p + 1] = NA_REAL;
+      continue;
+    }
+    rarefy_at(hist + maxn + 1, hist + 2*(maxn + 1), D, N[p], n, lf, do_se, 
+              out + 2*p, out + 2*p + 1);
+    if (!do_se)
+    {
+      out[2*p + 1] = NA_REAL;
+    }
+  }
+  R_Free(N);
+  R_Free(lf);
+  R_Free(work);
+  UNPROTECT(3);
+  return Rout;
+}
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+Exact rarefaction curves of an MLG table.
+
+Input: tab  - an npop x nmlg matrix of MLG counts (mlg.table())
+       step - the interval between sample sizes. Each curve is evaluated at 1,
+              1 + step, 1 + 2*step, ... and at the size of the population.
+       se   - if TRUE, standard errors are calculated
+       requested_threads - number of threads (0 = all available)
+Output: A list with one matrix per population with columns for the sample size,
+        the expected number of MLGs, and the standard error.
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+SEXP rarefaction_curve(SEXP tab, SEXP step, SEXP se, SEXP requested_threads)
+{
+  SEXP Rout;
+  SEXP Rdim;
+  int npop;
+  int nmlg;
+  int by;
+  int do_se;
+  int num_threads;
+  int maxn;
+  int p;
+  int* N;
+  int* npts;
+  int* work;
+  double* lf;
+  double** out;
+
+  Rdim  = getAttrib(tab, R_DimSymbol);
+  npop  = INTEGER(Rdim)[0];
+  nmlg  = INTEGER(Rdim)[1];
+  by    = asInteger(step);
+  do_se = asLogical(se);
+  if (by == NA_INTEGER || by < 1)
+  {
+    error("step must be a positive integer");
+  }
+  num_threads = poppr_threads(requested_threads);
+
+  PROTECT(tab = coerceVector(tab, INTSXP));
+  N    = R_Calloc(npop + 1, int);
+  maxn = rarefy_setup(INTEGER(tab), npop, nmlg, N);
+  if (maxn < 0)
+  {
+    R_Free(N);
+    error("MLG counts must be non-negative integers");
+  }
+  PROTECT(Rout = allocVector(VECSXP, npop));
+  out  = (double**)R_alloc(npop, sizeof(double*));
+  npts = (int*)R_alloc(npop, sizeof(int));
+  for (p = 0; p < npop; p++)
+  {
+    // 1, 1 + step, ..., and N if it was not reached
+    npts[p] = (N[p] > 0) ? (N[p] - 1)/by + 1 + ((N[p] - 1) % by != 0) : 0;
+    SET_VECTOR_ELT(Rout, p, allocMatrix(REALSXP, npts[p], 3));
+    out[p] = REAL(VECTOR_ELT(Rout, p));
+  }
+  lf   = rarefy_lfact(maxn);
+  work = R_Calloc((size_t)num_threads*3*(maxn + 1), int);
+  #ifdef _OPENMP
+  #pragma omp parallel for schedule(dynamic) num_threads(num_threads) private(p)
+  #endif
+  for (p = 0; p < npop; p++)
+  {
+    int tid = 0;
+    int D;
+    int i;
+    int n;
+    int* hist;
+    #ifdef _OPENMP
+    tid = omp_get_thread_num();
+    #endif
+    hist = work + (size_t)tid*3*(maxn + 1);
+    D = rarefy_classes(INTEGER(tab), npop, nmlg, p, hist, hist + maxn + 1, 
+                       hist + 2*(maxn + 1));
+    for (i = 0; i < npts[p]; i++)
+    {
+      n = (i == npts[p] - 1) ? N[p] : 1 + i*by;
+      out[p][i] = (double)n;
+      rarefy_at(hist + maxn + 1, hist + 2*(maxn + 1), D, N[p], n, lf, do_se,
+                out[p] + npts[p] + i, out[p] + 2*npts[p] + i);
+      if (!do_se)
+      {
+        out[p][2*npts[p] + i] = NA_REAL;
+      }
+    }
+  }
+  R_Free(N);
+  R_Free(lf);
+  R_Free(work);
+  UNPROTECT(2);
+  return Rout;
+}
@@ -0,0 +1,548 @@
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+#
+# This software was authored by Zhian N. Kamvar and Javier F. Tabima, graduate
+# students at Oregon State University; Jonah C. Brooks, undergraduate student at
+# Oregon State University; and Dr. Nik Grünwald, an employee of USDA-ARS.
+#
+# Permission to use, copy, modify, and distribute this software and its
+# documentation for educational, research and non-profit purposes, without fee,
+# and without a written agreement is hereby granted, provided that the statement
+# above is incorporated into the material, giving appropriate attribution to the
+# authors.
+#
+# Permission to incorporate this software into commercial products may be
+# obtained by contacting USDA ARS and OREGON STATE UNIVERSITY Office for
+# Commercialization and Corporate Development.
+#
+# The software program and documentation are supplied "as is", without any
+# accompanying services from the USDA or the University. USDA ARS or the
+# University do not warrant that the operation of the program will be
+# uninterrupted or error-free. The end-user understands that the program was
+# developed for research purposes and is advised not to rely exclusively on the
+# program for any reason.
+#
+# IN NO EVENT SHALL USDA ARS OR OREGON STATE UNIVERSITY BE LIABLE TO ANY PARTY
+# FOR DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES, INCLUDING
+# LOST PROFITS, ARISING OUT OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION,
+# EVEN IF THE OREGON STATE UNIVERSITY HAS BEEN ADVISED OF THE POSSIBILITY OF
+# SUCH DAMAGE. USDA ARS OR OREGON STATE UNIVERSITY SPECIFICALLY DISCLAIMS ANY
+# WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+# MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE AND ANY STATUTORY
+# WARRANTY OF NON-INFRINGEMENT. THE SOFTWARE PROVIDED HEREUNDER IS ON AN "AS IS"
+# BASIS, AND USDA ARS AND OREGON STATE UNIVERSITY HAVE NO OBLIGATIONS TO PROVIDE
+# MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS.
+#
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+// Include openMP if the compiler supports it
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include <Rinternals.h>
+#include <R_ext/Utils.h>
+#include <R.h>
+#include "poppr_threads.h"
+
+/*
+Euclidean corrections from the extreme eigenvalues
+==================================================
+
+A distance matrix D is Euclidean if the double-centered matrix
+
+  B = -1/2 * J D^2 J,  where J = I - 11'/n
+
+is positive semi-definite. Checking this (ade4::is.euclid) and finding the
+Lingoes and Cailliez constants (ade4::lingoes, ade4::cailliez) only depends on
+the smallest and largest eigenvalues of B, which are found here with the
+Lanczos algorithm. B is never formed: each product with a vector is calculated
+from the condensed dist vector in O(n^2), so the whole calculation is
+O(n^2 * k) for k Lanczos steps instead of O(n^3).
+
+Since B1 = 0, the Lanczos vectors are kept orthogonal to 1 so that the trivial
+zero eigenvalue is never found.
+*/
+
+#define EUCLID_CHECK    0
+#define EUCLID_LINGOES  1
+#define EUCLID_CAILLIEZ 2
+
+SEXP euclid_constant(SEXP dist, SEXP method, SEXP tol, SEXP max_steps, SEXP requested_threads);
+static void euclid_matvec(double *dist, int n, double add, double *x, double *y, double *work, int num_threads);
+static int euclid_sturm(double *alpha, double *beta, int m, double x);
+static double euclid_tridiag_extreme(double *alpha, double *beta, int m, int largest);
+static double euclid_last_component(double *alpha, double *beta, int m, double theta, double *work);
+static size_t euclid_lanczos_size(int n, int max_steps, int num_threads);
+static int euclid_lanczos(double *dist, int n, double add, int max_steps, double tol, int num_threads, double *ws, double *lmin, double *lmax);
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+Multiply B = -1/2 * J (D + add)^2 J by a vector x that sums to zero. The
+constant add is applied to the off-diagonal elements only (see Cailliez 1983).
+
+The condensed distances are read one column at a time so that memory access is
+sequential. Each thread accumulates into its own copy of the result in work
+(n * num_threads elements).
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+static void euclid_matvec(double *dist, int n, double add, double *x, double *y, double *work, int num_threads)
+{
+  int i;
+  int j;
+  int t;
+  double mu = 0.0;
+
+  memset(work, 0, sizeof(double)*n*num_threads);
+  #ifdef _OPENMP
+  #pragma omp parallel for schedule(guided) num_threads(num_threads) private(i, j, t)
+  #endif
+  for (j = 0; j < n - 1; j++)
+  {
+    #ifdef _OPENMP
+    t = omp_get_thread_num();
+    #else
+    t = 0;
+    #endif
+    double* my_y = work + (size_t)t*n;
+    // dist[(i, j)] for i > j is at n*j - j*(j + 1)/2 + i - j - 1
+    double* col = dist + ((size_t)n*j - ((size_t)j*(j + 1))/2 - j - 1);
+    double xj = x[j];
+    double acc = 0.0;
+    double d2;
+    for (i = j + 1; i < n; i++)
+    {
+      d2 = col[i] + add;
+      d2 *= d2;
+      acc += d2*x[i];
+      my_y[i] += d2*xj;
+    }
+    my_y[j] += acc;
+  }
+  for (i = 0; i < n; i++)
+  {
+    y[i] = 0.0;
+    for (t = 0; t < num_threads; t++)
+    {
+      y[i] += work[(size_t)t*n + i];
+    }
+    mu += y[i];
+  }
+  mu /= n;
+  for (i = 0; i < n; i++)
+  {
+    y[i] = -0.5*(y[i] - mu);
+  }
+}
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+The number of eigenvalues less than x of the symmetric tridiagonal matrix with
+diagonal alpha (m) and off-diagonal beta (m - 1), from its Sturm sequence.
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+static int euclid_sturm(double *alpha, double *beta, int m, double x)
+{
+  int i;
+  int count = 0;
+  double q = alpha[0] - x;
+  for (i = 0; i < m; i++)
+  {
+    if (i > 0)
+    {
+      q = alpha[i] - x - beta[i - 1]*beta[i - 1]/q;
+    }
+    if (q == 0.0)
+    {
+      q = -DBL_EPSILON*(fabs(alpha[i]) + fabs(x) + DBL_MIN);
+    }
+    count += (q < 0.0);
+  }
+  return count;
+}
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+The smallest (largest = 0) or largest (largest = 1) eigenvalue of a symmetric
+tridiagonal matrix by bisection within its Gershgorin bounds.
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+static double euclid_tridiag_extreme(double *alpha, double *beta, int m, int largest)
+{
+  int i;
+  int it;
+  double lo = alpha[0];
+  double hi = alpha[0];
+  double r;
+  double mid;
+  for (i = 0; i < m; i++)
+  {
+    r = ((i > 0) ? fabs(beta[i - 1]) : 0.0) + ((i < m - 1) ? fabs(beta[i]) : 0.0);
+    lo = (alpha[i] - r < lo) ? alpha[i] - r : lo;
+    hi = (alpha[i] + r > hi) ? alpha[i] + r : hi;
+  }
+  for (it = 0; it < 200 && hi - lo > 2*DBL_EPSILON*(fabs(lo) + fabs(hi)); it++)
+  {
+    mid = 0.5*(lo + hi);
+    // For the smallest, look for the point where one eigenvalue is below.
+    // For the largest, look for the point where all of them are below.
+    if (euclid_sturm(alpha, beta, m, mid) >= (largest ? m : 1))
+    {
+      hi = mid;
+    }
+    else
+    {
+      lo = mid;
+    }
+  }
+  return 0.5*(lo + hi);
+}
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+The magnitude of the last element of the unit eigenvector of the tridiagonal
+matrix for the eigenvalue theta, by inverse iteration. Multiplied by the next
+Lanczos beta, this bounds the error of the Ritz value theta.
+
+work must have 4 * m elements.
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+static double euclid_last_component(double *alpha, double *beta, int m, double theta, double *work)
+{
+  int i;
+  int it;
+  double* y = work;
+  double* c = work + m;
+  double* d = work + 2*m;
+  double* b = work + 3*m;
+  double piv;
+  double norm;
+  double shift = theta + 1e-10*(fabs(theta) + 1e-300);
+
+  for (i = 0; i < m; i++)
+  {
+    b[i] = 1.0;
+  }
+  for (it = 0; it < 3; it++)
+  {
+    // Thomas algorithm for (T - shift*I) y = b
+    for (i = 0; i < m; i++)
+    {
+      piv = alpha[i] - shift - ((i > 0) ? beta[i - 1]*c[i - 1] : 0.0);
+      if (fabs(piv) < DBL_MIN)
+      {
+        piv = DBL_EPSILON;
+      }
+      c[i] = (i < m - 1) ? beta[i]/piv : 0.0;
+      d[i] = (b[i] - ((i > 0) ? beta[i - 1]*d[i - 1] : 0.0))/piv;
+    }
+    y[m - 1] = d[m - 1];
+    for (i = m - 2; i >= 0; i--)
+    {
+      y[i] = d[i] - c[i]*y[i + 1];
+    }
+    norm = 0.0;
+    for (i = 0; i < m; i++)
+    {
+      norm += y[i]*y[i];
+    }
+    norm = sqrt(norm);
+    for (i = 0; i < m; i++)
+    {
+      b[i] = y[i]/norm;
+    }
+  }
+  return fabs(b[m - 1]);
+}
+
+// The number of doubles of the workspace of euclid_lanczos()
+static size_t euclid_lanczos_size(int n, int max_steps, int num_threads)
+{
+  int steps = (max_steps < n - 1) ? max_steps : n - 1;
+  if (steps < 1)
+  {
+    return 1;
+  }
+  return (size_t)n*(steps + 1) + n + (size_t)n*num_threads + 6*(size_t)steps;
+}
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+Lanczos iteration with full reorthogonalization for the smallest and largest
+eigenvalues of B = -1/2 * J (D + add)^2 J on the space orthogonal to 1.
+
+The iteration stops when the error bound of the smallest Ritz value is below
+tol * |largest Ritz value|, when an invariant subspace is found (in which case
+the values are exact), or after max_steps steps. The start vector is fixed so
+that the results are reproducible and R's random number generator is not
+touched.
+
+The Lanczos vectors and all other buffers live in ws, which has
+euclid_lanczos_size() elements. It is allocated once by the caller with
+R_alloc(), so an interrupt between steps does not leak.
+
+Output: 1 if the values converged, 0 otherwise.
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+static int euclid_lanczos(double *dist, int n, double add, int max_steps, double tol, int num_threads, double *ws, double *lmin, double *lmax)
+{
+  int i;
+  int j;
+  int l;
+  int pass;
+  int converged = 0;
+  int steps = (max_steps < n - 1) ? max_steps : n - 1;
+  double* V;
+  double* w;
+  double* work;
+  double* alpha;
+  double* beta;
+  double* tri_work;
+  double mu;
+  double dot;
+  double norm;
+  double bound;
+  uint64_t z;
+  uint64_t seed = 0x5eed5eed5eedULL;
+
+  *lmin = 0.0;
+  *lmax = 0.0;
+  if (steps < 1)
+  {
+    return 1;
+  }
+  V        = ws;
+  w        = V + (size_t)n*(steps + 1);
+  work     = w + n;
+  alpha    = work + (size_t)n*num_threads;
+  beta     = alpha + steps;
+  tri_work = beta + steps;
+
+  // Centered, normalized start vector from splitmix64
+  mu = 0.0;
+  for (i = 0; i < n; i++)
+  {
+    seed += 0x9e3779b97f4a7c15ULL;
+    z = seed;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    z ^= z >> 31;
+    V[i] = (double)(z >> 11) * 0x1.0p-53 - 0.5;
+    mu += V[i];
+  }
+  mu /= n;
+  norm = 0.0;
+  for (i = 0; i < n; i++)
+  {
+    V[i] -= mu;
+    norm += V[i]*V[i];
+  }
+  norm = sqrt(norm);
+  for (i = 0; i < n; i++)
+  {
+    V[i] /= norm;
+  }
+
+  for (j = 0; j < steps; j++)
+  {
+    double* v = V + (size_t)j*n;
+    R_CheckUserInterrupt();
+    euclid_matvec(dist, n, add, v, w, work, num_threads);
+    dot = 0.0;
+    for (i = 0; i < n; i++)
+    {
+      dot += v[i]*w[i];
+    }
+    alpha[j] = dot;
+    // Full reorthogonalization (twice is enough) against all previous
+    // vectors and against 1.
+    for (pass = 0; pass < 2; pass++)
+    {
+      for (l = 0; l <= j; l++)
+      {
+        double* u = V + (size_t)l*n;
+        dot = 0.0;
+        for (i = 0; i < n; i++)
+        {
+          dot += u[i]*w[i];
+        }
+        for (i = 0; i < n; i++)
+        {
+          w[i] -= dot*u[i];
+        }
+      }
+      mu = 0.0;
+      for (i = 0; i < n; i++)
+      {
+        mu += w[i];
+      }
+      mu /= n;
+      for (i = 0; i < n; i++)
+      {
+        w[i] -= mu;
+      }
+    }
+    norm = 0.0;
+    for (i = 0; i < n; i++)
+    {
+      norm += w[i]*w[i];
+    }
+    beta[j] = sqrt(norm);
+    *lmin = euclid_tridiag_extreme(alpha, beta, j + 1, 0);
+    *lmax = euclid_tridiag_extreme(alpha, beta, j + 1, 1);
+    if (beta[j] <= DBL_EPSILON*(fabs(*lmin) + fabs(*lmax)) || j == n - 2)
+    {
+      // Invariant subspace: the Ritz values are eigenvalues.
+      converged = 1;
+      break;
+    }
+    if (j >= 4)
+    {
+      bound = beta[j]*euclid_last_component(alpha, beta, j + 1, *lmin, tri_work);
+      if (bound <= tol*fabs(*lmax))
+      {
+        converged = 1;
+        break;
+      }
+    }
+    for (i = 0; i < n; i++)
+    {
+      V[(size_t)(j + 1)*n + i] = w[i]/beta[j];
+    }
+  }
+  return converged;
+}
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+Check if a distance matrix is Euclidean and find the constant needed to make it
+Euclidean.
+
+  - Euclidean: the smallest eigenvalue of B relative to the largest is greater
+    than -tol (as ade4::is.euclid).
+  - Lingoes: the constant is the absolute value of the smallest eigenvalue of
+    B. The corrected distances are sqrt(d^2 + 2 * constant).
+  - Cailliez: the constant c is the smallest value so that D + c (off the
+    diagonal) is Euclidean. Instead of the eigenvalues of the 2n x 2n matrix
+    used by ade4::cailliez, the smallest eigenvalue of B(c) is driven to zero
+    with the Illinois variant of regula falsi, which only needs the extreme
+    eigenvalues at each step.
+
+Input: dist      - a condensed dist vector (not squared).
+       method    - 0 (only check), 1 (Lingoes), or 2 (Cailliez)
+       tol       - the tolerance used to declare the distances Euclidean
+       max_steps - the maximum number of Lanczos steps
+       requested_threads - number of threads (0 = all available)
+Output: A list with elements
+       euclid    - TRUE if the distances are Euclidean
+       lambda    - the smallest and largest eigenvalues of B
+       constant  - the correction constant (0 if Euclidean or method = 0)
+       converged - FALSE if any Lanczos iteration hit max_steps
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+SEXP euclid_constant(SEXP dist, SEXP method, SEXP tol, SEXP max_steps, SEXP requested_threads)
+{
+  SEXP Rout;
+  SEXP Rnames;
+  SEXP R_lambda;
+  int n;
+  int it;
+  int side = 0;
+  int num_threads;
+  int steps = asInteger(max_steps);
+  int how = asInteger(method);
+  int converged;
+  int is_euclid;
+  double eps = asReal(tol);
+  double lmin;
+  double lmax;
+  double lo;
+  double hi;
+  double flo;
+  double fhi;
+  double c;
+  double fc;
+  double cmax;
+  double constant = 0.0;
+  double* ws;
+
+  n = (int)((1 + sqrt(1 + 8*(double)XLENGTH(dist)))/2);
+  if ((R_xlen_t)n*(n - 1)/2 != XLENGTH(dist))
+  {
+    error("dist must be a condensed distance matrix");
+  }
+
+  num_threads = poppr_threads(requested_threads);
+  ws = (double*)R_alloc(euclid_lanczos_size(n, steps, num_threads), sizeof(double));
+
+  converged = euclid_lanczos(REAL(dist), n, 0.0, steps, eps, num_threads, ws, &lmin, &lmax);
+  is_euclid = (lmax <= 0.0) ? lmin >= 0.0 : lmin/lmax > -eps;
+
+  if (!is_euclid && how == EUCLID_LINGOES)
+  {
+    constant = fabs(lmin);
+  }
+  else if (!is_euclid && how == EUCLID_CAILLIEZ)
+  {
+    // Bracket the root of lambda_min(c). Adding c to every distance makes
+    // any matrix Euclidean once c is large enough.
+    cmax = 0.0;
+    for (R_xlen_t i = 0; i < XLENGTH(dist); i++)
+    {
+      cmax = (REAL(dist)[i] > cmax) ? REAL(dist)[i] : cmax;
+    }
+    lo  = 0.0;
+    flo = lmin;
+    hi  = sqrt(2*fabs(lmin));
+    hi  = (hi > 0.0) ? hi : 1.0;
+    converged &= euclid_lanczos(REAL(dist), n, hi, steps, eps, num_threads, ws, &fhi, &c);
+    for (it = 0; fhi < 0.0 && it < 64; it++)
+    {
+      lo  = hi;
+      flo = fhi;
+      hi  = 2*hi + cmax;
+      converged &= euclid_lanczos(REAL(dist), n, hi, steps, eps, num_threads, ws, &fhi, &c);
+    }
+    // Illinois
+    for (it = 0; it < 100 && hi - lo > 1e-12*hi; it++)
+    {
+      c = (lo*fhi - hi*flo)/(fhi - flo);
+      if (!(c > lo && c < hi))
+      {
+        c = 0.5*(lo + hi);
+      }
+      converged &= euclid_lanczos(REAL(dist), n, c, steps, eps, num_threads, ws, &fc, &cmax);
+      if (fc < 0.0)
+      {
+        lo  = c;
+        flo = fc;
+        if (side == -1)
+        {
+          fhi *= 0.5;
+        }
+        side = -1;
+      }
+      else
+      {
+        hi  = c;
+        fhi = fc;
+        if (side == 1)
+        {
+          flo *= 0.5;
+        }
+        side = 1;
+      }
+      if (fc == 0.0)
+      {
+        break;
+      }
+    }
+    constant = hi;
+  }
+
+  PROTECT(Rout = allocVector(VECSXP, 4));
+  PROTECT(Rnames = allocVector(STRSXP, 4));
+  PROTECT(R_lambda = allocVector(REALSXP, 2));
+  REAL(R_lambda)[0] = lmin;
+  REAL(R_lambda)[1] = lmax;
+  SET_VECTOR_ELT(Rout, 0, ScalarLogical(is_euclid));
+  SET_VECTOR_ELT(Rout, 1, R_lambda);
+  SET_VECTOR_ELT(Rout, 2, ScalarReal(constant));
+  SET_VECTOR_ELT(Rout, 3, ScalarLogical(converged));
+  SET_STRING_ELT(Rnames, 0, mkChar("euclid"));
+  SET_STRING_ELT(Rnames, 1, mkChar("lambda"));
+  SET_STRING_ELT(Rnames, 2, mkChar("constant"));
+  SET_STRING_ELT(Rnames, 3, mkChar("converged"));
+  setAttrib(Rout, R_NamesSymbol, Rnames);
+  UNPROTECT(3);
+  return Rout;
+}
@@ -0,0 +1,760 @@
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+#
+# This software was authored by Zhian N. Kamvar and Javier F. Tabima, graduate
+# students at Oregon State University; Jonah C. Brooks, undergraduate student at
+# Oregon State University; and Dr. Nik Grünwald, an employee of USDA-ARS.
+#
+# Permission to use, copy, modify, and distribute this software and its
+# documentation for educational, research and non-profit purposes, without fee,
+# and without a written agreement is hereby granted, provided that the statement
+# above is incorporated into the material, giving appropriate attribution to the
+# authors.
+#
+# Permission to incorporate this software into commercial products may be
+# obtained by contacting USDA ARS and OREGON STATE UNIVERSITY Office for
+# Commercialization and Corporate Development.
+#
+# The software program and documentation are supplied "as is", without any
+# accompanying services from the USDA or the University. USDA ARS or the
+# University do not warrant that the operation of the program will be
+# uninterrupted or error-free. The end-user understands that the program was
+# developed for research purposes and is advised not to rely exclusively on the
+# program for any reason.
+#
+# IN NO EVENT SHALL USDA ARS OR OREGON STATE UNIVERSITY BE LIABLE TO ANY PARTY
+# FOR DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES, INCLUDING
+# LOST PROFITS, ARISING OUT OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION,
+# EVEN IF THE OREGON STATE UNIVERSITY HAS BEEN ADVISED OF THE POSSIBILITY OF
+# SUCH DAMAGE. USDA ARS OR OREGON STATE UNIVERSITY SPECIFICALLY DISCLAIMS ANY
+# WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+# MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE AND ANY STATUTORY
+# WARRANTY OF NON-INFRINGEMENT. THE SOFTWARE PROVIDED HEREUNDER IS ON AN "AS IS"
+# BASIS, AND USDA ARS AND OREGON STATE UNIVERSITY HAVE NO OBLIGATIONS TO PROVIDE
+# MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS.
+#
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <Rinternals.h>
+#include <R.h>
+
+/*
+GenAlEx files
+=============
+
+GenAlEx files are delimited text files with two lines of information on the
+number of loci, samples, and populations followed by a table with a header
+line. The table is read in a single pass into one factor per column: the
+fields are trimmed, empty fields and "NA" are missing, and each distinct value
+of a column becomes a level in order of appearance. This means that there is
+only one string per distinct value in each column instead of one per cell.
+
+The allele counts of the genotypes are then tabulated from the factor codes,
+and genotypes are formatted for writing directly from the allele counts.
+*/
+
+SEXP genalex_tokenize(SEXP source, SEXP is_file, SEXP sep, SEXP skip);
+SEXP genalex_tab(SEXP columns, SEXP ploidy, SEXP pa);
+SEXP genalex_rows(SEXP tab, SEXP loc_fac, SEXP alleles, SEXP maxploid, SEXP pa, SEXP sep);
+
+typedef struct {
+  const char *str;
+  int len;
+} field;
+
+// The levels of one column with an open addressing hash table. The tables are
+// allocated with R_alloc so that nothing leaks if R signals an error.
+typedef struct {
+  field *lev;
+  int nlev;
+  int levcap;
+  int *slot;
+  int slotcap;
+} level_table;
+
+static uint64_t field_hash(const char *s, int len)
+{
+  int i;
+  uint64_t h = 14695981039346656037ULL;
+  for (i = 0; i < len; i++)
+  {
+    h ^= (unsigned char)s[i];
+    h *= 1099511628211ULL;
+  }
+  return h;
+}
+
+static void level_table_grow(level_table *lt)
+{
+  int i;
+  int j;
+  int cap = (lt->slotcap == 0) ? 16 : lt->slotcap*2;
+  lt->slot    = (int*)R_alloc(cap, sizeof(int));
+  lt->slotcap = cap;
+  for (i = 0; i < cap; i++)
+  {
+    lt->slot[i] = -1;
+  }
+  for (i = 0; i < lt->nlev; i++)
+  {
+    j = (int)(field_hash(lt->lev[i].str, lt->lev[i].len) & (uint64_t)(cap - 1));
+    while (lt->slot[j] >= 0)
+    {
+      j = (j + 1) & (cap - 1);
+    }
+    lt->slot[j] = i;
+  }
+}
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+Returns the 1-based level of a field, adding it if it has not been seen.
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+static int level_table_code(level_table *lt, field f)
+{
+  int j;
+  if (2*(lt->nlev + 1) > lt->slotcap)
+  {
+    level_table_grow(lt);
+  }
+  j = (int)(field_hash(f.str, f.len) & (uint64_t)(lt->slotcap - 1));
+  while (lt->slot[j] >= 0)
+  {
+    field g = lt->lev[lt->slot[j]];
+    if (g.len == f.len && memcmp(g.str, f.str, f.len) == 0)
+    {
+      return lt->slot[j] + 1;
+    }
+    j = (j + 1) & (lt->slotcap - 1);
+  }
+  if (lt->nlev == lt->levcap)
+  {
+    field *lev = lt->lev;
+    lt->levcap = (lt->levcap == 0) ? 16 : lt->levcap*2;
+    lt->lev    = (field*)R_alloc(lt->levcap, sizeof(field));
+    if (lt->nlev > 0)
+    {
+      memcpy(lt->lev, lev, lt->nlev*sizeof(field));
+    }
+  }
+  lt->lev[lt->nlev] = f;
+  lt->slot[j] = lt->nlev;
+  return ++lt->nlev;
+}
+
+static int is_blank(char c)
+{
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+Reads the next field of a line starting at *pos and moves *pos past the
+separator. Quoted fields may contain the separator and doubled quotes, which
+are unescaped in place if unescape is TRUE (otherwise the field is only
+skipped). The field is trimmed of white space.
+
+Output: 1 if the field ends the line
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+static int next_field(char *buf, size_t *pos, size_t end, char sep, 
+                      int unescape, field *f)
+{
+  size_t i = *pos;
+  size_t out;
+  size_t start;
+  int last;
+  while (i < end && buf[i] != sep && is_blank(buf[i]) && buf[i] != '\n')
+  {
+    i++;
+  }
+  start = i;
+  out   = i;
+  if (i < end && buf[i] == '"')
+  {
+    i++;
+    while (i < end)
+    {
+      if (buf[i] == '"')
+      {
+        if (i + 1 < end && buf[i + 1] == '"')
+        {
+          i++;
+        }
+        else
+        {
+          i++;
+          break;
+        }
+      }
+      if (unescape)
+      {
+        buf[out] = buf[i];
+      }
+      out++;
+      i++;
+    }
+  }
+  while (i < end && buf[i] != sep && buf[i] != '\n')
+  {
+    if (unescape)
+    {
+      buf[out] = buf[i];
+    }
+    out++;
+    i++;
+  }
+  last = i >= end || buf[i] == '\n';
+  *pos = (i < end) ? i + 1 : i;
+  while (out > start && is_blank(buf[out - 1]))
+  {
+    out--;
+  }
+  f->str = buf + start;
+  f->len = (int)(out - start);
+  return last;
+}
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+Reads the table of a GenAlEx file into factors.
+
+Input: source  - a file name (is_file = TRUE) or a single string of text
+       is_file - TRUE if source is a file name
+       sep     - the field separator (a single character)
+       skip    - the number of lines to skip before the header line
+Output: A list with
+          names   - the trimmed fields of the header line
+          columns - a list of factors, one per column. Rows with fewer fields
+                    than the widest row are padded with NA. Empty lines are
+                    skipped.
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+SEXP genalex_tokenize(SEXP source, SEXP is_file, SEXP sep, SEXP skip)
+{
+  SEXP Rout;
+  SEXP Rnames;
+  SEXP Rcols;
+  SEXP Rlist_names;
+  char *buf;
+  char s;
+  size_t size;
+  size_t pos;
+  size_t line;
+  int nskip;
+  int nrow = 0;
+  int ncol = 0;
+  int nfield;
+  int row;
+  int c;
+  int i;
+  int last;
+  field f;
+  level_table *lt;
+
+  s     = CHAR(STRING_ELT(sep, 0))[0];
+  nskip = asInteger(skip);
+  if (asLogical(is_file))
+  {
+    const char *path = R_ExpandFileName(CHAR(STRING_ELT(source, 0)));
+    FILE *fp = fopen(path, "rb");
+    long fsize;
+    if (fp == NULL)
+    {
+      error("cannot open file '%s'", path);
+    }
+    if (fseek(fp, 0, SEEK_END) != 0 || (fsize = ftell(fp)) < 0)
+    {
+      fclose(fp);
+      error("cannot determine the size of '%s'", path);
+    }
+    rewind(fp);
+    size = (size_t)fsize;
+    buf  = R_alloc(size + 1, sizeof(char));
+    if (fread(buf, 1, size, fp) != size)
+    {
+      fclose(fp);
+      error("cannot read file '%s'", path);
+    }
+    fclose(fp);
+  }
+  else
+  {
+    const char *text = CHAR(STRING_ELT(source, 0));
+    size = strlen(text);
+    buf  = R_alloc(size + 1, sizeof(char));
+    memcpy(buf, text, size);
+  }
+  buf[size] = '\0';
+
+  // Skip the information lines
+  pos = 0;
+  for (i = 0; i < nskip && pos < size; i++)
+  {
+    while (pos < size && buf[pos] != '\n')
+    {
+      pos++;
+    }
+    pos += pos < size;
+  }
+  // First pass: the number of rows (including the header) and columns
+  for (line = pos; line < size; )
+  {
+    if (buf[line] == '\n' || (buf[line] == '\r' && line + 1 < size && buf[line + 1] == '\n'))
+    {
+      line += (buf[line] == '\r') ? 2 : 1;
+      continue;
+    }
+    nfield = 0;
+    do
+    {
+      last = next_field(buf, &line, size, s, 0, &f);
+      nfield++;
+    } while (!last);
+    ncol = (nfield > ncol) ? nfield : ncol;
+    nrow++;
+  }
+  nrow = (nrow > 0) ? nrow - 1 : 0;
+
+  PROTECT(Rout  = allocVector(VECSXP, 2));
+  PROTECT(Rnames = allocVector(STRSXP, ncol));
+  PROTECT(Rcols  = allocVector(VECSXP, ncol));
+  lt = (level_table*)R_alloc(ncol + 1, sizeof(level_table));
+  for (c = 0; c < ncol; c++)
+  {
+    SEXP Rcol = allocVector(INTSXP, nrow);
+    SET_VECTOR_ELT(Rcols, c, Rcol);
+    for (i = 0; i < nrow; i++)
+    {
+      INTEGER(Rcol)[i] = NA_INTEGER;
+    }
+    SET_STRING_ELT(Rnames, c, mkChar(""));
+    lt[c].lev     = NULL;
+    lt[c].nlev    = 0;
+    lt[c].levcap  = 0;
+    lt[c].slot    = NULL;
+    lt[c].slotcap = 0;
+  }
+  // Second pass: the header and the factor codes
+  row = -1;
+  for (line = pos; line < size; )
+  {
+    if (buf[line] == '\n' || (buf[line] == '\r' && line + 1 < size && buf[line + 1] == '\n'))
+    {
+      line += (buf[line] == '\r') ? 2 : 1;
+      continue;
+    }
+    c = 0;
+    do
+    {
+      last = next_field(buf, &line, size, s, 1, &f);
+      if (row < 0)
+      {
+        SET_STRING_ELT(Rnames, c, mkCharLenCE(f.str, f.len, CE_NATIVE));
+      }
+      else if (f.len > 0 && !(f.len == 2 && f.str[0] == 'N' && f.str[1] == 'A'))
+      {
+        INTEGER(VECTOR_ELT(Rcols, c))[row] = level_table_code(lt + c, f);
+      }
+      c++;
+    } while (!last);
+    row++;
+  }
+  for (c = 0; c < ncol; c++)
+  {
+    SEXP Rcol = VECTOR_ELT(Rcols, c);
+    SEXP Rlev = PROTECT(allocVector(STRSXP, lt[c].nlev));
+    for (i = 0; i < lt[c].nlev; i++)
+    {
+      SET_STRING_ELT(Rlev, i, mkCharLenCE(lt[c].lev[i].str, lt[c].lev[i].len, CE_NATIVE));
+    }
+    setAttrib(Rcol, R_LevelsSymbol, Rlev);
+    setAttrib(Rcol, R_ClassSymbol, mkString("factor"));
+    UNPROTECT(1);
+  }
+  PROTECT(Rlist_names = allocVector(STRSXP, 2));
+  SET_STRING_ELT(Rlist_names, 0, mkChar("names"));
+  SET_STRING_ELT(Rlist_names, 1, mkChar("columns"));
+  SET_VECTOR_ELT(Rout, 0, Rnames);
+  SET_VECTOR_ELT(Rout, 1, Rcols);
+  setAttrib(Rout, R_NamesSymbol, Rlist_names);
+  UNPROTECT(4);
+  return Rout;
+}
+
+static int same_string(SEXP a, SEXP b)
+{
+  return a == b || strcmp(CHAR(a), CHAR(b)) == 0;
+}
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+Tabulates the alleles of GenAlEx genotype columns.
+
+For codominant data, each locus is ploidy adjacent columns. A genotype is
+missing if all of its alleles are "0" or missing; otherwise, missing alleles
+are counted as the allele "0" (the placeholder of polyploid genotypes). The
+alleles of each locus are numbered as df2genind() numbers them: in order of
+their first appearance, sample by sample and from left to right within each
+genotype.
+
+For presence/absence data, each column is a locus with the values 1, 0, or -1
+(missing).
+
+Input: columns - a list of factors (see genalex_tokenize)
+       ploidy  - the number of columns per locus
+       pa      - TRUE for presence/absence data
+Output: A list with
+          tab    - an integer matrix of allele counts with NA for missing data
+          locus  - the locus (1-based) of each column of tab
+          allele - the allele of each column of tab
+          scored - TRUE for samples with at least one genotype
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+SEXP genalex_tab(SEXP columns, SEXP ploidy, SEXP pa)
+{
+  SEXP Rout;
+  SEXP Rnames;
+  SEXP Rtab;
+  SEXP Rlocus;
+  SEXP Rallele;
+  SEXP Rscored;
+  SEXP zero_string;
+  int n;
+  int p;
+  int ncol;
+  int nloc;
+  int is_pa;
+  int total = 0;
+  int nlev_total = 0;
+  int l;
+  int c;
+  int i;
+  int a;
+  int k;
+  int* tab;
+  int* codes;
+  int* scored;
+  int* nall;
+  int* first;
+  int* zero_allele;
+  int** map;
+  int** zero;
+  SEXP* alleles;
+  const char* names[4] = {"tab", "locus", "allele", "scored"};
+
+  p     = asInteger(ploidy);
+  is_pa = asLogical(pa);
+  ncol  = length(columns);
+  n     = (ncol > 0) ? length(VECTOR_ELT(columns, 0)) : 0;
+  if (p < 1 || ncol % p != 0)
+  {
+    error("the number of columns must be a multiple of the ploidy");
+  }
+  p    = (is_pa) ? 1 : p;
+  nloc = ncol / p;
+  PROTECT(zero_string = mkChar("0"));
+
+  // For each column, the allele of each level (map) and whether the level is
+  // "0" (zero). For each locus, its first column in tab, its number of
+  // alleles, and the allele representing "0".
+  map         = (int**)R_alloc(ncol + 1, sizeof(int*));
+  zero        = (int**)R_alloc(ncol + 1, sizeof(int*));
+  first       = (int*)R_alloc(nloc + 1, sizeof(int));
+  nall        = (int*)R_alloc(nloc + 1, sizeof(int));
+  zero_allele = (int*)R_alloc(nloc + 1, sizeof(int));
+  scored      = (int*)R_alloc(n + 1, sizeof(int));
+  for (i = 0; i < n; i++)
+  {
+    scored[i] = 0;
+  }
+  for (c = 0; c < ncol; c++)
+  {
+    SEXP Rlev = getAttrib(VECTOR_ELT(columns, c), R_LevelsSymbol);
+    int nlev  = length(Rlev);
+    if (length(VECTOR_ELT(columns, c)) != n)
+    {
+      error("all columns must have the same length");
+    }
+    map[c]  = (int*)R_alloc(nlev + 1, sizeof(int));
+    zero[c] = (int*)R_alloc(nlev + 1, sizeof(int));
+    for (k = 0; k < nlev; k++)
+    {
+      map[c][k]  = -1;
+      zero[c][k] = same_string(STRING_ELT(Rlev, k), zero_string);
+    }
+    nlev_total += nlev + 1;
+  }
+  // At most one allele per level and one for "0" in each column
+  alleles = (SEXP*)R_alloc(nlev_total + 1, sizeof(SEXP));
+
+  // First pass: the alleles of each locus in order of appearance
+  for (l = 0; l < nloc; l++)
+  {
+    first[l]       = total;
+    nall[l]        = (is_pa) ? 1 : 0;
+    zero_allele[l] = -1;
+    if (is_pa)
+    {
+      alleles[total++] = zero_string;
+      codes = INTEGER(VECTOR_ELT(columns, l));
+      for (i = 0; i < n; i++)
+      {
+        SEXP Rlev = getAttrib(VECTOR_ELT(columns, l), R_LevelsSymbol);
+        scored[i] |= codes[i] != NA_INTEGER && 
+                     strcmp(CHAR(STRING_ELT(Rlev, codes[i] - 1)), "-1") != 0;
+      }
+      continue;
+    }
+    for (i = 0; i < n; i++)
+    {
+      int missing = 1;
+      for (c = l*p; c < (l + 1)*p; c++)
+      {
+        k = INTEGER(VECTOR_ELT(columns, c))[i];
+        missing &= k == NA_INTEGER || zero[c][k - 1];
+      }
+      if (missing)
+      {
+        continue;
+      }
+      scored[i] = 1;
+      for (c = l*p; c < (l + 1)*p; c++)
+      {
+        SEXP Rlev;
+        k = INTEGER(VECTOR_ELT(columns, c))[i];
+        if (k == NA_INTEGER || zero[c][k - 1])
+        {
+          if (zero_allele[l] < 0)
+          {
+            zero_allele[l] = nall[l];
+            alleles[first[l] + nall[l]++] = zero_string;
+          }
+          continue;
+        }
+        if (map[c][k - 1] >= 0)
+        {
+          continue;
+        }
+        Rlev = STRING_ELT(getAttrib(VECTOR_ELT(columns, c), R_LevelsSymbol), k - 1);
+        for (a = 0; a < nall[l]; a++)
+        {
+          if (same_string(alleles[first[l] + a], Rlev))
+          {
+            break;
+          }
+        }
+        if (a == nall[l])
+        {
+          alleles[first[l] + nall[l]++] = Rlev;
+        }
+        map[c][k - 1] = a;
+      }
+    }
+    total += nall[l];
+  }
+
+  PROTECT(Rtab    = allocMatrix(INTSXP, n, total));
+  PROTECT(Rlocus  = allocVector(INTSXP, total));
+  PROTECT(Rallele = allocVector(STRSXP, total));
+  PROTECT(Rscored = allocVector(LGLSXP, n));
+  tab = INTEGER(Rtab);
+  for (l = 0; l < nloc; l++)
+  {
+    for (a = first[l]; a < first[l] + nall[l]; a++)
+    {
+      INTEGER(Rlocus)[a] = l + 1;
+      SET_STRING_ELT(Rallele, a, alleles[a]);
+    }
+  }
+  for (i = 0; i < n; i++)
+  {
+    LOGICAL(Rscored)[i] = scored[i];
+  }
+
+  // Second pass: the allele counts
+  for (l = 0; l < nloc; l++)
+  {
+    int* out = tab + (size_t)first[l]*n;
+    if (is_pa)
+    {
+      SEXP Rlev = getAttrib(VECTOR_ELT(columns, l), R_LevelsSymbol);
+      codes = INTEGER(VECTOR_ELT(columns, l));
+      for (i = 0; i < n; i++)
+      {
+        if (codes[i] == NA_INTEGER)
+        {
+          out[i] = NA_INTEGER;
+        }
+        else
+        {
+          out[i] = atoi(CHAR(STRING_ELT(Rlev, codes[i] - 1)));
+          out[i] = (out[i] < 0) ? NA_INTEGER : out[i];
+        }
+      }
+      continue;
+    }
+    for (i = 0; i < n; i++)
+    {
+      int missing = 1;
+      for (c = l*p; c < (l + 1)*p; c++)
+      {
+        k = INTEGER(VECTOR_ELT(columns, c))[i];
+        missing &= k == NA_INTEGER || zero[c][k - 1];
+      }
+      for (a = 0; a < nall[l]; a++)
+      {
+        out[i + (size_t)a*n] = (missing) ? NA_INTEGER : 0;
+      }
+      if (missing)
+      {
+        continue;
+      }
+      for (c = l*p; c < (l + 1)*p; c++)
+      {
+        k = INTEGER(VECTOR_ELT(columns, c))[i];
+        a = (k == NA_INTEGER || zero[c][k - 1]) ? zero_allele[l] : map[c][k - 1];
+        out[i + (size_t)a*n]++;
+      }
+    }
+  }
+
+  PROTECT(Rout   = allocVector(VECSXP, 4));
+  PROTECT(Rnames = allocVector(STRSXP, 4));
+  SET_VECTOR_ELT(Rout, 0, Rtab);
+  SET_VECTOR_ELT(Rout, 1, Rlocus);
+  SET_VECTOR_ELT(Rout, 2, Rallele);
+  SET_VECTOR_ELT(Rout, 3, Rscored);
+  for (i = 0; i < 4; i++)
+  {
+    SET_STRING_ELT(Rnames, i, mkChar(names[i]));
+  }
+  setAttrib(Rout, R_NamesSymbol, Rnames);
+  UNPROTECT(7);
+  return Rout;
+}
+
+typedef struct {
+  char *s;
+  size_t len;
+  size_t cap;
+} line_buffer;
+
+static void line_append(line_buffer *b, const char *s, size_t len)
+{
+  if (b->len + len + 1 > b->cap)
+  {
+    b->cap = 2*(b->len + len + 1);
+    b->s   = R_Realloc(b->s, b->cap, char);
+  }
+  memcpy(b->s + b->len, s, len);
+  b->len += len;
+}
+
+static void line_cell(line_buffer *b, const char *s, char sep)
+{
+  if (b->len > 0)
+  {
+    line_append(b, &sep, 1);
+  }
+  line_append(b, s, strlen(s));
+}
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+Formats the genotypes of each sample as GenAlEx allele columns.
+
+Codominant genotypes are written as maxploid columns per locus with the
+alleles in the order of the columns of tab, padded in front with "0" for
+genotypes of lower ploidy. Missing genotypes are written as "0". Presence/
+absence data are written as one column per locus with -1 for missing data.
+
+Input: tab      - an n x m matrix of allele counts
+       loc_fac  - the locus (1-based) of each column of tab (contiguous)
+       alleles  - the allele of each column of tab
+       maxploid - the number of columns per locus
+       pa       - TRUE for presence/absence data
+       sep      - the field separator
+Output: a character vector with the allele columns of each sample
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+SEXP genalex_rows(SEXP tab, SEXP loc_fac, SEXP alleles, SEXP maxploid, SEXP pa, SEXP sep)
+{
+  SEXP Rout;
+  SEXP Rdim;
+  int n;
+  int m;
+  int p;
+  int nloc;
+  int is_pa;
+  int i;
+  int l;
+  int a;
+  int k;
+  int* start;
+  int* locus;
+  int* X;
+  char s;
+  char number[32];
+  line_buffer b = {NULL, 0, 0};
+
+  Rdim  = getAttrib(tab, R_DimSymbol);
+  n     = INTEGER(Rdim)[0];
+  m     = INTEGER(Rdim)[1];
+  p     = asInteger(maxploid);
+  is_pa = asLogical(pa);
+  s     = CHAR(STRING_ELT(sep, 0))[0];
+  locus = INTEGER(loc_fac);
+  if (length(loc_fac) != m || length(alleles) != m)
+  {
+    error("the locus factor and alleles do not match the data");
+  }
+  nloc  = (m > 0) ? locus[m - 1] : 0;
+  start = (int*)R_alloc(nloc + 1, sizeof(int));
+  start[0] = 0;
+  for (a = 1; a < m; a++)
+  {
+    if (locus[a] != locus[a - 1])
+    {
+      start[locus[a] - 1] = a;
+    }
+  }
+  start[nloc] = m;
+
+  PROTECT(tab  = coerceVector(tab, INTSXP));
+  PROTECT(Rout = allocVector(STRSXP, n));
+  X = INTEGER(tab);
+  for (i = 0; i < n; i++)
+  {
+    b.len = 0;
+    for (l = 0; l < nloc; l++)
+    {
+      int missing = X[i + (size_t)start[l]*n] == NA_INTEGER;
+      int count   = 0;
+      if (is_pa)
+      {
+        snprintf(number, sizeof(number), "%d", (missing) ? -1 : X[i + (size_t)start[l]*n]);
+        line_cell(&b, number, s);
+        continue;
+      }
+      if (!missing)
+      {
+        for (a = start[l]; a < start[l + 1]; a++)
+        {
+          count += X[i + (size_t)a*n];
+        }
+      }
+      for (k = count; k < p; k++)
+      {
+        line_cell(&b, "0", s);
+      }
+      if (missing)
+      {
+        continue;
+      }
+      for (a = start[l]; a < start[l + 1]; a++)
+      {
+        for (k = 0; k < X[i + (size_t)a*n]; k++)
+        {
+          line_cell(&b, CHAR(STRING_ELT(alleles, a)), s);
+        }
+      }
+    }
+    SET_STRING_ELT(Rout, i, mkCharLenCE((b.len > 0) ? b.s : "", (int)b.len, CE_NATIVE));
+  }
+  R_Free(b.s);
+  UNPROTECT(2);
+  return Rout;
+}
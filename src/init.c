@@ -8,44 +8,96 @@
 */
 
 /* .Call calls */
-extern SEXP adjust_missing(SEXP, SEXP);
-extern SEXP association_index_diploid(SEXP, SEXP, SEXP, SEXP);
-extern SEXP association_index_haploid(SEXP, SEXP, SEXP);
-extern SEXP bitwise_distance_diploid(SEXP, SEXP, SEXP, SEXP, SEXP);
-extern SEXP bitwise_distance_haploid(SEXP, SEXP, SEXP);
+extern SEXP adjust_missing(SEXP, SEXP, SEXP);
+extern SEXP amova_native(SEXP, SEXP, SEXP, SEXP, SEXP);
+extern SEXP amova_native_tab(SEXP, SEXP, SEXP, SEXP, SEXP, SEXP);
+extern SEXP association_index_diploid(SEXP, SEXP, SEXP, SEXP, SEXP);
+extern SEXP association_index_haploid(SEXP, SEXP, SEXP, SEXP);
+extern SEXP bitwise_distance_diploid(SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP);
+extern SEXP bitwise_distance_haploid(SEXP, SEXP, SEXP, SEXP, SEXP);
 extern SEXP bruvo_distance(SEXP, SEXP, SEXP, SEXP, SEXP, SEXP);
 extern SEXP bruvo_between(SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP);
+extern SEXP diss_distance(SEXP, SEXP, SEXP, SEXP, SEXP, SEXP);
+extern SEXP diversity_bootstrap(SEXP, SEXP, SEXP, SEXP, SEXP);
+extern SEXP euclid_constant(SEXP, SEXP, SEXP, SEXP, SEXP);
 extern SEXP expand_indices(SEXP, SEXP);
+extern SEXP genalex_rows(SEXP, SEXP, SEXP, SEXP, SEXP, SEXP);
+extern SEXP genalex_tab(SEXP, SEXP, SEXP);
+extern SEXP genalex_tokenize(SEXP, SEXP, SEXP, SEXP);
 extern SEXP genotype_curve_internal(SEXP, SEXP, SEXP, SEXP);
 extern SEXP get_pgen_matrix_genind(SEXP, SEXP, SEXP, SEXP);
+extern SEXP locus_qc(SEXP, SEXP, SEXP, SEXP);
+extern SEXP locus_summary(SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP);
 extern SEXP mlg_round_robin(SEXP);
 extern SEXP msn_tied_edges(SEXP, SEXP, SEXP);
 extern SEXP neighbor_clustering(SEXP, SEXP, SEXP, SEXP, SEXP);
 extern SEXP omp_test();
 extern SEXP pairdiffs(SEXP);
 extern SEXP pairwise_covar(SEXP);
-extern SEXP permute_shuff(SEXP, SEXP, SEXP);
 extern SEXP permuto(SEXP);
+extern SEXP pop_distance(SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP);
+extern SEXP poppr_file_close(SEXP);
+extern SEXP poppr_file_index(SEXP);
+extern SEXP poppr_file_open(SEXP);
+extern SEXP poppr_file_section(SEXP, SEXP, SEXP, SEXP);
+extern SEXP poppr_file_write(SEXP, SEXP);
+extern SEXP poppr_hash(SEXP);
+extern SEXP poppr_memory_info();
+extern SEXP poppr_thread_info();
+extern SEXP population_summary(SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP);
+extern SEXP private_allele_table(SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP);
+extern SEXP rarefaction_curve(SEXP, SEXP, SEXP, SEXP);
+extern SEXP rarefaction_point(SEXP, SEXP, SEXP, SEXP);
+extern SEXP read_vcf_native(SEXP, SEXP, SEXP, SEXP, SEXP, SEXP);
+extern SEXP shuffle_ia(SEXP, SEXP, SEXP, SEXP, SEXP, SEXP);
+extern SEXP shuffle_tab(SEXP, SEXP, SEXP, SEXP, SEXP, SEXP);
+extern SEXP simulate_genotypes(SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP, SEXP);
 
 static const R_CallMethodDef CallEntries[] = {
-    {"adjust_missing",            (DL_FUNC) &adjust_missing,            2},
-    {"association_index_diploid", (DL_FUNC) &association_index_diploid, 4},
-    {"association_index_haploid", (DL_FUNC) &association_index_haploid, 3},
-    {"bitwise_distance_diploid",  (DL_FUNC) &bitwise_distance_diploid,  5},
-    {"bitwise_distance_haploid",  (DL_FUNC) &bitwise_distance_haploid,  3},
+    {"adjust_missing",            (DL_FUNC) &adjust_missing,            3},
+    {"amova_native",              (DL_FUNC) &amova_native,              5},
+    {"amova_native_tab",          (DL_FUNC) &amova_native_tab,          6},
+    {"association_index_diploid", (DL_FUNC) &association_index_diploid, 5},
+    {"association_index_haploid", (DL_FUNC) &association_index_haploid, 4},
+    {"bitwise_distance_diploid",  (DL_FUNC) &bitwise_distance_diploid,  7},
+    {"bitwise_distance_haploid",  (DL_FUNC) &bitwise_distance_haploid,  5},
     {"bruvo_distance",            (DL_FUNC) &bruvo_distance,            6},
     {"bruvo_between",             (DL_FUNC) &bruvo_between,             7},
+    {"diss_distance",             (DL_FUNC) &diss_distance,             6},
+    {"diversity_bootstrap",       (DL_FUNC) &diversity_bootstrap,       5},
+    {"euclid_constant",           (DL_FUNC) &euclid_constant,           5},
     {"expand_indices",            (DL_FUNC) &expand_indices,            2},
+    {"genalex_rows",              (DL_FUNC) &genalex_rows,              6},
+    {"genalex_tab",               (DL_FUNC) &genalex_tab,               3},
+    {"genalex_tokenize",          (DL_FUNC) &genalex_tokenize,          4},
     {"genotype_curve_internal",   (DL_FUNC) &genotype_curve_internal,   4},
     {"get_pgen_matrix_genind",    (DL_FUNC) &get_pgen_matrix_genind,    4},
+    {"locus_qc",                  (DL_FUNC) &locus_qc,                  4},
+    {"locus_summary",             (DL_FUNC) &locus_summary,             7},
     {"mlg_round_robin",           (DL_FUNC) &mlg_round_robin,           1},
     {"msn_tied_edges",            (DL_FUNC) &msn_tied_edges,            3},
     {"neighbor_clustering",       (DL_FUNC) &neighbor_clustering,       5},
     {"omp_test",                  (DL_FUNC) &omp_test,                  0},
     {"pairdiffs",                 (DL_FUNC) &pairdiffs,                 1},
     {"pairwise_covar",            (DL_FUNC) &pairwise_covar,            1},
-    {"permute_shuff",             (DL_FUNC) &permute_shuff,             3},
     {"permuto",                   (DL_FUNC) &permuto,                   1},
+    {"pop_distance",              (DL_FUNC) &pop_distance,              7},
+    {"poppr_file_close",          (DL_FUNC) &poppr_file_close,          1},
+    {"poppr_file_index",          (DL_FUNC) &poppr_file_index,          1},
+    {"poppr_file_open",           (DL_FUNC) &poppr_file_open,           1},
+    {"poppr_file_section",        (DL_FUNC) &poppr_file_section,        4},
+    {"poppr_file_write",          (DL_FUNC) &poppr_file_write,          2},
+    {"poppr_hash",                (DL_FUNC) &poppr_hash,                1},
+    {"poppr_memory_info",         (DL_FUNC) &poppr_memory_info,         0},
+    {"poppr_thread_info",         (DL_FUNC) &poppr_thread_info,         0},
+    {"population_summary",        (DL_FUNC) &population_summary,        8},
+    {"private_allele_table",      (DL_FUNC) &private_allele_table,      8},
+    {"rarefaction_curve",         (DL_FUNC) &rarefaction_curve,         4},
+    {"rarefaction_point",         (DL_FUNC) &rarefaction_point,         4},
+    {"read_vcf_native",           (DL_FUNC) &read_vcf_native,           6},
+    {"shuffle_ia",                (DL_FUNC) &shuffle_ia,                6},
+    {"shuffle_tab",               (DL_FUNC) &shuffle_tab,               6},
+    {"simulate_genotypes",        (DL_FUNC) &simulate_genotypes,        8},
     {NULL, NULL, 0}
 };
 
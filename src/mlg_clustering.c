@@ -43,6 +43,7 @@
 #include <R_ext/Utils.h>
 #include <Rdefines.h>
 #include <R.h>
+#include "poppr_profile.h"
 
 // Thu Apr 13 08:42:12 2017 ------------------------------
 // This code produces bugs when run on Fedora with multiple threads. Because of
@@ -111,6 +112,8 @@ SEXP neighbor_clustering(SEXP dist, SEXP mlg, SEXP threshold, SEXP algorithm, SE
   int* out_vector; // A copy of Rout for internal use
   int num_threads;
   char algo;  // Used for storing the first letter of algorithm
+  struct poppr_profile prof;
+  double tic;
 
   SEXP Rout;
   SEXP Rout_vects;
@@ -119,6 +122,9 @@ SEXP neighbor_clustering(SEXP dist, SEXP mlg, SEXP threshold, SEXP algorithm, SE
   SEXP Rout_sizes;
   SEXP Rdim;
 
+  // The clustering runs serially (see below)
+  poppr_profile_init(&prof, "neighbor_clustering", 1);
+  poppr_profile_phase(&prof, "setup");
   // Convert the R object arguments into C data types
   algo = *CHAR(STRING_ELT(algorithm,0));
   thresh = REAL(threshold)[0];
@@ -248,11 +254,15 @@ SEXP neighbor_clustering(SEXP dist, SEXP mlg, SEXP threshold, SEXP algorithm, SE
   while(min_cluster_distance < thresh && num_clusters > 1)
   {
     R_CheckUserInterrupt();
+    tic = poppr_profile_tic(&prof);
     min_cluster_distance = -1;
     closest_pair[0] = -1;
     closest_pair[1] = -1;
     // Fill the distance matrix with the new distances between each cluster
+    poppr_profile_phase(&prof, "distances");
     fill_distance_matrix(cluster_distance_matrix,private_distance_matrix,out_vector,cluster_size,dist,algo,num_individuals,num_mlgs,num_threads);
+    poppr_profile_count(&prof, "bytes", 8.0*num_individuals*num_individuals);
+    poppr_profile_phase(&prof, "search");
     // Loop through each pairing of MLGs to find the pair whose clusters are separated by the smallest distance
     for(int i = 0; i < num_mlgs; i++)
     {
@@ -277,6 +287,8 @@ SEXP neighbor_clustering(SEXP dist, SEXP mlg, SEXP threshold, SEXP algorithm, SE
     }
     else if(min_cluster_distance < thresh)
     {
+      poppr_profile_phase(&prof, "merge");
+      poppr_profile_count(&prof, "merges", 1);
       // Store the distance at which this merge occurred in reverse order, since we
       // want them listed from largest distance to smallest
       REAL(Rout_stats)[num_mlgs-num_clusters] = min_cluster_distance;
@@ -331,8 +343,12 @@ SEXP neighbor_clustering(SEXP dist, SEXP mlg, SEXP threshold, SEXP algorithm, SE
         }
       }
     }
+    poppr_profile_toc(&prof, tic);
   }
 
+  poppr_profile_phase(&prof, "output");
+  poppr_profile_count(&prof, "individuals", num_individuals);
+  poppr_profile_count(&prof, "mlgs", num_mlgs);
   // Fill return vector
   for(int i = 0; i < num_individuals; i++)
   {
@@ -386,6 +402,7 @@ SEXP neighbor_clustering(SEXP dist, SEXP mlg, SEXP threshold, SEXP algorithm, SE
   SET_VECTOR_ELT(Rout, 1, Rout_stats);
   SET_VECTOR_ELT(Rout, 2, Rout_dists);
   SET_VECTOR_ELT(Rout, 3, Rout_sizes);
+  Rout = poppr_profile_attach(&prof, Rout);
   
   UNPROTECT(5);
   
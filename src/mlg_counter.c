@@ -39,9 +39,10 @@
 #include <Rinternals.h>
 #include <R_ext/Utils.h>
 #include <R.h>
+#include "poppr_rng.h"
 
 int mlg_round_robin_cmpr (const void *a, const void *b);
-void SampleWithoutReplacement(int populationSize, int sampleSize, int* samples);
+void SampleWithoutReplacement(struct poppr_rng* rng, int populationSize, int sampleSize, int* samples);
 SEXP mlg_round_robin(SEXP mat);
 SEXP genotype_curve_internal(SEXP mat, SEXP iter, SEXP maxloci, SEXP report);
 // global variable indicating the size of array to use for comparison in memcmp.
@@ -76,7 +77,9 @@ int mlg_round_robin_cmpr (const void *a, const void *b){
 
 // Adapted from http://stackoverflow.com/a/311716/2752888
 // Algorithm 3.4.2S by Donald Knuth
-void SampleWithoutReplacement(int populationSize, int sampleSize, int* samples)
+//
+// The uniform numbers come from rng, so this is safe to call from any thread.
+void SampleWithoutReplacement(struct poppr_rng* rng, int populationSize, int sampleSize, int* samples)
 {
     
     // Use Knuth's variable names
@@ -86,10 +89,9 @@ void SampleWithoutReplacement(int populationSize, int sampleSize, int* samples)
     int m = 0; // number of items selected so far
     double u;
     
-    GetRNGstate();
     while (m < n)
     {
-        u = unif_rand(); // call a uniform(0,1) random number generator
+        u = poppr_rng_unif(rng); // call a uniform(0,1) random number generator
 
         if ( (N - t)*u >= n - m )
         {
@@ -101,7 +103,6 @@ void SampleWithoutReplacement(int populationSize, int sampleSize, int* samples)
             t++; m++;
         }
     }
-    PutRNGstate();
 }
 
 
@@ -243,6 +244,9 @@ SEXP mlg_round_robin(SEXP mat)
 * Output:
 *   - A matrix with iter rows and m - 1 columns filled with counts of the number
 *       of multilocus genotypes for j loci. 
+*
+* The loci of iteration i for j loci are the pair (j - 1, i) of one seed from
+* R's RNG (see poppr_rng.h), so each sample of loci is reproducible on its own.
 */
 SEXP genotype_curve_internal(SEXP mat, SEXP iter, SEXP maxloci, SEXP report)
 {
@@ -264,6 +268,8 @@ SEXP genotype_curve_internal(SEXP mat, SEXP iter, SEXP maxloci, SEXP report)
   int* sampled_loci;
   int selected_locus;
   struct mask* mask_matrix;
+  struct poppr_rng rng;
+  uint64_t seed;
   
   Rdim = getAttrib(mat, R_DimSymbol);
   rows = INTEGER(Rdim)[0];
@@ -274,6 +280,7 @@ SEXP genotype_curve_internal(SEXP mat, SEXP iter, SEXP maxloci, SEXP report)
   
   
   genotype_matrix = INTEGER(mat);
+  seed = poppr_rng_seed();
   sampled_loci = R_Calloc(nmax, int);
   mask_matrix = R_Calloc(rows, struct mask);
   for (i = 0; i < rows; i++)
@@ -293,8 +300,10 @@ SEXP genotype_curve_internal(SEXP mat, SEXP iter, SEXP maxloci, SEXP report)
     while (iteration < INTEGER(iter)[0])
     {
       // sampled_loci here is an array of integers specifying the columns to
-      // copy from the genotype_matrix.
-      SampleWithoutReplacement(cols, nloci, sampled_loci);
+      // copy from the genotype_matrix. After the first iteration, this is the
+      // sample for the next iteration.
+      poppr_rng_init(&rng, seed, nloci - 1, (iteration == 0) ? 0 : iteration + 1);
+      SampleWithoutReplacement(&rng, cols, nloci, sampled_loci);
       
       // If it's the first iteration, the matrix needs to be initialized.
       // We have to get three things for this:
@@ -316,7 +325,8 @@ SEXP genotype_curve_internal(SEXP mat, SEXP iter, SEXP maxloci, SEXP report)
         }
         // Since it's the first iteration, sample again to set up the next 
         // iteration.
-        SampleWithoutReplacement(cols, nloci, sampled_loci);
+        poppr_rng_init(&rng, seed, nloci - 1, 1);
+        SampleWithoutReplacement(&rng, cols, nloci, sampled_loci);
       }
       if (REPORT > 0 && (iteration + 1) % REPORT == 0)
       {
@@ -382,6 +392,7 @@ SEXP genotype_curve_internal(SEXP mat, SEXP iter, SEXP maxloci, SEXP report)
     R_Free(mask_matrix[i].ind);
   }
   R_Free(mask_matrix);
+  R_Free(sampled_loci);
   UNPROTECT(1);
   return(Rout);
 }
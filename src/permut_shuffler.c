@@ -36,76 +36,6 @@
 #include <Rinternals.h>
 #include <R_ext/Utils.h>
 #include <R.h>
-/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
-A slightly faster method of permuting alleles at a locus. 
-
-Inputs:
-	locus - The matrix to be permuted. Used for reference.
-	alleles - a vector of integers from 0 to n alleles indicating the matrix cols
-	# allele_freq - 1/ploidy
-	ploidy - self-explainitory
-
-Outputs;
-	Rout - the permuted matrix. 
-~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
-SEXP permute_shuff(SEXP locus, SEXP alleles, SEXP ploidy)
-{
-	int rows;
-	int cols;
-	int i;
-	int j;
-	int count = 0;
-	int* ploid;
-	int p;
-	int miss = 0;
-	SEXP Rout;
-	SEXP Rdim;
-	Rdim = getAttrib(locus, R_DimSymbol);
-	rows = INTEGER(Rdim)[0]; 
-	cols = INTEGER(Rdim)[1]; 
-	PROTECT(Rout = allocMatrix(INTSXP, rows, cols));
-	PROTECT(alleles = coerceVector(alleles, INTSXP));
-	PROTECT(ploidy = coerceVector(ploidy, INTSXP));
-	ploid = INTEGER(ploidy);
-	int* inmat = INTEGER(locus);
-	int* outmat = INTEGER(Rout);
-	int* alle = INTEGER(alleles);
-	R_CheckUserInterrupt(); // This function doesn't run very long so, checking
-	                        // at this point is fine.
-	for(i = 0; i < rows; i++)
-	{
-		// loop through all columns first and initialize
-		for(j = 0; j < cols; j++) 
-		{
-			if (inmat[i + j*rows] == NA_INTEGER) // skip missing values
-			{
-				outmat[i + j*rows] = NA_INTEGER; 
-				miss = 1;
-			}
-			else // initialize to zero
-			{
-				outmat[i + j*rows] = 0;
-			}
-		}
-		if (miss == 1)
-		{
-			miss = 0;
-		}
-		else
-		{
-			// loop over the observed ploidy and assign that many alleles.
-			for(p = 0; p < ploid[i]; p++)
-			{
-				outmat[i + alle[count++]*rows] += 1;
-			}
-		}
-	}
-	UNPROTECT(3); // Rout; alleles; ploidy
-	return Rout;
-}
-
-
-
 /*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 Method for expanding indices for bootstrapping. Only slightly faster than R
 version, but seems to scale better.
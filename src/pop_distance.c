@@ -0,0 +1,686 @@
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+#
+# This software was authored by Zhian N. Kamvar and Javier F. Tabima, graduate
+# students at Oregon State University; Jonah C. Brooks, undergraduate student at
+# Oregon State University; and Dr. Nik Grünwald, an employee of USDA-ARS.
+#
+# Permission to use, copy, modify, and distribute this software and its
+# documentation for educational, research and non-profit purposes, without fee,
+# and without a written agreement is hereby granted, provided that the statement
+# above is incorporated into the material, giving appropriate attribution to the
+# authors.
+#
+# Permission to incorporate this software into commercial products may be
+# obtained by contacting USDA ARS and OREGON STATE UNIVERSITY Office for
+# Commercialization and Corporate Development.
+#
+# The software program and documentation are supplied "as is", without any
+# accompanying services from the USDA or the University. USDA ARS or the
+# University do not warrant that the operation of the program will be
+# uninterrupted or error-free. The end-user understands that the program was
+# developed for research purposes and is advised not to rely exclusively on the
+# program for any reason.
+#
+# IN NO EVENT SHALL USDA ARS OR OREGON STATE UNIVERSITY BE LIABLE TO ANY PARTY
+# FOR DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES, INCLUDING
+# LOST PROFITS, ARISING OUT OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION,
+# EVEN IF THE OREGON STATE UNIVERSITY HAS BEEN ADVISED OF THE POSSIBILITY OF
+# SUCH DAMAGE. USDA ARS OR OREGON STATE UNIVERSITY SPECIFICALLY DISCLAIMS ANY
+# WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+# MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE AND ANY STATUTORY
+# WARRANTY OF NON-INFRINGEMENT. THE SOFTWARE PROVIDED HEREUNDER IS ON AN "AS IS"
+# BASIS, AND USDA ARS AND OREGON STATE UNIVERSITY HAVE NO OBLIGATIONS TO PROVIDE
+# MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS.
+#
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+#define USE_FC_LEN_T
+#include <string.h>
+#include <math.h>
+// Include openMP if the compiler supports it
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include <Rinternals.h>
+#include <R_ext/Utils.h>
+#include <R_ext/BLAS.h>
+#include <R.h>
+#include "poppr_threads.h"
+#include "poppr_profile.h"
+
+/*
+Population genetic distances
+============================
+
+All of the distances in R/distances.r that are based on allele frequencies are
+calculated here from a single pass over each pair of samples:
+
+  nei      - -log(<p_i, p_j> / sqrt(<p_i, p_i><p_j, p_j>))
+  edwards  - sqrt(1 - <sqrt(p_i), sqrt(p_j)> / L)
+  rogers   - sum over loci of sqrt(0.5 * |p_il - p_jl|^2) / L
+  reynolds - sqrt(|p_i - p_j|^2 / (2L - 2<p_i, p_j>))
+  prevosti - sum(|p_i - p_j|) / L (divided by 2 for codominant data), where
+             missing data are ignored
+
+where L is the number of loci. Nei, Edwards, and Reynolds distances only need
+the inner products between samples (a symmetric rank-k update, SYRK), while
+Rogers and Prevosti distances need the per-locus differences.
+
+The samples are split into tiles of DIST_TILE rows that are copied into
+row-major order so that every inner loop is over contiguous memory. Each pair
+of tiles is handled by one thread and the columns are visited in chunks that
+end at a locus boundary, so a chunk of both tiles stays in cache while every
+requested quantity for every pair in the tiles is accumulated. The inner
+products of a chunk are a blocked SYRK: dsyrk for a tile with itself and dgemm
+for two different tiles, both from the BLAS that R uses. The results are
+written directly into condensed (dist) vectors.
+
+The dissimilarity distance of diss.dist (the number of differing alleles) uses
+the same tiles over an integer copy of the allele counts.
+
+Both kernels take an optional vector of loci, which is how bootgen objects
+(aboot) are read: a bootstrap replicate is only a vector of resampled loci over
+the table of the full data set, and the columns of those loci are gathered
+into the row-major copy that the kernels make anyway. A locus that is drawn
+more than once counts as a separate locus each time. The columns of a locus do
+not need to be contiguous in the table.
+*/
+
+#define DIST_TILE  32 // rows per tile
+#define DIST_CHUNK 512 // minimum number of columns per chunk
+
+#define DIST_NEI      1
+#define DIST_EDWARDS  2
+#define DIST_ROGERS   3
+#define DIST_REYNOLDS 4
+#define DIST_PREVOSTI 5
+
+#ifndef FCONE
+# define FCONE
+#endif
+
+SEXP pop_distance(SEXP mat, SEXP loc_fac, SEXP nloc, SEXP codom, SEXP which, SEXP requested_threads, SEXP loci);
+SEXP diss_distance(SEXP tab, SEXP loc_fac, SEXP halve, SEXP divisor, SEXP requested_threads, SEXP loci);
+static void tile_dot(const double* X, int m, int i0, int ni, int j0, int nj, int k0, int k1, double dot[DIST_TILE][DIST_TILE]);
+static int locus_view(const int* locus, int m, SEXP loci, int** cols, int** view_locus);
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+Adds the inner products of the columns k0 to k1 - 1 of the rows of two tiles of
+a row-major n x m matrix X to dot, where dot[a][b] is the product of rows
+i0 + a and j0 + b. Only the pairs with i0 + a > j0 + b are needed.
+
+Seen by the (column-major) BLAS, X is the m x n matrix X', and the rows of a
+tile are ni adjacent columns of it. dot is then the nj x ni matrix
+X'[, j]' X'[, i] with a leading dimension of DIST_TILE. For a tile with itself
+(i0 == j0), dsyrk fills its upper triangle, which holds the pairs b < a.
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+static void tile_dot(const double* X, int m, int i0, int ni, int j0, int nj, int k0, int k1, double dot[DIST_TILE][DIST_TILE])
+{
+  const int kc = k1 - k0;
+  const int ld = DIST_TILE;
+  const double one = 1.0;
+  const double* xi = X + (size_t)i0*m + k0;
+  const double* xj = X + (size_t)j0*m + k0;
+  if (kc < 1)
+  {
+    return;
+  }
+  if (i0 == j0)
+  {
+    F77_CALL(dsyrk)("U", "T", &ni, &kc, &one, xi, &m, &one, &dot[0][0], &ld 
+                    FCONE FCONE);
+  }
+  else
+  {
+    F77_CALL(dgemm)("T", "N", &nj, &ni, &kc, &one, xj, &m, xi, &m, &one, 
+                    &dot[0][0], &ld FCONE FCONE);
+  }
+}
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+Gathers the columns of a vector of loci so that the columns of each locus are
+contiguous and in the order of the loci.
+
+Input: locus      - an integer vector of length m giving the locus (1-based) of
+                    each column of the table
+       m          - the number of columns of the table
+       loci       - an integer vector of 1-based loci. Loci may be repeated. If
+                    it is empty, all loci are used in order.
+       cols       - a pointer that will hold the columns of the view
+       view_locus - a pointer that will hold the locus of each column of the
+                    view, where the kth element of loci is locus k.
+Output: the number of columns of the view. cols and view_locus must be freed
+        with R_Free.
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+static int locus_view(const int* locus, int m, SEXP loci, int** cols, int** view_locus)
+{
+  int nl = 0;
+  int nsel;
+  int mv = 0;
+  int k;
+  int l;
+  int* sel;
+  int* start;
+  int* order;
+  int* fill;
+
+  for (k = 0; k < m; k++)
+  {
+    if (locus[k] == NA_INTEGER || locus[k] < 1)
+    {
+      error("loc_fac must contain positive integers");
+    }
+    if (locus[k] > nl)
+    {
+      nl = locus[k];
+    }
+  }
+  nsel = (length(loci) > 0) ? length(loci) : nl;
+  sel  = (length(loci) > 0) ? INTEGER(loci) : NULL;
+  for (l = 0; sel != NULL && l < nsel; l++)
+  {
+    if (sel[l] == NA_INTEGER || sel[l] < 1 || sel[l] > nl)
+    {
+      error("loci out of bounds");
+    }
+  }
+  // Counting sort of the columns by locus
+  start = R_Calloc(nl + 1, int);
+  fill  = R_Calloc(nl, int);
+  order = R_Calloc(m > 0 ? m : 1, int);
+  for (k = 0; k < m; k++)
+  {
+    start[locus[k]]++;
+  }
+  for (l = 0; l < nl; l++)
+  {
+    start[l + 1] += start[l];
+  }
+  for (k = 0; k < m; k++)
+  {
+    order[start[locus[k] - 1] + fill[locus[k] - 1]++] = k;
+  }
+  for (l = 0; l < nsel; l++)
+  {
+    int loc = (sel != NULL) ? sel[l] - 1 : l;
+    mv += start[loc + 1] - start[loc];
+  }
+  *cols       = R_Calloc(mv > 0 ? mv : 1, int);
+  *view_locus = R_Calloc(mv > 0 ? mv : 1, int);
+  mv = 0;
+  for (l = 0; l < nsel; l++)
+  {
+    int loc = (sel != NULL) ? sel[l] - 1 : l;
+    for (k = start[loc]; k < start[loc + 1]; k++)
+    {
+      (*cols)[mv]       = order[k];
+      (*view_locus)[mv] = l + 1;
+      mv++;
+    }
+  }
+  R_Free(start);
+  R_Free(fill);
+  R_Free(order);
+  return mv;
+}
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+Calculates one or more population genetic distances between the rows of a
+matrix of allele frequencies.
+
+Input: mat     - an n x m numeric matrix of allele frequencies
+       loc_fac - an integer vector of length m giving the locus of each column.
+       nloc    - the number of loci (L) of the view
+       codom   - TRUE if the data are codominant (for Prevosti's distance)
+       which   - an integer vector of distances to calculate:
+                 1 = Nei, 2 = Edwards, 3 = Rogers, 4 = Reynolds, 5 = Prevosti
+       requested_threads - number of threads (0 = all available)
+       loci    - an integer vector of the loci to use (see locus_view) or an
+                 empty vector for all loci
+Output: A list with one condensed distance vector per element of which.
+        Distances that cannot be calculated because of missing data are NA.
+        Nei's distance can be infinite; this is handled in R.
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+SEXP pop_distance(SEXP mat, SEXP loc_fac, SEXP nloc, SEXP codom, SEXP which, SEXP requested_threads, SEXP loci)
+{
+  SEXP Rout;
+  SEXP Rdim;
+  int n;
+  int m;
+  int w;
+  int nwhich;
+  int num_threads;
+  int ntiles;
+  int npairs;
+  int nchunks;
+  int tp;
+  int i;
+  int k;
+  int need_dot = 0;
+  int need_sdot = 0;
+  int need_diff = 0;
+  int* chunk_start;
+  int* cols;
+  int* locus;
+  int* methods;
+  double L;
+  double prev_div;
+  double* X;
+  double* S = NULL;
+  double* norm;
+  double** out;
+
+  Rdim    = getAttrib(mat, R_DimSymbol);
+  n       = INTEGER(Rdim)[0];
+  m       = INTEGER(Rdim)[1];
+  L       = (double)asInteger(nloc);
+  nwhich  = length(which);
+  methods = INTEGER(which);
+  prev_div = (asLogical(codom) ? 2.0 : 1.0)*L;
+  if (length(loc_fac) != m)
+  {
+    error("loc_fac must have one element per column");
+  }
+  for (w = 0; w < nwhich; w++)
+  {
+    switch (methods[w])
+    {
+      case DIST_NEI:
+      case DIST_REYNOLDS:
+        need_dot = 1;
+        break;
+      case DIST_EDWARDS:
+        need_sdot = 1;
+        break;
+      case DIST_ROGERS:
+      case DIST_PREVOSTI:
+        need_diff = 1;
+        break;
+      default:
+        error("unknown distance: %d", methods[w]);
+    }
+  }
+
+  num_threads = poppr_threads(requested_threads);
+
+  PROTECT(Rout = allocVector(VECSXP, nwhich));
+  out = (double**)R_alloc(nwhich, sizeof(double*));
+  for (w = 0; w < nwhich; w++)
+  {
+    SET_VECTOR_ELT(Rout, w, allocVector(REALSXP, (R_xlen_t)n*(n - 1)/2));
+    out[w] = REAL(VECTOR_ELT(Rout, w));
+  }
+  if (n < 2)
+  {
+    UNPROTECT(1);
+    return Rout;
+  }
+  // Check for an interrupt before anything is allocated with R_Calloc
+  R_CheckUserInterrupt();
+
+  // Row-major copies of the columns of the view (and their square roots for
+  // Edwards)
+  m    = locus_view(INTEGER(loc_fac), m, loci, &cols, &locus);
+  X    = R_Calloc((size_t)n*m, double);
+  norm = R_Calloc(n, double);
+  if (need_sdot)
+  {
+    S = R_Calloc((size_t)n*m, double);
+  }
+  for (i = 0; i < n; i++)
+  {
+    for (k = 0; k < m; k++)
+    {
+      double v = REAL(mat)[i + (size_t)cols[k]*n];
+      X[(size_t)i*m + k] = v;
+      norm[i] += v*v;
+      if (need_sdot)
+      {
+        S[(size_t)i*m + k] = sqrt(v);
+      }
+    }
+  }
+  // Column chunks that end on locus boundaries
+  chunk_start = R_Calloc(m + 1, int);
+  nchunks = 0;
+  for (k = 0; k < m; k++)
+  {
+    if (k == 0 || (k - chunk_start[nchunks - 1] >= DIST_CHUNK && locus[k] != locus[k - 1]))
+    {
+      chunk_start[nchunks++] = k;
+    }
+  }
+  chunk_start[nchunks] = m;
+
+  ntiles = (n + DIST_TILE - 1)/DIST_TILE;
+  npairs = ntiles*(ntiles + 1)/2;
+  #ifdef _OPENMP
+  #pragma omp parallel for schedule(dynamic) num_threads(num_threads) private(tp, w)
+  #endif
+  for (tp = 0; tp < npairs; tp++)
+  {
+    // Accumulators for every pair in the two tiles
+    double dot[DIST_TILE][DIST_TILE];
+    double sdot[DIST_TILE][DIST_TILE];
+    double rog[DIST_TILE][DIST_TILE];
+    double prev[DIST_TILE][DIST_TILE];
+    int bi = 0;
+    int bj;
+    int c;
+    int a;
+    int b;
+    int ii;
+    int jj;
+    int i0;
+    int j0;
+    int ni;
+    int nj;
+    // Unrank the tile pair (bi >= bj)
+    while ((bi + 1)*(bi + 2)/2 <= tp)
+    {
+      bi++;
+    }
+    bj = tp - bi*(bi + 1)/2;
+    i0 = bi*DIST_TILE;
+    j0 = bj*DIST_TILE;
+    ni = (i0 + DIST_TILE <= n) ? DIST_TILE : n - i0;
+    nj = (j0 + DIST_TILE <= n) ? DIST_TILE : n - j0;
+    memset(dot, 0, sizeof(dot));
+    memset(sdot, 0, sizeof(sdot));
+    memset(rog, 0, sizeof(rog));
+    memset(prev, 0, sizeof(prev));
+
+    for (c = 0; c < nchunks; c++)
+    {
+      int k0 = chunk_start[c];
+      int k1 = chunk_start[c + 1];
+      if (need_dot)
+      {
+        tile_dot(X, m, i0, ni, j0, nj, k0, k1, dot);
+      }
+      if (need_sdot)
+      {
+        tile_dot(S, m, i0, ni, j0, nj, k0, k1, sdot);
+      }
+      for (a = 0; a < ni && need_diff; a++)
+      {
+        ii = i0 + a;
+        const double* xi = X + (size_t)ii*m;
+        for (b = 0; b < nj; b++)
+        {
+          jj = j0 + b;
+          if (jj >= ii)
+          {
+            break;
+          }
+          const double* xj = X + (size_t)jj*m;
+          int kk;
+          double sq = 0.0;
+          double ab = 0.0;
+          double r = 0.0;
+          double diff;
+          for (kk = k0; kk < k1; kk++)
+          {
+            diff = xi[kk] - xj[kk];
+            if (kk > k0 && locus[kk] != locus[kk - 1])
+            {
+              r += sqrt(0.5*sq);
+              sq = 0.0;
+            }
+            sq += diff*diff;
+            if (!ISNAN(diff))
+            {
+              ab += fabs(diff);
+            }
+          }
+          r += sqrt(0.5*sq);
+          rog[a][b] += r;
+          prev[a][b] += ab;
+        }
+      }
+    }
+    // Finalize the distances for each pair
+    for (a = 0; a < ni; a++)
+    {
+      ii = i0 + a;
+      for (b = 0; b < nj; b++)
+      {
+        jj = j0 + b;
+        if (jj >= ii)
+        {
+          break;
+        }
+        // dist index for (ii, jj) with ii > jj
+        R_xlen_t idx = (R_xlen_t)n*jj - ((R_xlen_t)jj*(jj + 1))/2 + ii - jj - 1;
+        for (w = 0; w < nwhich; w++)
+        {
+          double d = 0.0;
+          switch (methods[w])
+          {
+            // The inner products are rounded differently than the norms, so
+            // identical samples can be a rounding error below 0.
+            case DIST_NEI:
+              d = -log(dot[a][b]/(sqrt(norm[ii])*sqrt(norm[jj])));
+              d = (d < 0.0) ? 0.0 : d;
+              break;
+            case DIST_EDWARDS:
+              d = 1.0 - sdot[a][b]/L;
+              d = sqrt((d < 0.0) ? 0.0 : d);
+              break;
+            case DIST_ROGERS:
+              d = rog[a][b]/L;
+              break;
+            case DIST_REYNOLDS:
+              d = (norm[ii] + norm[jj] - 2.0*dot[a][b])/(2.0*L - 2.0*dot[a][b]);
+              d = sqrt((d < 0.0) ? 0.0 : d);
+              break;
+            case DIST_PREVOSTI:
+              d = prev[a][b]/prev_div;
+              break;
+          }
+          out[w][idx] = ISNAN(d) ? NA_REAL : d;
+        }
+      }
+    }
+  }
+  R_Free(X);
+  R_Free(norm);
+  R_Free(chunk_start);
+  R_Free(cols);
+  R_Free(locus);
+  if (S != NULL)
+  {
+    R_Free(S);
+  }
+  UNPROTECT(1);
+  return Rout;
+}
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+Calculates the number of allelic differences between the rows of an allele
+count matrix (diss.dist). This replaces calling pairdiffs on every locus and
+summing the results in R.
+
+For each pair of samples and each locus, the absolute differences of the allele
+counts are summed. If halve is TRUE, this sum is divided by two and rounded up.
+If either sample has a missing value in any column of a locus, that locus
+contributes 0 to the distance.
+
+Input: tab     - an n x m integer matrix of allele counts
+       loc_fac - an integer vector of length m giving the locus of each column.
+       halve   - TRUE if the sum over each locus should be divided by 2 and
+                 rounded up (codominant data).
+       divisor - a numeric vector of length n or 0. If it is of length n, the
+                 distance between samples i and j with i > j is divided by
+                 divisor[i] (percent = TRUE).
+       requested_threads - number of threads (0 = all available)
+       loci    - an integer vector of the loci to use (see locus_view) or an
+                 empty vector for all loci
+Output: A condensed distance vector of length n*(n - 1)/2
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+SEXP diss_distance(SEXP tab, SEXP loc_fac, SEXP halve, SEXP divisor, SEXP requested_threads, SEXP loci)
+{
+  SEXP Rout;
+  SEXP Rdim;
+  int n;
+  int m;
+  int nloc;
+  int do_halve;
+  int num_threads;
+  int ntiles;
+  int npairs;
+  int tp;
+  int i;
+  int k;
+  int* X;
+  int* loc_start;
+  int* cols;
+  int* locus;
+  double* div = NULL;
+  double* out;
+  struct poppr_profile prof;
+
+  Rdim     = getAttrib(tab, R_DimSymbol);
+  n        = INTEGER(Rdim)[0];
+  m        = INTEGER(Rdim)[1];
+  do_halve = asLogical(halve);
+  if (length(loc_fac) != m)
+  {
+    error("loc_fac must have one element per column");
+  }
+  if (length(divisor) == n)
+  {
+    div = REAL(divisor);
+  }
+  else if (length(divisor) != 0)
+  {
+    error("divisor must have one element per row");
+  }
+
+  // Counts stored as doubles are only accepted if they are whole numbers
+  if (TYPEOF(tab) == REALSXP)
+  {
+    R_xlen_t j;
+    double* dtab = REAL(tab);
+    for (j = 0; j < XLENGTH(tab); j++)
+    {
+      if (!ISNAN(dtab[j]) && dtab[j] != floor(dtab[j]))
+      {
+        error("tab must contain integer allele counts");
+      }
+    }
+  }
+
+  num_threads = poppr_threads(requested_threads);
+  poppr_profile_init(&prof, "diss_distance", num_threads);
+  poppr_profile_phase(&prof, "copy");
+
+  PROTECT(tab = coerceVector(tab, INTSXP));
+  PROTECT(Rout = allocVector(REALSXP, (R_xlen_t)n*(n - 1)/2));
+  out = REAL(Rout);
+  if (n < 2)
+  {
+    UNPROTECT(2);
+    return Rout;
+  }
+  // Check for an interrupt before anything is allocated with R_Calloc
+  R_CheckUserInterrupt();
+
+  // Row-major copy of the columns of the view and the first column of each
+  // locus
+  m = locus_view(INTEGER(loc_fac), m, loci, &cols, &locus);
+  X = R_Calloc((size_t)n*m, int);
+  for (i = 0; i < n; i++)
+  {
+    for (k = 0; k < m; k++)
+    {
+      X[(size_t)i*m + k] = INTEGER(tab)[i + (size_t)cols[k]*n];
+    }
+  }
+  loc_start = R_Calloc(m + 1, int);
+  nloc = 0;
+  for (k = 0; k < m; k++)
+  {
+    if (k == 0 || locus[k] != locus[k - 1])
+    {
+      loc_start[nloc++] = k;
+    }
+  }
+  loc_start[nloc] = m;
+
+  ntiles = (n + DIST_TILE - 1)/DIST_TILE;
+  npairs = ntiles*(ntiles + 1)/2;
+  poppr_profile_phase(&prof, "pairs");
+  #ifdef _OPENMP
+  #pragma omp parallel for schedule(dynamic) num_threads(num_threads) private(tp)
+  #endif
+  for (tp = 0; tp < npairs; tp++)
+  {
+    int bi = 0;
+    int bj;
+    int a;
+    int b;
+    int l;
+    int ii;
+    int jj;
+    int i0;
+    int j0;
+    int ni;
+    int nj;
+    double tic = poppr_profile_tic(&prof);
+    // Unrank the tile pair (bi >= bj)
+    while ((bi + 1)*(bi + 2)/2 <= tp)
+    {
+      bi++;
+    }
+    bj = tp - bi*(bi + 1)/2;
+    i0 = bi*DIST_TILE;
+    j0 = bj*DIST_TILE;
+    ni = (i0 + DIST_TILE <= n) ? DIST_TILE : n - i0;
+    nj = (j0 + DIST_TILE <= n) ? DIST_TILE : n - j0;
+    for (a = 0; a < ni; a++)
+    {
+      ii = i0 + a;
+      const int* xi = X + (size_t)ii*m;
+      for (b = 0; b < nj; b++)
+      {
+        jj = j0 + b;
+        if (jj >= ii)
+        {
+          break;
+        }
+        const int* xj = X + (size_t)jj*m;
+        long total = 0;
+        for (l = 0; l < nloc; l++)
+        {
+          int kk;
+          int val = 0;
+          for (kk = loc_start[l]; kk < loc_start[l + 1]; kk++)
+          {
+            if (xi[kk] == NA_INTEGER || xj[kk] == NA_INTEGER)
+            {
+              val = 0;
+              break;
+            }
+            val += abs(xi[kk] - xj[kk]);
+          }
+          total += do_halve ? (val + 1)/2 : val;
+        }
+        // dist index for (ii, jj) with ii > jj
+        R_xlen_t idx = (R_xlen_t)n*jj - ((R_xlen_t)jj*(jj + 1))/2 + ii - jj - 1;
+        out[idx] = (div != NULL) ? (double)total/div[ii] : (double)total;
+      }
+    }
+    poppr_profile_toc(&prof, tic);
+  }
+  poppr_profile_count(&prof, "pairs", (double)n*(n - 1)/2);
+  poppr_profile_count(&prof, "loci", nloc);
+  // Each sample is read once per tile of the other samples
+  poppr_profile_count(&prof, "bytes", sizeof(int)*((double)n*m + (double)n*m*(ntiles + 1)/2));
+  R_Free(X);
+  R_Free(loc_start);
+  R_Free(cols);
+  R_Free(locus);
+  Rout = poppr_profile_attach(&prof, Rout);
+  UNPROTECT(2);
+  return Rout;
+}
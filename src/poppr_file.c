@@ -0,0 +1,632 @@
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+#
+# This software was authored by Zhian N. Kamvar and Javier F. Tabima, graduate
+# students at Oregon State University; Jonah C. Brooks, undergraduate student at
+# Oregon State University; and Dr. Nik Grünwald, an employee of USDA-ARS.
+#
+# Permission to use, copy, modify, and distribute this software and its
+# documentation for educational, research and non-profit purposes, without fee,
+# and without a written agreement is hereby granted, provided that the statement
+# above is incorporated into the material, giving appropriate attribution to the
+# authors.
+#
+# Permission to incorporate this software into commercial products may be
+# obtained by contacting USDA ARS and OREGON STATE UNIVERSITY Office for
+# Commercialization and Corporate Development.
+#
+# The software program and documentation are supplied "as is", without any
+# accompanying services from the USDA or the University. USDA ARS or the
+# University do not warrant that the operation of the program will be
+# uninterrupted or error-free. The end-user understands that the program was
+# developed for research purposes and is advised not to rely exclusively on the
+# program for any reason.
+#
+# IN NO EVENT SHALL USDA ARS OR OREGON STATE UNIVERSITY BE LIABLE TO ANY PARTY
+# FOR DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES, INCLUDING
+# LOST PROFITS, ARISING OUT OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION,
+# EVEN IF THE OREGON STATE UNIVERSITY HAS BEEN ADVISED OF THE POSSIBILITY OF
+# SUCH DAMAGE. USDA ARS OR OREGON STATE UNIVERSITY SPECIFICALLY DISCLAIMS ANY
+# WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+# MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE AND ANY STATUTORY
+# WARRANTY OF NON-INFRINGEMENT. THE SOFTWARE PROVIDED HEREUNDER IS ON AN "AS IS"
+# BASIS, AND USDA ARS AND OREGON STATE UNIVERSITY HAVE NO OBLIGATIONS TO PROVIDE
+# MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS.
+#
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <Rinternals.h>
+#include <R.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+/*
+poppr files
+===========
+
+A poppr file is a binary container of typed sections. It starts with a header
+of 64 bytes:
+
+  magic     "POPPRBIN"     8 bytes
+  version   uint32         currently 1
+  byteorder uint32         0x01020304 as written by the machine
+  nsections uint32
+  reserved  44 bytes of zeroes
+
+followed by one 64 byte index entry per section:
+
+  name      24 bytes, null terminated
+  type      int32          the SEXPTYPE (LGLSXP, INTSXP, REALSXP, or RAWSXP)
+  kind      int32          0: vector, 1: matrix, 2: condensed distance matrix
+  nrow      int64          the length of a vector, the rows of a matrix, or the
+                           number of samples of a distance matrix
+  ncol      int64          the columns of a matrix, otherwise 1
+  offset    uint64         from the start of the file
+  reserved  8 bytes of zeroes
+
+The data of every section starts at an offset aligned to 64 bytes and is
+stored in the same layout as the R vector: column major for matrices and the
+lower triangle by columns for distance matrices.
+
+The file is opened with mmap where it is available (and read into memory
+otherwise), so that only the sections (and the rows or columns of those
+sections) that are requested are read from disk.
+*/
+
+#define PF_MAGIC "POPPRBIN"
+#define PF_VERSION 1
+#define PF_BYTEORDER 0x01020304u
+#define PF_ALIGN 64
+#define PF_NAME 24
+
+typedef struct {
+  char name[PF_NAME];
+  int32_t type;
+  int32_t kind;
+  int64_t nrow;
+  int64_t ncol;
+  uint64_t offset;
+  uint64_t reserved;
+} pf_entry;
+
+typedef struct {
+  char magic[8];
+  uint32_t version;
+  uint32_t byteorder;
+  uint32_t nsections;
+  char reserved[44];
+} pf_header;
+
+// The index starts right after the header, so both must keep their sizes for
+// the int64 fields of the entries to stay aligned.
+_Static_assert(sizeof(pf_header) == 64, "the header of a poppr file must be 64 bytes");
+_Static_assert(sizeof(pf_entry) == 64, "an index entry of a poppr file must be 64 bytes");
+
+typedef struct {
+  unsigned char *base;
+  size_t size;
+  int mapped;
+  uint32_t nsections;
+  pf_entry *index;
+} pf_file;
+
+static size_t pf_type_size(int type)
+{
+  switch (type)
+  {
+    case LGLSXP:
+    case INTSXP:
+      return sizeof(int);
+    case REALSXP:
+      return sizeof(double);
+    case RAWSXP:
+      return 1;
+  }
+  return 0;
+}
+
+static uint64_t pf_aligned(uint64_t x)
+{
+  return (x + PF_ALIGN - 1) / PF_ALIGN * PF_ALIGN;
+}
+
+static uint64_t pf_length(const pf_entry *e)
+{
+  if (e->kind == 2)
+  {
+    return (uint64_t) e->nrow * (e->nrow - 1) / 2;
+  }
+  return (uint64_t) e->nrow * e->ncol;
+}
+
+// TRUE if the data of an entry lie within a file of the given size. The
+// dimensions are checked before they are multiplied so that corrupt values
+// cannot overflow.
+static int pf_fits(const pf_entry *e, size_t tsize, uint64_t size)
+{
+  uint64_t nrow = (uint64_t) e->nrow;
+  uint64_t ncol = (e->kind == 2) ? (nrow > 0 ? nrow - 1 : 0) : (uint64_t) e->ncol;
+  if (e->offset > size || (ncol > 0 && nrow > UINT64_MAX / ncol))
+  {
+    return 0;
+  }
+  return pf_length(e) <= (size - e->offset) / tsize;
+}
+
+static void *pf_data(SEXP x)
+{
+  switch (TYPEOF(x))
+  {
+    case LGLSXP:
+      return LOGICAL(x);
+    case INTSXP:
+      return INTEGER(x);
+    case REALSXP:
+      return REAL(x);
+    case RAWSXP:
+      return RAW(x);
+  }
+  return NULL;
+}
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+Write the sections of a poppr file.
+
+Input:
+  path     - the file name
+  sections - a named list of logical, integer, numeric, or raw vectors. A
+             section is a matrix if it has two dimensions and a condensed
+             distance matrix if it has a "Size" attribute.
+Output:
+  the number of bytes written
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+SEXP poppr_file_write(SEXP path, SEXP sections)
+{
+  R_len_t nsec = length(sections);
+  SEXP names   = getAttrib(sections, R_NamesSymbol);
+  SEXP Rsize   = PROTECT(install("Size"));
+  pf_header header;
+  pf_entry *index = (pf_entry *) R_alloc(nsec > 0 ? nsec : 1, sizeof(pf_entry));
+  uint64_t offset = pf_aligned(sizeof(pf_header) + (uint64_t) nsec * sizeof(pf_entry));
+  static const unsigned char zeroes[PF_ALIGN] = {0};
+  FILE *f;
+
+  if (nsec > 0 && isNull(names))
+  {
+    error("sections must be named");
+  }
+  memset(&header, 0, sizeof(pf_header));
+  memcpy(header.magic, PF_MAGIC, 8);
+  header.version   = PF_VERSION;
+  header.byteorder = PF_BYTEORDER;
+  header.nsections = (uint32_t) nsec;
+
+  for (R_len_t i = 0; i < nsec; i++)
+  {
+    SEXP x      = VECTOR_ELT(sections, i);
+    SEXP dim    = getAttrib(x, R_DimSymbol);
+    SEXP size   = getAttrib(x, Rsize);
+    const char *name = CHAR(STRING_ELT(names, i));
+    pf_entry *e = &index[i];
+    if (pf_type_size(TYPEOF(x)) == 0)
+    {
+      error("section %s must be a logical, integer, numeric, or raw vector", name);
+    }
+    if (strlen(name) == 0 || strlen(name) >= PF_NAME)
+    {
+      error("section names must have between 1 and %d characters", PF_NAME - 1);
+    }
+    memset(e, 0, sizeof(pf_entry));
+    strcpy(e->name, name);
+    e->type = TYPEOF(x);
+    if (!isNull(size))
+    {
+      e->kind = 2;
+      e->nrow = (int64_t) asReal(size);
+      e->ncol = 1;
+    }
+    else if (length(dim) == 2)
+    {
+      e->kind = 1;
+      e->nrow = INTEGER(dim)[0];
+      e->ncol = INTEGER(dim)[1];
+    }
+    else
+    {
+      e->kind = 0;
+      e->nrow = XLENGTH(x);
+      e->ncol = 1;
+    }
+    if (pf_length(e) != (uint64_t) XLENGTH(x))
+    {
+      error("the length of section %s does not match its dimensions", name);
+    }
+    e->offset = offset;
+    offset    = pf_aligned(offset + XLENGTH(x) * pf_type_size(e->type));
+  }
+
+  f = fopen(R_ExpandFileName(CHAR(STRING_ELT(path, 0))), "wb");
+  if (f == NULL)
+  {
+    error("cannot open file '%s' for writing", CHAR(STRING_ELT(path, 0)));
+  }
+  int ok = fwrite(&header, sizeof(pf_header), 1, f) == 1;
+  if (nsec > 0)
+  {
+    ok = ok && fwrite(index, sizeof(pf_entry), nsec, f) == (size_t) nsec;
+  }
+  uint64_t written = sizeof(pf_header) + (uint64_t) nsec * sizeof(pf_entry);
+  for (R_len_t i = 0; ok && i < nsec; i++)
+  {
+    SEXP x       = VECTOR_ELT(sections, i);
+    size_t bytes = XLENGTH(x) * pf_type_size(index[i].type);
+    size_t pad   = index[i].offset - written;
+    ok = fwrite(zeroes, 1, pad, f) == pad;
+    ok = ok && (bytes == 0 || fwrite(pf_data(x), 1, bytes, f) == bytes);
+    written = index[i].offset + bytes;
+  }
+  if (ok && offset > written)
+  {
+    ok = fwrite(zeroes, 1, offset - written, f) == offset - written;
+  }
+  ok = (fclose(f) == 0) && ok;
+  if (!ok)
+  {
+    error("could not write to file '%s'", CHAR(STRING_ELT(path, 0)));
+  }
+  UNPROTECT(1);
+  return ScalarReal((double) offset);
+}
+
+static void pf_close(pf_file *pf)
+{
+  if (pf->base != NULL)
+  {
+#ifndef _WIN32
+    if (pf->mapped)
+    {
+      munmap(pf->base, pf->size);
+    }
+    else
+#endif
+    {
+      free(pf->base);
+    }
+  }
+  pf->base  = NULL;
+  pf->index = NULL;
+  pf->nsections = 0;
+}
+
+static void pf_finalize(SEXP ptr)
+{
+  pf_file *pf = (pf_file *) R_ExternalPtrAddr(ptr);
+  if (pf != NULL)
+  {
+    pf_close(pf);
+    free(pf);
+    R_ClearExternalPtr(ptr);
+  }
+}
+
+static pf_file *pf_get(SEXP ptr)
+{
+  pf_file *pf;
+  if (TYPEOF(ptr) != EXTPTRSXP || (pf = (pf_file *) R_ExternalPtrAddr(ptr)) == NULL 
+      || pf->base == NULL)
+  {
+    error("the poppr file has been closed");
+  }
+  return pf;
+}
+
+static const pf_entry *pf_find(pf_file *pf, const char *name)
+{
+  for (uint32_t i = 0; i < pf->nsections; i++)
+  {
+    if (strncmp(pf->index[i].name, name, PF_NAME) == 0)
+    {
+      return &pf->index[i];
+    }
+  }
+  error("section %s does not exist", name);
+  return NULL;
+}
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+Open a poppr file. The header and the index are validated before any section
+is read.
+
+Input:
+  path - the file name
+Output:
+  an external pointer to the mapped file. The file is unmapped when the
+  pointer is garbage collected or closed with poppr_file_close.
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+SEXP poppr_file_open(SEXP path)
+{
+  const char *fname = R_ExpandFileName(CHAR(STRING_ELT(path, 0)));
+  pf_file *pf = (pf_file *) calloc(1, sizeof(pf_file));
+  const char *problem = NULL;
+  if (pf == NULL)
+  {
+    error("could not allocate memory for the poppr file");
+  }
+#ifndef _WIN32
+  int fd = open(fname, O_RDONLY);
+  struct stat st;
+  if (fd >= 0 && fstat(fd, &st) == 0 && st.st_size > 0)
+  {
+    void *map = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map != MAP_FAILED)
+    {
+      pf->base   = (unsigned char *) map;
+      pf->size   = (size_t) st.st_size;
+      pf->mapped = 1;
+    }
+  }
+  if (fd >= 0)
+  {
+    close(fd);
+  }
+#endif
+  if (pf->base == NULL)
+  {
+    FILE *f = fopen(fname, "rb");
+    if (f != NULL && fseek(f, 0, SEEK_END) == 0)
+    {
+      long size = ftell(f);
+      if (size > 0 && fseek(f, 0, SEEK_SET) == 0)
+      {
+        pf->base = (unsigned char *) malloc((size_t) size);
+        if (pf->base != NULL && fread(pf->base, 1, (size_t) size, f) != (size_t) size)
+        {
+          free(pf->base);
+          pf->base = NULL;
+        }
+        pf->size = (size_t) size;
+      }
+    }
+    if (f != NULL)
+    {
+      fclose(f);
+    }
+  }
+  if (pf->base == NULL)
+  {
+    free(pf);
+    error("cannot open file '%s'", CHAR(STRING_ELT(path, 0)));
+  }
+
+  pf_header header;
+  if (pf->size < sizeof(pf_header))
+  {
+    problem = "is not a poppr file";
+  }
+  else
+  {
+    memcpy(&header, pf->base, sizeof(pf_header));
+    if (memcmp(header.magic, PF_MAGIC, 8) != 0)
+    {
+      problem = "is not a poppr file";
+    }
+    else if (header.byteorder != PF_BYTEORDER)
+    {
+      problem = "was written on a machine with a different byte order";
+    }
+    else if (header.version > PF_VERSION)
+    {
+      problem = "was written by a newer version of poppr";
+    }
+    else if (sizeof(pf_header) + (uint64_t) header.nsections * sizeof(pf_entry) > pf->size)
+    {
+      problem = "is truncated";
+    }
+  }
+  if (problem == NULL)
+  {
+    pf->nsections = header.nsections;
+    pf->index     = (pf_entry *) (pf->base + sizeof(pf_header));
+    for (uint32_t i = 0; i < pf->nsections && problem == NULL; i++)
+    {
+      const pf_entry *e = &pf->index[i];
+      size_t tsize = pf_type_size(e->type);
+      if (tsize == 0 || e->kind < 0 || e->kind > 2 || e->nrow < 0 || e->ncol < 0 ||
+          memchr(e->name, '\0', PF_NAME) == NULL || e->offset % PF_ALIGN != 0 ||
+          !pf_fits(e, tsize, pf->size))
+      {
+        problem = "is corrupt or truncated";
+      }
+    }
+  }
+  if (problem != NULL)
+  {
+    pf_close(pf);
+    free(pf);
+    error("'%s' %s", CHAR(STRING_ELT(path, 0)), problem);
+  }
+  SEXP ptr = PROTECT(R_MakeExternalPtr(pf, R_NilValue, R_NilValue));
+  R_RegisterCFinalizerEx(ptr, pf_finalize, TRUE);
+  UNPROTECT(1);
+  return ptr;
+}
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+Unmap a poppr file before the pointer is garbage collected.
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+SEXP poppr_file_close(SEXP ptr)
+{
+  pf_finalize(ptr);
+  return R_NilValue;
+}
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+The index of a poppr file.
+
+Output:
+  a list with the name, type, kind ("vector", "matrix", or "dist"), nrow,
+  ncol, and offset of every section
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+SEXP poppr_file_index(SEXP ptr)
+{
+  pf_file *pf = pf_get(ptr);
+  R_len_t n = (R_len_t) pf->nsections;
+  const char *kinds[3] = {"vector", "matrix", "dist"};
+  SEXP res   = PROTECT(allocVector(VECSXP, 6));
+  SEXP names = PROTECT(allocVector(STRSXP, 6));
+  SEXP name  = PROTECT(allocVector(STRSXP, n));
+  SEXP type  = PROTECT(allocVector(STRSXP, n));
+  SEXP kind  = PROTECT(allocVector(STRSXP, n));
+  SEXP nrow  = PROTECT(allocVector(REALSXP, n));
+  SEXP ncol  = PROTECT(allocVector(REALSXP, n));
+  SEXP off   = PROTECT(allocVector(REALSXP, n));
+  for (R_len_t i = 0; i < n; i++)
+  {
+    const pf_entry *e = &pf->index[i];
+    SET_STRING_ELT(name, i, mkChar(e->name));
+    SET_STRING_ELT(type, i, mkChar(type2char(e->type)));
+    SET_STRING_ELT(kind, i, mkChar(kinds[e->kind]));
+    REAL(nrow)[i] = (double) e->nrow;
+    REAL(ncol)[i] = (double) e->ncol;
+    REAL(off)[i]  = (double) e->offset;
+  }
+  SET_VECTOR_ELT(res, 0, name);
+  SET_VECTOR_ELT(res, 1, type);
+  SET_VECTOR_ELT(res, 2, kind);
+  SET_VECTOR_ELT(res, 3, nrow);
+  SET_VECTOR_ELT(res, 4, ncol);
+  SET_VECTOR_ELT(res, 5, off);
+  SET_STRING_ELT(names, 0, mkChar("name"));
+  SET_STRING_ELT(names, 1, mkChar("type"));
+  SET_STRING_ELT(names, 2, mkChar("kind"));
+  SET_STRING_ELT(names, 3, mkChar("nrow"));
+  SET_STRING_ELT(names, 4, mkChar("ncol"));
+  SET_STRING_ELT(names, 5, mkChar("offset"));
+  setAttrib(res, R_NamesSymbol, names);
+  UNPROTECT(8);
+  return res;
+}
+
+static R_xlen_t *pf_subscript(SEXP idx, int64_t n, R_xlen_t *len, const char *what)
+{
+  R_xlen_t *res;
+  if (isNull(idx))
+  {
+    *len = (R_xlen_t) n;
+    return NULL;
+  }
+  *len = XLENGTH(idx);
+  res  = (R_xlen_t *) R_alloc(*len > 0 ? *len : 1, sizeof(R_xlen_t));
+  for (R_xlen_t i = 0; i < *len; i++)
+  {
+    double x = isReal(idx) ? REAL(idx)[i] : (double) INTEGER(idx)[i];
+    if (ISNAN(x) || (isInteger(idx) && INTEGER(idx)[i] == NA_INTEGER) || 
+        x < 1 || x > (double) n)
+    {
+      error("%s subscript out of bounds", what);
+    }
+    res[i] = (R_xlen_t) x - 1;
+  }
+  return res;
+}
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+Read a section of a poppr file. Only the requested elements are copied from
+the mapped file.
+
+Input:
+  ptr  - the external pointer from poppr_file_open
+  name - the name of the section
+  rows - NULL or the 1-based elements of a vector, rows of a matrix, or
+         samples of a distance matrix
+  cols - NULL or the 1-based columns of a matrix
+Output:
+  a vector of the type of the section. Matrices keep their dimensions.
+  Distance matrices are returned as the condensed vector of the selected
+  samples.
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+SEXP poppr_file_section(SEXP ptr, SEXP name, SEXP rows, SEXP cols)
+{
+  pf_file *pf = pf_get(ptr);
+  const pf_entry *e = pf_find(pf, CHAR(STRING_ELT(name, 0)));
+  size_t tsize = pf_type_size(e->type);
+  const unsigned char *src = pf->base + e->offset;
+  R_xlen_t nr, nc;
+  R_xlen_t *ri = pf_subscript(rows, e->nrow, &nr, "row");
+  R_xlen_t *ci = pf_subscript(e->kind == 1 ? cols : R_NilValue, e->ncol, &nc, "column");
+  SEXP res;
+  unsigned char *dest;
+
+  if (e->kind == 2)
+  {
+    /* Lower triangle by columns: element (i, j) with i > j is at
+       n*j - j*(j+1)/2 + i - j - 1 */
+    R_xlen_t n   = (R_xlen_t) e->nrow;
+    R_xlen_t len = nr * (nr - 1) / 2;
+    res  = PROTECT(allocVector(e->type, len));
+    dest = (unsigned char *) pf_data(res);
+    if (ri == NULL)
+    {
+      memcpy(dest, src, len * tsize);
+    }
+    else
+    {
+      R_xlen_t k = 0;
+      for (R_xlen_t b = 0; b < nr; b++)
+      {
+        for (R_xlen_t a = b + 1; a < nr; a++)
+        {
+          R_xlen_t i = ri[a], j = ri[b];
+          if (i == j)
+          {
+            error("duplicated samples cannot be read from a distance matrix");
+          }
+          if (i < j)
+          {
+            R_xlen_t tmp = i;
+            i = j;
+            j = tmp;
+          }
+          memcpy(dest + k*tsize, src + (n*j - j*(j + 1)/2 + i - j - 1)*tsize, tsize);
+          k++;
+        }
+      }
+    }
+    UNPROTECT(1);
+    return res;
+  }
+
+  res  = PROTECT(allocVector(e->type, nr * nc));
+  dest = (unsigned char *) pf_data(res);
+  for (R_xlen_t j = 0; j < nc; j++)
+  {
+    const unsigned char *col = src + (ci == NULL ? j : ci[j]) * e->nrow * tsize;
+    unsigned char *out = dest + j * nr * tsize;
+    if (ri == NULL)
+    {
+      memcpy(out, col, nr * tsize);
+    }
+    else
+    {
+      for (R_xlen_t i = 0; i < nr; i++)
+      {
+        memcpy(out + i*tsize, col + ri[i]*tsize, tsize);
+      }
+    }
+  }
+  if (e->kind == 1)
+  {
+    SEXP dim = PROTECT(allocVector(INTSXP, 2));
+    INTEGER(dim)[0] = (int) nr;
+    INTEGER(dim)[1] = (int) nc;
+    setAttrib(res, R_DimSymbol, dim);
+    UNPROTECT(1);
+  }
+  UNPROTECT(1);
+  return res;
+}
@@ -0,0 +1,224 @@
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+#
+# This software was authored by Zhian N. Kamvar and Javier F. Tabima, graduate
+# students at Oregon State University; Jonah C. Brooks, undergraduate student at
+# Oregon State University; and Dr. Nik Grünwald, an employee of USDA-ARS.
+#
+# Permission to use, copy, modify, and distribute this software and its
+# documentation for educational, research and non-profit purposes, without fee,
+# and without a written agreement is hereby granted, provided that the statement
+# above is incorporated into the material, giving appropriate attribution to the
+# authors.
+#
+# Permission to incorporate this software into commercial products may be
+# obtained by contacting USDA ARS and OREGON STATE UNIVERSITY Office for
+# Commercialization and Corporate Development.
+#
+# The software program and documentation are supplied "as is", without any
+# accompanying services from the USDA or the University. USDA ARS or the
+# University do not warrant that the operation of the program will be
+# uninterrupted or error-free. The end-user understands that the program was
+# developed for research purposes and is advised not to rely exclusively on the
+# program for any reason.
+#
+# IN NO EVENT SHALL USDA ARS OR OREGON STATE UNIVERSITY BE LIABLE TO ANY PARTY
+# FOR DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES, INCLUDING
+# LOST PROFITS, ARISING OUT OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION,
+# EVEN IF THE OREGON STATE UNIVERSITY HAS BEEN ADVISED OF THE POSSIBILITY OF
+# SUCH DAMAGE. USDA ARS OR OREGON STATE UNIVERSITY SPECIFICALLY DISCLAIMS ANY
+# WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+# MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE AND ANY STATUTORY
+# WARRANTY OF NON-INFRINGEMENT. THE SOFTWARE PROVIDED HEREUNDER IS ON AN "AS IS"
+# BASIS, AND USDA ARS AND OREGON STATE UNIVERSITY HAVE NO OBLIGATIONS TO PROVIDE
+# MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS.
+#
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+#include <stdint.h>
+#include <string.h>
+#include <Rinternals.h>
+#include <R.h>
+
+/*
+Content hashes
+==============
+
+The caches of poppr (see R/global_memory.r) are keyed by a hash of the data
+and the arguments of a calculation, so a result is found again whenever the
+same data are used, no matter which object or session they come from.
+
+The hash walks an R object and consumes the bytes of its vectors eight at a
+time in two independent 64 bit lanes: FNV-1a (as for the genotypes in
+population_summary.c) and a multiply-rotate lane. Together they give a 128
+bit hash, which is printed as 32 hexadecimal digits. The type and length of
+every vector, the names of symbols, the elements of lists and pairlists,
+and all attributes (and so the slots of S4 objects) are part of the hash.
+Environments, functions, and external pointers only contribute their type,
+so functions have to be part of a key by their text. The attributes are read
+with a call to attributes() so that only the API of R is used.
+
+No copy of the object is made, so hashing a large genind object takes about
+as long as reading its tables once.
+*/
+
+typedef struct {
+  uint64_t a;
+  uint64_t b;
+  SEXP attr_call; // attributes(quote(x))
+  SEXP attr_arg;  // quote(x)
+} hash_state;
+
+static void hash_object(hash_state* h, SEXP x);
+static void hash_attributes(hash_state* h, SEXP x);
+
+static inline void hash_word(hash_state* h, uint64_t w)
+{
+  h->a ^= w;
+  h->a *= 1099511628211ULL;
+  h->b ^= w*0x9E3779B97F4A7C15ULL;
+  h->b = (h->b << 31) | (h->b >> 33);
+  h->b *= 0xC2B2AE3D27D4EB4FULL;
+}
+
+static void hash_bytes(hash_state* h, const void* data, size_t len)
+{
+  const unsigned char* p = (const unsigned char*)data;
+  uint64_t w;
+  size_t i;
+  hash_word(h, (uint64_t)len);
+  for (i = 0; i + 8 <= len; i += 8)
+  {
+    memcpy(&w, p + i, 8);
+    hash_word(h, w);
+  }
+  if (i < len)
+  {
+    w = 0;
+    memcpy(&w, p + i, len - i);
+    hash_word(h, w);
+  }
+}
+
+static void hash_string(hash_state* h, SEXP s)
+{
+  if (s == NA_STRING)
+  {
+    hash_word(h, 0xFFFFFFFFFFFFFFFFULL);
+    return;
+  }
+  hash_bytes(h, CHAR(s), strlen(CHAR(s)));
+}
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+Hashes the content of an R object.
+
+Input: any R object
+Output: a string of 32 hexadecimal digits
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+SEXP poppr_hash(SEXP x)
+{
+  hash_state h = {14695981039346656037ULL, 0x27D4EB2F165667C5ULL, 
+                  R_NilValue, R_NilValue};
+  char out[33];
+  PROTECT(h.attr_arg = lang2(install("quote"), R_NilValue));
+  PROTECT(h.attr_call = lang2(install("attributes"), h.attr_arg));
+  hash_object(&h, x);
+  UNPROTECT(2);
+  // One more round so that the last bytes reach every bit of both lanes
+  hash_word(&h, h.a ^ h.b);
+  snprintf(out, sizeof(out), "%016llx%016llx", 
+           (unsigned long long)h.a, (unsigned long long)h.b);
+  return mkString(out);
+}
+
+static void hash_object(hash_state* h, SEXP x)
+{
+  R_xlen_t i;
+  R_xlen_t n;
+  int type = TYPEOF(x);
+  hash_word(h, (uint64_t)type);
+  switch (type)
+  {
+    case NILSXP:
+      return;
+    case SYMSXP:
+      hash_string(h, PRINTNAME(x));
+      return;
+    case CHARSXP:
+      hash_string(h, x);
+      return;
+    case LISTSXP:
+    case LANGSXP:
+    case DOTSXP:
+      // Pairlists can be long, so they are walked in a loop. Their tags
+      // are their names, so only the attributes of the first cell are
+      // hashed.
+      hash_attributes(h, x);
+      for (; x != R_NilValue && (TYPEOF(x) == LISTSXP || TYPEOF(x) == LANGSXP 
+                                 || TYPEOF(x) == DOTSXP); x = CDR(x))
+      {
+        hash_object(h, TAG(x));
+        hash_object(h, CAR(x));
+      }
+      hash_object(h, x);
+      return;
+    case LGLSXP:
+      hash_bytes(h, LOGICAL(x), XLENGTH(x)*sizeof(int));
+      break;
+    case INTSXP:
+      hash_bytes(h, INTEGER(x), XLENGTH(x)*sizeof(int));
+      break;
+    case REALSXP:
+      hash_bytes(h, REAL(x), XLENGTH(x)*sizeof(double));
+      break;
+    case CPLXSXP:
+      hash_bytes(h, COMPLEX(x), XLENGTH(x)*sizeof(Rcomplex));
+      break;
+    case RAWSXP:
+      hash_bytes(h, RAW(x), XLENGTH(x));
+      break;
+    case STRSXP:
+      n = XLENGTH(x);
+      hash_word(h, (uint64_t)n);
+      for (i = 0; i < n; i++)
+      {
+        hash_string(h, STRING_ELT(x, i));
+      }
+      break;
+    case VECSXP:
+    case EXPRSXP:
+      n = XLENGTH(x);
+      hash_word(h, (uint64_t)n);
+      for (i = 0; i < n; i++)
+      {
+        hash_object(h, VECTOR_ELT(x, i));
+      }
+      break;
+    case S4SXP:
+      break;
+    default:
+      // Environments, functions, and pointers have no content to hash
+      return;
+  }
+  hash_attributes(h, x);
+}
+
+// Hashes the names and values of the attributes of x
+static void hash_attributes(hash_state* h, SEXP x)
+{
+  SEXP attr;
+  SEXP names;
+  R_xlen_t i;
+  R_xlen_t n;
+  SETCADR(h->attr_arg, x);
+  PROTECT(attr = eval(h->attr_call, R_BaseEnv));
+  SETCADR(h->attr_arg, R_NilValue);
+  n = (attr == R_NilValue) ? 0 : XLENGTH(attr);
+  hash_word(h, (uint64_t)n);
+  names = getAttrib(attr, R_NamesSymbol);
+  for (i = 0; i < n; i++)
+  {
+    hash_string(h, STRING_ELT(names, i));
+    hash_object(h, VECTOR_ELT(attr, i));
+  }
+  UNPROTECT(1);
+}
@@ -0,0 +1,272 @@
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+#
+# This software was authored by Zhian N. Kamvar and Javier F. Tabima, graduate
+# students at Oregon State University; Jonah C. Brooks, undergraduate student at
+# Oregon State University; and Dr. Nik Grünwald, an employee of USDA-ARS.
+#
+# Permission to use, copy, modify, and distribute this software and its
+# documentation for educational, research and non-profit purposes, without fee,
+# and without a written agreement is hereby granted, provided that the statement
+# above is incorporated into the material, giving appropriate attribution to the
+# authors.
+#
+# Permission to incorporate this software into commercial products may be
+# obtained by contacting USDA ARS and OREGON STATE UNIVERSITY Office for
+# Commercialization and Corporate Development.
+#
+# The software program and documentation are supplied "as is", without any
+# accompanying services from the USDA or the University. USDA ARS or the
+# University do not warrant that the operation of the program will be
+# uninterrupted or error-free. The end-user understands that the program was
+# developed for research purposes and is advised not to rely exclusively on the
+# program for any reason.
+#
+# IN NO EVENT SHALL USDA ARS OR OREGON STATE UNIVERSITY BE LIABLE TO ANY PARTY
+# FOR DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES, INCLUDING
+# LOST PROFITS, ARISING OUT OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION,
+# EVEN IF THE OREGON STATE UNIVERSITY HAS BEEN ADVISED OF THE POSSIBILITY OF
+# SUCH DAMAGE. USDA ARS OR OREGON STATE UNIVERSITY SPECIFICALLY DISCLAIMS ANY
+# WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+# MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE AND ANY STATUTORY
+# WARRANTY OF NON-INFRINGEMENT. THE SOFTWARE PROVIDED HEREUNDER IS ON AN "AS IS"
+# BASIS, AND USDA ARS AND OREGON STATE UNIVERSITY HAVE NO OBLIGATIONS TO PROVIDE
+# MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS.
+#
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef __unix__
+#include <unistd.h>
+#endif
+#include <Rinternals.h>
+#include <R.h>
+
+/*
+Memory limits
+=============
+
+The memory planner in R (memory_plan()) compares the memory a calculation
+needs with the memory the process may still use. Without
+options(poppr.memory_limit), that is
+
+  - the limit of the cgroup of the process less its usage (memory.max and
+    memory.current for cgroup v2 or memory.limit_in_bytes and
+    memory.usage_in_bytes for cgroup v1), or
+  - the memory the kernel reports as available to new processes
+    (MemAvailable in /proc/meminfo).
+
+The cgroup of the process is the "0::<path>" line of /proc/self/cgroup for
+cgroup v2 or the line of the memory controller for cgroup v1. A limit may be
+set on the cgroup or on any of its ancestors, so the hierarchy is walked up to
+its root and the limit with the least memory left is used. If the path cannot
+be read (or is not visible, as in many containers), only the root of the
+hierarchy is read.
+
+Every value that cannot be read is NA, so the planner does not plan on
+systems without these files.
+*/
+
+#define CGROUP_PATH 4096
+
+static double read_bytes(const char* file);
+static double meminfo_bytes(const char* key);
+static void cgroup_path(int version, char* path, size_t size);
+static void cgroup_limit(const char* root, const char* path, 
+                         const char* limit_file, const char* usage_file, 
+                         double physical, double* limit, double* usage);
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+Reports the memory of the machine and the memory limit of the process.
+
+Output: a named numeric vector with the physical memory, the available memory,
+        the cgroup memory limit, and the memory used by the cgroup, in bytes
+        (NA if they are not known or there is no limit).
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+SEXP poppr_memory_info(void)
+{
+  SEXP Rout;
+  SEXP Rnames;
+  double physical = NA_REAL;
+  double limit = NA_REAL;
+  double usage = NA_REAL;
+  char path[CGROUP_PATH];
+  #if defined(__unix__) && defined(_SC_PHYS_PAGES) && defined(_SC_PAGE_SIZE)
+  {
+    long pages = sysconf(_SC_PHYS_PAGES);
+    long size = sysconf(_SC_PAGE_SIZE);
+    if (pages > 0 && size > 0)
+    {
+      physical = (double)pages*(double)size;
+    }
+  }
+  #endif
+  cgroup_path(2, path, sizeof(path));
+  cgroup_limit("/sys/fs/cgroup", path, "memory.max", "memory.current", 
+               physical, &limit, &usage);
+  if (ISNA(limit))
+  {
+    cgroup_path(1, path, sizeof(path));
+    cgroup_limit("/sys/fs/cgroup/memory", path, "memory.limit_in_bytes", 
+                 "memory.usage_in_bytes", physical, &limit, &usage);
+  }
+  PROTECT(Rout = allocVector(REALSXP, 4));
+  PROTECT(Rnames = allocVector(STRSXP, 4));
+  REAL(Rout)[0] = physical;
+  REAL(Rout)[1] = meminfo_bytes("MemAvailable:");
+  REAL(Rout)[2] = limit;
+  REAL(Rout)[3] = ISNA(limit) ? NA_REAL : usage;
+  SET_STRING_ELT(Rnames, 0, mkChar("physical"));
+  SET_STRING_ELT(Rnames, 1, mkChar("available"));
+  SET_STRING_ELT(Rnames, 2, mkChar("cgroup"));
+  SET_STRING_ELT(Rnames, 3, mkChar("cgroup_usage"));
+  setAttrib(Rout, R_NamesSymbol, Rnames);
+  UNPROTECT(2);
+  return Rout;
+}
+
+// Reads a number of bytes from a file with one number, or NA if the file
+// cannot be read or says "max".
+static double read_bytes(const char* file)
+{
+  FILE* f;
+  double bytes = NA_REAL;
+  char first[32];
+  f = fopen(file, "r");
+  if (f == NULL)
+  {
+    return NA_REAL;
+  }
+  if (fscanf(f, "%31s", first) == 1 && first[0] != 'm')
+  {
+    bytes = atof(first);
+  }
+  fclose(f);
+  return (bytes > 0.0) ? bytes : NA_REAL;
+}
+
+// Reads a line of /proc/meminfo (in kB) in bytes, or NA.
+static double meminfo_bytes(const char* key)
+{
+  FILE* f;
+  char line[128];
+  double kb = NA_REAL;
+  size_t len = strlen(key);
+  f = fopen("/proc/meminfo", "r");
+  if (f == NULL)
+  {
+    return NA_REAL;
+  }
+  while (fgets(line, sizeof(line), f) != NULL)
+  {
+    if (strncmp(line, key, len) == 0)
+    {
+      kb = atof(line + len);
+      break;
+    }
+  }
+  fclose(f);
+  return ISNA(kb) ? NA_REAL : kb*1024.0;
+}
+
+// TRUE if a comma separated list of cgroup v1 controllers has the memory
+// controller.
+static int has_memory_controller(const char* controllers)
+{
+  const char* c = controllers;
+  while (c != NULL && *c != '\0')
+  {
+    if (strncmp(c, "memory", 6) == 0 && (c[6] == ',' || c[6] == '\0'))
+    {
+      return 1;
+    }
+    c = strchr(c, ',');
+    c = (c == NULL) ? NULL : c + 1;
+  }
+  return 0;
+}
+
+// Reads the path of the cgroup of the process for cgroup v2 (version 2) or the
+// memory controller of cgroup v1 (version 1) from /proc/self/cgroup. The path
+// is empty if it cannot be found.
+static void cgroup_path(int version, char* path, size_t size)
+{
+  FILE* f;
+  char line[CGROUP_PATH];
+  path[0] = '\0';
+  f = fopen("/proc/self/cgroup", "r");
+  if (f == NULL)
+  {
+    return;
+  }
+  // Each line is "<hierarchy id>:<controllers>:<path>"
+  while (fgets(line, sizeof(line), f) != NULL)
+  {
+    char* controllers = strchr(line, ':');
+    char* p;
+    if (controllers == NULL)
+    {
+      continue;
+    }
+    controllers++;
+    p = strchr(controllers, ':');
+    if (p == NULL)
+    {
+      continue;
+    }
+    *p++ = '\0';
+    p[strcspn(p, "\n")] = '\0';
+    if ((version == 2 && strncmp(line, "0:", 2) == 0 && controllers[0] == '\0') ||
+        (version == 1 && has_memory_controller(controllers)))
+    {
+      snprintf(path, size, "%s", p);
+      break;
+    }
+  }
+  fclose(f);
+}
+
+// Walks from the cgroup at path up to the root of the hierarchy mounted at root
+// and keeps the limit (and usage) with the least memory left. Limits that are
+// not below the physical memory are no limit (cgroup v1 reports no limit as a
+// number close to the largest 64 bit integer). The limit stays NA if none of
+// the cgroups has a limit.
+static void cgroup_limit(const char* root, const char* path, 
+                         const char* limit_file, const char* usage_file, 
+                         double physical, double* limit, double* usage)
+{
+  char dir[CGROUP_PATH];
+  char file[CGROUP_PATH + 64];
+  size_t len;
+  snprintf(dir, sizeof(dir), "%s", path);
+  while (1)
+  {
+    double lim;
+    double use;
+    char* slash;
+    len = strlen(dir);
+    while (len > 0 && dir[len - 1] == '/')
+    {
+      dir[--len] = '\0';
+    }
+    snprintf(file, sizeof(file), "%s%s/%s", root, dir, limit_file);
+    lim = read_bytes(file);
+    if (!ISNA(lim) && (ISNA(physical) || lim < physical))
+    {
+      snprintf(file, sizeof(file), "%s%s/%s", root, dir, usage_file);
+      use = read_bytes(file);
+      if (ISNA(*limit) || lim - (ISNA(use) ? 0.0 : use) < 
+                          *limit - (ISNA(*usage) ? 0.0 : *usage))
+      {
+        *limit = lim;
+        *usage = use;
+      }
+    }
+    slash = strrchr(dir, '/');
+    if (len == 0 || slash == NULL)
+    {
+      break;
+    }
+    *slash = '\0';
+  }
+}
@@ -0,0 +1,225 @@
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+#
+# This software was authored by Zhian N. Kamvar and Javier F. Tabima, graduate
+# students at Oregon State University; Jonah C. Brooks, undergraduate student at
+# Oregon State University; and Dr. Nik Grünwald, an employee of USDA-ARS.
+#
+# Permission to use, copy, modify, and distribute this software and its
+# documentation for educational, research and non-profit purposes, without fee,
+# and without a written agreement is hereby granted, provided that the statement
+# above is incorporated into the material, giving appropriate attribution to the
+# authors.
+#
+# Permission to incorporate this software into commercial products may be
+# obtained by contacting USDA ARS and OREGON STATE UNIVERSITY Office for
+# Commercialization and Corporate Development.
+#
+# The software program and documentation are supplied "as is", without any
+# accompanying services from the USDA or the University. USDA ARS or the
+# University do not warrant that the operation of the program will be
+# uninterrupted or error-free. The end-user understands that the program was
+# developed for research purposes and is advised not to rely exclusively on the
+# program for any reason.
+#
+# IN NO EVENT SHALL USDA ARS OR OREGON STATE UNIVERSITY BE LIABLE TO ANY PARTY
+# FOR DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES, INCLUDING
+# LOST PROFITS, ARISING OUT OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION,
+# EVEN IF THE OREGON STATE UNIVERSITY HAS BEEN ADVISED OF THE POSSIBILITY OF
+# SUCH DAMAGE. USDA ARS OR OREGON STATE UNIVERSITY SPECIFICALLY DISCLAIMS ANY
+# WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+# MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE AND ANY STATUTORY
+# WARRANTY OF NON-INFRINGEMENT. THE SOFTWARE PROVIDED HEREUNDER IS ON AN "AS IS"
+# BASIS, AND USDA ARS AND OREGON STATE UNIVERSITY HAVE NO OBLIGATIONS TO PROVIDE
+# MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS.
+#
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+#include <string.h>
+// Include openMP if the compiler supports it
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include <Rinternals.h>
+#include <R_ext/Utils.h>
+#include <R.h>
+#include "poppr_profile.h"
+
+static SEXP profile_named(const char** names, const double* values, int n);
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+Sets up the profile of a kernel. The profile is only recorded if
+options(poppr.profile = TRUE). This must be called from the main thread.
+
+Input: p       - the profile struct
+       kernel  - the name of the kernel (a string constant)
+       threads - the number of threads the kernel uses
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+void poppr_profile_init(struct poppr_profile* p, const char* kernel, int threads)
+{
+  SEXP option = GetOption1(install("poppr.profile"));
+  p->enabled = !isNull(option) && asLogical(option) == TRUE;
+  p->kernel  = kernel;
+  p->threads = (threads > 0) ? threads : 1;
+  p->phase   = -1;
+  p->start   = 0.0;
+  p->nphases = 0;
+  p->ncounts = 0;
+  p->thread_seconds = NULL;
+  if (p->enabled)
+  {
+    p->thread_seconds = (double*)R_alloc(p->threads*POPPR_PROFILE_STRIDE, sizeof(double));
+    memset(p->thread_seconds, 0, p->threads*POPPR_PROFILE_STRIDE*sizeof(double));
+  }
+}
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+Ends the current phase and starts the given phase. Phases after the first
+POPPR_PROFILE_MAX are not recorded.
+
+Input: p     - the profile struct
+       phase - the name of the phase (a string constant) or NULL to only end
+               the current phase
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+void poppr_profile_phase(struct poppr_profile* p, const char* phase)
+{
+  double now;
+  int i;
+  if (!p->enabled)
+  {
+    return;
+  }
+  now = poppr_profile_now();
+  if (p->phase >= 0)
+  {
+    p->phase_seconds[p->phase] += now - p->start;
+  }
+  p->phase = -1;
+  p->start = now;
+  if (phase == NULL)
+  {
+    return;
+  }
+  for (i = 0; i < p->nphases; i++)
+  {
+    if (strcmp(p->phase_names[i], phase) == 0)
+    {
+      p->phase = i;
+      return;
+    }
+  }
+  if (p->nphases < POPPR_PROFILE_MAX)
+  {
+    p->phase = p->nphases++;
+    p->phase_names[p->phase] = phase;
+    p->phase_seconds[p->phase] = 0.0;
+  }
+}
+
+// Adds n to the named count (see poppr_profile_count()).
+void poppr_profile_add(struct poppr_profile* p, const char* name, double n)
+{
+  int i;
+  for (i = 0; i < p->ncounts; i++)
+  {
+    if (strcmp(p->count_names[i], name) == 0)
+    {
+      p->counts[i] += n;
+      return;
+    }
+  }
+  if (p->ncounts < POPPR_PROFILE_MAX)
+  {
+    p->count_names[p->ncounts] = name;
+    p->counts[p->ncounts++] = n;
+  }
+}
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+Ends the profile and attaches it to the result of the kernel. The attribute is
+a list of class "poppr_profile" with one element per kernel, so the profiles
+of kernels that were called by this kernel (and attached to result before) are
+kept. Each element is a list with
+
+  kernel         - the name of the kernel
+  threads        - the number of threads
+  seconds        - a named vector of the seconds of each phase
+  counts         - a named vector of the counts
+  thread_seconds - the busy time of each thread
+  imbalance      - the longest busy time over the mean busy time
+
+Input: p      - the profile struct
+       result - the result of the kernel
+Output: result
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+SEXP poppr_profile_attach(struct poppr_profile* p, SEXP result)
+{
+  SEXP R_sym;
+  SEXP R_old;
+  SEXP R_new;
+  SEXP R_entry;
+  SEXP R_names;
+  SEXP R_busy;
+  double total = 0.0;
+  double longest = 0.0;
+  int nold;
+  int i;
+  if (!p->enabled)
+  {
+    return result;
+  }
+  poppr_profile_phase(p, NULL);
+  PROTECT(result);
+  R_sym = install("poppr_profile");
+  R_old = getAttrib(result, R_sym);
+  nold  = isNull(R_old) ? 0 : length(R_old);
+
+  PROTECT(R_entry = allocVector(VECSXP, 6));
+  PROTECT(R_names = allocVector(STRSXP, 6));
+  SET_STRING_ELT(R_names, 0, mkChar("kernel"));
+  SET_STRING_ELT(R_names, 1, mkChar("threads"));
+  SET_STRING_ELT(R_names, 2, mkChar("seconds"));
+  SET_STRING_ELT(R_names, 3, mkChar("counts"));
+  SET_STRING_ELT(R_names, 4, mkChar("thread_seconds"));
+  SET_STRING_ELT(R_names, 5, mkChar("imbalance"));
+  setAttrib(R_entry, R_NamesSymbol, R_names);
+  SET_VECTOR_ELT(R_entry, 0, mkString(p->kernel));
+  SET_VECTOR_ELT(R_entry, 1, ScalarInteger(p->threads));
+  SET_VECTOR_ELT(R_entry, 2, profile_named(p->phase_names, p->phase_seconds, p->nphases));
+  SET_VECTOR_ELT(R_entry, 3, profile_named(p->count_names, p->counts, p->ncounts));
+  R_busy = allocVector(REALSXP, p->threads);
+  SET_VECTOR_ELT(R_entry, 4, R_busy);
+  for (i = 0; i < p->threads; i++)
+  {
+    REAL(R_busy)[i] = p->thread_seconds[i*POPPR_PROFILE_STRIDE];
+    total += REAL(R_busy)[i];
+    longest = (REAL(R_busy)[i] > longest) ? REAL(R_busy)[i] : longest;
+  }
+  SET_VECTOR_ELT(R_entry, 5, ScalarReal(total > 0 ? longest/(total/p->threads) : NA_REAL));
+
+  PROTECT(R_new = allocVector(VECSXP, nold + 1));
+  for (i = 0; i < nold; i++)
+  {
+    SET_VECTOR_ELT(R_new, i, VECTOR_ELT(R_old, i));
+  }
+  SET_VECTOR_ELT(R_new, nold, R_entry);
+  setAttrib(R_new, R_ClassSymbol, mkString("poppr_profile"));
+  setAttrib(result, R_sym, R_new);
+  UNPROTECT(4);
+  return result;
+}
+
+static SEXP profile_named(const char** names, const double* values, int n)
+{
+  SEXP R_out;
+  SEXP R_names;
+  int i;
+  PROTECT(R_out = allocVector(REALSXP, n));
+  PROTECT(R_names = allocVector(STRSXP, n));
+  for (i = 0; i < n; i++)
+  {
+    REAL(R_out)[i] = values[i];
+    SET_STRING_ELT(R_names, i, mkChar(names[i]));
+  }
+  setAttrib(R_out, R_NamesSymbol, R_names);
+  UNPROTECT(2);
+  return R_out;
+}
@@ -0,0 +1,134 @@
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+#
+# This software was authored by Zhian N. Kamvar and Javier F. Tabima, graduate
+# students at Oregon State University; Jonah C. Brooks, undergraduate student at
+# Oregon State University; and Dr. Nik Grünwald, an employee of USDA-ARS.
+#
+# Permission to use, copy, modify, and distribute this software and its
+# documentation for educational, research and non-profit purposes, without fee,
+# and without a written agreement is hereby granted, provided that the statement
+# above is incorporated into the material, giving appropriate attribution to the
+# authors.
+#
+# Permission to incorporate this software into commercial products may be
+# obtained by contacting USDA ARS and OREGON STATE UNIVERSITY Office for
+# Commercialization and Corporate Development.
+#
+# The software program and documentation are supplied "as is", without any
+# accompanying services from the USDA or the University. USDA ARS or the
+# University do not warrant that the operation of the program will be
+# uninterrupted or error-free. The end-user understands that the program was
+# developed for research purposes and is advised not to rely exclusively on the
+# program for any reason.
+#
+# IN NO EVENT SHALL USDA ARS OR OREGON STATE UNIVERSITY BE LIABLE TO ANY PARTY
+# FOR DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES, INCLUDING
+# LOST PROFITS, ARISING OUT OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION,
+# EVEN IF THE OREGON STATE UNIVERSITY HAS BEEN ADVISED OF THE POSSIBILITY OF
+# SUCH DAMAGE. USDA ARS OR OREGON STATE UNIVERSITY SPECIFICALLY DISCLAIMS ANY
+# WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+# MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE AND ANY STATUTORY
+# WARRANTY OF NON-INFRINGEMENT. THE SOFTWARE PROVIDED HEREUNDER IS ON AN "AS IS"
+# BASIS, AND USDA ARS AND OREGON STATE UNIVERSITY HAVE NO OBLIGATIONS TO PROVIDE
+# MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS.
+#
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+#ifndef POPPR_PROFILE_H
+#define POPPR_PROFILE_H
+
+#include <time.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include <Rinternals.h>
+
+/*
+Instrumentation of kernels
+==========================
+
+With options(poppr.profile = TRUE), a kernel records where its time went and
+attaches it to its result as the "poppr_profile" attribute (see
+poppr_profile() in R):
+
+  - phases: the kernel switches between named phases with
+    poppr_profile_phase() on the main thread. The time between two switches
+    is added to the phase, so a phase can be entered more than once.
+  - counts: named amounts of work (pairs, loci, bytes, ...) added with
+    poppr_profile_count().
+  - threads: the busy time of each thread, measured around units of parallel
+    work with poppr_profile_tic() and poppr_profile_toc(). The imbalance is
+    the longest busy time over the mean busy time.
+
+When the option is not set, poppr_profile_init() only reads it and every other
+function returns after testing one flag, so the kernel does not read any
+clocks. Memory of a profile is allocated with R_alloc, so an interrupted
+kernel does not leak it.
+*/
+
+#define POPPR_PROFILE_MAX 8
+// The busy times of two threads are this many doubles (one cache line) apart,
+// so threads do not share the line they write to.
+#define POPPR_PROFILE_STRIDE 8
+
+struct poppr_profile {
+  int enabled;
+  const char* kernel;
+  int threads;
+  int phase;            // current phase or -1
+  double start;         // start of the current phase
+  int nphases;
+  const char* phase_names[POPPR_PROFILE_MAX];
+  double phase_seconds[POPPR_PROFILE_MAX];
+  int ncounts;
+  const char* count_names[POPPR_PROFILE_MAX];
+  double counts[POPPR_PROFILE_MAX];
+  double* thread_seconds; // busy time of each thread (strided)
+};
+
+void poppr_profile_init(struct poppr_profile* p, const char* kernel, int threads);
+void poppr_profile_phase(struct poppr_profile* p, const char* phase);
+void poppr_profile_add(struct poppr_profile* p, const char* name, double n);
+SEXP poppr_profile_attach(struct poppr_profile* p, SEXP result);
+
+static inline double poppr_profile_now(void)
+{
+  #ifdef _OPENMP
+  return omp_get_wtime();
+  #else
+  return (double)clock()/CLOCKS_PER_SEC;
+  #endif
+}
+
+// Adds to a count. Call from the main thread.
+static inline void poppr_profile_count(struct poppr_profile* p, const char* name, double n)
+{
+  if (p->enabled)
+  {
+    poppr_profile_add(p, name, n);
+  }
+}
+
+// Starts a unit of parallel work. Safe to call from any thread.
+static inline double poppr_profile_tic(struct poppr_profile* p)
+{
+  return p->enabled ? poppr_profile_now() : 0.0;
+}
+
+// Adds the time since poppr_profile_tic() to the busy time of this thread.
+static inline void poppr_profile_toc(struct poppr_profile* p, double tic)
+{
+  int thread = 0;
+  if (!p->enabled)
+  {
+    return;
+  }
+  #ifdef _OPENMP
+  thread = omp_get_thread_num();
+  #endif
+  if (thread < p->threads)
+  {
+    p->thread_seconds[thread*POPPR_PROFILE_STRIDE] += poppr_profile_now() - tic;
+  }
+}
+
+#endif
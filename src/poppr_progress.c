@@ -0,0 +1,162 @@
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+#
+# This software was authored by Zhian N. Kamvar and Javier F. Tabima, graduate
+# students at Oregon State University; Jonah C. Brooks, undergraduate student at
+# Oregon State University; and Dr. Nik Grünwald, an employee of USDA-ARS.
+#
+# Permission to use, copy, modify, and distribute this software and its
+# documentation for educational, research and non-profit purposes, without fee,
+# and without a written agreement is hereby granted, provided that the statement
+# above is incorporated into the material, giving appropriate attribution to the
+# authors.
+#
+# Permission to incorporate this software into commercial products may be
+# obtained by contacting USDA ARS and OREGON STATE UNIVERSITY Office for
+# Commercialization and Corporate Development.
+#
+# The software program and documentation are supplied "as is", without any
+# accompanying services from the USDA or the University. USDA ARS or the
+# University do not warrant that the operation of the program will be
+# uninterrupted or error-free. The end-user understands that the program was
+# developed for research purposes and is advised not to rely exclusively on the
+# program for any reason.
+#
+# IN NO EVENT SHALL USDA ARS OR OREGON STATE UNIVERSITY BE LIABLE TO ANY PARTY
+# FOR DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES, INCLUDING
+# LOST PROFITS, ARISING OUT OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION,
+# EVEN IF THE OREGON STATE UNIVERSITY HAS BEEN ADVISED OF THE POSSIBILITY OF
+# SUCH DAMAGE. USDA ARS OR OREGON STATE UNIVERSITY SPECIFICALLY DISCLAIMS ANY
+# WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+# MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE AND ANY STATUTORY
+# WARRANTY OF NON-INFRINGEMENT. THE SOFTWARE PROVIDED HEREUNDER IS ON AN "AS IS"
+# BASIS, AND USDA ARS AND OREGON STATE UNIVERSITY HAVE NO OBLIGATIONS TO PROVIDE
+# MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS.
+#
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+#include <stdint.h>
+#include <time.h>
+// Include openMP if the compiler supports it
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include <Rinternals.h>
+#include <R_ext/Utils.h>
+#include <R.h>
+#include "poppr_progress.h"
+
+static double progress_time(void);
+static void progress_check_interrupt(void* data);
+static void progress_report(struct poppr_progress* p);
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+Sets up the progress of a kernel. This must be called from the main thread
+before any threads are started.
+
+Input: p        - the progress struct
+       total    - the total amount of work (the sum of poppr_progress_add())
+       callback - an R function or NULL (no progress is reported)
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+void poppr_progress_init(struct poppr_progress* p, double total, SEXP callback)
+{
+  p->total     = (total > 0) ? total : 1;
+  p->done      = 0;
+  p->reported  = 0;
+  p->cancelled = 0;
+  p->last      = progress_time();
+  p->callback  = isFunction(callback) ? callback : R_NilValue;
+}
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+Checks for a user interrupt and reports progress if POPPR_PROGRESS_INTERVAL
+seconds have passed since the last poll. This does nothing on any thread but
+the master thread, so it can be called from every iteration of a parallel
+loop.
+
+Input: p - the progress struct
+Output: 1 if the kernel was interrupted, 0 otherwise
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+int poppr_progress_poll(struct poppr_progress* p)
+{
+  double now;
+  #ifdef _OPENMP
+  if (omp_get_thread_num() != 0)
+  {
+    return poppr_progress_cancelled(p);
+  }
+  #endif
+  if (p->cancelled)
+  {
+    return 1;
+  }
+  now = progress_time();
+  if (now - p->last < POPPR_PROGRESS_INTERVAL)
+  {
+    return 0;
+  }
+  p->last = now;
+  // R_CheckUserInterrupt() jumps to the top level on an interrupt, which
+  // R_ToplevelExec() catches so that the kernel can clean up.
+  if (!R_ToplevelExec(progress_check_interrupt, NULL))
+  {
+    #ifdef _OPENMP
+    #pragma omp atomic write
+    #endif
+    p->cancelled = 1;
+    return 1;
+  }
+  progress_report(p);
+  return 0;
+}
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+Ends the progress of a kernel. This must be called from the main thread after
+the parallel regions and after all memory of the kernel is freed, since it
+raises an error if the kernel was interrupted.
+
+Input: p - the progress struct
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+void poppr_progress_finish(struct poppr_progress* p)
+{
+  if (p->cancelled)
+  {
+    error("interrupted by the user");
+  }
+  p->done = (int64_t)p->total;
+  progress_report(p);
+}
+
+// Calls the R callback with the proportion of work done since the last call.
+// Errors in the callback are printed and otherwise ignored.
+static void progress_report(struct poppr_progress* p)
+{
+  SEXP call;
+  int err;
+  int64_t done;
+  #ifdef _OPENMP
+  #pragma omp atomic read
+  #endif
+  done = p->done;
+  if (isNull(p->callback) || done <= p->reported)
+  {
+    return;
+  }
+  PROTECT(call = lang2(p->callback, ScalarReal((done - p->reported)/p->total)));
+  R_tryEval(call, R_GlobalEnv, &err);
+  UNPROTECT(1);
+  p->reported = done;
+}
+
+static void progress_check_interrupt(void* data)
+{
+  (void)data;
+  R_CheckUserInterrupt();
+}
+
+static double progress_time(void)
+{
+  #ifdef _OPENMP
+  return omp_get_wtime();
+  #else
+  return (double)time(NULL);
+  #endif
+}
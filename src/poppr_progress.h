@@ -0,0 +1,105 @@
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+#
+# This software was authored by Zhian N. Kamvar and Javier F. Tabima, graduate
+# students at Oregon State University; Jonah C. Brooks, undergraduate student at
+# Oregon State University; and Dr. Nik Grünwald, an employee of USDA-ARS.
+#
+# Permission to use, copy, modify, and distribute this software and its
+# documentation for educational, research and non-profit purposes, without fee,
+# and without a written agreement is hereby granted, provided that the statement
+# above is incorporated into the material, giving appropriate attribution to the
+# authors.
+#
+# Permission to incorporate this software into commercial products may be
+# obtained by contacting USDA ARS and OREGON STATE UNIVERSITY Office for
+# Commercialization and Corporate Development.
+#
+# The software program and documentation are supplied "as is", without any
+# accompanying services from the USDA or the University. USDA ARS or the
+# University do not warrant that the operation of the program will be
+# uninterrupted or error-free. The end-user understands that the program was
+# developed for research purposes and is advised not to rely exclusively on the
+# program for any reason.
+#
+# IN NO EVENT SHALL USDA ARS OR OREGON STATE UNIVERSITY BE LIABLE TO ANY PARTY
+# FOR DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES, INCLUDING
+# LOST PROFITS, ARISING OUT OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION,
+# EVEN IF THE OREGON STATE UNIVERSITY HAS BEEN ADVISED OF THE POSSIBILITY OF
+# SUCH DAMAGE. USDA ARS OR OREGON STATE UNIVERSITY SPECIFICALLY DISCLAIMS ANY
+# WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+# MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE AND ANY STATUTORY
+# WARRANTY OF NON-INFRINGEMENT. THE SOFTWARE PROVIDED HEREUNDER IS ON AN "AS IS"
+# BASIS, AND USDA ARS AND OREGON STATE UNIVERSITY HAVE NO OBLIGATIONS TO PROVIDE
+# MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS.
+#
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+#ifndef POPPR_PROGRESS_H
+#define POPPR_PROGRESS_H
+
+#include <stdint.h>
+#include <Rinternals.h>
+
+/*
+Progress and interruption of parallel kernels
+=============================================
+
+R may only be called from the main thread, and an interrupt or an error
+longjmps out of the caller, so worker threads must never call
+R_CheckUserInterrupt() or any other function that can reach R. Instead, a
+kernel shares one poppr_progress struct with its workers:
+
+  - workers add the work they finish with poppr_progress_add() (an atomic
+    add) and skip their remaining work once poppr_progress_cancelled() is
+    true,
+  - the master thread (thread 0, which is the R main thread) calls
+    poppr_progress_poll() between its own work. At most every
+    POPPR_PROGRESS_INTERVAL seconds, this checks for a user interrupt without
+    leaving the kernel and reports the new progress to R, and
+  - after the parallel region, and after all memory is freed, the kernel calls
+    poppr_progress_finish(), which raises the interrupt as an R error or
+    reports the rest of the progress.
+
+Progress is reported by calling an R function (from R, usually wrapping a
+progressr progressor) with the proportion of the total work that was done
+since its previous call. The proportions of a call that is not interrupted
+add up to 1.
+*/
+
+#ifndef POPPR_PROGRESS_INTERVAL
+#define POPPR_PROGRESS_INTERVAL 0.1
+#endif
+
+struct poppr_progress {
+  double total;     // total amount of work
+  int64_t done;     // work done, updated atomically by the workers
+  int64_t reported; // work reported to R
+  int cancelled;    // set by the master thread after a user interrupt
+  double last;      // time of the last poll
+  SEXP callback;    // R function of one argument or R_NilValue
+};
+
+void poppr_progress_init(struct poppr_progress* p, double total, SEXP callback);
+int poppr_progress_poll(struct poppr_progress* p);
+void poppr_progress_finish(struct poppr_progress* p);
+
+// Adds finished work. Safe to call from any thread.
+static inline void poppr_progress_add(struct poppr_progress* p, int64_t n)
+{
+  #ifdef _OPENMP
+  #pragma omp atomic
+  #endif
+  p->done += n;
+}
+
+// Has the user interrupted the kernel? Safe to call from any thread.
+static inline int poppr_progress_cancelled(struct poppr_progress* p)
+{
+  int cancelled;
+  #ifdef _OPENMP
+  #pragma omp atomic read
+  #endif
+  cancelled = p->cancelled;
+  return cancelled;
+}
+
+#endif
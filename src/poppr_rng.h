@@ -0,0 +1,173 @@
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+#
+# This software was authored by Zhian N. Kamvar and Javier F. Tabima, graduate
+# students at Oregon State University; Jonah C. Brooks, undergraduate student at
+# Oregon State University; and Dr. Nik Grünwald, an employee of USDA-ARS.
+#
+# Permission to use, copy, modify, and distribute this software and its
+# documentation for educational, research and non-profit purposes, without fee,
+# and without a written agreement is hereby granted, provided that the statement
+# above is incorporated into the material, giving appropriate attribution to the
+# authors.
+#
+# Permission to incorporate this software into commercial products may be
+# obtained by contacting USDA ARS and OREGON STATE UNIVERSITY Office for
+# Commercialization and Corporate Development.
+#
+# The software program and documentation are supplied "as is", without any
+# accompanying services from the USDA or the University. USDA ARS or the
+# University do not warrant that the operation of the program will be
+# uninterrupted or error-free. The end-user understands that the program was
+# developed for research purposes and is advised not to rely exclusively on the
+# program for any reason.
+#
+# IN NO EVENT SHALL USDA ARS OR OREGON STATE UNIVERSITY BE LIABLE TO ANY PARTY
+# FOR DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES, INCLUDING
+# LOST PROFITS, ARISING OUT OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION,
+# EVEN IF THE OREGON STATE UNIVERSITY HAS BEEN ADVISED OF THE POSSIBILITY OF
+# SUCH DAMAGE. USDA ARS OR OREGON STATE UNIVERSITY SPECIFICALLY DISCLAIMS ANY
+# WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+# MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE AND ANY STATUTORY
+# WARRANTY OF NON-INFRINGEMENT. THE SOFTWARE PROVIDED HEREUNDER IS ON AN "AS IS"
+# BASIS, AND USDA ARS AND OREGON STATE UNIVERSITY HAVE NO OBLIGATIONS TO PROVIDE
+# MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS.
+#
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+#ifndef POPPR_RNG_H
+#define POPPR_RNG_H
+
+#include <stdint.h>
+#include <R.h>
+
+/*
+Counter-based random numbers
+============================
+
+All resampling in the compiled code draws from Philox4x32-10 (Salmon et al.
+2011), a generator whose output is a keyed bijection of a 128-bit counter. It
+has no state to carry from one number to the next, so any number of any
+stream can be produced by any thread without coordination.
+
+Every .Call that resamples draws one 64-bit seed from R's RNG with
+poppr_rng_seed() on the main thread, before any threads are started. That seed
+is the key of the generator, and each unit of work (a replicate, a
+permutation, a subsample) is addressed by a (replicate, stream) pair from the
+caller. The words of a pair are, in order, the four outputs of the blocks
+
+  counter = (b, stream, replicate & 0xffffffff, replicate >> 32)
+
+for b = 0, 1, 2, ... A uniform double in [0, 1) takes the next two words (53
+bits, high word first) and an integer in [0, n) is floor(u*n) of such a
+double. This is the serial order: the numbers of a (replicate, stream) pair
+only depend on the seed and the pair, so the results of parallel code are
+identical to running the pairs one after the other on a single thread.
+*/
+
+#define POPPR_PHILOX_M0 0xD2511F53U
+#define POPPR_PHILOX_M1 0xCD9E8D57U
+#define POPPR_PHILOX_W0 0x9E3779B9U
+#define POPPR_PHILOX_W1 0xBB67AE85U
+
+struct poppr_rng {
+  uint32_t key[2]; // the seed
+  uint32_t ctr[4]; // block, stream, replicate (low), replicate (high)
+  uint32_t out[4]; // output of the current block
+  int next;        // next unused word of out (4 = none left)
+};
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+Ten rounds of Philox4x32 on a counter and a key.
+
+Input: ctr - the 128-bit counter
+       key - the 64-bit key
+       out - the 128-bit output
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+static inline void poppr_philox(const uint32_t* ctr, const uint32_t* key, uint32_t* out)
+{
+  uint32_t c0 = ctr[0];
+  uint32_t c1 = ctr[1];
+  uint32_t c2 = ctr[2];
+  uint32_t c3 = ctr[3];
+  uint32_t k0 = key[0];
+  uint32_t k1 = key[1];
+  int i;
+  for (i = 0; i < 10; i++)
+  {
+    uint64_t p0 = (uint64_t)POPPR_PHILOX_M0*c0;
+    uint64_t p1 = (uint64_t)POPPR_PHILOX_M1*c2;
+    c0 = (uint32_t)(p1 >> 32) ^ c1 ^ k0;
+    c2 = (uint32_t)(p0 >> 32) ^ c3 ^ k1;
+    c1 = (uint32_t)p1;
+    c3 = (uint32_t)p0;
+    k0 += POPPR_PHILOX_W0;
+    k1 += POPPR_PHILOX_W1;
+  }
+  out[0] = c0;
+  out[1] = c1;
+  out[2] = c2;
+  out[3] = c3;
+}
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+Draws the seed of a .Call from R's RNG. This must be called from the main
+thread.
+
+Output: a 64-bit seed
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+static inline uint64_t poppr_rng_seed(void)
+{
+  uint64_t seed;
+  GetRNGstate();
+  seed = ((uint64_t)(unif_rand()*4294967296.0) << 32) ^
+          (uint64_t)(unif_rand()*4294967296.0);
+  PutRNGstate();
+  return seed;
+}
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+Positions a generator at the first number of a (replicate, stream) pair.
+
+Input: rng       - the generator
+       seed      - the seed from poppr_rng_seed()
+       replicate - the replicate
+       stream    - the stream within the replicate
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+static inline void poppr_rng_init(struct poppr_rng* rng, uint64_t seed, uint64_t replicate, uint32_t stream)
+{
+  rng->key[0] = (uint32_t)seed;
+  rng->key[1] = (uint32_t)(seed >> 32);
+  rng->ctr[0] = 0;
+  rng->ctr[1] = stream;
+  rng->ctr[2] = (uint32_t)replicate;
+  rng->ctr[3] = (uint32_t)(replicate >> 32);
+  rng->next   = 4;
+}
+
+// The next 32-bit word
+static inline uint32_t poppr_rng_u32(struct poppr_rng* rng)
+{
+  if (rng->next == 4)
+  {
+    poppr_philox(rng->ctr, rng->key, rng->out);
+    rng->ctr[0]++;
+    rng->next = 0;
+  }
+  return rng->out[rng->next++];
+}
+
+// Uniform double in [0, 1)
+static inline double poppr_rng_unif(struct poppr_rng* rng)
+{
+  uint64_t hi = poppr_rng_u32(rng);
+  uint64_t lo = poppr_rng_u32(rng);
+  return (((hi << 32) | lo) >> 11)*0x1.0p-53;
+}
+
+// Uniform integer in [0, n)
+static inline int poppr_rng_int(struct poppr_rng* rng, int n)
+{
+  int res = (int)(poppr_rng_unif(rng)*n);
+  return (res < n) ? res : n - 1;
+}
+
+#endif
@@ -0,0 +1,242 @@
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+#
+# This software was authored by Zhian N. Kamvar and Javier F. Tabima, graduate
+# students at Oregon State University; Jonah C. Brooks, undergraduate student at
+# Oregon State University; and Dr. Nik Grünwald, an employee of USDA-ARS.
+#
+# Permission to use, copy, modify, and distribute this software and its
+# documentation for educational, research and non-profit purposes, without fee,
+# and without a written agreement is hereby granted, provided that the statement
+# above is incorporated into the material, giving appropriate attribution to the
+# authors.
+#
+# Permission to incorporate this software into commercial products may be
+# obtained by contacting USDA ARS and OREGON STATE UNIVERSITY Office for
+# Commercialization and Corporate Development.
+#
+# The software program and documentation are supplied "as is", without any
+# accompanying services from the USDA or the University. USDA ARS or the
+# University do not warrant that the operation of the program will be
+# uninterrupted or error-free. The end-user understands that the program was
+# developed for research purposes and is advised not to rely exclusively on the
+# program for any reason.
+#
+# IN NO EVENT SHALL USDA ARS OR OREGON STATE UNIVERSITY BE LIABLE TO ANY PARTY
+# FOR DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES, INCLUDING
+# LOST PROFITS, ARISING OUT OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION,
+# EVEN IF THE OREGON STATE UNIVERSITY HAS BEEN ADVISED OF THE POSSIBILITY OF
+# SUCH DAMAGE. USDA ARS OR OREGON STATE UNIVERSITY SPECIFICALLY DISCLAIMS ANY
+# WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+# MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE AND ANY STATUTORY
+# WARRANTY OF NON-INFRINGEMENT. THE SOFTWARE PROVIDED HEREUNDER IS ON AN "AS IS"
+# BASIS, AND USDA ARS AND OREGON STATE UNIVERSITY HAVE NO OBLIGATIONS TO PROVIDE
+# MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS.
+#
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <math.h>
+// Include openMP if the compiler supports it
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include <Rinternals.h>
+#include <R.h>
+#include "poppr_threads.h"
+
+/*
+Thread policy
+=============
+
+Every parallel kernel asks poppr_threads() for the size of its team and passes
+it to the num_threads() clause of its parallel regions. omp_set_num_threads()
+is never called, so the OpenMP settings of the R session (and of any other
+package) are left as they are. The threads themselves are the persistent pool
+of the OpenMP runtime, which is reused by every parallel region.
+
+The size of the pool is found once per session as the smallest of
+
+  - the number of processors available to the process (omp_get_num_procs(),
+    which respects the CPU affinity mask),
+  - the CPU quota of the cgroup of the process, rounded up (cpu.max for cgroup
+    v2 or cpu.cfs_quota_us/cpu.cfs_period_us for cgroup v1), and
+  - OMP_THREAD_LIMIT (omp_get_thread_limit()).
+
+The number of threads of a call is then
+
+  - 1 if the kernel is called from inside a parallel region, so that kernels
+    never nest teams,
+  - options(poppr.threads) if threads = 0 and the option is a positive number,
+  - the whole pool if threads = 0 otherwise, or
+  - the requested number of threads, capped at the size of the pool.
+
+Threads are bound to cores by the OpenMP runtime with OMP_PROC_BIND and
+OMP_PLACES, which are read when the runtime starts, so they have to be set
+before R is started.
+*/
+
+static int POOL_SIZE = 0;
+
+static int cgroup_quota(void);
+static int read_quota(const char* quota_file, const char* period_file);
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+The number of threads of the pool, found on the first call.
+
+Output: the number of threads (1 without OpenMP)
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+int poppr_pool_size(void)
+{
+  if (POOL_SIZE == 0)
+  {
+    int size = 1;
+    #ifdef _OPENMP
+    {
+      int quota = cgroup_quota();
+      int limit = omp_get_thread_limit();
+      size = omp_get_num_procs();
+      if (quota > 0 && quota < size)
+      {
+        size = quota;
+      }
+      if (limit > 0 && limit < size)
+      {
+        size = limit;
+      }
+    }
+    #endif
+    POOL_SIZE = (size > 0) ? size : 1;
+  }
+  return POOL_SIZE;
+}
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+The number of threads of a call to a parallel kernel. This reads an R option
+and must be called before any threads are started.
+
+Input: requested_threads - an integer from the caller (0 = all available)
+Output: the number of threads to pass to num_threads()
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+int poppr_threads(SEXP requested_threads)
+{
+  int pool = poppr_pool_size();
+  int num_threads = asInteger(requested_threads);
+  #ifdef _OPENMP
+  if (omp_in_parallel())
+  {
+    return 1;
+  }
+  #endif
+  if (num_threads == NA_INTEGER || num_threads <= 0)
+  {
+    SEXP option = GetOption1(install("poppr.threads"));
+    num_threads = isNull(option) ? 0 : asInteger(option);
+    if (num_threads == NA_INTEGER || num_threads <= 0)
+    {
+      num_threads = pool;
+    }
+  }
+  return (num_threads < pool) ? num_threads : pool;
+}
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+Reports the thread policy to R.
+
+Output: a named integer vector with the size of the pool, the number of
+        processors, the cgroup CPU quota (NA if there is none), the OpenMP
+        thread limit (NA if there is none), and the number of threads used for
+        threads = 0.
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+SEXP poppr_thread_info(void)
+{
+  SEXP Rout;
+  SEXP Rnames;
+  SEXP zero;
+  int quota = cgroup_quota();
+  int procs = 1;
+  int limit = NA_INTEGER;
+  #ifdef _OPENMP
+  procs = omp_get_num_procs();
+  limit = omp_get_thread_limit();
+  // An unset OMP_THREAD_LIMIT is reported as INT_MAX
+  if (limit <= 0 || limit == INT_MAX)
+  {
+    limit = NA_INTEGER;
+  }
+  #endif
+  PROTECT(Rout = allocVector(INTSXP, 5));
+  PROTECT(Rnames = allocVector(STRSXP, 5));
+  PROTECT(zero = ScalarInteger(0));
+  INTEGER(Rout)[0] = poppr_pool_size();
+  INTEGER(Rout)[1] = procs;
+  INTEGER(Rout)[2] = (quota > 0) ? quota : NA_INTEGER;
+  INTEGER(Rout)[3] = limit;
+  INTEGER(Rout)[4] = poppr_threads(zero);
+  SET_STRING_ELT(Rnames, 0, mkChar("pool"));
+  SET_STRING_ELT(Rnames, 1, mkChar("processors"));
+  SET_STRING_ELT(Rnames, 2, mkChar("cgroup"));
+  SET_STRING_ELT(Rnames, 3, mkChar("limit"));
+  SET_STRING_ELT(Rnames, 4, mkChar("default"));
+  setAttrib(Rout, R_NamesSymbol, Rnames);
+  UNPROTECT(3);
+  return Rout;
+}
+
+// The CPU quota of the cgroup of the process in whole CPUs, or 0 if there is
+// no quota or it cannot be read.
+static int cgroup_quota(void)
+{
+  int quota = 0;
+  #ifdef __linux__
+  quota = read_quota("/sys/fs/cgroup/cpu.max", NULL);
+  if (quota == 0)
+  {
+    quota = read_quota("/sys/fs/cgroup/cpu/cpu.cfs_quota_us",
+                       "/sys/fs/cgroup/cpu/cpu.cfs_period_us");
+  }
+  #endif
+  return quota;
+}
+
+// Reads a quota and period from one file ("quota period" or "max period") or
+// from two files and returns ceiling(quota/period).
+static int read_quota(const char* quota_file, const char* period_file)
+{
+  FILE* f;
+  double quota = -1.0;
+  double period = 0.0;
+  char first[32];
+  f = fopen(quota_file, "r");
+  if (f == NULL)
+  {
+    return 0;
+  }
+  if (fscanf(f, "%31s", first) == 1 && first[0] != 'm')
+  {
+    quota = atof(first);
+    if (period_file == NULL && fscanf(f, "%lf", &period) != 1)
+    {
+      period = 0.0;
+    }
+  }
+  fclose(f);
+  if (period_file != NULL && quota > 0.0)
+  {
+    f = fopen(period_file, "r");
+    if (f == NULL)
+    {
+      return 0;
+    }
+    if (fscanf(f, "%lf", &period) != 1)
+    {
+      period = 0.0;
+    }
+    fclose(f);
+  }
+  if (!(quota > 0.0) || !(period > 0.0))
+  {
+    return 0;
+  }
+  return (int)ceil(quota/period);
+}
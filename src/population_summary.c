@@ -0,0 +1,890 @@
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+#
+# This software was authored by Zhian N. Kamvar and Javier F. Tabima, graduate
+# students at Oregon State University; Jonah C. Brooks, undergraduate student at
+# Oregon State University; and Dr. Nik Grünwald, an employee of USDA-ARS.
+#
+# Permission to use, copy, modify, and distribute this software and its
+# documentation for educational, research and non-profit purposes, without fee,
+# and without a written agreement is hereby granted, provided that the statement
+# above is incorporated into the material, giving appropriate attribution to the
+# authors.
+#
+# Permission to incorporate this software into commercial products may be
+# obtained by contacting USDA ARS and OREGON STATE UNIVERSITY Office for
+# Commercialization and Corporate Development.
+#
+# The software program and documentation are supplied "as is", without any
+# accompanying services from the USDA or the University. USDA ARS or the
+# University do not warrant that the operation of the program will be
+# uninterrupted or error-free. The end-user understands that the program was
+# developed for research purposes and is advised not to rely exclusively on the
+# program for any reason.
+#
+# IN NO EVENT SHALL USDA ARS OR OREGON STATE UNIVERSITY BE LIABLE TO ANY PARTY
+# FOR DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES, INCLUDING
+# LOST PROFITS, ARISING OUT OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION,
+# EVEN IF THE OREGON STATE UNIVERSITY HAS BEEN ADVISED OF THE POSSIBILITY OF
+# SUCH DAMAGE. USDA ARS OR OREGON STATE UNIVERSITY SPECIFICALLY DISCLAIMS ANY
+# WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+# MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE AND ANY STATUTORY
+# WARRANTY OF NON-INFRINGEMENT. THE SOFTWARE PROVIDED HEREUNDER IS ON AN "AS IS"
+# BASIS, AND USDA ARS AND OREGON STATE UNIVERSITY HAVE NO OBLIGATIONS TO PROVIDE
+# MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS.
+#
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+// Include openMP if the compiler supports it
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include <Rinternals.h>
+#include <R_ext/Utils.h>
+#include <R.h>
+#include "poppr_threads.h"
+
+/*
+Population and locus summaries for poppr() and locus_table()
+============================================================
+
+poppr() reports Nei's expected heterozygosity and the index of association for
+every population and locus_table() reports diversity statistics for every
+locus. All are calculated here directly from the allele table of the full data
+set. A population is only a vector of row indices, so nothing is subset or
+copied and every population (or population and locus) is an independent task.
+
+Hexp is Nei's unbiased gene diversity averaged over loci,
+
+  Hexp_l = n/(n - 1) * (1 - sum(p^2))
+
+where n is the number of observed alleles at the locus in samples without
+missing data. Zero-length alleles of codominant data (e.g. "000") are not
+counted. For presence/absence data, every marker is a locus with the alleles
+present and absent. The same statistics at the genotype level use the counts of
+distinct genotypes (rows of the locus) among samples without missing data,
+which are found by sorting the samples by a hash of their genotypes.
+
+The index of association only needs the sums of the pairwise differences over
+pairs of samples (Agapow and Burt 2001): for each locus, the sum and the sum of
+squares of d_l, and the sum and sum of squares of D = sum(d_l). These are
+accumulated in a single pass over all pairs without storing the pairs x loci
+matrix of differences.
+*/
+
+SEXP population_summary(SEXP tab, SEXP loc_fac, SEXP pops, SEXP zero_allele, SEXP ploidy, SEXP pa, SEXP round_mean, SEXP requested_threads);
+SEXP locus_summary(SEXP tab, SEXP loc_fac, SEXP pops, SEXP zero_allele, SEXP genotype, SEXP pa, SEXP requested_threads);
+SEXP locus_qc(SEXP tab, SEXP loc_fac, SEXP maf, SEXP requested_threads);
+
+#define LOCUS_NSTAT 6
+
+typedef struct {
+  uint64_t hash;
+  int row;
+} geno_key;
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+Counts the alleles at one locus for one population.
+
+Input: X      - the n x m allele table
+       n      - the number of rows in X
+       idx    - 0-based row indices of the population
+       ni     - the number of samples in the population
+       from   - the first column of the locus
+       to     - one past the last column of the locus
+       zero   - columns that are not counted (zero-length alleles)
+       pa     - if nonzero, the locus is a presence/absence marker
+       counts - output: the allele counts (at least to - from + 1 elements)
+Output: the number of elements of counts
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+static int locus_allele_counts(const double *X, int n, const int *idx, int ni,
+                               int from, int to, const int *zero, int pa,
+                               double *counts)
+{
+  int a;
+  int i;
+  int k = 0;
+  int nvalid = 0;
+  for (a = from; a < to; a++)
+  {
+    counts[a - from] = 0.0;
+  }
+  for (i = 0; i < ni; i++)
+  {
+    if (ISNA(X[idx[i] + (size_t)from*n]))
+    {
+      continue;
+    }
+    nvalid++;
+    for (a = from; a < to; a++)
+    {
+      counts[a - from] += X[idx[i] + (size_t)a*n];
+    }
+  }
+  if (pa)
+  {
+    // alleles present and absent
+    counts[1] = (double)nvalid - counts[0];
+    return 2;
+  }
+  for (a = from; a < to; a++)
+  {
+    if (!zero[a])
+    {
+      counts[k++] = counts[a - from];
+    }
+  }
+  return k;
+}
+
+static uint64_t genotype_hash(const double *X, int n, int row, int from, int to)
+{
+  int a;
+  uint64_t bits;
+  uint64_t h = 14695981039346656037ULL; // FNV-1a
+  for (a = from; a < to; a++)
+  {
+    memcpy(&bits, X + row + (size_t)a*n, sizeof(uint64_t));
+    h ^= bits;
+    h *= 1099511628211ULL;
+  }
+  return h;
+}
+
+static int compare_geno_key(const void *a, const void *b)
+{
+  const geno_key *x = (const geno_key*)a;
+  const geno_key *y = (const geno_key*)b;
+  if (x->hash != y->hash)
+  {
+    return (x->hash < y->hash) ? -1 : 1;
+  }
+  return (x->row > y->row) - (x->row < y->row);
+}
+
+static int same_genotype(const double *X, int n, int r1, int r2, int from, int to)
+{
+  int a;
+  for (a = from; a < to; a++)
+  {
+    if (X[r1 + (size_t)a*n] != X[r2 + (size_t)a*n])
+    {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+Counts the distinct genotypes at one locus for one population. A haploid
+genotype that consists of a single zero-length allele is not counted.
+
+Input: X, n, idx, ni, from, to, zero - as in locus_allele_counts
+       keys   - a work vector of ni keys
+       reps   - a work vector of ni rows representing each genotype
+       counts - output: the genotype counts (at least ni elements)
+Output: the number of elements of counts
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+static int locus_genotype_counts(const double *X, int n, const int *idx, int ni,
+                                 int from, int to, const int *zero, 
+                                 geno_key *keys, int *reps, double *counts)
+{
+  int i;
+  int j;
+  int a;
+  int g;
+  int run;
+  int first;
+  int only_zero;
+  int nkeys = 0;
+  int k = 0;
+  double x;
+  double allele_sum;
+  for (i = 0; i < ni; i++)
+  {
+    if (ISNA(X[idx[i] + (size_t)from*n]))
+    {
+      continue;
+    }
+    allele_sum = 0.0;
+    only_zero  = 1;
+    for (a = from; a < to; a++)
+    {
+      x = X[idx[i] + (size_t)a*n];
+      allele_sum += x;
+      if (x != 0.0 && !zero[a])
+      {
+        only_zero = 0;
+      }
+    }
+    if (only_zero && allele_sum == 1.0)
+    {
+      continue;
+    }
+    keys[nkeys].hash = genotype_hash(X, n, idx[i], from, to);
+    keys[nkeys].row  = idx[i];
+    nkeys++;
+  }
+  qsort(keys, nkeys, sizeof(geno_key), compare_geno_key);
+  for (i = 0; i < nkeys; i = run)
+  {
+    for (run = i + 1; run < nkeys && keys[run].hash == keys[i].hash; run++);
+    // Genotypes with the same hash are the same unless there is a collision.
+    first = k;
+    for (j = i; j < run; j++)
+    {
+      for (g = first; g < k; g++)
+      {
+        if (same_genotype(X, n, keys[j].row, reps[g], from, to))
+        {
+          break;
+        }
+      }
+      if (g == k)
+      {
+        reps[k]   = keys[j].row;
+        counts[k] = 0.0;
+        k++;
+      }
+      counts[g] += 1.0;
+    }
+  }
+  return k;
+}
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+Calculates diversity statistics from a vector of counts.
+
+Input: counts - a vector of k counts
+       k      - the number of counts
+       out    - a vector of length LOCUS_NSTAT for the number of observed types,
+                Simpson's index (1 - D), Shannon's index (H), Stoddart and
+                Taylor's index (G), Nei's unbiased gene diversity (Hexp), and
+                evenness (E.5)
+Output: none; out is filled. Empty vectors have H = 0 and NaN for the others,
+        as in vegan::diversity().
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+static void locus_stats_counts(const double *counts, int k, double *out)
+{
+  int i;
+  double N = 0.0;
+  double ntypes = 0.0;
+  double H = 0.0;
+  double sumsq = 0.0;
+  double simp;
+  double p;
+  for (i = 0; i < k; i++)
+  {
+    if (counts[i] > 0.0)
+    {
+      N      += counts[i];
+      sumsq  += counts[i]*counts[i];
+      ntypes += 1.0;
+    }
+  }
+  // H from the proportions so that a single type gives exactly 0
+  for (i = 0; i < k; i++)
+  {
+    if (counts[i] > 0.0)
+    {
+      p  = counts[i]/N;
+      H -= p*log(p);
+    }
+  }
+  simp   = sumsq/(N*N);
+  out[0] = ntypes;
+  out[1] = 1.0 - simp;
+  out[2] = H;
+  out[3] = 1.0/simp;
+  out[4] = (N/(N - 1.0))*(1.0 - simp);
+  out[5] = (out[3] - 1.0)/(exp(out[2]) - 1.0);
+}
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+Calculates Nei's expected heterozygosity averaged over loci for one population.
+
+Input: X, n, idx, ni, zero, pa - as in locus_allele_counts
+       start  - the first column of each locus (nloc + 1 elements)
+       nloc   - the number of loci
+       counts - a work vector of at least m + 1 doubles
+Output: the mean of Hexp over loci where it can be calculated
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+static double pop_hexp(const double *X, int n, const int *idx, int ni, 
+                       const int *start, int nloc, const int *zero, int pa,
+                       double *counts)
+{
+  int l;
+  int k;
+  double stats[LOCUS_NSTAT];
+  double res = 0.0;
+  int nres = 0;
+  for (l = 0; l < nloc; l++)
+  {
+    k = locus_allele_counts(X, n, idx, ni, start[l], start[l + 1], zero, pa,
+                            counts);
+    locus_stats_counts(counts, k, stats);
+    if (!ISNAN(stats[4]))
+    {
+      res += stats[4];
+      nres++;
+    }
+  }
+  return (nres > 0) ? res/nres : R_NaN;
+}
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+Calculates the index of association and the standardized index of association
+for one population.
+
+The difference between two samples at a codominant locus is half the number of
+differing alleles, rounded up (as pairdiffs), and zero if either sample is
+missing. For presence/absence data, it is the absolute difference multiplied
+by the largest ploidy in the population. Values imputed with the mean are
+rounded half up.
+
+Input: X, n, idx, ni, start, nloc - as in pop_hexp
+       pa    - if nonzero, each column is a presence/absence marker
+       mult  - multiplier for presence/absence differences
+       round - if nonzero, differences are rounded
+       work  - a work vector of at least 3*nloc doubles
+       out   - a vector of length 2 for Ia and rbarD
+Output: none; out is filled. Populations with fewer than three samples are NA.
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+static void pop_ia(const double *X, int n, const int *idx, int ni, 
+                   const int *start, int nloc, int pa, double mult, int round,
+                   double *work, double *out)
+{
+  int i;
+  int j;
+  int l;
+  int a;
+  double xi;
+  double xj;
+  double dl;
+  double D;
+  double sumD  = 0.0;
+  double sumD2 = 0.0;
+  double np;
+  double varD;
+  double sigvar = 0.0;
+  double cumroot = 0.0;
+  double pairs = 0.0;
+  double root;
+  double* d    = work;
+  double* d2   = work + nloc;
+  double* vard = work + 2*nloc;
+  if (ni < 3)
+  {
+    out[0] = NA_REAL;
+    out[1] = NA_REAL;
+    return;
+  }
+  for (l = 0; l < nloc; l++)
+  {
+    d[l]  = 0.0;
+    d2[l] = 0.0;
+  }
+  for (i = 0; i < ni - 1; i++)
+  {
+    for (j = i + 1; j < ni; j++)
+    {
+      D = 0.0;
+      for (l = 0; l < nloc; l++)
+      {
+        dl = 0.0;
+        for (a = start[l]; a < start[l + 1]; a++)
+        {
+          xi = X[idx[i] + (size_t)a*n];
+          xj = X[idx[j] + (size_t)a*n];
+          if (ISNA(xi) || ISNA(xj))
+          {
+            dl = 0.0;
+            break;
+          }
+          dl += fabs(xi - xj);
+        }
+        if (pa)
+        {
+          dl = (round) ? floor(dl + 0.5)*mult : dl*mult;
+        }
+        else
+        {
+          dl = ceil(dl/2.0);
+        }
+        d[l]  += dl;
+        d2[l] += dl*dl;
+        D     += dl;
+      }
+      sumD  += D;
+      sumD2 += D*D;
+    }
+  }
+  np   = (double)ni*(ni - 1)/2.0;
+  varD = (sumD2 - (sumD*sumD)/np)/np;
+  for (l = 0; l < nloc; l++)
+  {
+    vard[l] = (d2[l] - (d[l]*d[l])/np)/np;
+    sigvar += vard[l];
+    // sum of sqrt(var_j * var_k) for all pairs of loci j < k
+    root     = sqrt(vard[l]);
+    pairs   += root*cumroot;
+    cumroot += root;
+  }
+  out[0] = (varD/sigvar) - 1.0;
+  out[1] = (varD - sigvar)/(2.0*pairs);
+}
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+The first column of each locus from a locus factor of m contiguous columns.
+The result has nloc + 1 elements, the last being m.
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+static int* summary_locus_start(SEXP loc_fac, int m, int *nloc)
+{
+  int i;
+  int* start;
+  int* locus = INTEGER(loc_fac);
+  *nloc = (m > 0) ? locus[m - 1] : 0;
+  start = (int*)R_alloc(*nloc + 1, sizeof(int));
+  start[0] = 0;
+  for (i = 1; i < m; i++)
+  {
+    if (locus[i] < locus[i - 1])
+    {
+      error("the columns of each locus must be contiguous");
+    }
+    if (locus[i] != locus[i - 1])
+    {
+      start[locus[i] - 1] = i;
+    }
+  }
+  start[*nloc] = m;
+  return start;
+}
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+Converts a list of 1-based population indices to 0-based arrays and returns the
+size of the largest population.
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+static int summary_pop_index(SEXP pops, int n, int **idx, int *nidx)
+{
+  int p;
+  int i;
+  int maxpop = 0;
+  for (p = 0; p < length(pops); p++)
+  {
+    SEXP Rpop = VECTOR_ELT(pops, p);
+    nidx[p] = length(Rpop);
+    idx[p]  = (int*)R_alloc(nidx[p] + 1, sizeof(int));
+    for (i = 0; i < nidx[p]; i++)
+    {
+      idx[p][i] = INTEGER(Rpop)[i] - 1;
+      if (idx[p][i] < 0 || idx[p][i] >= n)
+      {
+        error("population indices are out of range");
+      }
+    }
+    maxpop = (nidx[p] > maxpop) ? nidx[p] : maxpop;
+  }
+  return maxpop;
+}
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+Calculates Hexp, Ia, and rbarD for several populations of one allele table.
+
+Input: tab         - an n x m matrix of allele counts (tab(gid))
+       loc_fac     - an integer vector of length m giving the locus of each
+                     column. The columns of each locus must be contiguous.
+       pops        - a list of integer vectors of (1-based) rows, one per
+                     population. Populations can overlap (e.g. the total).
+       zero_allele - a logical vector of length m marking columns that are not
+                     counted for Hexp
+       ploidy      - an integer vector of length n with the ploidy of each
+                     sample (used for presence/absence data)
+       pa          - TRUE if the data are presence/absence
+       round_mean  - TRUE if missing presence/absence data were replaced with
+                     the mean, so that differences need rounding
+       requested_threads - number of threads (0 = all available)
+Output: A length(pops) x 3 matrix with Hexp, Ia, and rbarD in columns.
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+SEXP population_summary(SEXP tab, SEXP loc_fac, SEXP pops, SEXP zero_allele, SEXP ploidy, SEXP pa, SEXP round_mean, SEXP requested_threads)
+{
+  SEXP Rout;
+  SEXP Rdim;
+  int n;
+  int m;
+  int nloc;
+  int npop;
+  int is_pa;
+  int do_round;
+  int num_threads;
+  int p;
+  int* start;
+  int** idx;
+  int* nidx;
+  size_t nwork;
+  double* X;
+  double* out;
+  double* work;
+
+  Rdim     = getAttrib(tab, R_DimSymbol);
+  n        = INTEGER(Rdim)[0];
+  m        = INTEGER(Rdim)[1];
+  npop     = length(pops);
+  is_pa    = asLogical(pa);
+  do_round = asLogical(round_mean);
+  if (length(loc_fac) != m || length(zero_allele) != m || length(ploidy) != n)
+  {
+    error("the locus factor, zero alleles, and ploidy do not match the data");
+  }
+  num_threads = poppr_threads(requested_threads);
+  start = summary_locus_start(loc_fac, m, &nloc);
+  idx   = (int**)R_alloc(npop, sizeof(int*));
+  nidx  = (int*)R_alloc(npop, sizeof(int));
+  summary_pop_index(pops, n, idx, nidx);
+
+  PROTECT(tab = coerceVector(tab, REALSXP));
+  PROTECT(Rout = allocMatrix(REALSXP, npop, 3));
+  X     = REAL(tab);
+  out   = REAL(Rout);
+  // allele counts (m + 1) and Ia sums (3*nloc) for each thread
+  nwork = (size_t)m + 1 + 3*(size_t)nloc;
+  work  = R_Calloc((size_t)num_threads*nwork, double);
+  #ifdef _OPENMP
+  #pragma omp parallel for schedule(dynamic) num_threads(num_threads) private(p)
+  #endif
+  for (p = 0; p < npop; p++)
+  {
+    int tid = 0;
+    int j;
+    int maxploid = 1;
+    double ia[2];
+    double* w;
+    #ifdef _OPENMP
+    tid = omp_get_thread_num();
+    #endif
+    w = work + (size_t)tid*nwork;
+    for (j = 0; j < nidx[p]; j++)
+    {
+      int pl = INTEGER(ploidy)[idx[p][j]];
+      maxploid = (pl > maxploid) ? pl : maxploid;
+    }
+    out[p] = pop_hexp(X, n, idx[p], nidx[p], start, nloc, 
+                      LOGICAL(zero_allele), is_pa, w);
+    pop_ia(X, n, idx[p], nidx[p], start, nloc, is_pa, (double)maxploid, 
+           do_round, w + m + 1, ia);
+    out[p + npop]   = ia[0];
+    out[p + 2*npop] = ia[1];
+  }
+  R_Free(work);
+  UNPROTECT(2);
+  return Rout;
+}
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+Calculates diversity statistics for every locus of several populations of one
+allele table. Every population and locus is a separate task.
+
+Input: tab, loc_fac, pops, zero_allele, pa - as in population_summary
+       genotype - if TRUE, the statistics are calculated on the genotypes
+                  instead of the alleles
+       requested_threads - number of threads (0 = all available)
+Output: A list with one nloc x LOCUS_NSTAT matrix per population with the
+        number of observed alleles (or genotypes), 1 - D, H, G, Hexp, and E.5
+        of each locus (see locus_stats_counts).
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+SEXP locus_summary(SEXP tab, SEXP loc_fac, SEXP pops, SEXP zero_allele, SEXP genotype, SEXP pa, SEXP requested_threads)
+{
+  SEXP Rout;
+  SEXP Rdim;
+  int n;
+  int m;
+  int nloc;
+  int npop;
+  int is_pa;
+  int by_genotype;
+  int num_threads;
+  int maxpop;
+  int maxall = 1;
+  int task;
+  int l;
+  int* start;
+  int** idx;
+  int* nidx;
+  size_t ncount;
+  double* X;
+  double** out;
+  double* counts;
+  int* reps;
+  geno_key* keys;
+
+  Rdim        = getAttrib(tab, R_DimSymbol);
+  n           = INTEGER(Rdim)[0];
+  m           = INTEGER(Rdim)[1];
+  npop        = length(pops);
+  is_pa       = asLogical(pa);
+  by_genotype = asLogical(genotype);
+  if (length(loc_fac) != m || length(zero_allele) != m)
+  {
+    error("the locus factor and zero alleles do not match the data");
+  }
+  num_threads = poppr_threads(requested_threads);
+  start  = summary_locus_start(loc_fac, m, &nloc);
+  idx    = (int**)R_alloc(npop, sizeof(int*));
+  nidx   = (int*)R_alloc(npop, sizeof(int));
+  maxpop = summary_pop_index(pops, n, idx, nidx);
+  for (l = 0; l < nloc; l++)
+  {
+    maxall = (start[l + 1] - start[l] > maxall) ? start[l + 1] - start[l] : maxall;
+  }
+
+  PROTECT(tab = coerceVector(tab, REALSXP));
+  PROTECT(Rout = allocVector(VECSXP, npop));
+  X   = REAL(tab);
+  out = (double**)R_alloc(npop, sizeof(double*));
+  for (task = 0; task < npop; task++)
+  {
+    SET_VECTOR_ELT(Rout, task, allocMatrix(REALSXP, nloc, LOCUS_NSTAT));
+    out[task] = REAL(VECTOR_ELT(Rout, task));
+  }
+  // counts of alleles (maxall + 1) or genotypes (maxpop) for each thread
+  ncount = (size_t)((maxall + 1 > maxpop) ? maxall + 1 : maxpop);
+  counts = R_Calloc((size_t)num_threads*ncount, double);
+  keys   = (by_genotype) ? R_Calloc((size_t)num_threads*maxpop + 1, geno_key) : NULL;
+  reps   = (by_genotype) ? R_Calloc((size_t)num_threads*maxpop + 1, int) : NULL;
+  #ifdef _OPENMP
+  #pragma omp parallel for schedule(dynamic) num_threads(num_threads) private(task)
+  #endif
+  for (task = 0; task < npop*nloc; task++)
+  {
+    int tid = 0;
+    int p   = task / nloc;
+    int loc = task % nloc;
+    int k;
+    int s;
+    double stats[LOCUS_NSTAT];
+    double* w;
+    #ifdef _OPENMP
+    tid = omp_get_thread_num();
+    #endif
+    w = counts + (size_t)tid*ncount;
+    if (by_genotype)
+    {
+      k = locus_genotype_counts(X, n, idx[p], nidx[p], start[loc], 
+                                start[loc + 1], LOGICAL(zero_allele), 
+                                keys + (size_t)tid*maxpop, 
+                                reps + (size_t)tid*maxpop, w);
+    }
+    else
+    {
+      k = locus_allele_counts(X, n, idx[p], nidx[p], start[loc], 
+                              start[loc + 1], LOGICAL(zero_allele), is_pa, w);
+    }
+    locus_stats_counts(w, k, stats);
+    for (s = 0; s < LOCUS_NSTAT; s++)
+    {
+      out[p][loc + s*nloc] = stats[s];
+    }
+  }
+  R_Free(counts);
+  if (by_genotype)
+  {
+    R_Free(keys);
+    R_Free(reps);
+  }
+  UNPROTECT(2);
+  return Rout;
+}
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+Quality control statistics of every locus and sample of one allele table. Each
+locus is a separate task and is read once; the counts of missing loci of each
+sample are kept per thread and summed at the end.
+
+A sample is missing at a locus if the first column of the locus is NA. Every
+combination of allele counts is a distinct genotype, including those made of
+zero-length alleles. Like adegenet's isPoly(), a locus is polymorphic if at
+least two of its alleles have a frequency of at least maf.
+
+Input: tab, loc_fac - as in population_summary
+       maf     - the minimum allele frequency for polymorphism
+       requested_threads - number of threads (0 = all available)
+Output: A list with
+          locus_missing - the number of samples missing at each locus
+          sample_missing - the number of loci missing in each sample
+          genotypes     - the number of genotypes observed at each locus
+          genotype_max  - the number of samples with the most common genotype
+          maf           - the frequency of the second most common allele
+          polymorphic   - TRUE for polymorphic loci
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+SEXP locus_qc(SEXP tab, SEXP loc_fac, SEXP maf, SEXP requested_threads)
+{
+  SEXP Rout;
+  SEXP Rnames;
+  SEXP Rdim;
+  int n;
+  int m;
+  int nloc;
+  int num_threads;
+  int l;
+  int i;
+  int t;
+  int maxall = 1;
+  size_t ncount;
+  int* start;
+  int* all;
+  int* zero;
+  int* sample_missing;
+  int* reps;
+  int* locus_missing;
+  int* ngeno;
+  int* genomax;
+  int* poly;
+  double thresh;
+  double* mafs;
+  double* X;
+  double* counts;
+  geno_key* keys;
+  const char* names[6] = {"locus_missing", "sample_missing", "genotypes", 
+                          "genotype_max", "maf", "polymorphic"};
+
+  Rdim   = getAttrib(tab, R_DimSymbol);
+  n      = INTEGER(Rdim)[0];
+  m      = INTEGER(Rdim)[1];
+  thresh = asReal(maf);
+  if (length(loc_fac) != m)
+  {
+    error("the locus factor does not match the data");
+  }
+  num_threads = poppr_threads(requested_threads);
+  start = summary_locus_start(loc_fac, m, &nloc);
+  all   = (int*)R_alloc(n + 1, sizeof(int));
+  zero  = (int*)R_alloc(m + 1, sizeof(int));
+  for (i = 0; i < n; i++)
+  {
+    all[i] = i;
+  }
+  for (i = 0; i < m; i++)
+  {
+    zero[i] = 0;
+  }
+  for (l = 0; l < nloc; l++)
+  {
+    maxall = (start[l + 1] - start[l] > maxall) ? start[l + 1] - start[l] : maxall;
+  }
+
+  PROTECT(tab = coerceVector(tab, REALSXP));
+  PROTECT(Rout = allocVector(VECSXP, 6));
+  PROTECT(Rnames = allocVector(STRSXP, 6));
+  SET_VECTOR_ELT(Rout, 0, allocVector(INTSXP, nloc));
+  SET_VECTOR_ELT(Rout, 1, allocVector(INTSXP, n));
+  SET_VECTOR_ELT(Rout, 2, allocVector(INTSXP, nloc));
+  SET_VECTOR_ELT(Rout, 3, allocVector(INTSXP, nloc));
+  SET_VECTOR_ELT(Rout, 4, allocVector(REALSXP, nloc));
+  SET_VECTOR_ELT(Rout, 5, allocVector(LGLSXP, nloc));
+  for (i = 0; i < 6; i++)
+  {
+    SET_STRING_ELT(Rnames, i, mkChar(names[i]));
+  }
+  setAttrib(Rout, R_NamesSymbol, Rnames);
+  X             = REAL(tab);
+  locus_missing = INTEGER(VECTOR_ELT(Rout, 0));
+  ngeno         = INTEGER(VECTOR_ELT(Rout, 2));
+  genomax       = INTEGER(VECTOR_ELT(Rout, 3));
+  mafs          = REAL(VECTOR_ELT(Rout, 4));
+  poly          = LOGICAL(VECTOR_ELT(Rout, 5));
+  // missing loci of samples, counts of alleles (maxall) or genotypes (n),
+  // keys, and representatives for each thread
+  ncount = (size_t)((maxall > n) ? maxall : n) + 1;
+  sample_missing = R_Calloc((size_t)num_threads*n + 1, int);
+  counts = R_Calloc((size_t)num_threads*ncount, double);
+  keys   = R_Calloc((size_t)num_threads*n + 1, geno_key);
+  reps   = R_Calloc((size_t)num_threads*n + 1, int);
+  #ifdef _OPENMP
+  #pragma omp parallel for schedule(dynamic) num_threads(num_threads) private(l)
+  #endif
+  for (l = 0; l < nloc; l++)
+  {
+    int tid = 0;
+    int j;
+    int k;
+    int a;
+    int missing = 0;
+    int npoly   = 0;
+    double total = 0.0;
+    double first = 0.0;
+    double second = 0.0;
+    double maxgeno = 0.0;
+    double x;
+    double* w;
+    int* miss;
+    #ifdef _OPENMP
+    tid = omp_get_thread_num();
+    #endif
+    w    = counts + (size_t)tid*ncount;
+    miss = sample_missing + (size_t)tid*n;
+    for (j = 0; j < n; j++)
+    {
+      if (ISNA(X[j + (size_t)start[l]*n]))
+      {
+        missing++;
+        miss[j]++;
+      }
+    }
+    for (a = start[l]; a < start[l + 1]; a++)
+    {
+      x = 0.0;
+      for (j = 0; j < n; j++)
+      {
+        if (!ISNA(X[j + (size_t)a*n]))
+        {
+          x += X[j + (size_t)a*n];
+        }
+      }
+      w[a - start[l]] = x;
+      total += x;
+    }
+    for (a = 0; a < start[l + 1] - start[l]; a++)
+    {
+      if (w[a] > first)
+      {
+        second = first;
+        first  = w[a];
+      }
+      else if (w[a] > second)
+      {
+        second = w[a];
+      }
+      npoly += total > 0.0 && w[a]/total >= thresh;
+    }
+    mafs[l] = (total > 0.0) ? second/total : 0.0;
+    poly[l] = npoly >= 2;
+    k = locus_genotype_counts(X, n, all, n, start[l], start[l + 1], zero, 
+                              keys + (size_t)tid*n, reps + (size_t)tid*n, w);
+    for (j = 0; j < k; j++)
+    {
+      maxgeno = (w[j] > maxgeno) ? w[j] : maxgeno;
+    }
+    locus_missing[l] = missing;
+    ngeno[l]         = k;
+    genomax[l]       = (int)maxgeno;
+  }
+  for (t = 1; t < num_threads; t++)
+  {
+    for (i = 0; i < n; i++)
+    {
+      sample_missing[i] += sample_missing[(size_t)t*n + i];
+    }
+  }
+  for (i = 0; i < n; i++)
+  {
+    INTEGER(VECTOR_ELT(Rout, 1))[i] = sample_missing[i];
+  }
+  R_Free(sample_missing);
+  R_Free(counts);
+  R_Free(keys);
+  R_Free(reps);
+  UNPROTECT(3);
+  return Rout;
+}
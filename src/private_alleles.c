@@ -0,0 +1,325 @@
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+#
+# This software was authored by Zhian N. Kamvar and Javier F. Tabima, graduate
+# students at Oregon State University; Jonah C. Brooks, undergraduate student at
+# Oregon State University; and Dr. Nik Grünwald, an employee of USDA-ARS.
+#
+# Permission to use, copy, modify, and distribute this software and its
+# documentation for educational, research and non-profit purposes, without fee,
+# and without a written agreement is hereby granted, provided that the statement
+# above is incorporated into the material, giving appropriate attribution to the
+# authors.
+#
+# Permission to incorporate this software into commercial products may be
+# obtained by contacting USDA ARS and OREGON STATE UNIVERSITY Office for
+# Commercialization and Corporate Development.
+#
+# The software program and documentation are supplied "as is", without any
+# accompanying services from the USDA or the University. USDA ARS or the
+# University do not warrant that the operation of the program will be
+# uninterrupted or error-free. The end-user understands that the program was
+# developed for research purposes and is advised not to rely exclusively on the
+# program for any reason.
+#
+# IN NO EVENT SHALL USDA ARS OR OREGON STATE UNIVERSITY BE LIABLE TO ANY PARTY
+# FOR DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES, INCLUDING
+# LOST PROFITS, ARISING OUT OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION,
+# EVEN IF THE OREGON STATE UNIVERSITY HAS BEEN ADVISED OF THE POSSIBILITY OF
+# SUCH DAMAGE. USDA ARS OR OREGON STATE UNIVERSITY SPECIFICALLY DISCLAIMS ANY
+# WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+# MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE AND ANY STATUTORY
+# WARRANTY OF NON-INFRINGEMENT. THE SOFTWARE PROVIDED HEREUNDER IS ON AN "AS IS"
+# BASIS, AND USDA ARS AND OREGON STATE UNIVERSITY HAVE NO OBLIGATIONS TO PROVIDE
+# MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS.
+#
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+#include <string.h>
+#include <math.h>
+// Include openMP if the compiler supports it
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include <Rinternals.h>
+#include <R_ext/Utils.h>
+#include <R.h>
+#include "poppr_threads.h"
+
+/*
+Private alleles
+===============
+
+An allele is private if it is observed in fewer than two populations. The
+population counts of every allele are found in one pass over its column of the
+allele table, so no population x allele table is created. The private alleles
+are reported as (row, column, count) triples where the row is a population or
+a sample and the column is an allele or a locus, skipping zero counts.
+
+Every locus is a separate task. The first pass finds the private alleles and
+the number of triples of each locus; the second pass writes the triples of the
+loci with private alleles at their offsets, so the result is in the same order
+for any number of threads.
+*/
+
+SEXP private_allele_table(SEXP tab, SEXP pop, SEXP npop, SEXP loc_fac, SEXP individual, SEXP count_alleles, SEXP by_locus, SEXP requested_threads);
+
+typedef struct {
+  const double *X;  // the n x m allele table
+  int n;            // number of samples
+  const int *pop;   // population of each sample (1-based, NA allowed)
+  int npop;         // number of populations
+  int individual;   // report samples instead of populations
+  int count;        // report counts of alleles instead of presence
+  int by_locus;     // sum the private alleles in each locus
+} private_data;
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+Finds the private alleles of one locus and counts or writes its triples.
+
+Input: d        - the data
+       l        - the locus (0-based)
+       from, to - the columns of the locus
+       popcount - a work vector of npop doubles
+       rowsum   - a work vector of n (or npop) doubles for sums over the locus
+       private  - output: 1 for private columns
+       row, col, cnt - output: if not NULL, the triples are written here
+Output: the number of triples
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+static int private_locus(const private_data *d, int l, int from, int to, 
+                         double *popcount, double *rowsum, int *private,
+                         int *row, int *col, double *cnt)
+{
+  int a;
+  int i;
+  int p;
+  int present;
+  int nrow = (d->individual) ? d->n : d->npop;
+  int ntrip = 0;
+  double x;
+  if (d->by_locus)
+  {
+    for (i = 0; i < nrow; i++)
+    {
+      rowsum[i] = 0.0;
+    }
+  }
+  for (a = from; a < to; a++)
+  {
+    const double *column = d->X + (size_t)a*d->n;
+    for (p = 0; p < d->npop; p++)
+    {
+      popcount[p] = 0.0;
+    }
+    for (i = 0; i < d->n; i++)
+    {
+      p = d->pop[i];
+      if (p != NA_INTEGER && !ISNA(column[i]))
+      {
+        popcount[p - 1] += column[i];
+      }
+    }
+    present = 0;
+    for (p = 0; p < d->npop; p++)
+    {
+      present += popcount[p] > 0.0;
+    }
+    private[a] = present < 2;
+    if (!private[a])
+    {
+      continue;
+    }
+    for (i = 0; i < nrow; i++)
+    {
+      if (d->individual)
+      {
+        x = column[i];
+      }
+      else
+      {
+        x = (d->count || popcount[i] <= 0.0) ? popcount[i] : 1.0;
+      }
+      if (d->by_locus)
+      {
+        rowsum[i] += (ISNA(x)) ? 0.0 : x;
+      }
+      else if (x != 0.0)
+      {
+        if (row != NULL)
+        {
+          row[ntrip] = i + 1;
+          col[ntrip] = a + 1;
+          cnt[ntrip] = x;
+        }
+        ntrip++;
+      }
+    }
+  }
+  if (d->by_locus)
+  {
+    for (i = 0; i < nrow; i++)
+    {
+      if (rowsum[i] != 0.0)
+      {
+        if (row != NULL)
+        {
+          row[ntrip] = i + 1;
+          col[ntrip] = l + 1;
+          cnt[ntrip] = rowsum[i];
+        }
+        ntrip++;
+      }
+    }
+  }
+  return ntrip;
+}
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+Finds private alleles and reports them as sparse triples.
+
+Input: tab     - an n x m matrix of allele counts of samples (or populations)
+       pop     - an integer vector of length n giving the population of each
+                 row (1-based). Rows with missing populations are not counted.
+       npop    - the number of populations
+       loc_fac - an integer vector of length m giving the locus of each
+                 column. The columns of each locus must be contiguous.
+       individual    - if TRUE, rows of the triples are samples
+       count_alleles - if FALSE, population counts are reported as presence
+                       (samples are always reported as counts)
+       by_locus      - if TRUE, the private alleles of each locus are summed
+       requested_threads - number of threads (0 = all available)
+Output: A list with
+          private - a logical vector of length m marking the private alleles
+          row     - the population or sample of each triple (1-based)
+          col     - the allele or locus of each triple (1-based)
+          count   - the count of each triple
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+SEXP private_allele_table(SEXP tab, SEXP pop, SEXP npop, SEXP loc_fac, SEXP individual, SEXP count_alleles, SEXP by_locus, SEXP requested_threads)
+{
+  SEXP Rout;
+  SEXP Rprivate;
+  SEXP Rrow;
+  SEXP Rcol;
+  SEXP Rcount;
+  SEXP Rnames;
+  SEXP Rdim;
+  int m;
+  int nloc;
+  int num_threads;
+  int nrow;
+  int l;
+  int i;
+  int* locus;
+  int* start;
+  int* private;
+  R_xlen_t* offset;
+  double* work;
+  private_data d;
+
+  Rdim         = getAttrib(tab, R_DimSymbol);
+  d.n          = INTEGER(Rdim)[0];
+  m            = INTEGER(Rdim)[1];
+  d.npop       = asInteger(npop);
+  d.individual = asLogical(individual);
+  d.count      = asLogical(count_alleles);
+  d.by_locus   = asLogical(by_locus);
+  locus        = INTEGER(loc_fac);
+  if (length(loc_fac) != m || length(pop) != d.n)
+  {
+    error("the locus factor and populations do not match the data");
+  }
+  for (i = 0; i < d.n; i++)
+  {
+    if (INTEGER(pop)[i] != NA_INTEGER && 
+        (INTEGER(pop)[i] < 1 || INTEGER(pop)[i] > d.npop))
+    {
+      error("populations must be between 1 and npop");
+    }
+  }
+  num_threads = poppr_threads(requested_threads);
+
+  // The start of each locus
+  nloc  = (m > 0) ? locus[m - 1] : 0;
+  start = (int*)R_alloc(nloc + 1, sizeof(int));
+  start[0] = 0;
+  for (i = 1; i < m; i++)
+  {
+    if (locus[i] < locus[i - 1])
+    {
+      error("the columns of each locus must be contiguous");
+    }
+    if (locus[i] != locus[i - 1])
+    {
+      start[locus[i] - 1] = i;
+    }
+  }
+  start[nloc] = m;
+
+  PROTECT(tab = coerceVector(tab, REALSXP));
+  PROTECT(Rprivate = allocVector(LGLSXP, m));
+  d.X     = REAL(tab);
+  d.pop   = INTEGER(pop);
+  private = LOGICAL(Rprivate);
+  nrow    = (d.individual) ? d.n : d.npop;
+  offset  = (R_xlen_t*)R_alloc(nloc + 1, sizeof(R_xlen_t));
+  // population counts (npop) and row sums (nrow) for each thread
+  work    = R_Calloc((size_t)num_threads*(d.npop + nrow + 1), double);
+
+  // First pass: private alleles and number of triples per locus
+  #ifdef _OPENMP
+  #pragma omp parallel for schedule(dynamic) num_threads(num_threads) private(l)
+  #endif
+  for (l = 0; l < nloc; l++)
+  {
+    int tid = 0;
+    double* w;
+    #ifdef _OPENMP
+    tid = omp_get_thread_num();
+    #endif
+    w = work + (size_t)tid*(d.npop + nrow + 1);
+    offset[l + 1] = private_locus(&d, l, start[l], start[l + 1], w, 
+                                  w + d.npop, private, NULL, NULL, NULL);
+  }
+  offset[0] = 0;
+  for (l = 0; l < nloc; l++)
+  {
+    offset[l + 1] += offset[l];
+  }
+
+  // Second pass: the triples
+  PROTECT(Rrow   = allocVector(INTSXP, offset[nloc]));
+  PROTECT(Rcol   = allocVector(INTSXP, offset[nloc]));
+  PROTECT(Rcount = allocVector(REALSXP, offset[nloc]));
+  #ifdef _OPENMP
+  #pragma omp parallel for schedule(dynamic) num_threads(num_threads) private(l)
+  #endif
+  for (l = 0; l < nloc; l++)
+  {
+    int tid = 0;
+    double* w;
+    if (offset[l + 1] == offset[l])
+    {
+      continue;
+    }
+    #ifdef _OPENMP
+    tid = omp_get_thread_num();
+    #endif
+    w = work + (size_t)tid*(d.npop + nrow + 1);
+    private_locus(&d, l, start[l], start[l + 1], w, w + d.npop, private, 
+                  INTEGER(Rrow) + offset[l], INTEGER(Rcol) + offset[l], 
+                  REAL(Rcount) + offset[l]);
+  }
+  R_Free(work);
+
+  PROTECT(Rout = allocVector(VECSXP, 4));
+  PROTECT(Rnames = allocVector(STRSXP, 4));
+  SET_VECTOR_ELT(Rout, 0, Rprivate);
+  SET_VECTOR_ELT(Rout, 1, Rrow);
+  SET_VECTOR_ELT(Rout, 2, Rcol);
+  SET_VECTOR_ELT(Rout, 3, Rcount);
+  SET_STRING_ELT(Rnames, 0, mkChar("private"));
+  SET_STRING_ELT(Rnames, 1, mkChar("row"));
+  SET_STRING_ELT(Rnames, 2, mkChar("col"));
+  SET_STRING_ELT(Rnames, 3, mkChar("count"));
+  setAttrib(Rout, R_NamesSymbol, Rnames);
+  UNPROTECT(7);
+  return Rout;
+}
@@ -0,0 +1,666 @@
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+#
+# This software was authored by Zhian N. Kamvar and Javier F. Tabima, graduate
+# students at Oregon State University; Jonah C. Brooks, undergraduate student at
+# Oregon State University; and Dr. Nik Grünwald, an employee of USDA-ARS.
+#
+# Permission to use, copy, modify, and distribute this software and its
+# documentation for educational, research and non-profit purposes, without fee,
+# and without a written agreement is hereby granted, provided that the statement
+# above is incorporated into the material, giving appropriate attribution to the
+# authors.
+#
+# Permission to incorporate this software into commercial products may be
+# obtained by contacting USDA ARS and OREGON STATE UNIVERSITY Office for
+# Commercialization and Corporate Development.
+#
+# The software program and documentation are supplied "as is", without any
+# accompanying services from the USDA or the University. USDA ARS or the
+# University do not warrant that the operation of the program will be
+# uninterrupted or error-free. The end-user understands that the program was
+# developed for research purposes and is advised not to rely exclusively on the
+# program for any reason.
+#
+# IN NO EVENT SHALL USDA ARS OR OREGON STATE UNIVERSITY BE LIABLE TO ANY PARTY
+# FOR DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES, INCLUDING
+# LOST PROFITS, ARISING OUT OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION,
+# EVEN IF THE OREGON STATE UNIVERSITY HAS BEEN ADVISED OF THE POSSIBILITY OF
+# SUCH DAMAGE. USDA ARS OR OREGON STATE UNIVERSITY SPECIFICALLY DISCLAIMS ANY
+# WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+# MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE AND ANY STATUTORY
+# WARRANTY OF NON-INFRINGEMENT. THE SOFTWARE PROVIDED HEREUNDER IS ON AN "AS IS"
+# BASIS, AND USDA ARS AND OREGON STATE UNIVERSITY HAVE NO OBLIGATIONS TO PROVIDE
+# MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS.
+#
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+// Include openMP if the compiler supports it
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include <Rinternals.h>
+#include <R_ext/Utils.h>
+#include <R.h>
+#include "poppr_rng.h"
+#include "poppr_threads.h"
+#include "poppr_progress.h"
+
+// Number of pairs of samples whose distances shuffle_ia_stats() holds at once
+#define SHUFFLE_PAIR_BLOCK 65536
+
+/*
+Shuffling loci of genind objects
+================================
+
+shufflepop() and the permutation tests of ia() and poppr() shuffle every locus
+of an allele count table independently with one of four methods:
+
+  1 - permute alleles: the alleles of all typed samples at a locus are pooled
+      and dealt back out to the samples, each receiving as many alleles as it
+      had. Missing data stay in place.
+  2 - parametric bootstrap: every sample receives a multinomial draw of alleles
+      from the allele frequencies of the locus. The number of alleles is the
+      ploidy of one sample drawn at random for each locus.
+  3 - non-parametric bootstrap: as 2, but with equal allele frequencies.
+  4 - multilocus: the genotypes of the typed samples are permuted.
+
+Loci with a single allele are never shuffled.
+
+Everything that does not change between replicates is set up once: the pool of
+alleles of each locus (one entry per allele copy, holding its column), the
+number of alleles of each sample at each locus, the typed samples of each
+locus, and the cumulative allele frequencies. A replicate is then a
+Fisher-Yates shuffle of a copy of the pool (or of the typed samples) in a
+per-thread buffer and a pass over the columns of the locus. All of the
+buffers are allocated with R_alloc() so that nothing leaks when the user
+interrupts the replicates.
+
+Every replicate is independent, with its own random number stream, so the
+replicates are run in parallel. shuffle_tab() returns the shuffled tables and
+shuffle_ia() passes each shuffled table directly to the index of association
+without returning it to R.
+*/
+
+struct shuffle_data {
+  int n;             // number of samples
+  int m;             // number of columns
+  int nloc;          // number of loci
+  int method;        // shuffling method (1 - 4)
+  const int* tab;    // n x m allele counts
+  const int* ploidy; // ploidy of each sample
+  int* loc_start;    // first column of each locus (nloc + 1)
+  int* pool;         // allele pools of all loci (method 1)
+  size_t* pool_start; // first element of the pool of each locus (nloc + 1)
+  int* count;        // alleles of each sample at each locus or -1 if missing
+  int* typed;        // typed samples of all loci (method 4)
+  size_t* typed_start; // first typed sample of each locus (nloc + 1)
+  double* cumw;      // cumulative allele frequencies (methods 2 and 3)
+  int maxwork;       // the largest pool or number of typed samples
+};
+
+SEXP shuffle_tab(SEXP tab, SEXP loc_fac, SEXP ploidy, SEXP method, SEXP nrep, SEXP requested_threads);
+SEXP shuffle_ia(SEXP tab, SEXP loc_fac, SEXP ploidy, SEXP method, SEXP nrep, SEXP requested_threads);
+static void shuffle_setup(struct shuffle_data* d, SEXP tab, SEXP loc_fac, SEXP ploidy, SEXP method);
+static void shuffle_replicate(const struct shuffle_data* d, struct poppr_rng* rng, int* out, int* work);
+static void shuffle_ia_stats(const struct shuffle_data* d, const int* x, int* pairs, double* D, double* lsum, double* out);
+
+// In-place Fisher-Yates shuffle of x[0..n-1]
+static inline void shuffle_fisher_yates(struct poppr_rng *rng, int *x, int n)
+{
+  int i;
+  int j;
+  int tmp;
+  for (i = n - 1; i > 0; i--)
+  {
+    j    = poppr_rng_int(rng, i + 1);
+    tmp  = x[i];
+    x[i] = x[j];
+    x[j] = tmp;
+  }
+}
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+Shuffles every locus of an allele count table independently.
+
+Input: tab     - an n x m integer matrix of allele counts
+       loc_fac - an integer vector of length m giving the locus of each column.
+                 The columns of each locus must be contiguous.
+       ploidy  - an integer vector of length n with the ploidy of each sample
+       method  - the shuffling method (1 - 4, see above)
+       nrep    - the number of shuffled tables
+       requested_threads - number of threads (0 = all available)
+Output: a list of nrep n x m integer matrices
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+SEXP shuffle_tab(SEXP tab, SEXP loc_fac, SEXP ploidy, SEXP method, SEXP nrep, SEXP requested_threads)
+{
+  SEXP Rout;
+  struct shuffle_data d;
+  int R = asInteger(nrep);
+  int num_threads;
+  int r;
+  int** out;
+  int* work;
+  uint64_t seed;
+  struct poppr_progress prog;
+
+  R_CheckUserInterrupt();
+  PROTECT(tab = coerceVector(tab, INTSXP));
+  PROTECT(ploidy = coerceVector(ploidy, INTSXP));
+  shuffle_setup(&d, tab, loc_fac, ploidy, method);
+  num_threads = poppr_threads(requested_threads);
+  // The matrices are allocated before the threads are started and filled in
+  // place.
+  PROTECT(Rout = allocVector(VECSXP, R));
+  out = (int**)R_alloc(R > 0 ? R : 1, sizeof(int*));
+  for (r = 0; r < R; r++)
+  {
+    SET_VECTOR_ELT(Rout, r, allocMatrix(INTSXP, d.n, d.m));
+    out[r] = INTEGER(VECTOR_ELT(Rout, r));
+  }
+  // Replicate r is the pair (r, 0) of one seed
+  seed  = poppr_rng_seed();
+  work  = (int*)R_alloc((size_t)num_threads*(d.maxwork + 1), sizeof(int));
+  poppr_progress_init(&prog, (double)R, R_NilValue);
+  #ifdef _OPENMP
+  #pragma omp parallel for schedule(dynamic) num_threads(num_threads)
+  #endif
+  for (r = 0; r < R; r++)
+  {
+    int tid = 0;
+    struct poppr_rng rng;
+    if (poppr_progress_poll(&prog))
+    {
+      continue;
+    }
+    #ifdef _OPENMP
+    tid = omp_get_thread_num();
+    #endif
+    poppr_rng_init(&rng, seed, r, 0);
+    shuffle_replicate(&d, &rng, out[r], work + (size_t)tid*(d.maxwork + 1));
+    poppr_progress_add(&prog, 1);
+  }
+  poppr_progress_finish(&prog);
+  UNPROTECT(3);
+  return Rout;
+}
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+Calculates the index of association and the standardized index of association
+(rbarD) of shuffled allele count tables. This is the permutation test of ia()
+without creating the shuffled tables in R. The statistics are the same as those
+of .Ia.Rd() on the loci of the shuffled table.
+
+Input: see shuffle_tab()
+Output: an nrep x 2 matrix with the columns Ia and rbarD
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+SEXP shuffle_ia(SEXP tab, SEXP loc_fac, SEXP ploidy, SEXP method, SEXP nrep, SEXP requested_threads)
+{
+  SEXP Rout;
+  struct shuffle_data d;
+  int R = asInteger(nrep);
+  int num_threads;
+  int r;
+  size_t np;
+  size_t nm;
+  int* xbuf;
+  int* work;
+  int* pairs;
+  double* D;
+  double* lsum;
+  double* out;
+  uint64_t seed;
+  struct poppr_progress prog;
+
+  R_CheckUserInterrupt();
+  PROTECT(tab = coerceVector(tab, INTSXP));
+  PROTECT(ploidy = coerceVector(ploidy, INTSXP));
+  shuffle_setup(&d, tab, loc_fac, ploidy, method);
+  num_threads = poppr_threads(requested_threads);
+  PROTECT(Rout = allocMatrix(REALSXP, R, 2));
+  out = REAL(Rout);
+  np  = (size_t)d.n*(d.n - 1)/2;
+  nm  = (size_t)d.n*d.m;
+  // The pairwise distances are processed in blocks, so a thread never holds
+  // more than SHUFFLE_PAIR_BLOCK of them.
+  if (np > SHUFFLE_PAIR_BLOCK)
+  {
+    np = SHUFFLE_PAIR_BLOCK;
+  }
+  // Replicate r is the pair (r, 0) of one seed
+  seed  = poppr_rng_seed();
+  // Per-thread shuffled table, shuffle buffer, pairwise differences, and sums
+  // of the distances of each locus
+  xbuf  = (int*)R_alloc((size_t)num_threads*(nm + 1), sizeof(int));
+  work  = (int*)R_alloc((size_t)num_threads*(d.maxwork + 1), sizeof(int));
+  pairs = (int*)R_alloc((size_t)num_threads*(np + 1), sizeof(int));
+  D     = (double*)R_alloc((size_t)num_threads*(np + 1), sizeof(double));
+  lsum  = (double*)R_alloc((size_t)num_threads*(2*d.nloc + 1), sizeof(double));
+  poppr_progress_init(&prog, (double)R, R_NilValue);
+  #ifdef _OPENMP
+  #pragma omp parallel for schedule(dynamic) num_threads(num_threads)
+  #endif
+  for (r = 0; r < R; r++)
+  {
+    int tid = 0;
+    int* x;
+    double res[2];
+    struct poppr_rng rng;
+    if (poppr_progress_poll(&prog))
+    {
+      continue;
+    }
+    #ifdef _OPENMP
+    tid = omp_get_thread_num();
+    #endif
+    x = xbuf + (size_t)tid*(nm + 1);
+    poppr_rng_init(&rng, seed, r, 0);
+    shuffle_replicate(&d, &rng, x, work + (size_t)tid*(d.maxwork + 1));
+    shuffle_ia_stats(&d, x, pairs + (size_t)tid*(np + 1), 
+                     D + (size_t)tid*(np + 1), 
+                     lsum + (size_t)tid*(2*d.nloc + 1), res);
+    out[r]     = res[0];
+    out[r + R] = res[1];
+    poppr_progress_add(&prog, 1);
+  }
+  poppr_progress_finish(&prog);
+  UNPROTECT(3);
+  return Rout;
+}
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+Sets up everything that is shared by the replicates of a method.
+
+Input: d       - a shuffle_data struct to fill. Its buffers are allocated
+                 with R_alloc().
+       tab     - an n x m integer matrix of allele counts
+       loc_fac - an integer vector of length m giving the locus of each column
+       ploidy  - an integer vector of length n
+       method  - the shuffling method
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+static void shuffle_setup(struct shuffle_data* d, SEXP tab, SEXP loc_fac, SEXP ploidy, SEXP method)
+{
+  SEXP Rdim = getAttrib(tab, R_DimSymbol);
+  const int* locus = INTEGER(loc_fac);
+  int i;
+  int k;
+  int l;
+  size_t np;
+  size_t nt;
+
+  d->n      = INTEGER(Rdim)[0];
+  d->m      = INTEGER(Rdim)[1];
+  d->method = asInteger(method);
+  d->tab    = INTEGER(tab);
+  d->ploidy = INTEGER(ploidy);
+  if (length(loc_fac) != d->m)
+  {
+    error("loc_fac must have one element per column");
+  }
+  if (length(ploidy) != d->n)
+  {
+    error("ploidy must have one element per row");
+  }
+  if (d->method < 1 || d->method > 4)
+  {
+    error("unknown method: %d", d->method);
+  }
+  for (k = 1; k < d->m; k++)
+  {
+    if (locus[k] < locus[k - 1])
+    {
+      error("the columns of each locus must be contiguous");
+    }
+  }
+  d->pool        = NULL;
+  d->pool_start  = NULL;
+  d->count       = NULL;
+  d->typed       = NULL;
+  d->typed_start = NULL;
+  d->cumw        = NULL;
+  d->maxwork     = 0;
+  d->loc_start   = (int*)R_alloc(d->m + 1, sizeof(int));
+  d->nloc        = 0;
+  for (k = 0; k < d->m; k++)
+  {
+    if (k == 0 || locus[k] != locus[k - 1])
+    {
+      d->loc_start[d->nloc++] = k;
+    }
+  }
+  d->loc_start[d->nloc] = d->m;
+
+  if (d->method == 1)
+  {
+    // Allele pools and the number of alleles of each sample
+    d->count      = (int*)R_alloc((size_t)d->n*d->nloc + 1, sizeof(int));
+    d->pool_start = (size_t*)R_alloc(d->nloc + 1, sizeof(size_t));
+    np = 0;
+    for (l = 0; l < d->nloc; l++)
+    {
+      d->pool_start[l] = np;
+      for (i = 0; i < d->n; i++)
+      {
+        int total = 0;
+        int miss  = 0;
+        for (k = d->loc_start[l]; k < d->loc_start[l + 1]; k++)
+        {
+          int v = d->tab[i + (size_t)k*d->n];
+          if (v == NA_INTEGER)
+          {
+            miss = 1;
+          }
+          else
+          {
+            total += v;
+          }
+        }
+        np += total;
+        d->count[i + (size_t)l*d->n] = miss ? -1 : total;
+      }
+      if (np - d->pool_start[l] > (size_t)d->maxwork)
+      {
+        d->maxwork = (int)(np - d->pool_start[l]);
+      }
+    }
+    d->pool_start[d->nloc] = np;
+    d->pool = (int*)R_alloc(np + 1, sizeof(int));
+    for (l = 0; l < d->nloc; l++)
+    {
+      size_t p = d->pool_start[l];
+      for (k = d->loc_start[l]; k < d->loc_start[l + 1]; k++)
+      {
+        for (i = 0; i < d->n; i++)
+        {
+          int v = d->tab[i + (size_t)k*d->n];
+          if (v != NA_INTEGER)
+          {
+            while (v-- > 0)
+            {
+              d->pool[p++] = k;
+            }
+          }
+        }
+      }
+    }
+  }
+  else if (d->method == 4)
+  {
+    // Typed samples of each locus
+    d->typed       = (int*)R_alloc((size_t)d->n*d->nloc + 1, sizeof(int));
+    d->typed_start = (size_t*)R_alloc(d->nloc + 1, sizeof(size_t));
+    nt = 0;
+    for (l = 0; l < d->nloc; l++)
+    {
+      d->typed_start[l] = nt;
+      for (i = 0; i < d->n; i++)
+      {
+        int miss = 0;
+        for (k = d->loc_start[l]; k < d->loc_start[l + 1]; k++)
+        {
+          if (d->tab[i + (size_t)k*d->n] == NA_INTEGER)
+          {
+            miss = 1;
+            break;
+          }
+        }
+        if (!miss)
+        {
+          d->typed[nt++] = i;
+        }
+      }
+    }
+    d->typed_start[d->nloc] = nt;
+    d->maxwork = d->n;
+  }
+  else
+  {
+    // Cumulative allele frequencies of each locus. A locus without any typed
+    // samples has a total of zero and is not shuffled.
+    d->cumw = (double*)R_alloc(d->m + 1, sizeof(double));
+    for (l = 0; l < d->nloc; l++)
+    {
+      double total = 0.0;
+      for (k = d->loc_start[l]; k < d->loc_start[l + 1]; k++)
+      {
+        double w = 1.0;
+        if (d->method == 2)
+        {
+          double sum = 0.0;
+          int ntyped = 0;
+          for (i = 0; i < d->n; i++)
+          {
+            int v = d->tab[i + (size_t)k*d->n];
+            if (v != NA_INTEGER)
+            {
+              sum += v;
+              ntyped++;
+            }
+          }
+          w = (ntyped > 0) ? sum/ntyped : 0.0;
+        }
+        total += w;
+        d->cumw[k] = total;
+      }
+    }
+  }
+}
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+Creates one shuffled table.
+
+Input: d     - the shared data from shuffle_setup()
+       rng   - the random number stream of the replicate
+       out   - an n x m buffer for the shuffled table
+       work  - a buffer of at least d->maxwork integers
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+static void shuffle_replicate(const struct shuffle_data* d, struct poppr_rng* rng, int* out, int* work)
+{
+  const int n = d->n;
+  const int* tab = d->tab;
+  int i;
+  int k;
+  int l;
+
+  for (l = 0; l < d->nloc; l++)
+  {
+    const int k0 = d->loc_start[l];
+    const int k1 = d->loc_start[l + 1];
+    if (k1 - k0 < 2)
+    {
+      memcpy(out + (size_t)k0*n, tab + (size_t)k0*n, sizeof(int)*n*(k1 - k0));
+      continue;
+    }
+    if (d->method == 1)
+    {
+      const int* count = d->count + (size_t)l*n;
+      const int npool  = (int)(d->pool_start[l + 1] - d->pool_start[l]);
+      int p = 0;
+      int a;
+      memcpy(work, d->pool + d->pool_start[l], sizeof(int)*npool);
+      shuffle_fisher_yates(rng, work, npool);
+      for (k = k0; k < k1; k++)
+      {
+        for (i = 0; i < n; i++)
+        {
+          size_t idx = i + (size_t)k*n;
+          out[idx] = (tab[idx] == NA_INTEGER) ? NA_INTEGER : 0;
+        }
+      }
+      for (i = 0; i < n; i++)
+      {
+        for (a = 0; a < count[i]; a++)
+        {
+          out[i + (size_t)work[p++]*n] += 1;
+        }
+      }
+    }
+    else if (d->method == 4)
+    {
+      const int* typed = d->typed + d->typed_start[l];
+      const int ntyped = (int)(d->typed_start[l + 1] - d->typed_start[l]);
+      int t;
+      memcpy(work, typed, sizeof(int)*ntyped);
+      shuffle_fisher_yates(rng, work, ntyped);
+      memcpy(out + (size_t)k0*n, tab + (size_t)k0*n, sizeof(int)*n*(k1 - k0));
+      for (t = 0; t < ntyped; t++)
+      {
+        for (k = k0; k < k1; k++)
+        {
+          out[typed[t] + (size_t)k*n] = tab[work[t] + (size_t)k*n];
+        }
+      }
+    }
+    else
+    {
+      const double* cumw = d->cumw;
+      const double total = cumw[k1 - 1];
+      int size;
+      int a;
+      if (!(total > 0.0))
+      {
+        memcpy(out + (size_t)k0*n, tab + (size_t)k0*n, sizeof(int)*n*(k1 - k0));
+        continue;
+      }
+      // One sample's ploidy is the number of alleles of every sample
+      size = d->ploidy[poppr_rng_int(rng, n)];
+      for (k = k0; k < k1; k++)
+      {
+        memset(out + (size_t)k*n, 0, sizeof(int)*n);
+      }
+      for (i = 0; i < n; i++)
+      {
+        for (a = 0; a < size; a++)
+        {
+          double u = poppr_rng_unif(rng)*total;
+          k = k0;
+          while (k < k1 - 1 && cumw[k] <= u)
+          {
+            k++;
+          }
+          out[i + (size_t)k*n] += 1;
+        }
+      }
+    }
+  }
+}
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+Calculates the index of association and rbarD of a table. The distance between
+two samples at a locus is half of the sum of the absolute differences of their
+allele counts, rounded up, or 0 if either sample is missing (as in
+pair_matrix()).
+
+The pairs of samples are visited in blocks of at most SHUFFLE_PAIR_BLOCK pairs
+in the order of pair_matrix(). Only the sums over the pairs are kept between
+blocks, and they are accumulated in the same order as over all pairs at once.
+
+Input: d     - the shared data from shuffle_setup()
+       x     - an n x m table of allele counts
+       pairs - a buffer of min(n(n - 1)/2, SHUFFLE_PAIR_BLOCK) integers
+       D     - a buffer of min(n(n - 1)/2, SHUFFLE_PAIR_BLOCK) doubles
+       lsum  - a buffer of two doubles per locus
+       out   - a vector of length 2 for Ia and rbarD
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+static void shuffle_ia_stats(const struct shuffle_data* d, const int* x, int* pairs, double* D, double* lsum, double* out)
+{
+  const int n = d->n;
+  const size_t np = (size_t)n*(n - 1)/2;
+  double* dsum = lsum;
+  double* d2sum = lsum + d->nloc;
+  double sum_vard = 0.0;
+  double sum_covar = 0.0;
+  double sumD = 0.0;
+  double sumD2 = 0.0;
+  double varD;
+  double vard;
+  int i;
+  int j;
+  int bi;
+  int bj;
+  int k;
+  int l;
+  size_t p;
+  size_t p0;
+  size_t nb;
+
+  if (np < 2)
+  {
+    out[0] = R_NaN;
+    out[1] = R_NaN;
+    return;
+  }
+  memset(lsum, 0, sizeof(double)*2*d->nloc);
+  // (bi, bj) is the first pair of the block
+  bi = 0;
+  bj = 1;
+  for (p0 = 0; p0 < np; p0 += nb)
+  {
+    nb = (np - p0 < SHUFFLE_PAIR_BLOCK) ? np - p0 : SHUFFLE_PAIR_BLOCK;
+    memset(D, 0, sizeof(double)*nb);
+    for (l = 0; l < d->nloc; l++)
+    {
+      memset(pairs, 0, sizeof(int)*nb);
+      for (k = d->loc_start[l]; k < d->loc_start[l + 1]; k++)
+      {
+        const int* col = x + (size_t)k*n;
+        i = bi;
+        j = bj;
+        for (p = 0; p < nb; p++)
+        {
+          if (pairs[p] >= 0)
+          {
+            if (col[i] == NA_INTEGER || col[j] == NA_INTEGER)
+            {
+              pairs[p] = -1;
+            }
+            else
+            {
+              pairs[p] += abs(col[i] - col[j]);
+            }
+          }
+          if (++j == n)
+          {
+            i++;
+            j = i + 1;
+          }
+        }
+      }
+      for (p = 0; p < nb; p++)
+      {
+        double dist = (pairs[p] < 0) ? 0.0 : (double)((pairs[p] + 1)/2);
+        dsum[l]  += dist;
+        d2sum[l] += dist*dist;
+        D[p]     += dist;
+      }
+    }
+    for (p = 0; p < nb; p++)
+    {
+      sumD  += D[p];
+      sumD2 += D[p]*D[p];
+      if (++bj == n)
+      {
+        bi++;
+        bj = bi + 1;
+      }
+    }
+  }
+  varD = (sumD2 - sumD*sumD/np)/np;
+  // The variance of each locus replaces its sum
+  for (l = 0; l < d->nloc; l++)
+  {
+    vard      = (d2sum[l] - dsum[l]*dsum[l]/np)/np;
+    dsum[l]   = vard;
+    sum_vard += vard;
+  }
+  for (l = 0; l < d->nloc - 1; l++)
+  {
+    for (k = l + 1; k < d->nloc; k++)
+    {
+      sum_covar += sqrt(dsum[l]*dsum[k]);
+    }
+  }
+  out[0] = varD/sum_vard - 1.0;
+  out[1] = (varD - sum_vard)/(2.0*sum_covar);
+}
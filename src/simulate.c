@@ -0,0 +1,253 @@
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+#
+# This software was authored by Zhian N. Kamvar and Javier F. Tabima, graduate
+# students at Oregon State University; Jonah C. Brooks, undergraduate student at
+# Oregon State University; and Dr. Nik Grünwald, an employee of USDA-ARS.
+#
+# Permission to use, copy, modify, and distribute this software and its
+# documentation for educational, research and non-profit purposes, without fee,
+# and without a written agreement is hereby granted, provided that the statement
+# above is incorporated into the material, giving appropriate attribution to the
+# authors.
+#
+# Permission to incorporate this software into commercial products may be
+# obtained by contacting USDA ARS and OREGON STATE UNIVERSITY Office for
+# Commercialization and Corporate Development.
+#
+# The software program and documentation are supplied "as is", without any
+# accompanying services from the USDA or the University. USDA ARS or the
+# University do not warrant that the operation of the program will be
+# uninterrupted or error-free. The end-user understands that the program was
+# developed for research purposes and is advised not to rely exclusively on the
+# program for any reason.
+#
+# IN NO EVENT SHALL USDA ARS OR OREGON STATE UNIVERSITY BE LIABLE TO ANY PARTY
+# FOR DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES, INCLUDING
+# LOST PROFITS, ARISING OUT OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION,
+# EVEN IF THE OREGON STATE UNIVERSITY HAS BEEN ADVISED OF THE POSSIBILITY OF
+# SUCH DAMAGE. USDA ARS OR OREGON STATE UNIVERSITY SPECIFICALLY DISCLAIMS ANY
+# WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+# MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE AND ANY STATUTORY
+# WARRANTY OF NON-INFRINGEMENT. THE SOFTWARE PROVIDED HEREUNDER IS ON AN "AS IS"
+# BASIS, AND USDA ARS AND OREGON STATE UNIVERSITY HAVE NO OBLIGATIONS TO PROVIDE
+# MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS.
+#
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+// Include openMP if the compiler supports it
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include <Rinternals.h>
+#include <R_ext/Utils.h>
+#include <R.h>
+#include "poppr_rng.h"
+#include "poppr_threads.h"
+
+/*
+Synthetic genotypes
+===================
+
+simulate_genotypes() draws the alleles of n samples at m loci for
+benchmarks and tests. Each locus has its own allele frequencies, which are
+uniform random weights normalized to one, so loci differ in their diversity.
+
+  - sexual samples draw each of their alleles independently from the allele
+    frequencies of the locus (Hardy-Weinberg and linkage equilibrium),
+  - clonal samples copy one of a number of founders, which are drawn like
+    sexual samples. Each allele of a copy mutates with a given probability
+    by one step up or down, so that the alleles keep the structure of
+    repeat counts that Bruvo's distance relies on.
+
+Every genotype of a sample at a locus is missing with a given probability.
+Every sample has its own random number stream (see poppr_rng.h), so the
+samples are drawn in parallel and the result of a seed does not depend on the
+number of threads. The streams are
+
+  (locus, 0)   - allele frequencies of a locus
+  (founder, 1) - alleles of a founder
+  (sample, 2)  - alleles of a sample (or its founder, mutation, and missing
+                 data)
+*/
+
+SEXP simulate_genotypes(SEXP n, SEXP nloc, SEXP ploidy, SEXP alleles, SEXP clones, SEXP missing, SEXP mutation, SEXP threads);
+static int draw_allele(struct poppr_rng* rng, const double* cumfreq, int k);
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+Draws synthetic genotypes.
+
+Input: n        - the number of samples
+       nloc     - the number of loci
+       ploidy   - the number of alleles per sample per locus
+       alleles  - the number of alleles of each locus (a vector of length nloc)
+       clones   - the number of clonal founders (0 for a sexual population)
+       missing  - the probability that the genotype of a sample at a locus is
+                  missing
+       mutation - the probability that an allele of a clone mutates by one
+                  repeat
+       threads  - the number of threads to use (see poppr_threads.h)
+Output: an n x (nloc*ploidy) integer matrix of 0-based allele indices where
+        the alleles of locus l are in columns l*ploidy to (l+1)*ploidy - 1.
+        Missing alleles are NA.
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+SEXP simulate_genotypes(SEXP n, SEXP nloc, SEXP ploidy, SEXP alleles, SEXP clones, SEXP missing, SEXP mutation, SEXP threads)
+{
+  int N = asInteger(n);
+  int M = asInteger(nloc);
+  int P = asInteger(ploidy);
+  int C = asInteger(clones);
+  double miss = asReal(missing);
+  double mu = asReal(mutation);
+  int* nall;
+  int* out;
+  int* founders = NULL;
+  double* cumfreq;
+  size_t* offset;
+  size_t ncol;
+  uint64_t seed;
+  int num_threads;
+  int i, l, a;
+  SEXP R_out;
+
+  if (N < 0 || M < 0 || P < 1 || C < 0 || XLENGTH(alleles) != M)
+  {
+    error("invalid dimensions of the simulation");
+  }
+  nall = INTEGER(alleles);
+  for (l = 0; l < M; l++)
+  {
+    if (nall[l] < 1)
+    {
+      error("every locus needs at least one allele");
+    }
+  }
+  ncol = (size_t)M*P;
+  R_out = PROTECT(allocMatrix(INTSXP, N, (int)ncol));
+  out = INTEGER(R_out);
+  num_threads = poppr_threads(threads);
+  seed = poppr_rng_seed();
+
+  // Cumulative allele frequencies of each locus
+  offset = R_Calloc(M + 1, size_t);
+  for (l = 0; l < M; l++)
+  {
+    offset[l + 1] = offset[l] + nall[l];
+  }
+  cumfreq = R_Calloc(offset[M] > 0 ? offset[M] : 1, double);
+  #ifdef _OPENMP
+  #pragma omp parallel for schedule(static) num_threads(num_threads) private(a)
+  #endif
+  for (l = 0; l < M; l++)
+  {
+    struct poppr_rng rng;
+    double* cf = cumfreq + offset[l];
+    double sum = 0.0;
+    poppr_rng_init(&rng, seed, l, 0);
+    for (a = 0; a < nall[l]; a++)
+    {
+      sum += poppr_rng_unif(&rng) + 1e-3;
+      cf[a] = sum;
+    }
+    for (a = 0; a < nall[l]; a++)
+    {
+      cf[a] /= sum;
+    }
+  }
+
+  if (C > 0)
+  {
+    founders = R_Calloc((size_t)C*ncol, int);
+    #ifdef _OPENMP
+    #pragma omp parallel for schedule(static) num_threads(num_threads) private(l, a)
+    #endif
+    for (i = 0; i < C; i++)
+    {
+      struct poppr_rng rng;
+      poppr_rng_init(&rng, seed, i, 1);
+      for (l = 0; l < M; l++)
+      {
+        for (a = 0; a < P; a++)
+        {
+          founders[(size_t)i*ncol + (size_t)l*P + a] = draw_allele(&rng, cumfreq + offset[l], nall[l]);
+        }
+      }
+    }
+  }
+
+  #ifdef _OPENMP
+  #pragma omp parallel for schedule(static) num_threads(num_threads) private(l, a)
+  #endif
+  for (i = 0; i < N; i++)
+  {
+    struct poppr_rng rng;
+    int* founder = NULL;
+    poppr_rng_init(&rng, seed, i, 2);
+    if (C > 0)
+    {
+      founder = founders + (size_t)poppr_rng_int(&rng, C)*ncol;
+    }
+    for (l = 0; l < M; l++)
+    {
+      int is_missing = miss > 0 && poppr_rng_unif(&rng) < miss;
+      for (a = 0; a < P; a++)
+      {
+        size_t cell = (size_t)i + (size_t)N*((size_t)l*P + a);
+        int allele;
+        if (founder == NULL)
+        {
+          allele = draw_allele(&rng, cumfreq + offset[l], nall[l]);
+        }
+        else
+        {
+          allele = founder[(size_t)l*P + a];
+          if (mu > 0 && poppr_rng_unif(&rng) < mu)
+          {
+            allele += (poppr_rng_unif(&rng) < 0.5) ? -1 : 1;
+            // Reflect at the smallest and largest allele
+            if (allele < 0)
+            {
+              allele = (nall[l] > 1) ? 1 : 0;
+            }
+            else if (allele >= nall[l])
+            {
+              allele = (nall[l] > 1) ? nall[l] - 2 : 0;
+            }
+          }
+        }
+        out[cell] = is_missing ? NA_INTEGER : allele;
+      }
+    }
+  }
+
+  R_Free(offset);
+  R_Free(cumfreq);
+  if (founders != NULL)
+  {
+    R_Free(founders);
+  }
+  UNPROTECT(1);
+  return R_out;
+}
+
+// Draws an allele from the cumulative frequencies of a locus by bisection.
+static int draw_allele(struct poppr_rng* rng, const double* cumfreq, int k)
+{
+  double u = poppr_rng_unif(rng);
+  int lo = 0;
+  int hi = k - 1;
+  while (lo < hi)
+  {
+    int mid = lo + (hi - lo)/2;
+    if (u < cumfreq[mid])
+    {
+      hi = mid;
+    }
+    else
+    {
+      lo = mid + 1;
+    }
+  }
+  return lo;
+}
@@ -0,0 +1,886 @@
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+#
+# This software was authored by Zhian N. Kamvar and Javier F. Tabima, graduate
+# students at Oregon State University; Jonah C. Brooks, undergraduate student at
+# Oregon State University; and Dr. Nik Grünwald, an employee of USDA-ARS.
+#
+# Permission to use, copy, modify, and distribute this software and its
+# documentation for educational, research and non-profit purposes, without fee,
+# and without a written agreement is hereby granted, provided that the statement
+# above is incorporated into the material, giving appropriate attribution to the
+# authors.
+#
+# Permission to incorporate this software into commercial products may be
+# obtained by contacting USDA ARS and OREGON STATE UNIVERSITY Office for
+# Commercialization and Corporate Development.
+#
+# The software program and documentation are supplied "as is", without any
+# accompanying services from the USDA or the University. USDA ARS or the
+# University do not warrant that the operation of the program will be
+# uninterrupted or error-free. The end-user understands that the program was
+# developed for research purposes and is advised not to rely exclusively on the
+# program for any reason.
+#
+# IN NO EVENT SHALL USDA ARS OR OREGON STATE UNIVERSITY BE LIABLE TO ANY PARTY
+# FOR DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES, INCLUDING
+# LOST PROFITS, ARISING OUT OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION,
+# EVEN IF THE OREGON STATE UNIVERSITY HAS BEEN ADVISED OF THE POSSIBILITY OF
+# SUCH DAMAGE. USDA ARS OR OREGON STATE UNIVERSITY SPECIFICALLY DISCLAIMS ANY
+# WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+# MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE AND ANY STATUTORY
+# WARRANTY OF NON-INFRINGEMENT. THE SOFTWARE PROVIDED HEREUNDER IS ON AN "AS IS"
+# BASIS, AND USDA ARS AND OREGON STATE UNIVERSITY HAVE NO OBLIGATIONS TO PROVIDE
+# MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS.
+#
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+// Include openMP if the compiler supports it
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include <Rinternals.h>
+#include <R.h>
+#include "poppr_threads.h"
+
+/*
+Streaming VCF import
+====================
+
+The genotypes of a (plain or gzipped) VCF file are decoded directly into the
+bit planes of adegenet's SNPbin objects, which the bitwise kernels use, without
+creating a genotype matrix in R.
+
+The file is read in chunks of lines. The lines of a chunk are parsed in
+parallel: the GT field of every sample is decoded to the number of alternate
+alleles (or missing) and the site filters are applied. The sites that pass the
+filters are then appended to the bit planes of every sample (in parallel over
+samples), so the order of the loci is the order of the file for any number of
+threads.
+
+The planes of a sample with ploidy p follow adegenet: plane k has a bit set
+wherever the sample has at least k alternate alleles, with the first locus of
+every byte in the least significant bit. Missing genotypes have no bits set in
+the planes and a bit set in a separate missing data plane, from which NA.posi
+is created.
+*/
+
+#define VCF_BUFFER (1 << 20)
+#define VCF_MISSING -1
+
+typedef struct {
+  gzFile gz;
+  char *buf;
+  size_t cap;   // capacity of buf
+  size_t start; // start of the unread data
+  size_t end;   // end of the unread data
+  int eof;
+} vcf_reader;
+
+typedef struct {
+  char *text;      // the lines of the chunk, each terminated by '\0'
+  size_t cap;
+  size_t len;
+  size_t *offset;  // the start of each line in text
+  int nlines;
+} vcf_chunk;
+
+typedef struct {
+  int keep;
+  const char *chrom;
+  const char *pos;
+  const char *id;
+  const char *ref;
+  const char *alt;
+  int maxploid;
+} vcf_site;
+
+typedef struct {
+  unsigned char ***planes; // [plane][sample][byte]
+  unsigned char **na;      // [sample][byte]
+  int *ploidy;             // [sample]
+  int maxploid;
+  size_t cap;              // capacity in bytes of every plane
+  int nloc;
+  // locus metadata
+  char **chrom;
+  int *position;
+  char **locname;
+  char **alleles;
+  int loccap;
+} vcf_store;
+
+static int vcf_fill(vcf_reader *r)
+{
+  // Move the unread data to the front and read more, growing the buffer if it
+  // is full.
+  if (r->start > 0)
+  {
+    memmove(r->buf, r->buf + r->start, r->end - r->start);
+    r->end  -= r->start;
+    r->start = 0;
+  }
+  if (r->end == r->cap)
+  {
+    char *tmp = (char *) realloc(r->buf, r->cap * 2);
+    if (tmp == NULL)
+    {
+      return -1;
+    }
+    r->buf  = tmp;
+    r->cap *= 2;
+  }
+  int n = gzread(r->gz, r->buf + r->end, (unsigned int) (r->cap - r->end));
+  if (n < 0)
+  {
+    return -1;
+  }
+  if (n == 0)
+  {
+    r->eof = 1;
+  }
+  r->end += n;
+  return n;
+}
+
+/* Find the next line. The newline (and a carriage return) is replaced with
+   '\0'. Returns NULL at the end of the file; *status is -1 on read errors. */
+static char *vcf_next_line(vcf_reader *r, size_t *len, int *status)
+{
+  char *nl;
+  *status = 0;
+  while ((nl = (char *) memchr(r->buf + r->start, '\n', r->end - r->start)) == NULL)
+  {
+    if (r->eof)
+    {
+      if (r->end == r->start)
+      {
+        return NULL;
+      }
+      // last line without a newline
+      if (r->end == r->cap && vcf_fill(r) < 0)
+      {
+        *status = -1;
+        return NULL;
+      }
+      nl = r->buf + r->end;
+      r->end++;
+      break;
+    }
+    if (vcf_fill(r) < 0)
+    {
+      *status = -1;
+      return NULL;
+    }
+  }
+  char *line = r->buf + r->start;
+  *nl  = '\0';
+  *len = nl - line;
+  if (*len > 0 && line[*len - 1] == '\r')
+  {
+    line[--(*len)] = '\0';
+  }
+  r->start = (nl - r->buf) + 1;
+  return line;
+}
+
+static char *vcf_strdup(const char *x, size_t len)
+{
+  char *res = (char *) malloc(len + 1);
+  if (res != NULL)
+  {
+    memcpy(res, x, len);
+    res[len] = '\0';
+  }
+  return res;
+}
+
+/* Move to the start of the next tab-separated field. Returns NULL if there
+   are no more fields. */
+static const char *vcf_next_field(const char *x)
+{
+  const char *tab = strchr(x, '\t');
+  return tab == NULL ? NULL : tab + 1;
+}
+
+static size_t vcf_field_len(const char *x)
+{
+  size_t i = 0;
+  while (x[i] != '\t' && x[i] != '\0')
+  {
+    i++;
+  }
+  return i;
+}
+
+/* Decode a GT field into the number of alternate alleles and the number of
+   alleles. A genotype with any missing allele is missing. */
+static void vcf_decode_gt(const char *gt, signed char *dosage, signed char *nal)
+{
+  int alleles = 0;
+  int alt     = 0;
+  int missing = 0;
+  const char *p = gt;
+  while (1)
+  {
+    if (*p == '.')
+    {
+      missing = 1;
+      p++;
+    }
+    else if (*p >= '0' && *p <= '9')
+    {
+      int value = 0;
+      while (*p >= '0' && *p <= '9')
+      {
+        value = value * 10 + (*p - '0');
+        p++;
+      }
+      alt += value > 0;
+    }
+    else
+    {
+      missing = 1;
+    }
+    alleles++;
+    if (*p == '/' || *p == '|')
+    {
+      p++;
+    }
+    else
+    {
+      break;
+    }
+  }
+  if (alleles > 127)
+  {
+    alleles = 127;
+  }
+  *nal    = (signed char) alleles;
+  *dosage = missing ? VCF_MISSING : (signed char) (alt > 127 ? 127 : alt);
+}
+
+/* Parse one data line and decode the genotypes of all samples. */
+static void vcf_parse_line(const char *line, int nsamp, int biallelic, 
+                           double maf, double max_missing, vcf_site *site, 
+                           signed char *dosage, signed char *nal)
+{
+  const char *fields[9];
+  const char *p = line;
+  int gt_index  = -1;
+  site->keep     = 0;
+  site->maxploid = 0;
+  for (int i = 0; i < 9; i++)
+  {
+    if (p == NULL)
+    {
+      return;
+    }
+    fields[i] = p;
+    p = vcf_next_field(p);
+  }
+  site->chrom = fields[0];
+  site->pos   = fields[1];
+  site->id    = fields[2];
+  site->ref   = fields[3];
+  site->alt   = fields[4];
+  if (biallelic)
+  {
+    size_t alt_len = vcf_field_len(site->alt);
+    if (alt_len == 0 || (alt_len == 1 && site->alt[0] == '.') || 
+        memchr(site->alt, ',', alt_len) != NULL)
+    {
+      return;
+    }
+  }
+  // Find the position of GT in the FORMAT field
+  const char *f = fields[8];
+  for (int i = 0; *f != '\t' && *f != '\0'; i++)
+  {
+    if (f[0] == 'G' && f[1] == 'T' && (f[2] == ':' || f[2] == '\t' || f[2] == '\0'))
+    {
+      gt_index = i;
+      break;
+    }
+    while (*f != ':' && *f != '\t' && *f != '\0')
+    {
+      f++;
+    }
+    if (*f == ':')
+    {
+      f++;
+    }
+  }
+  int nmissing = 0;
+  long alt_total = 0;
+  long allele_total = 0;
+  for (int s = 0; s < nsamp; s++)
+  {
+    dosage[s] = VCF_MISSING;
+    nal[s]    = 0;
+    if (p == NULL)
+    {
+      nmissing++;
+      continue;
+    }
+    const char *gt = p;
+    for (int i = 0; i < gt_index && gt != NULL; i++)
+    {
+      while (*gt != ':' && *gt != '\t' && *gt != '\0')
+      {
+        gt++;
+      }
+      gt = (*gt == ':') ? gt + 1 : NULL;
+    }
+    if (gt_index >= 0 && gt != NULL)
+    {
+      vcf_decode_gt(gt, &dosage[s], &nal[s]);
+    }
+    if (dosage[s] == VCF_MISSING)
+    {
+      nmissing++;
+    }
+    else
+    {
+      alt_total    += dosage[s];
+      allele_total += nal[s];
+    }
+    if (nal[s] > site->maxploid)
+    {
+      site->maxploid = nal[s];
+    }
+    p = vcf_next_field(p);
+  }
+  if (nsamp > 0 && (double) nmissing / nsamp > max_missing)
+  {
+    return;
+  }
+  if (maf > 0)
+  {
+    if (allele_total == 0)
+    {
+      return;
+    }
+    double freq = (double) alt_total / allele_total;
+    if ((freq < 0.5 ? freq : 1 - freq) < maf)
+    {
+      return;
+    }
+  }
+  site->keep = 1;
+}
+
+static void vcf_store_free(vcf_store *st, int nsamp)
+{
+  for (int k = 0; k < st->maxploid; k++)
+  {
+    for (int s = 0; st->planes[k] != NULL && s < nsamp; s++)
+    {
+      free(st->planes[k][s]);
+    }
+    free(st->planes[k]);
+  }
+  for (int s = 0; st->na != NULL && s < nsamp; s++)
+  {
+    free(st->na[s]);
+  }
+  for (int i = 0; i < st->nloc; i++)
+  {
+    free(st->locname[i]);
+    free(st->alleles[i]);
+  }
+  // chromosome names are shared between loci; they are freed by the caller
+  free(st->planes);
+  free(st->na);
+  free(st->ploidy);
+  free(st->chrom);
+  free(st->position);
+  free(st->locname);
+  free(st->alleles);
+}
+
+/* Make room for nnew more loci and maxploid planes. Returns 0 on failure. */
+static int vcf_store_grow(vcf_store *st, int nsamp, int nnew, int maxploid)
+{
+  size_t need = ((size_t) st->nloc + nnew + 7) / 8;
+  if (need > st->cap)
+  {
+    size_t cap = st->cap > 0 ? st->cap : 1024;
+    while (cap < need)
+    {
+      cap *= 2;
+    }
+    for (int s = 0; s < nsamp; s++)
+    {
+      unsigned char *tmp;
+      for (int k = 0; k < st->maxploid; k++)
+      {
+        tmp = (unsigned char *) realloc(st->planes[k][s], cap);
+        if (tmp == NULL) return 0;
+        memset(tmp + st->cap, 0, cap - st->cap);
+        st->planes[k][s] = tmp;
+      }
+      tmp = (unsigned char *) realloc(st->na[s], cap);
+      if (tmp == NULL) return 0;
+      memset(tmp + st->cap, 0, cap - st->cap);
+      st->na[s] = tmp;
+    }
+    st->cap = cap;
+  }
+  if (maxploid > st->maxploid)
+  {
+    unsigned char ***tmp = (unsigned char ***) realloc(st->planes, maxploid * sizeof(unsigned char **));
+    if (tmp == NULL) return 0;
+    st->planes = tmp;
+    for (int k = st->maxploid; k < maxploid; k++)
+    {
+      st->planes[k] = (unsigned char **) calloc(nsamp > 0 ? nsamp : 1, sizeof(unsigned char *));
+      if (st->planes[k] == NULL) return 0;
+      // The plane is freed with the store from here on, even if it is
+      // incomplete.
+      st->maxploid = k + 1;
+      for (int s = 0; s < nsamp; s++)
+      {
+        st->planes[k][s] = (unsigned char *) calloc(st->cap > 0 ? st->cap : 1, 1);
+        if (st->planes[k][s] == NULL) return 0;
+      }
+    }
+  }
+  if (st->nloc + nnew > st->loccap)
+  {
+    int cap = st->loccap > 0 ? st->loccap : 1024;
+    while (cap < st->nloc + nnew)
+    {
+      cap *= 2;
+    }
+    char **chrom    = (char **) realloc(st->chrom, cap * sizeof(char *));
+    if (chrom == NULL) return 0;
+    st->chrom = chrom;
+    int *position   = (int *) realloc(st->position, cap * sizeof(int));
+    if (position == NULL) return 0;
+    st->position = position;
+    char **locname  = (char **) realloc(st->locname, cap * sizeof(char *));
+    if (locname == NULL) return 0;
+    st->locname = locname;
+    char **alleles  = (char **) realloc(st->alleles, cap * sizeof(char *));
+    if (alleles == NULL) return 0;
+    st->alleles = alleles;
+    st->loccap  = cap;
+  }
+  return 1;
+}
+
+static SEXP vcf_snpbin(SEXP class_def, vcf_store *st, int s, size_t nbytes)
+{
+  SEXP Rsnp_symbol    = PROTECT(install("snp"));
+  SEXP Rnloc_symbol   = PROTECT(install("n.loc"));
+  SEXP Rna_symbol     = PROTECT(install("NA.posi"));
+  SEXP Rploidy_symbol = PROTECT(install("ploidy"));
+  SEXP res    = PROTECT(R_do_new_object(class_def));
+  int ploidy  = st->ploidy[s] > 0 ? st->ploidy[s] : 1;
+  int nplanes = ploidy < st->maxploid ? ploidy : st->maxploid;
+  SEXP snp    = PROTECT(allocVector(VECSXP, nplanes));
+  for (int k = 0; k < nplanes; k++)
+  {
+    SEXP plane = allocVector(RAWSXP, nbytes);
+    SET_VECTOR_ELT(snp, k, plane);
+    if (nbytes > 0)
+    {
+      memcpy(RAW(plane), st->planes[k][s], nbytes);
+    }
+  }
+  int nna = 0;
+  for (size_t b = 0; b < nbytes; b++)
+  {
+    unsigned char x = st->na[s][b];
+    while (x)
+    {
+      nna += x & 1;
+      x >>= 1;
+    }
+  }
+  SEXP na = PROTECT(allocVector(INTSXP, nna));
+  for (int i = 0, j = 0; i < st->nloc && j < nna; i++)
+  {
+    if (st->na[s][i / 8] & (1 << (i % 8)))
+    {
+      INTEGER(na)[j++] = i + 1;
+    }
+  }
+  R_do_slot_assign(res, Rsnp_symbol, snp);
+  R_do_slot_assign(res, Rnloc_symbol, ScalarInteger(st->nloc));
+  R_do_slot_assign(res, Rna_symbol, na);
+  R_do_slot_assign(res, Rploidy_symbol, ScalarInteger(ploidy));
+  UNPROTECT(7);
+  return res;
+}
+
+/*~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+Read the genotypes of a VCF file into SNPbin objects.
+
+Input:
+  file        - the name of a plain or gzipped (including bgzipped) VCF file
+  biallelic   - if TRUE, only sites with exactly one alternate allele are kept.
+                Otherwise, all alternate alleles are counted together.
+  maf         - the minimum minor allele frequency of a site
+  max_missing - the maximum fraction of samples with missing genotypes
+  chunk_size  - the number of lines parsed at once
+  threads     - the number of threads
+Output:
+  a list with
+    gen        - a list of SNPbin objects, one per sample
+    ind.names  - the sample names
+    loc.names  - the ID of every locus (NA if missing)
+    chromosome - the chromosome of every locus
+    position   - the position of every locus
+    alleles    - the alleles of every locus as "REF/ALT"
+    ploidy     - the ploidy of every sample
+    sites      - the number of sites in the file
+~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+SEXP read_vcf_native(SEXP file, SEXP biallelic, SEXP maf, SEXP max_missing, 
+                     SEXP chunk_size, SEXP threads)
+{
+  const char *fname = R_ExpandFileName(CHAR(STRING_ELT(file, 0)));
+  int bi          = asLogical(biallelic);
+  double min_maf  = asReal(maf);
+  double max_miss = asReal(max_missing);
+  int chunk_lines = asInteger(chunk_size);
+  int nthreads    = poppr_threads(threads);
+  const char *problem = NULL;
+  vcf_reader r;
+  vcf_chunk chunk;
+  vcf_store st;
+  vcf_site *sites      = NULL;
+  signed char *dosage  = NULL;
+  signed char *nal     = NULL;
+  char **samples       = NULL;
+  char **chroms        = NULL; // unique chromosome names
+  int nchroms = 0, chromcap = 0;
+  int nsamp = 0;
+  double nsites = 0;
+  char *line;
+  size_t len;
+  int status;
+
+  if (chunk_lines < 1)
+  {
+    chunk_lines = 1;
+  }
+  memset(&r, 0, sizeof(vcf_reader));
+  memset(&chunk, 0, sizeof(vcf_chunk));
+  memset(&st, 0, sizeof(vcf_store));
+  r.gz = gzopen(fname, "rb");
+  if (r.gz == NULL)
+  {
+    error("cannot open file '%s'", CHAR(STRING_ELT(file, 0)));
+  }
+  gzbuffer(r.gz, VCF_BUFFER);
+  r.cap = VCF_BUFFER;
+  r.buf = (char *) malloc(r.cap);
+  if (r.buf == NULL)
+  {
+    gzclose(r.gz);
+    error("could not allocate memory to read '%s'", CHAR(STRING_ELT(file, 0)));
+  }
+
+  // Header ---------------------------------------------------------------------
+  while (1)
+  {
+    line = vcf_next_line(&r, &len, &status);
+    if (line == NULL)
+    {
+      problem = status < 0 ? "could not be read" : "has no #CHROM header line";
+      break;
+    }
+    if (strncmp(line, "##", 2) == 0)
+    {
+      continue;
+    }
+    if (strncmp(line, "#CHROM", 6) != 0)
+    {
+      problem = "has no #CHROM header line";
+      break;
+    }
+    const char *p = line;
+    for (int i = 0; i < 9 && p != NULL; i++)
+    {
+      p = vcf_next_field(p);
+    }
+    for (const char *q = p; q != NULL; q = vcf_next_field(q))
+    {
+      nsamp++;
+    }
+    samples = (char **) calloc(nsamp > 0 ? nsamp : 1, sizeof(char *));
+    for (int s = 0; samples != NULL && s < nsamp; s++, p = vcf_next_field(p))
+    {
+      samples[s] = vcf_strdup(p, vcf_field_len(p));
+    }
+    break;
+  }
+
+  // Body -----------------------------------------------------------------------
+  if (problem == NULL)
+  {
+    st.na     = (unsigned char **) calloc(nsamp > 0 ? nsamp : 1, sizeof(unsigned char *));
+    st.ploidy = (int *) calloc(nsamp > 0 ? nsamp : 1, sizeof(int));
+    chunk.offset = (size_t *) malloc(chunk_lines * sizeof(size_t));
+    sites  = (vcf_site *) malloc(chunk_lines * sizeof(vcf_site));
+    dosage = (signed char *) malloc((size_t) chunk_lines * (nsamp > 0 ? nsamp : 1));
+    nal    = (signed char *) malloc((size_t) chunk_lines * (nsamp > 0 ? nsamp : 1));
+    if (samples == NULL || st.na == NULL || st.ploidy == NULL ||
+        chunk.offset == NULL || sites == NULL || dosage == NULL || nal == NULL)
+    {
+      problem = "is too large for the available memory";
+    }
+  }
+  int done = problem != NULL;
+  while (!done)
+  {
+    // Read a chunk of lines
+    chunk.len    = 0;
+    chunk.nlines = 0;
+    while (chunk.nlines < chunk_lines)
+    {
+      line = vcf_next_line(&r, &len, &status);
+      if (line == NULL)
+      {
+        if (status < 0) problem = "could not be read";
+        done = 1;
+        break;
+      }
+      if (len == 0 || line[0] == '#')
+      {
+        continue;
+      }
+      if (chunk.len + len + 1 > chunk.cap)
+      {
+        size_t cap = chunk.cap > 0 ? chunk.cap : VCF_BUFFER;
+        while (cap < chunk.len + len + 1)
+        {
+          cap *= 2;
+        }
+        char *tmp = (char *) realloc(chunk.text, cap);
+        if (tmp == NULL)
+        {
+          problem = "is too large for the available memory";
+          done = 1;
+          break;
+        }
+        chunk.text = tmp;
+        chunk.cap  = cap;
+      }
+      memcpy(chunk.text + chunk.len, line, len + 1);
+      chunk.offset[chunk.nlines++] = chunk.len;
+      chunk.len += len + 1;
+    }
+    if (problem != NULL || chunk.nlines == 0)
+    {
+      break;
+    }
+    nsites += chunk.nlines;
+
+    // Parse the lines in parallel
+    int nlines = chunk.nlines;
+    #ifdef _OPENMP
+    #pragma omp parallel for schedule(dynamic) num_threads(nthreads)
+    #endif
+    for (int i = 0; i < nlines; i++)
+    {
+      vcf_parse_line(chunk.text + chunk.offset[i], nsamp, bi, min_maf, max_miss,
+                     &sites[i], dosage + (size_t) i * nsamp, nal + (size_t) i * nsamp);
+    }
+
+    // Record the metadata of the kept sites
+    int nkeep = 0, maxploid = st.maxploid;
+    for (int i = 0; i < nlines; i++)
+    {
+      nkeep += sites[i].keep;
+      if (sites[i].keep && sites[i].maxploid > maxploid)
+      {
+        maxploid = sites[i].maxploid;
+      }
+    }
+    if (!vcf_store_grow(&st, nsamp, nkeep, maxploid))
+    {
+      problem = "is too large for the available memory";
+      break;
+    }
+    int first = st.nloc;
+    for (int i = 0; i < nlines && problem == NULL; i++)
+    {
+      const vcf_site *site = &sites[i];
+      if (!site->keep)
+      {
+        continue;
+      }
+      size_t chrom_len = vcf_field_len(site->chrom);
+      if (nchroms == 0 || strlen(chroms[nchroms - 1]) != chrom_len || 
+          strncmp(chroms[nchroms - 1], site->chrom, chrom_len) != 0)
+      {
+        if (nchroms == chromcap)
+        {
+          chromcap = chromcap > 0 ? chromcap * 2 : 64;
+          char **tmp = (char **) realloc(chroms, chromcap * sizeof(char *));
+          if (tmp == NULL)
+          {
+            problem = "is too large for the available memory";
+            break;
+          }
+          chroms = tmp;
+        }
+        chroms[nchroms++] = vcf_strdup(site->chrom, chrom_len);
+      }
+      size_t id_len  = vcf_field_len(site->id);
+      size_t ref_len = vcf_field_len(site->ref);
+      size_t alt_len = vcf_field_len(site->alt);
+      int l = st.nloc;
+      st.chrom[l]    = chroms[nchroms - 1];
+      st.position[l] = atoi(site->pos);
+      st.locname[l]  = (id_len == 1 && site->id[0] == '.') ? NULL : vcf_strdup(site->id, id_len);
+      st.alleles[l]  = (char *) malloc(ref_len + alt_len + 2);
+      if (st.alleles[l] != NULL)
+      {
+        memcpy(st.alleles[l], site->ref, ref_len);
+        st.alleles[l][ref_len] = '/';
+        memcpy(st.alleles[l] + ref_len + 1, site->alt, alt_len);
+        st.alleles[l][ref_len + alt_len + 1] = '\0';
+      }
+      st.nloc++;
+    }
+    if (problem != NULL)
+    {
+      break;
+    }
+
+    // Append the kept sites to the planes of every sample
+    #ifdef _OPENMP
+    #pragma omp parallel for schedule(static) num_threads(nthreads)
+    #endif
+    for (int s = 0; s < nsamp; s++)
+    {
+      int l = first;
+      for (int i = 0; i < nlines; i++)
+      {
+        if (!sites[i].keep)
+        {
+          continue;
+        }
+        signed char d = dosage[(size_t) i * nsamp + s];
+        signed char a = nal[(size_t) i * nsamp + s];
+        unsigned char bit = (unsigned char) (1 << (l % 8));
+        if (a > st.ploidy[s])
+        {
+          st.ploidy[s] = a;
+        }
+        if (d == VCF_MISSING)
+        {
+          st.na[s][l / 8] |= bit;
+        }
+        else
+        {
+          for (int k = 0; k < d && k < st.maxploid; k++)
+          {
+            st.planes[k][s][l / 8] |= bit;
+          }
+        }
+        l++;
+      }
+    }
+  }
+  gzclose(r.gz);
+  free(r.buf);
+  free(chunk.text);
+  free(chunk.offset);
+  free(sites);
+  free(dosage);
+  free(nal);
+  if (problem == NULL)
+  {
+    for (int i = 0; i < st.nloc; i++)
+    {
+      if (st.alleles[i] == NULL)
+      {
+        problem = "is too large for the available memory";
+        break;
+      }
+    }
+  }
+
+  // Output ---------------------------------------------------------------------
+  SEXP res = R_NilValue;
+  if (problem == NULL)
+  {
+    size_t nbytes = ((size_t) st.nloc + 7) / 8;
+    SEXP class_def = PROTECT(R_do_MAKE_CLASS("SNPbin"));
+    SEXP gen       = PROTECT(allocVector(VECSXP, nsamp));
+    SEXP ind_names = PROTECT(allocVector(STRSXP, nsamp));
+    SEXP loc_names = PROTECT(allocVector(STRSXP, st.nloc));
+    SEXP chrom     = PROTECT(allocVector(STRSXP, st.nloc));
+    SEXP position  = PROTECT(allocVector(INTSXP, st.nloc));
+    SEXP alleles   = PROTECT(allocVector(STRSXP, st.nloc));
+    SEXP ploidy    = PROTECT(allocVector(INTSXP, nsamp));
+    SEXP names     = PROTECT(allocVector(STRSXP, 8));
+    res = PROTECT(allocVector(VECSXP, 8));
+    for (int s = 0; s < nsamp; s++)
+    {
+      SET_VECTOR_ELT(gen, s, vcf_snpbin(class_def, &st, s, nbytes));
+      SET_STRING_ELT(ind_names, s, mkChar(samples[s] != NULL ? samples[s] : ""));
+      INTEGER(ploidy)[s] = st.ploidy[s] > 0 ? st.ploidy[s] : 1;
+      // The planes are no longer needed once they are copied to R.
+      for (int k = 0; k < st.maxploid; k++)
+      {
+        free(st.planes[k][s]);
+        st.planes[k][s] = NULL;
+      }
+      free(st.na[s]);
+      st.na[s] = NULL;
+    }
+    SEXP chrom_sexp = R_NilValue;
+    for (int l = 0; l < st.nloc; l++)
+    {
+      if (l == 0 || st.chrom[l] != st.chrom[l - 1])
+      {
+        chrom_sexp = mkChar(st.chrom[l]);
+      }
+      SET_STRING_ELT(chrom, l, chrom_sexp);
+      SET_STRING_ELT(loc_names, l, st.locname[l] != NULL ? mkChar(st.locname[l]) : NA_STRING);
+      SET_STRING_ELT(alleles, l, mkChar(st.alleles[l]));
+      INTEGER(position)[l] = st.position[l];
+    }
+    SET_VECTOR_ELT(res, 0, gen);
+    SET_VECTOR_ELT(res, 1, ind_names);
+    SET_VECTOR_ELT(res, 2, loc_names);
+    SET_VECTOR_ELT(res, 3, chrom);
+    SET_VECTOR_ELT(res, 4, position);
+    SET_VECTOR_ELT(res, 5, alleles);
+    SET_VECTOR_ELT(res, 6, ploidy);
+    SET_VECTOR_ELT(res, 7, ScalarReal(nsites));
+    SET_STRING_ELT(names, 0, mkChar("gen"));
+    SET_STRING_ELT(names, 1, mkChar("ind.names"));
+    SET_STRING_ELT(names, 2, mkChar("loc.names"));
+    SET_STRING_ELT(names, 3, mkChar("chromosome"));
+    SET_STRING_ELT(names, 4, mkChar("position"));
+    SET_STRING_ELT(names, 5, mkChar("alleles"));
+    SET_STRING_ELT(names, 6, mkChar("ploidy"));
+    SET_STRING_ELT(names, 7, mkChar("sites"));
+    setAttrib(res, R_NamesSymbol, names);
+    UNPROTECT(10);
+  }
+  vcf_store_free(&st, nsamp);
+  for (int s = 0; samples != NULL && s < nsamp; s++)
+  {
+    free(samples[s]);
+  }
+  free(samples);
+  for (int i = 0; i < nchroms; i++)
+  {
+    free(chroms[i]);
+  }
+  free(chroms);
+  if (problem != NULL)
+  {
+    error("'%s' %s", CHAR(STRING_ELT(file, 0)), problem);
+  }
+  return res;
+}